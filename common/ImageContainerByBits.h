@@ -0,0 +1,316 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#pragma once
+
+/**
+ * @file ImageContainerByBits.h
+ *
+ * Header file for module ImageContainerByBits.ih
+ *
+ * Bit-packed binary volumes (snow masks), one bit per voxel.
+ */
+
+#if defined(ImageContainerByBits_RECURSES)
+#error Recursive header files inclusion detected in ImageContainerByBits.h
+#else // defined(ImageContainerByBits_RECURSES)
+/** Prevents recursive inclusion of headers. */
+#define ImageContainerByBits_RECURSES
+
+#if !defined ImageContainerByBits_h
+/** Prevents repeated inclusion of headers. */
+#define ImageContainerByBits_h
+
+//////////////////////////////////////////////////////////////////////////////
+// Inclusions
+#include <iostream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <cstddef>
+#include <stdint.h>
+#include <boost/static_assert.hpp>
+
+#include "DGtal/base/Common.h"
+#include "ImageContainerByMmapVol.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace DGtal
+{
+
+  /////////////////////////////////////////////////////////////////////////////
+  // template class ImageContainerByBits
+  /**
+   * Description of template class 'ImageContainerByBits' <p>
+   * \brief Aim: binary image storing one bit per voxel in 64-bit words,
+   * 8 times smaller than an unsigned char volume.
+   *
+   * Each row of voxels along x starts on a new word (the last word of a
+   * row is padded with zeros), so that the whole-image operations
+   * (count(), boolean operators, addBorder(), downsample()) work on words
+   * instead of voxels.
+   *
+   * @tparam TDomain a 3d HyperRectDomain
+   */
+  template <typename TDomain>
+  class ImageContainerByBits
+  {
+
+    BOOST_STATIC_ASSERT( TDomain::dimension == 3 );
+
+    // ----------------------- Types ------------------------------
+  public:
+
+    typedef bool Value;
+    typedef TDomain Domain;
+    typedef typename Domain::Point Point;
+    typedef typename Domain::Vector Vector;
+    typedef typename Domain::Dimension Dimension;
+    typedef typename Domain::Size Size;
+    static const Dimension dimension = Domain::dimension;
+
+    typedef uint64_t Word;
+    static const int wordBits = 64;
+
+    /**
+     * How the values of a block are reduced to one voxel by downsample().
+     */
+    enum Reduction { ANY, ALL, MAJORITY };
+
+    /**
+     * Read-only iterator on the voxel values, in the order of the domain.
+     */
+    class ConstIterator
+    {
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef bool value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const bool* pointer;
+      typedef bool reference;
+
+      ConstIterator() : myImage( 0 ), myWord( 0 ), myBit( 0 ), myX( 0 ) {}
+      ConstIterator( const ImageContainerByBits *anImage, Size aWord, int aBit, int anX )
+        : myImage( anImage ), myWord( aWord ), myBit( aBit ), myX( anX ) {}
+      Value operator*() const { return ( myImage->myWords[ myWord ] >> myBit ) & 1; }
+      ConstIterator & operator++();
+      ConstIterator operator++( int ) { ConstIterator tmp( *this ); ++*this; return tmp; }
+      bool operator==( const ConstIterator & other ) const
+      { return myWord == other.myWord && myBit == other.myBit; }
+      bool operator!=( const ConstIterator & other ) const { return ! ( *this == other ); }
+    private:
+      const ImageContainerByBits *myImage;
+      Size myWord;
+      int myBit, myX;
+    };
+    typedef ConstIterator const_iterator;
+
+    /**
+     * Range of the voxel values, in the order of the domain.
+     */
+    class ConstRange
+    {
+    public:
+      typedef typename ImageContainerByBits::ConstIterator ConstIterator;
+      ConstRange( ConstIterator aBegin, ConstIterator anEnd ) : myBegin( aBegin ), myEnd( anEnd ) {}
+      ConstIterator begin() const { return myBegin; }
+      ConstIterator end() const { return myEnd; }
+    private:
+      ConstIterator myBegin, myEnd;
+    };
+    typedef ConstRange Range;
+
+    // ----------------------- Standard services ------------------------------
+  public:
+
+    /**
+     * Constructor: empty image (every voxel false) on @a aDomain.
+     */
+    ImageContainerByBits( const Domain & aDomain );
+
+    /**
+     * Destructor.
+     */
+    ~ImageContainerByBits();
+
+    // ----------------------- Interface --------------------------------------
+  public:
+
+    /**
+     * @return the domain of the image.
+     */
+    const Domain & domain() const { return myDomain; }
+
+    /**
+     * @return the size of the image in each direction.
+     */
+    Vector extent() const { return myExtent; }
+
+    /**
+     * @param aPoint a point of the domain.
+     * @return the value at @a aPoint.
+     */
+    Value operator() ( const Point & aPoint ) const
+    {
+      int x = aPoint[0] - myDomain.lowerBound()[0];
+      return ( row( aPoint[1] - myDomain.lowerBound()[1], aPoint[2] - myDomain.lowerBound()[2] )
+               [ x / wordBits ] >> ( x % wordBits ) ) & 1;
+    }
+
+    /**
+     * Changes the value at @a aPoint.
+     */
+    void setValue( const Point & aPoint, const Value & aValue )
+    {
+      int x = aPoint[0] - myDomain.lowerBound()[0];
+      Word &w = row( aPoint[1] - myDomain.lowerBound()[1], aPoint[2] - myDomain.lowerBound()[2] )[ x / wordBits ];
+      Word bit = (Word)1 << ( x % wordBits );
+      w = aValue ? ( w | bit ) : ( w & ~bit );
+    }
+
+    ConstRange constRange() const { return ConstRange( begin(), end() ); }
+    ConstRange range() const { return constRange(); }
+    ConstIterator begin() const { return ConstIterator( this, 0, 0, 0 ); }
+    ConstIterator end() const { return ConstIterator( this, myWords.size(), 0, 0 ); }
+
+    /**
+     * @return the number of words of a row along x.
+     */
+    int wordsPerRow() const { return myWordsPerRow; }
+
+    /**
+     * @param y the row ordinate, from 0 to extent()[1]-1.
+     * @param z the row slice, from 0 to extent()[2]-1.
+     * @return the words of row (y, z); voxel x is bit x%64 of word x/64.
+     */
+    Word * row( int y, int z ) { return &myWords[ ( (Size)z * myExtent[1] + y ) * myWordsPerRow ]; }
+    const Word * row( int y, int z ) const { return &myWords[ ( (Size)z * myExtent[1] + y ) * myWordsPerRow ]; }
+
+    /**
+     * @return the number of true voxels.
+     */
+    Size count() const;
+
+    /**
+     * Sets every voxel to @a aValue.
+     */
+    void fill( const Value & aValue );
+
+    /**
+     * Boolean operations, voxel by voxel, with an image of the same
+     * extent.
+     */
+    ImageContainerByBits & operator&= ( const ImageContainerByBits & other );
+    ImageContainerByBits & operator|= ( const ImageContainerByBits & other );
+    ImageContainerByBits & operator^= ( const ImageContainerByBits & other );
+
+    /**
+     * Negates every voxel.
+     */
+    void flip();
+
+    /**
+     * @param aWidth the width of the border.
+     * @param aValue the value of the border voxels.
+     * @return a copy of this image with a border of @a aWidth voxels on
+     * each side; the lower bound of the domain moves by -@a aWidth.
+     */
+    ImageContainerByBits addBorder( int aWidth, const Value & aValue = false ) const;
+
+    /**
+     * @param aFactor the sub-sampling factor in each direction.
+     * @param aReduction how the (at most) @a aFactor^3 voxels of a block
+     * are reduced: ANY (one of them is true), ALL (all of them are true) or
+     * MAJORITY (at least half of them are true).
+     * @return the sub-sampled image, on [0, ceil(extent/aFactor)-1].
+     */
+    ImageContainerByBits downsample( int aFactor, Reduction aReduction ) const;
+
+    /**
+     * Checks the validity/consistency of the object.
+     * @return 'true' if the object is valid, 'false' otherwise.
+     */
+    bool isValid() const { return myWords.size() == (Size)myWordsPerRow * myExtent[1] * myExtent[2]; }
+
+    /**
+     * Writes/Displays the object on an output stream.
+     * @param out the output stream where the object is written.
+     */
+    void selfDisplay ( std::ostream & out ) const;
+
+    // ------------------------- Private Datas --------------------------------
+  private:
+
+    Domain myDomain;
+    Vector myExtent;
+    int myWordsPerRow;
+    std::vector<Word> myWords;
+
+    /**
+     * @return the mask of the valid bits of the last word of a row.
+     */
+    Word lastWordMask() const;
+
+  }; // end of class ImageContainerByBits
+
+
+  /**
+   * Overloads 'operator<<' for displaying objects of class 'ImageContainerByBits'.
+   * @param out the output stream where the object is written.
+   * @param object the object of class 'ImageContainerByBits' to write.
+   * @return the output stream after the writing.
+   */
+  template <typename TDomain>
+  std::ostream&
+  operator<< ( std::ostream & out, const ImageContainerByBits<TDomain> & object );
+
+
+  /**
+   * Thresholds a vol file into a binary image: a voxel is true if its value
+   * is in ]@a aMin, @a aMax]. The file is read through ImageContainerByMmapVol.
+   * Throws an IOException if it is not a readable vol file.
+   *
+   * @return the binary image, on [0, extent-1].
+   */
+  template <typename TDomain>
+  ImageContainerByBits<TDomain> importVolBits( const std::string & aFilename,
+                                               int aMin = 0, int aMax = 255 );
+
+  /**
+   * Writes @a anImage in the vol file @a aFilename through MmapVolWriter:
+   * @a aTrue for true voxels, 0 for the others.
+   *
+   * @return 'true' if the file has been written.
+   */
+  template <typename TDomain>
+  bool exportVolBits( const std::string & aFilename, const ImageContainerByBits<TDomain> & anImage,
+                      unsigned char aTrue = 255 );
+
+} // namespace DGtal
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes inline functions.
+#include "ImageContainerByBits.ih"
+
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // !defined ImageContainerByBits_h
+
+#undef ImageContainerByBits_RECURSES
+#endif // else defined(ImageContainerByBits_RECURSES)
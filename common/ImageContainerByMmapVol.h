@@ -0,0 +1,311 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **/
+
+#pragma once
+
+/**
+ * @file ImageContainerByMmapVol.h
+ *
+ * Header file for module ImageContainerByMmapVol.ih
+ *
+ * Memory-mapped access to DGtal vol files, shared by the tools of the
+ * project instead of VolReader / VolWriter.
+ */
+
+#if defined(ImageContainerByMmapVol_RECURSES)
+#error Recursive header files inclusion detected in ImageContainerByMmapVol.h
+#else // defined(ImageContainerByMmapVol_RECURSES)
+/** Prevents recursive inclusion of headers. */
+#define ImageContainerByMmapVol_RECURSES
+
+#if !defined ImageContainerByMmapVol_h
+/** Prevents repeated inclusion of headers. */
+#define ImageContainerByMmapVol_h
+
+//////////////////////////////////////////////////////////////////////////////
+// Inclusions
+#include <iostream>
+#include <string>
+#include <iterator>
+#include <algorithm>
+#include <cstddef>
+#include <boost/shared_ptr.hpp>
+#include <boost/static_assert.hpp>
+
+#include "DGtal/base/Common.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace DGtal
+{
+
+  /**
+   * Reads the header of a vol file: "Key: value" lines ended by a "."
+   * line, followed by the voxels (one byte each, x first).
+   *
+   * @param aFilename the vol file.
+   * @param anExtent (returned) the X, Y and Z sizes.
+   * @param aHeaderSize (returned) the offset of the first voxel.
+   * @return 'true' if the header is complete.
+   */
+  bool readVolHeader( const std::string & aFilename, int anExtent[3], std::size_t & aHeaderSize );
+
+  /**
+   * @return the header written by VolWriter for a volume of size
+   * @a nx * @a ny * @a nz.
+   */
+  std::string volHeader( int nx, int ny, int nz );
+
+
+  /////////////////////////////////////////////////////////////////////////////
+  // template class ImageContainerByMmapVol
+  /**
+   * Description of template class 'ImageContainerByMmapVol' <p>
+   * \brief Aim: image view on a vol file mapped in memory, instead of
+   * VolReader which copies every voxel into an ImageContainerBySTLVector.
+   * Opening the file only parses its header: voxels are paged in on
+   * access, and the pages are shared through the page cache by every
+   * process that maps the same file.
+   *
+   * The mapping is private: setValue() only modifies a copy-on-write page
+   * of this image, never the file. Copies of the image share the same
+   * mapping.
+   *
+   * The domain is [0, extent-1], as with VolReader.
+   *
+   * @tparam TDomain a 3d HyperRectDomain
+   * @tparam TValue a one byte value type (vol voxels)
+   */
+  template <typename TDomain, typename TValue = unsigned char>
+  class ImageContainerByMmapVol
+  {
+
+    BOOST_STATIC_ASSERT( TDomain::dimension == 3 );
+    BOOST_STATIC_ASSERT( sizeof(TValue) == 1 );
+
+    // ----------------------- Types ------------------------------
+  public:
+
+    typedef TValue Value;
+    typedef TDomain Domain;
+    typedef typename Domain::Point Point;
+    typedef typename Domain::Vector Vector;
+    typedef typename Domain::Dimension Dimension;
+    typedef typename Domain::Size Size;
+    static const Dimension dimension = Domain::dimension;
+
+    typedef Value* Iterator;
+    typedef const Value* ConstIterator;
+    typedef Iterator iterator;
+    typedef ConstIterator const_iterator;
+    typedef std::reverse_iterator<ConstIterator> ConstReverseIterator;
+
+    /**
+     * Range of the voxel values, in the order of the domain.
+     */
+    class ConstRange
+    {
+    public:
+      typedef typename ImageContainerByMmapVol::ConstIterator ConstIterator;
+      typedef typename ImageContainerByMmapVol::ConstReverseIterator ConstReverseIterator;
+      ConstRange( ConstIterator aBegin, ConstIterator anEnd ) : myBegin( aBegin ), myEnd( anEnd ) {}
+      ConstIterator begin() const { return myBegin; }
+      ConstIterator end() const { return myEnd; }
+      ConstReverseIterator rbegin() const { return ConstReverseIterator( myEnd ); }
+      ConstReverseIterator rend() const { return ConstReverseIterator( myBegin ); }
+    private:
+      ConstIterator myBegin, myEnd;
+    };
+    typedef ConstRange Range;
+
+    // ----------------------- Standard services ------------------------------
+  public:
+
+    /**
+     * Constructor: maps @a aFilename.
+     * Throws an IOException if it is not a readable vol file.
+     *
+     * @param aFilename a vol file.
+     */
+    ImageContainerByMmapVol( const std::string & aFilename );
+
+    /**
+     * Destructor. The file is unmapped with the last copy.
+     */
+    ~ImageContainerByMmapVol();
+
+    // ----------------------- Interface --------------------------------------
+  public:
+
+    /**
+     * @return the domain of the image.
+     */
+    const Domain & domain() const { return myDomain; }
+
+    /**
+     * @return the size of the image in each direction.
+     */
+    Vector extent() const { return myExtent; }
+
+    /**
+     * @param aPoint a point of the domain.
+     * @return the value at @a aPoint.
+     */
+    Value operator() ( const Point & aPoint ) const { return myData[ linearized( aPoint ) ]; }
+
+    /**
+     * Changes the value at @a aPoint in the private mapping (the file is
+     * not modified).
+     */
+    void setValue( const Point & aPoint, const Value & aValue ) { myData[ linearized( aPoint ) ] = aValue; }
+
+    ConstRange constRange() const { return ConstRange( myData, myData + mySize ); }
+    ConstRange range() const { return constRange(); }
+    ConstIterator begin() const { return myData; }
+    ConstIterator end() const { return myData + mySize; }
+
+    /**
+     * @return the voxels, x first then y then z.
+     */
+    const Value * data() const { return myData; }
+
+    /**
+     * @return the linear index of @a aPoint in data().
+     */
+    Size linearized( const Point & aPoint ) const
+    {
+      return ( (Size)aPoint[2] * myExtent[1] + aPoint[1] ) * myExtent[0] + aPoint[0];
+    }
+
+    /**
+     * Checks the validity/consistency of the object.
+     * @return 'true' if the object is valid, 'false' otherwise.
+     */
+    bool isValid() const { return myData != 0; }
+
+    /**
+     * Writes/Displays the object on an output stream.
+     * @param out the output stream where the object is written.
+     */
+    void selfDisplay ( std::ostream & out ) const;
+
+    // ------------------------- Private Datas --------------------------------
+  private:
+
+    /**
+     * A mapped file, unmapped by its destructor.
+     */
+    struct Mapping
+    {
+      void *address;
+      std::size_t length;
+      ~Mapping();
+    };
+
+    boost::shared_ptr<Mapping> myMapping;
+    Value *myData;
+    Size mySize;
+    Domain myDomain;
+    Vector myExtent;
+
+  }; // end of class ImageContainerByMmapVol
+
+
+  /**
+   * Overloads 'operator<<' for displaying objects of class 'ImageContainerByMmapVol'.
+   * @param out the output stream where the object is written.
+   * @param object the object of class 'ImageContainerByMmapVol' to write.
+   * @return the output stream after the writing.
+   */
+  template <typename TDomain, typename TValue>
+  std::ostream&
+  operator<< ( std::ostream & out, const ImageContainerByMmapVol<TDomain,TValue> & object );
+
+
+  /////////////////////////////////////////////////////////////////////////////
+  // class MmapVolWriter
+  /**
+   * Description of class 'MmapVolWriter' <p>
+   * \brief Aim: writes a vol file directly: the file is created at its
+   * final size with the VolWriter header, and its voxels are mapped in
+   * memory to be filled in place (x first then y then z).
+   */
+  class MmapVolWriter
+  {
+  public:
+
+    /**
+     * Creates @a aFilename for a volume of size @a nx * @a ny * @a nz.
+     * Throws an IOException if the file cannot be created.
+     */
+    MmapVolWriter( const std::string & aFilename, int nx, int ny, int nz );
+
+    /**
+     * Destructor: closes the file if close() was not called.
+     */
+    ~MmapVolWriter();
+
+    /**
+     * @return the voxels to fill.
+     */
+    unsigned char * data() { return myData; }
+
+    /**
+     * @return the number of voxels.
+     */
+    std::size_t size() const { return mySize; }
+
+    /**
+     * Unmaps and closes the file.
+     * @return 'true' if the voxels have been written.
+     */
+    bool close();
+
+  private:
+    void *myAddress;
+    std::size_t myLength, mySize;
+    unsigned char *myData;
+    int myFile;
+
+    MmapVolWriter ( const MmapVolWriter & other );
+    MmapVolWriter & operator= ( const MmapVolWriter & other );
+  }; // end of class MmapVolWriter
+
+
+  /**
+   * Writes @a anImage in the vol file @a aFilename through MmapVolWriter,
+   * each value being converted to a voxel by @a aFunctor. Replaces
+   * VolWriter::exportVol.
+   *
+   * @return 'true' if the file has been written.
+   */
+  template <typename TImage, typename TFunctor>
+  bool exportVolMmap( const std::string & aFilename, const TImage & anImage, const TFunctor & aFunctor );
+
+} // namespace DGtal
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes inline functions.
+#include "ImageContainerByMmapVol.ih"
+
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // !defined ImageContainerByMmapVol_h
+
+#undef ImageContainerByMmapVol_RECURSES
+#endif // else defined(ImageContainerByMmapVol_RECURSES)
@@ -31,7 +31,8 @@
 #include <QtGui/qapplication.h>
 
 #include "DGtal/base/Common.h"
-#include "DGtal/io/readers/VolReader.h"
+#include "ImageContainerByMmapVol.h"
+#include "ImageContainerByBits.h"
 #include "DGtal/io/viewers/Viewer3D.h"
 #include "DGtal/io/DrawWithDisplay3DModifier.h"
 
@@ -60,7 +61,8 @@ int main( int argc, char** argv )
     ("input-file,i", po::value<std::string>(), "volume file" )
     ("thresholdMin,m",  po::value<int>()->default_value(0), "threshold min to define binary shape" ) 
     ("thresholdMax,M",  po::value<int>()->default_value(255), "threshold max to define binary shape" )
-    ("transparency,t",  po::value<uint>()->default_value(255), "transparency") ; 
+    ("transparency,t",  po::value<uint>()->default_value(255), "transparency")
+    ("packed,p", "threshold the volume into a bit-packed mask first, to skip the empty parts of the volume 64 voxels at a time") ; 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, general_opt), vm);  
   po::notify(vm);    
@@ -87,8 +89,8 @@ int main( int argc, char** argv )
   viewer.setWindowTitle("simple Volume Viewer");
   viewer.show();
  
-  typedef ImageSelector<Domain, unsigned char>::Type Image;
-  Image image = VolReader<Image>::importVol( inputFilename );
+  typedef ImageContainerByMmapVol<Domain, unsigned char> Image;
+  Image image( inputFilename );
 
   trace.info() << "Image loaded: "<<image<< std::endl;
 
@@ -98,6 +100,24 @@ int main( int argc, char** argv )
   gradient.addColor(Color::Green);
   gradient.addColor(Color::Yellow);
   gradient.addColor(Color::Red);
+  if(vm.count("packed")){
+    //voxels in [thresholdMin, thresholdMax], scanned word by word
+    typedef ImageContainerByBits<Domain> Mask;
+    Mask mask = importVolBits<Domain>( inputFilename, thresholdMin-1, thresholdMax );
+    trace.info() << "Mask: "<< mask.count() << " voxels" << std::endl;
+    for(int z=0; z<mask.extent()[2]; z++)
+      for(int y=0; y<mask.extent()[1]; y++){
+        const Mask::Word *row = mask.row( y, z );
+        for(int i=0; i<mask.wordsPerRow(); i++)
+          for(Mask::Word w = row[i]; w != 0; w &= w-1){
+            Point p( i*Mask::wordBits + __builtin_ctzll( w ), y, z );
+            Color c= gradient(image( p ));
+            viewer <<  CustomColors3D(Color((float)(c.red()), (float)(c.green()),(float)(c.blue()), transp),
+              Color((float)(c.red()), (float)(c.green()),(float)(c.blue()), transp));
+            viewer << p;
+          }
+      }
+  }else{
   for(Domain::ConstIterator it = domain.begin(), itend=domain.end(); it!=itend; ++it){
     unsigned char  val= image( (*it) );     
    
@@ -108,6 +128,7 @@ int main( int argc, char** argv )
       viewer << *it;     
     }     
   }
+  }
   viewer << Viewer3D::updateDisplay;
   return application.exec();
 }
@@ -11,7 +11,7 @@ namespace po = boost::program_options;
 /////////////////////
 #include <DGtal/base/Common.h>
 #include <DGtal/helpers/StdDefs.h>
-#include "DGtal/io/readers/VolReader.h"
+#include "ImageContainerByMmapVol.h"
 
 using namespace Z3i; 
 
@@ -123,7 +123,10 @@ int main(int argc, char** argv)
       string imageFileName = vm["inputImage"].as<std::string>();
       trace.emphase() << imageFileName <<std::endl; 
       typedef ImageContainerBySTLVector<Domain,unsigned char> BinaryImage; 
-      BinaryImage img = VolReader<BinaryImage>::importVol( imageFileName);
+      //the voxels are copied in one pass from the mapped file
+      ImageContainerByMmapVol<Domain,unsigned char> volFile( imageFileName );
+      BinaryImage img( volFile.domain() );
+      std::copy( volFile.begin(), volFile.end(), img.begin() );
       Domain d = img.domain(); 
       p = d.lowerBound(); q = d.upperBound(); 
       implicitFunction = ImageContainerBySTLVector<Domain,double>( Domain(p,q) ); 
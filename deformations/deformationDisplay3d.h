@@ -6,7 +6,15 @@
 
 #include "DGtal/io/Color.h"
 #include "DGtal/io/colormaps/GradientColorMap.h"
-#include "DGtal/io/writers/VolWriter.h"
+#include "ImageContainerByMmapVol.h"
+
+//label of a voxel in the vol files: 255 inside (value <= threshold), 0 outside
+struct Labeler {
+  double myThreshold; 
+  Labeler(const double& aThreshold) : myThreshold( aThreshold ) {}
+  template< typename TValue >
+  unsigned char operator()(const TValue& v) const { return (v <= myThreshold) ? 255 : 0; }
+}; 
 
 template< typename TImage >
 bool writeImage(const TImage& img, string filename, string format, const double& threshold = 0)
@@ -103,26 +111,10 @@ bool writeImage(const TImage& img, string filename, string format, const double&
   } else if (format.compare("vol")==0)
   {
 
-    //create a label image from the implicit function
-    typedef ImageContainerBySTLVector<Domain,int> LabelImage; 
-    LabelImage labelImage( img.domain() ); 
-    Domain d(labelImage.domain()); 
-    Domain::ConstIterator cIt = d.begin(); 
-    Domain::ConstIterator cItEnd = d.end(); 
-    for ( ; cIt != cItEnd; ++cIt)
-    { 
-      if (img(*cIt) <= threshold) 
-	       labelImage.setValue(*cIt,255);
-      else  
-	       labelImage.setValue(*cIt,0);
-    }
-    //write it into a vol file
+    //write the label image of the implicit function directly into a vol file
     std::stringstream s; 
     s << filename << ".vol";
-    typedef GradientColorMap<typename LabelImage::Value, DGtal::CMAP_GRAYSCALE> ColorMap; 
-    VolWriter<LabelImage,ColorMap>::exportVol( s.str(), labelImage, 0, 255 );
-
-    return true; 
+    return exportVolMmap( s.str(), img, Labeler(threshold) ); 
 
  } else return false; 
   
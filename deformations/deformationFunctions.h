@@ -1,5 +1,6 @@
 //images
 #include <DGtal/images/ImageContainerBySTLVector.h>
+#include "ImageContainerByBits.h"
 
 /////////////////////////// useful functions
 template< typename TImage >
@@ -23,6 +24,13 @@ int setSize(TImage& img, const double& threshold = 0)
   return c; 
 }
 
+//bit-packed mask: the true voxels are counted 64 at a time
+template< typename TDomain >
+int setSize(const DGtal::ImageContainerByBits<TDomain>& img)
+{
+  return img.count(); 
+}
+
 
 template< typename TImage >
 void initWithBall(TImage& img, const typename TImage::Point& c, const double& r)
@@ -27,6 +27,7 @@
 #include "accelerators/bvh.h"
 #include "probes.h"
 #include "paramset.h"
+#include "parallel.h"
 
 // BVHAccel Local Declarations
 struct BVHPrimitiveInfo {
@@ -62,6 +63,47 @@ struct BVHBuildNode {
 };
 
 
+// Shared state of a (possibly parallel) BVH build; leaves store their
+// primitives at the same offset as in _buildData_, so subtrees can be built
+// by different tasks and still give the sequential build's layout
+struct BVHBuildState {
+    BVHBuildState(uint32_t n) : orderedPrims(n) {
+        totalNodes = 0;
+        mutex = Mutex::Create();
+    }
+    ~BVHBuildState();
+    AtomicInt32 totalNodes;
+    vector<Reference<Primitive> > orderedPrims;
+    Mutex *mutex;
+    vector<Task *> subtreeTasks;
+};
+
+
+class BVHBuildTask : public Task {
+public:
+    BVHBuildTask(BVHAccel *a, vector<BVHPrimitiveInfo> &bd, uint32_t s,
+                 uint32_t e, BVHBuildState &st)
+        : accel(a), buildData(bd), start(s), end(e), state(st), node(NULL) { }
+    void Run() {
+        node = accel->recursiveBuild(arena, buildData, start, end, state);
+    }
+    BVHAccel *accel;
+    vector<BVHPrimitiveInfo> &buildData;
+    uint32_t start, end;
+    BVHBuildState &state;
+    MemoryArena arena;
+    BVHBuildNode *node;
+};
+
+
+BVHBuildState::~BVHBuildState() {
+    // Subtree tasks own the arenas their nodes were allocated in
+    for (uint32_t i = 0; i < subtreeTasks.size(); ++i)
+        delete subtreeTasks[i];
+    Mutex::Destroy(mutex);
+}
+
+
 struct CompareToMid {
     CompareToMid(int d, float m) { dim = d; mid = m; }
     int dim;
@@ -173,13 +215,11 @@ BVHAccel::BVHAccel(const vector<Reference<Primitive> > &p,
 
     // Recursively build BVH tree for primitives
     MemoryArena buildArena;
-    uint32_t totalNodes = 0;
-    vector<Reference<Primitive> > orderedPrims;
-    orderedPrims.reserve(primitives.size());
+    BVHBuildState state(primitives.size());
     BVHBuildNode *root = recursiveBuild(buildArena, buildData, 0,
-                                        primitives.size(), &totalNodes,
-                                        orderedPrims);
-    primitives.swap(orderedPrims);
+                                        primitives.size(), state);
+    uint32_t totalNodes = state.totalNodes;
+    primitives.swap(state.orderedPrims);
         Info("BVH created with %d nodes for %d primitives (%.2f MB)", totalNodes,
              (int)primitives.size(), float(totalNodes * sizeof(LinearBVHNode))/(1024.f*1024.f));
 
@@ -201,10 +241,9 @@ BBox BVHAccel::WorldBound() const {
 
 BVHBuildNode *BVHAccel::recursiveBuild(MemoryArena &buildArena,
         vector<BVHPrimitiveInfo> &buildData, uint32_t start,
-        uint32_t end, uint32_t *totalNodes,
-        vector<Reference<Primitive> > &orderedPrims) {
+        uint32_t end, BVHBuildState &state) {
     Assert(start != end);
-    (*totalNodes)++;
+    AtomicAdd(&state.totalNodes, 1);
     BVHBuildNode *node = buildArena.Alloc<BVHBuildNode>();
     // Compute bounds of all primitives in BVH node
     BBox bbox;
@@ -213,10 +252,10 @@ BVHBuildNode *BVHAccel::recursiveBuild(MemoryArena &buildArena,
     uint32_t nPrimitives = end - start;
     if (nPrimitives == 1) {
         // Create leaf _BVHBuildNode_
-        uint32_t firstPrimOffset = orderedPrims.size();
+        uint32_t firstPrimOffset = start;
         for (uint32_t i = start; i < end; ++i) {
             uint32_t primNum = buildData[i].primitiveNumber;
-            orderedPrims.push_back(primitives[primNum]);
+            state.orderedPrims[i] = primitives[primNum];
         }
         node->InitLeaf(firstPrimOffset, nPrimitives, bbox);
     }
@@ -231,10 +270,10 @@ BVHBuildNode *BVHAccel::recursiveBuild(MemoryArena &buildArena,
         uint32_t mid = (start + end) / 2;
         if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) {
             // Create leaf _BVHBuildNode_
-            uint32_t firstPrimOffset = orderedPrims.size();
+            uint32_t firstPrimOffset = start;
             for (uint32_t i = start; i < end; ++i) {
                 uint32_t primNum = buildData[i].primitiveNumber;
-                orderedPrims.push_back(primitives[primNum]);
+                state.orderedPrims[i] = primitives[primNum];
             }
             node->InitLeaf(firstPrimOffset, nPrimitives, bbox);
             return node;
@@ -329,10 +368,10 @@ BVHBuildNode *BVHAccel::recursiveBuild(MemoryArena &buildArena,
                 
                 else {
                     // Create leaf _BVHBuildNode_
-                    uint32_t firstPrimOffset = orderedPrims.size();
+                    uint32_t firstPrimOffset = start;
                     for (uint32_t i = start; i < end; ++i) {
                         uint32_t primNum = buildData[i].primitiveNumber;
-                        orderedPrims.push_back(primitives[primNum]);
+                        state.orderedPrims[i] = primitives[primNum];
                     }
                     node->InitLeaf(firstPrimOffset, nPrimitives, bbox);
                     return node;
@@ -341,11 +380,26 @@ BVHBuildNode *BVHAccel::recursiveBuild(MemoryArena &buildArena,
             break;
         }
         }
-        node->InitInterior(dim,
-                           recursiveBuild(buildArena, buildData, start, mid,
-                                          totalNodes, orderedPrims),
-                           recursiveBuild(buildArena, buildData, mid, end,
-                                          totalNodes, orderedPrims));
+        if (nPrimitives < 32768 || PbrtOptions.nCores == 1)
+            node->InitInterior(dim,
+                               recursiveBuild(buildArena, buildData, start,
+                                              mid, state),
+                               recursiveBuild(buildArena, buildData, mid,
+                                              end, state));
+        else {
+            // Build both children of large nodes in parallel
+            BVHBuildTask *t0 = new BVHBuildTask(this, buildData, start, mid, state);
+            BVHBuildTask *t1 = new BVHBuildTask(this, buildData, mid, end, state);
+            { MutexLock lock(*state.mutex);
+            state.subtreeTasks.push_back(t0);
+            state.subtreeTasks.push_back(t1);
+            }
+            vector<Task *> tasks;
+            tasks.push_back(t0);
+            tasks.push_back(t1);
+            RunTasks(tasks);
+            node->InitInterior(dim, t0->node, t1->node);
+        }
     }
     return node;
 }
@@ -35,6 +35,7 @@ struct BVHBuildNode;
 
 // BVHAccel Forward Declarations
 struct BVHPrimitiveInfo;
+struct BVHBuildState;
 struct LinearBVHNode;
 
 // BVHAccel Declarations
@@ -49,10 +50,11 @@ public:
     bool Intersect(const Ray &ray, Intersection *isect) const;
     bool IntersectP(const Ray &ray) const;
 private:
+    friend class BVHBuildTask;
     // BVHAccel Private Methods
     BVHBuildNode *recursiveBuild(MemoryArena &buildArena,
         vector<BVHPrimitiveInfo> &buildData, uint32_t start, uint32_t end,
-        uint32_t *totalNodes, vector<Reference<Primitive> > &orderedPrims);
+        BVHBuildState &state);
     uint32_t flattenBVHTree(BVHBuildNode *node, uint32_t *offset);
 
     // BVHAccel Private Data
@@ -0,0 +1,495 @@
+
+/*
+    pbrt source code Copyright(c) 1998-2010 Matt Pharr and Greg Humphreys.
+
+    This file is part of pbrt.
+
+    pbrt is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.  Note that the text contents of
+    the book "Physically Based Rendering" are *not* licensed under the
+    GNU GPL.
+
+    pbrt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+// accelerators/trianglesoup.cpp*
+#include "stdafx.h"
+#include "accelerators/trianglesoup.h"
+#include "intersection.h"
+#include "probes.h"
+
+extern bool PhotonImage;
+class BVHAccel;
+struct LinearBVHNode;
+
+// TriangleSoupPrimitive Local Declarations
+struct SoupBuildInfo {
+    SoupBuildInfo() { }
+    SoupBuildInfo(int tn, const BBox &b)
+        : triNumber(tn), bounds(b) {
+        centroid = .5f * b.pMin + .5f * b.pMax;
+    }
+    int triNumber;
+    Point centroid;
+    BBox bounds;
+};
+
+
+struct SoupBVHNode {
+    BBox bounds;
+    union {
+        uint32_t trisOffset;          // leaf
+        uint32_t secondChildOffset;   // interior
+    };
+
+    uint8_t nTris;        // 0 -> interior node
+    uint8_t axis;         // interior node: xyz
+    uint8_t pad[2];       // ensure 32 byte total size
+};
+
+
+struct CompareSoupCentroids {
+    CompareSoupCentroids(int d) { dim = d; }
+    int dim;
+    bool operator()(const SoupBuildInfo &a, const SoupBuildInfo &b) const {
+        return a.centroid[dim] < b.centroid[dim];
+    }
+};
+
+
+struct CompareSoupToBucket {
+    CompareSoupToBucket(int split, int num, int d, const BBox &b)
+        : centroidBounds(b)
+    { splitBucket = split; nBuckets = num; dim = d; }
+    bool operator()(const SoupBuildInfo &p) const {
+        int b = nBuckets * ((p.centroid[dim] - centroidBounds.pMin[dim]) /
+                (centroidBounds.pMax[dim] - centroidBounds.pMin[dim]));
+        if (b == nBuckets) b = nBuckets-1;
+        return b <= splitBucket;
+    }
+
+    int splitBucket, nBuckets, dim;
+    const BBox &centroidBounds;
+};
+
+
+static inline bool IntersectP(const BBox &bounds, const Ray &ray,
+        const Vector &invDir, const uint32_t dirIsNeg[3]) {
+    // Check for ray intersection against $x$ and $y$ slabs
+    // The far distances are slightly enlarged: voxel faces give flat leaf
+    // boxes, and a ray through a face edge must not be rounded out
+    const float farScale = 1.f + 2.f * 3.f * 0.5f * 1.19209290e-07f;
+    float tmin =  (bounds[  dirIsNeg[0]].x - ray.o.x) * invDir.x;
+    float tmax =  (bounds[1-dirIsNeg[0]].x - ray.o.x) * invDir.x * farScale;
+    float tymin = (bounds[  dirIsNeg[1]].y - ray.o.y) * invDir.y;
+    float tymax = (bounds[1-dirIsNeg[1]].y - ray.o.y) * invDir.y * farScale;
+    if ((tmin > tymax) || (tymin > tmax))
+        return false;
+    if (tymin > tmin) tmin = tymin;
+    if (tymax < tmax) tmax = tymax;
+
+    // Check for ray intersection against $z$ slab
+    float tzmin = (bounds[  dirIsNeg[2]].z - ray.o.z) * invDir.z;
+    float tzmax = (bounds[1-dirIsNeg[2]].z - ray.o.z) * invDir.z * farScale;
+    if ((tmin > tzmax) || (tzmin > tmax))
+        return false;
+    if (tzmin > tmin)
+        tmin = tzmin;
+    if (tzmax < tmax)
+        tmax = tzmax;
+    return (tmin < ray.maxt) && (tmax > ray.mint);
+}
+
+
+// Same test as _Triangle::Intersect()_, without building any geometry
+static inline bool IntersectTriangle(const Ray &ray, const Point &p1,
+        const Point &p2, const Point &p3, float *tHit, float *b1Hit,
+        float *b2Hit) {
+    Vector e1 = p2 - p1;
+    Vector e2 = p3 - p1;
+    Vector s1 = Cross(ray.d, e2);
+    float divisor = Dot(s1, e1);
+    if (divisor == 0.)
+        return false;
+    float invDivisor = 1.f / divisor;
+
+    // Compute first barycentric coordinate
+    Vector d = ray.o - p1;
+    float b1 = Dot(d, s1) * invDivisor;
+    if (b1 < 0. || b1 > 1.)
+        return false;
+
+    // Compute second barycentric coordinate
+    Vector s2 = Cross(d, e1);
+    float b2 = Dot(ray.d, s2) * invDivisor;
+    if (b2 < 0. || b1 + b2 > 1.)
+        return false;
+
+    // Compute _t_ to intersection point
+    float t = Dot(e2, s2) * invDivisor;
+    if (t < ray.mint || t > ray.maxt)
+        return false;
+    *tHit = t;
+    *b1Hit = b1;
+    *b2Hit = b2;
+    return true;
+}
+
+
+
+// TriangleSoupPrimitive Method Definitions
+TriangleSoupPrimitive::TriangleSoupPrimitive(const Reference<TriangleMesh> &m,
+        const Reference<Material> &mtl, uint32_t maxTris)
+    : mesh(m), material(mtl) {
+    maxTrisInNode = min(255u, max(1u, maxTris));
+    nodes = NULL;
+    nNodes = 0;
+    if (mesh->ntris == 0) return;
+
+    // Initialize _buildData_ array for the mesh triangles
+    vector<SoupBuildInfo> buildData;
+    buildData.reserve(mesh->ntris);
+    for (int i = 0; i < mesh->ntris; ++i) {
+        const int *v = &mesh->vertexIndex[3*i];
+        BBox bbox = Union(BBox(mesh->p[v[0]], mesh->p[v[1]]), mesh->p[v[2]]);
+        buildData.push_back(SoupBuildInfo(i, bbox));
+    }
+
+    // Build BVH nodes in depth-first order
+    vector<SoupBVHNode> buildNodes;
+    buildNodes.reserve(2 * mesh->ntris / maxTrisInNode + 1);
+    PBRT_BVH_STARTED_CONSTRUCTION((BVHAccel *)NULL, mesh->ntris);
+    recursiveBuild(buildData, 0, buildData.size(), buildNodes);
+    PBRT_BVH_FINISHED_CONSTRUCTION((BVHAccel *)NULL);
+    nNodes = buildNodes.size();
+    nodes = AllocAligned<SoupBVHNode>(nNodes);
+    for (uint32_t i = 0; i < nNodes; ++i)
+        nodes[i] = buildNodes[i];
+
+    // Store the mesh vertex indices in leaf order
+    Reference<ParamSetArray<int> > orderedIndex =
+        new ParamSetArray<int>(3 * mesh->ntris);
+    for (int i = 0; i < mesh->ntris; ++i) {
+        const int *v = &mesh->vertexIndex[3*buildData[i].triNumber];
+        orderedIndex->data[3*i]   = v[0];
+        orderedIndex->data[3*i+1] = v[1];
+        orderedIndex->data[3*i+2] = v[2];
+    }
+    mesh->vertexIndexArray = orderedIndex;
+    mesh->vertexIndex = orderedIndex->data;
+    Info("Triangle soup created with %d nodes for %d triangles (%.2f MB)",
+         nNodes, mesh->ntris,
+         float(nNodes * sizeof(SoupBVHNode) + 3 * mesh->ntris * sizeof(int)) /
+         (1024.f*1024.f));
+}
+
+
+TriangleSoupPrimitive::~TriangleSoupPrimitive() {
+    FreeAligned(nodes);
+}
+
+
+bool TriangleSoupPrimitive::CanStore(const TriangleMesh *m) {
+    // Alpha-tested meshes still go through _Triangle_
+    return m && !m->alphaTexture;
+}
+
+
+BBox TriangleSoupPrimitive::WorldBound() const {
+    return nodes ? nodes[0].bounds : BBox();
+}
+
+
+uint32_t TriangleSoupPrimitive::recursiveBuild(vector<SoupBuildInfo> &buildData,
+        uint32_t start, uint32_t end, vector<SoupBVHNode> &buildNodes) {
+    Assert(start != end);
+    uint32_t nodeNum = buildNodes.size();
+    buildNodes.push_back(SoupBVHNode());
+    // Compute bounds of all triangles in node
+    BBox bbox;
+    for (uint32_t i = start; i < end; ++i)
+        bbox = Union(bbox, buildData[i].bounds);
+    buildNodes[nodeNum].bounds = bbox;
+    uint32_t nTris = end - start;
+
+    // Compute bound of triangle centroids, choose split dimension _dim_
+    BBox centroidBounds;
+    for (uint32_t i = start; i < end; ++i)
+        centroidBounds = Union(centroidBounds, buildData[i].centroid);
+    int dim = centroidBounds.MaximumExtent();
+    uint32_t mid = (start + end) / 2;
+    bool degenerate = centroidBounds.pMax[dim] == centroidBounds.pMin[dim];
+    bool makeLeaf = nTris == 1 || (degenerate && nTris <= maxTrisInNode);
+    if (!makeLeaf) {
+        if (nTris <= 4 || degenerate) {
+            // Partition triangles into equally-sized subsets
+            std::nth_element(&buildData[start], &buildData[mid],
+                             &buildData[end-1]+1, CompareSoupCentroids(dim));
+        }
+        else {
+            // Partition triangles using approximate SAH
+            const int nBuckets = 12;
+            int counts[nBuckets];
+            BBox bounds[nBuckets];
+            for (int b = 0; b < nBuckets; ++b) counts[b] = 0;
+            for (uint32_t i = start; i < end; ++i) {
+                int b = nBuckets *
+                    ((buildData[i].centroid[dim] - centroidBounds.pMin[dim]) /
+                     (centroidBounds.pMax[dim] - centroidBounds.pMin[dim]));
+                if (b == nBuckets) b = nBuckets-1;
+                Assert(b >= 0 && b < nBuckets);
+                counts[b]++;
+                bounds[b] = Union(bounds[b], buildData[i].bounds);
+            }
+
+            // Sweep the buckets to find the cheapest split
+            float minCost = INFINITY;
+            int minCostSplit = 0;
+            BBox below[nBuckets];
+            int countBelow[nBuckets];
+            BBox acc;
+            int n = 0;
+            for (int b = 0; b < nBuckets; ++b) {
+                acc = Union(acc, bounds[b]);
+                n += counts[b];
+                below[b] = acc;
+                countBelow[b] = n;
+            }
+            acc = BBox();
+            n = 0;
+            for (int b = nBuckets-1; b > 0; --b) {
+                acc = Union(acc, bounds[b]);
+                n += counts[b];
+                float cost = .125f + (countBelow[b-1] * below[b-1].SurfaceArea() +
+                                      n * acc.SurfaceArea()) / bbox.SurfaceArea();
+                if (cost < minCost) {
+                    minCost = cost;
+                    minCostSplit = b-1;
+                }
+            }
+
+            // Either create leaf or split triangles at selected SAH bucket
+            if (nTris > maxTrisInNode || minCost < nTris) {
+                SoupBuildInfo *pmid = std::partition(&buildData[start],
+                    &buildData[end-1]+1,
+                    CompareSoupToBucket(minCostSplit, nBuckets, dim, centroidBounds));
+                mid = pmid - &buildData[0];
+                if (mid == start || mid == end) {
+                    mid = (start + end) / 2;
+                    std::nth_element(&buildData[start], &buildData[mid],
+                                     &buildData[end-1]+1, CompareSoupCentroids(dim));
+                }
+            }
+            else
+                makeLeaf = true;
+        }
+    }
+
+    if (makeLeaf) {
+        // Initialize leaf node, triangles are already contiguous
+        buildNodes[nodeNum].trisOffset = start;
+        buildNodes[nodeNum].nTris = nTris;
+        return nodeNum;
+    }
+    recursiveBuild(buildData, start, mid, buildNodes);
+    uint32_t second = recursiveBuild(buildData, mid, end, buildNodes);
+    buildNodes[nodeNum].secondChildOffset = second;
+    buildNodes[nodeNum].axis = dim;
+    buildNodes[nodeNum].nTris = 0;
+    return nodeNum;
+}
+
+
+bool TriangleSoupPrimitive::Intersect(const Ray &ray,
+                                      Intersection *isect) const {
+    if (!nodes) return false;
+    const Point *p = mesh->p;
+    const int *vertexIndex = mesh->vertexIndex;
+    int hitTri = -1;
+    float tHit = 0.f, b1Hit = 0.f, b2Hit = 0.f;
+    Vector invDir(1.f / ray.d.x, 1.f / ray.d.y, 1.f / ray.d.z);
+    uint32_t dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+    // Follow ray through soup nodes, keeping only the closest hit
+    uint32_t todoOffset = 0, nodeNum = 0;
+    uint32_t todo[64];
+    while (true) {
+        const SoupBVHNode *node = &nodes[nodeNum];
+        if (::IntersectP(node->bounds, ray, invDir, dirIsNeg)) {
+            if (node->nTris > 0) {
+                PBRT_BVH_INTERSECTION_TRAVERSED_LEAF_NODE((LinearBVHNode *)NULL);
+                const int *v = &vertexIndex[3 * node->trisOffset];
+                for (uint32_t i = 0; i < node->nTris; ++i, v += 3) {
+                    PBRT_RAY_TRIANGLE_INTERSECTION_TEST(const_cast<Ray *>(&ray), (Triangle *)NULL);
+                    float t, b1, b2;
+                    if (IntersectTriangle(ray, p[v[0]], p[v[1]], p[v[2]],
+                                          &t, &b1, &b2)) {
+                        PBRT_RAY_TRIANGLE_INTERSECTION_HIT(const_cast<Ray *>(&ray), t);
+                        hitTri = node->trisOffset + i;
+                        tHit = t;
+                        b1Hit = b1;
+                        b2Hit = b2;
+                        ray.maxt = t;
+                    }
+                }
+                if (todoOffset == 0) break;
+                nodeNum = todo[--todoOffset];
+            }
+            else {
+                PBRT_BVH_INTERSECTION_TRAVERSED_INTERIOR_NODE((LinearBVHNode *)NULL);
+                // Put far node on _todo_ stack, advance to near node
+                if (dirIsNeg[node->axis]) {
+                   todo[todoOffset++] = nodeNum + 1;
+                   nodeNum = node->secondChildOffset;
+                }
+                else {
+                   todo[todoOffset++] = node->secondChildOffset;
+                   nodeNum = nodeNum + 1;
+                }
+            }
+        }
+        else {
+            if (todoOffset == 0) break;
+            nodeNum = todo[--todoOffset];
+        }
+    }
+    if (hitTri < 0) return false;
+
+    // Build _Intersection_ for the closest triangle only
+    fillDifferentialGeometry(ray, hitTri, tHit, b1Hit, b2Hit, &isect->dg);
+    isect->primitive = this;
+    isect->WorldToObject = *mesh->WorldToObject;
+    isect->ObjectToWorld = *mesh->ObjectToWorld;
+    isect->shapeId = mesh->shapeId;
+    isect->primitiveId = primitiveId;
+    isect->rayEpsilon = 1e-3f * tHit;
+    return true;
+}
+
+
+bool TriangleSoupPrimitive::IntersectP(const Ray &ray) const {
+    if (!nodes) return false;
+    const Point *p = mesh->p;
+    const int *vertexIndex = mesh->vertexIndex;
+    Vector invDir(1.f / ray.d.x, 1.f / ray.d.y, 1.f / ray.d.z);
+    uint32_t dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+    uint32_t todoOffset = 0, nodeNum = 0;
+    uint32_t todo[64];
+    while (true) {
+        const SoupBVHNode *node = &nodes[nodeNum];
+        if (::IntersectP(node->bounds, ray, invDir, dirIsNeg)) {
+            if (node->nTris > 0) {
+                PBRT_BVH_INTERSECTIONP_TRAVERSED_LEAF_NODE((LinearBVHNode *)NULL);
+                const int *v = &vertexIndex[3 * node->trisOffset];
+                for (uint32_t i = 0; i < node->nTris; ++i, v += 3) {
+                    PBRT_RAY_TRIANGLE_INTERSECTIONP_TEST(const_cast<Ray *>(&ray), (Triangle *)NULL);
+                    float t, b1, b2;
+                    if (IntersectTriangle(ray, p[v[0]], p[v[1]], p[v[2]],
+                                          &t, &b1, &b2)) {
+                        PBRT_RAY_TRIANGLE_INTERSECTIONP_HIT(const_cast<Ray *>(&ray), t);
+                        return true;
+                    }
+                }
+                if (todoOffset == 0) break;
+                nodeNum = todo[--todoOffset];
+            }
+            else {
+                PBRT_BVH_INTERSECTIONP_TRAVERSED_INTERIOR_NODE((LinearBVHNode *)NULL);
+                if (dirIsNeg[node->axis]) {
+                   todo[todoOffset++] = nodeNum + 1;
+                   nodeNum = node->secondChildOffset;
+                }
+                else {
+                   todo[todoOffset++] = node->secondChildOffset;
+                   nodeNum = nodeNum + 1;
+                }
+            }
+        }
+        else {
+            if (todoOffset == 0) break;
+            nodeNum = todo[--todoOffset];
+        }
+    }
+    return false;
+}
+
+
+void TriangleSoupPrimitive::fillDifferentialGeometry(const Ray &ray,
+        int tri, float t, float b1, float b2,
+        DifferentialGeometry *dg) const {
+    const int *v = &mesh->vertexIndex[3*tri];
+    const Point &p1 = mesh->p[v[0]];
+    const Point &p2 = mesh->p[v[1]];
+    const Point &p3 = mesh->p[v[2]];
+    Vector e1 = p2 - p1;
+    Vector e2 = p3 - p1;
+
+    // Compute triangle partial derivatives
+    Vector dpdu, dpdv;
+    float uvs[3][2];
+    mesh->GetTriangleUVs(v, uvs);
+
+    // Compute deltas for triangle partial derivatives
+    float du1 = uvs[0][0] - uvs[2][0];
+    float du2 = uvs[1][0] - uvs[2][0];
+    float dv1 = uvs[0][1] - uvs[2][1];
+    float dv2 = uvs[1][1] - uvs[2][1];
+    Vector dp1 = p1 - p3, dp2 = p2 - p3;
+    float determinant = du1 * dv2 - dv1 * du2;
+    if (determinant == 0.f) {
+        // Handle zero determinant for triangle partial derivative matrix
+        CoordinateSystem(Normalize(Cross(e2, e1)), &dpdu, &dpdv);
+    }
+    else {
+        float invdet = 1.f / determinant;
+        dpdu = ( dv2 * dp1 - dv1 * dp2) * invdet;
+        dpdv = (-du2 * dp1 + du1 * dp2) * invdet;
+    }
+
+    // Interpolate $(u,v)$ triangle parametric coordinates
+    float b0 = 1 - b1 - b2;
+    float tu = b0*uvs[0][0] + b1*uvs[1][0] + b2*uvs[2][0];
+    float tv = b0*uvs[0][1] + b1*uvs[1][1] + b2*uvs[2][1];
+
+    //[DGtal meme orientation que _Triangle::Intersect()_ en mode photon]
+    if (PhotonImage && mesh->n) {
+        const Normal &normalMesh = mesh->n[v[0]];
+        if (Dot(normalMesh, Cross(dpdu, dpdv)) < 0)
+            dpdu = -dpdu;
+    }
+    *dg = DifferentialGeometry(ray(t), dpdu, dpdv,
+                               Normal(0,0,0), Normal(0,0,0),
+                               tu, tv, mesh.GetPtr());
+    dg->faceIndex = tri;
+}
+
+
+BSDF *TriangleSoupPrimitive::GetBSDF(const DifferentialGeometry &dg,
+                                     const Transform &ObjectToWorld,
+                                     MemoryArena &arena) const {
+    DifferentialGeometry dgs;
+    mesh->GetTriangleShadingGeometry(&mesh->vertexIndex[3*dg.faceIndex],
+                                     ObjectToWorld, dg, &dgs);
+    return material->GetBSDF(dg, dgs, arena);
+}
+
+
+BSSRDF *TriangleSoupPrimitive::GetBSSRDF(const DifferentialGeometry &dg,
+                                         const Transform &ObjectToWorld,
+                                         MemoryArena &arena) const {
+    DifferentialGeometry dgs;
+    mesh->GetTriangleShadingGeometry(&mesh->vertexIndex[3*dg.faceIndex],
+                                     ObjectToWorld, dg, &dgs);
+    return material->GetBSSRDF(dg, dgs, arena);
+}
+
+
@@ -0,0 +1,79 @@
+
+/*
+    pbrt source code Copyright(c) 1998-2010 Matt Pharr and Greg Humphreys.
+
+    This file is part of pbrt.
+
+    pbrt is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.  Note that the text contents of
+    the book "Physically Based Rendering" are *not* licensed under the
+    GNU GPL.
+
+    pbrt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef PBRT_ACCELERATORS_TRIANGLESOUP_H
+#define PBRT_ACCELERATORS_TRIANGLESOUP_H
+
+// accelerators/trianglesoup.h*
+#include "pbrt.h"
+#include "primitive.h"
+#include "shapes/trianglemesh.h"
+
+// TriangleSoupPrimitive Forward Declarations
+struct SoupBuildInfo;
+struct SoupBVHNode;
+
+// TriangleSoupPrimitive Declarations
+//[DGtal : un maillage entier en une seule primitive. Les triangles ne sont
+// plus raffines en _Triangle_/_GeometricPrimitive_ : leurs indices sont
+// stockes a plat dans l'ordre des feuilles d'un BVH interne et testes dans
+// une boucle sans appel virtuel. La _DifferentialGeometry_ n'est construite
+// que pour l'intersection la plus proche.]
+class TriangleSoupPrimitive : public Primitive {
+public:
+    // TriangleSoupPrimitive Public Methods
+    TriangleSoupPrimitive(const Reference<TriangleMesh> &m,
+                          const Reference<Material> &mtl,
+                          uint32_t maxTris = 4);
+    ~TriangleSoupPrimitive();
+    static bool CanStore(const TriangleMesh *m);
+    BBox WorldBound() const;
+    bool CanIntersect() const { return true; }
+    bool Intersect(const Ray &ray, Intersection *isect) const;
+    bool IntersectP(const Ray &ray) const;
+    const AreaLight *GetAreaLight() const { return NULL; }
+    BSDF *GetBSDF(const DifferentialGeometry &dg,
+                  const Transform &ObjectToWorld, MemoryArena &arena) const;
+    BSSRDF *GetBSSRDF(const DifferentialGeometry &dg,
+                      const Transform &ObjectToWorld, MemoryArena &arena) const;
+private:
+    // TriangleSoupPrimitive Private Methods
+    uint32_t recursiveBuild(vector<SoupBuildInfo> &buildData,
+        uint32_t start, uint32_t end, vector<SoupBVHNode> &buildNodes);
+    void fillDifferentialGeometry(const Ray &ray, int tri, float t,
+        float b1, float b2, DifferentialGeometry *dg) const;
+
+    // TriangleSoupPrimitive Private Data
+    Reference<TriangleMesh> mesh;
+    Reference<Material> material;
+    uint32_t maxTrisInNode;
+    SoupBVHNode *nodes;
+    uint32_t nNodes;
+};
+
+
+#endif // PBRT_ACCELERATORS_TRIANGLESOUP_H
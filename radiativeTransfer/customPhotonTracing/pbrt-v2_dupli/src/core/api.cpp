@@ -33,11 +33,13 @@
 #include "film.h"
 #include "volume.h"
 #include "probes.h"
+#include "shapeinclude.h"
 
 // API Additional Headers
 #include "accelerators/bvh.h"
 #include "accelerators/grid.h"
 #include "accelerators/kdtreeaccel.h"
+#include "accelerators/trianglesoup.h"
 #include "cameras/environment.h"
 #include "cameras/orthographic.h"
 #include "cameras/perspective.h"
@@ -81,6 +83,7 @@
 #include "materials/translucent.h"
 #include "materials/uber.h"
 #include "renderers/aggregatetest.h"
+#include "renderers/accelbench.h"
 #include "renderers/createprobes.h"
 #include "renderers/metropolis.h"
 #include "renderers/samplerrenderer.h"
@@ -100,6 +103,7 @@
 #include "shapes/nurbs.h"
 #include "shapes/paraboloid.h"
 #include "shapes/sphere.h"
+#include "shapes/tiledmesh.h"
 #include "shapes/trianglemesh.h"
 #include "textures/bilerp.h"
 #include "textures/checkerboard.h"
@@ -116,8 +120,11 @@
 #include "volumes/exponential.h"
 #include "volumes/homogeneous.h"
 #include "volumes/volumegrid.h"
+#include "volumes/brickgrid.h"
 #include <map>
 #include <sstream>
+#include <fstream>
+#include <iostream>
  #if (_MSC_VER >= 1400)
  #include <stdio.h>
  #define snprintf _snprintf
@@ -129,16 +136,11 @@ Options PbrtOptions;
 
 
 
-// [DGtal ajout de variables globales pour l'absorption : valeur par défaut l=700nm]
-#ifndef GLOBAL_VARS_H
-#define GLOBAL_VARS_H
-double M_Nt=1.3069;
-double M_ABSORB=0.000000029;
-int dimensionImageX=512, dimensionImageY=512,dimensionImageZ=512;
-float resolutionPixel=8.59;
-string fileName="fichierSortie";
+//[DGtal mode lancer de photons, lancer en cours et liste des travaux du mode
+// --batch ; les valeurs par defaut (l=700nm) sont celles de _PhotonJob_]
 bool PhotonImage(false);
-#endif
+static PhotonJob photonJob;
+static vector<PhotonJob> photonJobs;
 
 //[DGtal la structure indice stocke l'indice de réfraction
 struct indiceRefrac {
@@ -152,7 +154,7 @@ typedef struct indiceRefrac indiceRefrac;
 
 
 //[DGtal : la fonction qui calcule l'absorption en fonction de la longueur d'onde
-void calculAbsor(const Options opt){
+static PhotonJob calculAbsor(const Options &opt, float lOnde){
 map<int, indiceRefrac> longOnde;
 int longChoisie(700);
 
@@ -434,43 +436,84 @@ longOnde[2600].indiceIm=0.0007543;
 
 
 //[DGtal on regarde la longueur d'onde choisie = la plus proche de celle donnee dans la table]
-if (opt.lOnde>700 && opt.lOnde<=2600){
+if (lOnde>700 && lOnde<=2600){
 	for (map<int, indiceRefrac>::iterator it=longOnde.begin(); it!=longOnde.end();it++)
-	{	if (opt.lOnde <= it->first) {
+	{	if (lOnde <= it->first) {
 			longChoisie=it->first;
 			break;
 		}
 	}
 }
-else if (opt.lOnde>2600)
+else if (lOnde>2600)
 	longChoisie=2600;
 
 
-//[DGtal on intitialise les variables globales] 
-printf("wavelength given by Warren table 2008 : %d nm \n", longChoisie);
-printf("dimension of image: %d * %d * %d \n", opt.dimx,opt.dimy,opt.dimz);
-printf("resolution of a pixel : %f micrometer \n", opt.resolPixel);
-
-M_Nt=longOnde[longChoisie].indiceRe;
-M_ABSORB=longOnde[longChoisie].indiceIm*1000*4*M_PI*opt.resolPixel*opt.dimz/256/longChoisie;
-dimensionImageX=opt.dimx;
-dimensionImageY=opt.dimy;
-dimensionImageZ=opt.dimz;
-resolutionPixel=opt.resolPixel;
+//[DGtal on intitialise les parametres du lancer]
+PhotonJob job;
+job.wavelength=longChoisie;
+job.nt=longOnde[longChoisie].indiceRe;
+job.absorb=longOnde[longChoisie].indiceIm*1000*4*M_PI*opt.resolPixel*opt.dimz/256/longChoisie;
+job.dimx=opt.dimx;
+job.dimy=opt.dimy;
+job.dimz=opt.dimz;
+job.resolPixel=opt.resolPixel;
 
 //[DGtal on initialise les noms de fichier]
 
 size_t pos=opt.filename.rfind("/");
 std::ostringstream longChoix;
 longChoix << longChoisie;
-fileName=opt.filename;
-if (pos!=std::string::npos) fileName=opt.filename.substr(pos+1);
+job.fileName=opt.filename;
+if (pos!=std::string::npos) job.fileName=opt.filename.substr(pos+1);
+
+size_t pos1=job.fileName.rfind(".");
+if (pos1!=std::string::npos) job.fileName=job.fileName.substr(0,pos1);
 
-size_t pos1=fileName.rfind(".");
-if (pos1!=std::string::npos) fileName=fileName.substr(0,pos1);
+job.fileName+="_"+longChoix.str();
+return job;
+}
 
-fileName+="_"+longChoix.str();	
 
+static void printPhotonJob(const PhotonJob &job){
+printf("wavelength given by Warren table 2008 : %d nm \n", job.wavelength);
+printf("dimension of image: %d * %d * %d \n", job.dimx,job.dimy,job.dimz);
+printf("resolution of a pixel : %f micrometer \n", job.resolPixel);
+}
+
+
+//[DGtal lecture du fichier de travaux du mode --batch ("-" : entree standard),
+// une ligne par lancer :
+//   longueurOnde(nm) [photons [dx dy dz [prefixe]]]
+// photons = 0 garde "causticphotons" de la scene, (dx,dy,dz) = (0,0,0) garde la
+// direction de la lumiere, et le prefixe des fichiers de sortie est par defaut
+// celui d'un lancer simple (scene_longueurOnde)]
+static void readPhotonJobs(const Options &opt){
+std::ifstream fichier;
+if (opt.batchFile!="-") {
+	fichier.open(opt.batchFile.c_str());
+	if (!fichier) Severe("Unable to open batch file \"%s\"", opt.batchFile.c_str());
+}
+std::istream &in=(opt.batchFile=="-") ? std::cin : fichier;
+string ligne;
+int numLigne(0);
+while (std::getline(in,ligne)) {
+	++numLigne;
+	size_t debut=ligne.find_first_not_of(" \t\r");
+	if (debut==string::npos || ligne[debut]=='#') continue;
+	std::istringstream champs(ligne);
+	vector<string> mots;
+	string mot;
+	while (champs >> mot) mots.push_back(mot);
+	if (mots.size()!=1 && mots.size()!=2 && mots.size()!=5 && mots.size()!=6)
+		Severe("%s(%d): expected \"wavelength [photons [dx dy dz [prefix]]]\"", opt.batchFile.c_str(), numLigne);
+	PhotonJob job=calculAbsor(opt,atof(mots[0].c_str()));
+	if (mots.size()>=2) job.nPhotons=atoi(mots[1].c_str());
+	if (mots.size()>=5)
+		for (int i=0; i<3; ++i) job.lightDir[i]=atof(mots[2+i].c_str());
+	if (mots.size()==6) job.fileName=mots[5];
+	photonJobs.push_back(job);
+}
+if (photonJobs.size()==0) Severe("No job in batch file \"%s\"", opt.batchFile.c_str());
 }
 
 
@@ -531,6 +574,7 @@ struct RenderOptions {
     TransformSet CameraToWorld;
     vector<Light *> lights;
     vector<Reference<Primitive> > primitives;
+    vector<AccelBenchMesh> benchMeshes;   //[DGtal maillages des primitives, pour accelbench]
     mutable vector<VolumeRegion *> volumeRegions;
     map<string, vector<Reference<Primitive> > > instances;
     vector<Reference<Primitive> > *currentInstance;
@@ -684,6 +728,9 @@ Reference<Shape> MakeShape(const string &name,
     else if (name == "trianglemesh")
         s = CreateTriangleMeshShape(object2world, world2object, reverseOrientation,
                                     paramSet, &graphicsState.floatTextures);
+    else if (name == "tiledmesh")
+        s = CreateTiledMeshShape(object2world, world2object, reverseOrientation,
+                                 paramSet);
     else if (name == "heightfield")
         s = CreateHeightfieldShape(object2world, world2object, reverseOrientation,
                                    paramSet);
@@ -834,7 +881,7 @@ Light *MakeLight(const string &name,
     else if (name == "projection")
         light = CreateProjectionLight(light2world, paramSet);
     else if (name == "distant")
-        light = CreateDistantLight(light2world, paramSet);
+        light = CreateDistantLight(light2world, paramSet, photonJob);
     else if (name == "infinite" || name == "exinfinite")
         light = CreateInfiniteLight(light2world, paramSet);
     else
@@ -864,6 +911,8 @@ VolumeRegion *MakeVolumeRegion(const string &name,
         vr = CreateHomogeneousVolumeDensityRegion(volume2world, paramSet);
     else if (name == "volumegrid")
         vr = CreateGridVolumeRegion(volume2world, paramSet);
+    else if (name == "brickgrid")
+        vr = CreateBrickGridVolumeRegion(volume2world, paramSet);
     else if (name == "exponential")
         vr = CreateExponentialVolumeRegion(volume2world, paramSet);
     else
@@ -883,7 +932,7 @@ SurfaceIntegrator *MakeSurfaceIntegrator(const string &name,
     else if (name == "path")
         si = CreatePathSurfaceIntegrator(paramSet);
     else if (name == "photonmap" || name == "exphotonmap")
-        si = CreatePhotonMapSurfaceIntegrator(paramSet);
+        si = CreatePhotonMapSurfaceIntegrator(paramSet, photonJob);
     else if (name == "irradiancecache")
         si = CreateIrradianceCacheIntegrator(paramSet);
     else if (name == "igi")
@@ -1024,7 +1073,14 @@ void pbrtInit(const Options &opt) {
 	//[DGtal ajout pour calculer l'indice et le coefficient d'absorption]
 	if (opt.photon)
 	{
-		calculAbsor(opt);
+		if (opt.batchFile.empty()) {
+			photonJob=calculAbsor(opt,opt.lOnde);
+			printPhotonJob(photonJob);
+		}
+		else {
+			readPhotonJobs(opt);
+			photonJob=photonJobs[0];
+		}
 		PhotonImage=true;
 	}	
 
@@ -1339,10 +1395,79 @@ void pbrtAreaLightSource(const string &name,
 }
 
 
+//[DGtal les Include qui ne contiennent que des Shape sont lus par des taches,
+// avec l'etat graphique du moment, et ajoutes a la scene dans l'ordre au
+// prochain Shape, ObjectBegin/End, ObjectInstance ou WorldEnd]
+struct ShapeIncludeJob {
+    string filename;
+    TransformSet transform;
+    GraphicsState graphicsState;
+    vector<ShapeIncludeEntry> shapes;
+    bool ok;
+};
+
+
+class ShapeIncludeTask : public Task {
+public:
+    ShapeIncludeTask(ShapeIncludeJob *j) : job(j) { }
+    void Run() {
+        job->ok = ParseShapeInclude(job->filename, &job->shapes);
+    }
+private:
+    ShapeIncludeJob *job;
+};
+
+
+static vector<ShapeIncludeJob *> pendingShapeIncludes;
+static vector<Task *> pendingShapeIncludeTasks;
+
+bool pbrtShapeInclude(const string &filename) {
+    if (currentApiState != STATE_WORLD_BLOCK || !IsShapeInclude(filename))
+        return false;
+    ShapeIncludeJob *job = new ShapeIncludeJob;
+    job->filename = filename;
+    job->transform = curTransform;
+    job->graphicsState = graphicsState;
+    job->ok = false;
+    pendingShapeIncludes.push_back(job);
+    Task *task = new ShapeIncludeTask(job);
+    pendingShapeIncludeTasks.push_back(task);
+    EnqueueTasks(vector<Task *>(1, task));
+    return true;
+}
+
+
+static void FlushShapeIncludes() {
+    if (pendingShapeIncludes.size() == 0) return;
+    vector<ShapeIncludeJob *> jobs;
+    jobs.swap(pendingShapeIncludes);
+    WaitForAllTasks();
+    for (uint32_t i = 0; i < pendingShapeIncludeTasks.size(); ++i)
+        delete pendingShapeIncludeTasks[i];
+    pendingShapeIncludeTasks.clear();
+
+    // Create shapes with the state saved at each _Include_
+    TransformSet savedTransform = curTransform;
+    GraphicsState savedGraphicsState = graphicsState;
+    for (uint32_t i = 0; i < jobs.size(); ++i) {
+        curTransform = jobs[i]->transform;
+        graphicsState = jobs[i]->graphicsState;
+        for (uint32_t j = 0; jobs[i]->ok && j < jobs[i]->shapes.size(); ++j)
+            pbrtShape(jobs[i]->shapes[j].name, jobs[i]->shapes[j].params);
+        delete jobs[i];
+    }
+    curTransform = savedTransform;
+    graphicsState = savedGraphicsState;
+}
+
+
 void pbrtShape(const string &name, const ParamSet &params) {
     VERIFY_WORLD("Shape");
+    FlushShapeIncludes();
     Reference<Primitive> prim;
     AreaLight *area = NULL;
+    AccelBenchMesh benchMesh;
+    bool isBenchMesh = false;
     if (!curTransform.IsAnimated()) {
         // Create primitive for static shape
         Transform *obj2world, *world2obj;
@@ -1358,7 +1483,24 @@ void pbrtShape(const string &name, const ParamSet &params) {
             area = MakeAreaLight(graphicsState.areaLight, curTransform[0],
                                  graphicsState.areaLightParams, shape);
         }
-        prim = new GeometricPrimitive(shape, mtl, area);
+        //[DGtal un "trianglemesh" sans lumiere devient une seule primitive
+        // plate (desactivable par Accelerator ... "bool trianglesoup" "false").
+        // Le rendu "accelbench" garde les triangles pour les accelerateurs et
+        // construit lui-meme le candidat "trianglesoup".]
+        bool soup = name == "trianglemesh" && !area &&
+            TriangleSoupPrimitive::CanStore((TriangleMesh *)shape.GetPtr());
+        if (soup && renderOptions->RendererName == "accelbench" &&
+            !renderOptions->currentInstance) {
+            benchMesh.mesh = shape;
+            benchMesh.material = mtl;
+            isBenchMesh = true;
+            prim = new GeometricPrimitive(shape, mtl, area);
+        }
+        else if (soup &&
+            renderOptions->AcceleratorParams.FindOneBool("trianglesoup", true))
+            prim = new TriangleSoupPrimitive((TriangleMesh *)shape.GetPtr(), mtl);
+        else
+            prim = new GeometricPrimitive(shape, mtl, area);
     } else {
         // Create primitive for animated shape
 
@@ -1403,6 +1545,10 @@ void pbrtShape(const string &name, const ParamSet &params) {
     }
     
     else {
+        if (isBenchMesh) {
+            benchMesh.primitive = renderOptions->primitives.size();
+            renderOptions->benchMeshes.push_back(benchMesh);
+        }
         renderOptions->primitives.push_back(prim);
         if (area != NULL) {
             renderOptions->lights.push_back(area);
@@ -1446,6 +1592,7 @@ void pbrtVolume(const string &name, const ParamSet &params) {
 
 void pbrtObjectBegin(const string &name) {
     VERIFY_WORLD("ObjectBegin");
+    FlushShapeIncludes();
     pbrtAttributeBegin();
     if (renderOptions->currentInstance)
         Error("ObjectBegin called inside of instance definition");
@@ -1456,6 +1603,7 @@ void pbrtObjectBegin(const string &name) {
 
 void pbrtObjectEnd() {
     VERIFY_WORLD("ObjectEnd");
+    FlushShapeIncludes();
     if (!renderOptions->currentInstance)
         Error("ObjectEnd called outside of instance definition");
     renderOptions->currentInstance = NULL;
@@ -1465,6 +1613,7 @@ void pbrtObjectEnd() {
 
 void pbrtObjectInstance(const string &name) {
     VERIFY_WORLD("ObjectInstance");
+    FlushShapeIncludes();
     // Object instance error checking
     if (renderOptions->currentInstance) {
         Error("ObjectInstance can't be called inside instance definition");
@@ -1501,6 +1650,7 @@ void pbrtObjectInstance(const string &name) {
 
 void pbrtWorldEnd() {
     VERIFY_WORLD("WorldEnd");
+    FlushShapeIncludes();
     // Ensure there are no pushed graphics states
     while (pushedGraphicsStates.size()) {
         Warning("Missing end to pbrtAttributeBegin()");
@@ -1513,18 +1663,46 @@ void pbrtWorldEnd() {
     }
 
     // Create scene and render
-    Renderer *renderer = renderOptions->MakeRenderer();
-    Scene *scene = renderOptions->MakeScene();
-    if (scene && renderer) renderer->Render(scene);
-    TasksCleanup();
-    delete renderer;
-    delete scene;
+    if (photonJobs.size() > 0) {
+        //[DGtal mode --batch : la scene et son BVH sont construits une seule
+        // fois, chaque travail a son propre integrateur (compteurs et
+        // generateurs aleatoires remis a zero)]
+        Scene *scene = renderOptions->MakeScene();
+        renderOptions->lights = scene->lights;
+        for (uint32_t i = 0; i < photonJobs.size(); ++i) {
+            photonJob = photonJobs[i];
+            printf("\njob %u/%u : %s\n", i + 1, uint32_t(photonJobs.size()),
+                   photonJob.fileName.c_str());
+            printPhotonJob(photonJob);
+            for (uint32_t j = 0; j < scene->lights.size(); ++j) {
+                DistantLight *light = dynamic_cast<DistantLight *>(scene->lights[j]);
+                if (light) light->SetPhotonJob(photonJob);
+            }
+            Renderer *renderer = renderOptions->MakeRenderer();
+            if (renderer) renderer->Render(scene);
+            delete renderer;
+            if (i + 1 < photonJobs.size())
+                ProbesPrint(stdout, photonJob.fileName);
+        }
+        renderOptions->lights.erase(renderOptions->lights.begin(),
+                                    renderOptions->lights.end());
+        TasksCleanup();
+        delete scene;
+    }
+    else {
+        Renderer *renderer = renderOptions->MakeRenderer();
+        Scene *scene = renderOptions->MakeScene();
+        if (scene && renderer) renderer->Render(scene);
+        TasksCleanup();
+        delete renderer;
+        delete scene;
+    }
 
     // Clean up after rendering
     graphicsState = GraphicsState();
     transformCache.Clear();
     currentApiState = STATE_OPTIONS_BLOCK;
-    ProbesPrint(stdout);
+    ProbesPrint(stdout, photonJob.fileName);
     for (int i = 0; i < MAX_TRANSFORMS; ++i)
         curTransform[i] = Transform();
     activeTransformBits = ALL_TRANSFORMS_BITS;
@@ -1553,6 +1731,7 @@ Scene *RenderOptions::MakeScene() {
     Scene *scene = new Scene(accelerator, lights, volumeRegion);
     // Erase primitives, lights, and volume regions from _RenderOptions_
     primitives.erase(primitives.begin(), primitives.end());
+    benchMeshes.clear();
     lights.erase(lights.begin(), lights.end());
     volumeRegions.erase(volumeRegions.begin(), volumeRegions.end());
     return scene;
@@ -1590,6 +1769,11 @@ Renderer *RenderOptions::MakeRenderer() const {
         renderer = CreateAggregateTestRenderer(RendererParams, primitives);
         RendererParams.ReportUnused();
     }
+    else if (RendererName == "accelbench") {
+        renderer = CreateAcceleratorBenchmarkRenderer(RendererParams, camera,
+                                                      primitives, benchMeshes);
+        RendererParams.ReportUnused();
+    }
     else if (RendererName == "surfacepoints") {
         Point pCamera = camera->CameraToWorld(camera->shutterOpen, Point(0, 0, 0));
         renderer = CreateSurfacePointsRenderer(RendererParams, pCamera, camera->shutterOpen);
@@ -1600,6 +1784,15 @@ Renderer *RenderOptions::MakeRenderer() const {
             Warning("Renderer type \"%s\" unknown.  Using \"sampler\".",
                     RendererName.c_str());
         bool visIds = RendererParams.FindOneBool("visualizeobjectids", false);
+        float timeBudget = RendererParams.FindOneFloat("timebudget", 0.f);
+        float targetNoise = RendererParams.FindOneFloat("targetnoise", 0.f);
+        bool progressive = timeBudget > 0.f || targetNoise > 0.f;
+        float flushInterval = RendererParams.FindOneFloat("flushinterval",
+                                                          progressive ? 60.f : 0.f);
+        int maxPasses = RendererParams.FindOneInt("maxpasses",
+                                                  progressive ? 0 : 1);
+        bool adaptiveTiles = RendererParams.FindOneBool("adaptivetiles", false);
+        float adaptiveFraction = RendererParams.FindOneFloat("adaptivefraction", .25f);
         RendererParams.ReportUnused();
         Sampler *sampler = MakeSampler(SamplerName, SamplerParams, camera->film, camera);
         if (!sampler) Severe("Unable to create sampler.");
@@ -1611,7 +1804,9 @@ Renderer *RenderOptions::MakeRenderer() const {
             VolIntegratorParams);
         if (!volumeIntegrator) Severe("Unable to create volume integrator.");
         renderer = new SamplerRenderer(sampler, camera, surfaceIntegrator,
-                                       volumeIntegrator, visIds);
+                                       volumeIntegrator, visIds, timeBudget,
+                                       flushInterval, targetNoise, maxPasses,
+                                       adaptiveTiles, adaptiveFraction);
         // Warn if no light sources are defined
         if (lights.size() == 0)
             Warning("No light sources defined in scene; "
@@ -82,4 +82,8 @@ void pbrtObjectEnd();
 void pbrtObjectInstance(const string &name);
 void pbrtWorldEnd();
 
+//[DGtal Include d'un fichier qui ne contient que des Shape, lu en parallele ;
+// renvoie false si le fichier doit passer par le lexer]
+bool pbrtShapeInclude(const string &filename);
+
 #endif // PBRT_CORE_API_H
@@ -37,6 +37,7 @@ struct DifferentialGeometry {
     DifferentialGeometry() { 
         u = v = dudx = dvdx = dudy = dvdy = 0.; 
         shape = NULL; 
+        faceIndex = 0;
     }
     // DifferentialGeometry Public Methods
     DifferentialGeometry(const Point &P, const Vector &DPDU,
@@ -50,6 +51,7 @@ struct DifferentialGeometry {
     Normal nn;
     float u, v;
     const Shape *shape;
+    int64_t faceIndex;
     Vector dpdu, dpdv;
     Normal dndu, dndv;
     mutable Vector dpdx, dpdy;
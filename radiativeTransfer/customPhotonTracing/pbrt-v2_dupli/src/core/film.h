@@ -47,6 +47,10 @@ public:
                                 int *ystart, int *yend) const = 0;
     virtual void UpdateDisplay(int x0, int y0, int x1, int y1, float splatScale = 1.f);
     virtual void WriteImage(float splatScale = 1.f) = 0;
+    virtual bool WantsFeatures() const { return false; }
+    virtual void AddFeatures(const CameraSample &sample, const Spectrum &L,
+                             const Normal &n, const Spectrum &albedo,
+                             float depth) { }
 
     // Film Public Data
     const int xResolution, yResolution;
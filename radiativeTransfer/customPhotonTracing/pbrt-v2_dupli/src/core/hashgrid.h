@@ -0,0 +1,189 @@
+
+/*
+    pbrt source code Copyright(c) 1998-2010 Matt Pharr and Greg Humphreys.
+
+    This file is part of pbrt.
+
+    pbrt is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.  Note that the text contents of
+    the book "Physically Based Rendering" are *not* licensed under the
+    GNU GPL.
+
+    pbrt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef PBRT_CORE_HASHGRID_H
+#define PBRT_CORE_HASHGRID_H
+
+// core/hashgrid.h*
+#include "pbrt.h"
+#include "geometry.h"
+#include "memory.h"
+
+// HashGrid Declarations
+
+// Uniform grid over the data points with cells hashed into a table sized to
+// the number of points; points are sorted by bucket so that the points of a
+// cell are contiguous.  _Lookup()_ has the same interface as _KdTree_ and
+// visits cells in shells of growing distance around the lookup point, so
+// that both fixed-radius and nearest-neighbor lookups stay local.
+template <typename NodeData> class HashGrid {
+public:
+    // HashGrid Public Methods
+    HashGrid(const vector<NodeData> &data, float cellSize = 0.f);
+    ~HashGrid() {
+        FreeAligned(nodeData);
+        FreeAligned(cellKeys);
+    }
+    template <typename LookupProc> void Lookup(const Point &p,
+            LookupProc &process, float &maxDistSquared) const;
+private:
+    // HashGrid Private Methods
+    void cellCoords(const Point &p, int c[3]) const {
+        for (int axis = 0; axis < 3; ++axis)
+            c[axis] = Clamp(Floor2Int((p[axis] - bounds.pMin[axis]) * invCellSize),
+                            -(1 << 20), (1 << 20) - 1);
+    }
+    static uint64_t cellKey(int x, int y, int z) {
+        return (uint64_t(x + (1 << 20)) << 42) |
+               (uint64_t(y + (1 << 20)) << 21) | uint64_t(z + (1 << 20));
+    }
+    uint32_t hash(int x, int y, int z) const {
+        return ((uint32_t(x) * 73856093u) ^ (uint32_t(y) * 19349663u) ^
+                (uint32_t(z) * 83492791u)) & (hashSize - 1);
+    }
+    template <typename LookupProc> void lookupCell(int x, int y, int z,
+        const Point &p, LookupProc &process, float &maxDistSquared) const;
+
+    // HashGrid Private Data
+    NodeData *nodeData;
+    uint64_t *cellKeys;
+    vector<uint32_t> bucketStart;
+    uint32_t nData, hashSize;
+    BBox bounds;
+    float cellSize, invCellSize;
+    int cellMax[3];
+};
+
+
+
+// HashGrid Method Definitions
+template <typename NodeData>
+HashGrid<NodeData>::HashGrid(const vector<NodeData> &d, float cs) {
+    nData = d.size();
+    nodeData = AllocAligned<NodeData>(max(nData, 1u));
+    cellKeys = AllocAligned<uint64_t>(max(nData, 1u));
+    for (uint32_t i = 0; i < nData; ++i)
+        bounds = Union(bounds, d[i].p);
+
+    // Choose cell size, about eight points per cell if not given
+    cellSize = cs;
+    if (cellSize <= 0.f && nData > 0) {
+        Vector diag = bounds.pMax - bounds.pMin;
+        float maxExtent = max(diag.x, max(diag.y, diag.z));
+        float volume = max(diag.x, 1e-3f * maxExtent) *
+                       max(diag.y, 1e-3f * maxExtent) *
+                       max(diag.z, 1e-3f * maxExtent);
+        cellSize = 2.f * powf(volume / nData, 1.f / 3.f);
+    }
+    if (!(cellSize > 0.f)) cellSize = 1.f;
+    invCellSize = 1.f / cellSize;
+    int c[3];
+    cellCoords(bounds.pMax, c);
+    for (int axis = 0; axis < 3; ++axis)
+        cellMax[axis] = nData > 0 ? c[axis] : -1;
+
+    // Sort points by hash bucket
+    hashSize = RoundUpPow2(max(nData, 1u));
+    bucketStart.resize(hashSize + 1, 0);
+    vector<uint32_t> buckets(nData);
+    for (uint32_t i = 0; i < nData; ++i) {
+        cellCoords(d[i].p, c);
+        buckets[i] = hash(c[0], c[1], c[2]);
+        ++bucketStart[buckets[i] + 1];
+    }
+    for (uint32_t i = 0; i < hashSize; ++i)
+        bucketStart[i + 1] += bucketStart[i];
+    vector<uint32_t> next(bucketStart.begin(), bucketStart.end() - 1);
+    for (uint32_t i = 0; i < nData; ++i) {
+        uint32_t slot = next[buckets[i]]++;
+        nodeData[slot] = d[i];
+        cellCoords(d[i].p, c);
+        cellKeys[slot] = cellKey(c[0], c[1], c[2]);
+    }
+}
+
+
+template <typename NodeData> template <typename LookupProc>
+void HashGrid<NodeData>::Lookup(const Point &p, LookupProc &process,
+                                float &maxDistSquared) const {
+    if (nData == 0) return;
+    int c[3];
+    cellCoords(p, c);
+    // Skip shells that cannot overlap the cells holding data
+    int kStart = 0;
+    for (int axis = 0; axis < 3; ++axis)
+        kStart = max(kStart, max(-c[axis], c[axis] - cellMax[axis]));
+    for (int k = kStart; ; ++k) {
+        // Stop when cells of shell _k_ are all farther than _maxDistSquared_
+        float minDist = (k - 1) * cellSize;
+        if (k > 1 && minDist * minDist >= maxDistSquared) break;
+
+        // Visit cells at Chebyshev distance _k_ that overlap the data
+        int z0 = max(c[2] - k, 0), z1 = min(c[2] + k, cellMax[2]);
+        int y0 = max(c[1] - k, 0), y1 = min(c[1] + k, cellMax[1]);
+        for (int z = z0; z <= z1; ++z) {
+            for (int y = y0; y <= y1; ++y) {
+                if (abs(z - c[2]) == k || abs(y - c[1]) == k) {
+                    int x0 = max(c[0] - k, 0), x1 = min(c[0] + k, cellMax[0]);
+                    for (int x = x0; x <= x1; ++x)
+                        lookupCell(x, y, z, p, process, maxDistSquared);
+                }
+                else {
+                    if (c[0] - k >= 0 && c[0] - k <= cellMax[0])
+                        lookupCell(c[0] - k, y, z, p, process, maxDistSquared);
+                    if (k > 0 && c[0] + k >= 0 && c[0] + k <= cellMax[0])
+                        lookupCell(c[0] + k, y, z, p, process, maxDistSquared);
+                }
+            }
+        }
+
+        // Stop once shell _k_ encloses all cells holding data
+        if (c[0] - k <= 0 && c[0] + k >= cellMax[0] &&
+            c[1] - k <= 0 && c[1] + k >= cellMax[1] &&
+            c[2] - k <= 0 && c[2] + k >= cellMax[2])
+            break;
+    }
+}
+
+
+template <typename NodeData> template <typename LookupProc>
+void HashGrid<NodeData>::lookupCell(int x, int y, int z, const Point &p,
+        LookupProc &process, float &maxDistSquared) const {
+    uint32_t b = hash(x, y, z);
+    uint64_t key = cellKey(x, y, z);
+    for (uint32_t i = bucketStart[b]; i < bucketStart[b + 1]; ++i) {
+        // Skip points of other cells hashed to the same bucket
+        if (cellKeys[i] != key) continue;
+        float dist2 = DistanceSquared(nodeData[i].p, p);
+        if (dist2 < maxDistSquared)
+            process(p, nodeData[i], dist2, maxDistSquared);
+    }
+}
+
+
+
+#endif // PBRT_CORE_HASHGRID_H
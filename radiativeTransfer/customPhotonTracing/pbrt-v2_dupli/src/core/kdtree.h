@@ -31,27 +31,28 @@
 // core/kdtree.h*
 #include "pbrt.h"
 #include "geometry.h"
+#include "parallel.h"
 
 // KdTree Declarations
+
+// Nodes are stored in implicit left-balanced order: the children of node
+// $i$ are $2i+1$ and $2i+2$, so no child links are stored and the top
+// levels of the tree, visited by every lookup, are contiguous in memory
 struct KdNode {
     void init(float p, uint32_t a) {
         splitPos = p;
         splitAxis = a;
-        rightChild = (1<<29)-1;
-        hasLeftChild = 0;
     }
     void initLeaf() {
         splitAxis = 3;
-        rightChild = (1<<29)-1;
-        hasLeftChild = 0;
     }
     // KdNode Data
     float splitPos;
-    uint32_t splitAxis:2;
-    uint32_t hasLeftChild:1, rightChild:29;
+    uint32_t splitAxis;
 };
 
 
+template <typename NodeData> class KdTreeBuildTask;
 template <typename NodeData> class KdTree {
 public:
     // KdTree Public Methods
@@ -64,6 +65,7 @@ public:
             LookupProc &process, float &maxDistSquared) const;
 private:
     // KdTree Private Methods
+    friend class KdTreeBuildTask<NodeData>;
     void recursiveBuild(uint32_t nodeNum, int start, int end,
         const NodeData **buildNodes);
     template <typename LookupProc> void privateLookup(uint32_t nodeNum,
@@ -72,7 +74,7 @@ private:
     // KdTree Private Data
     KdNode *nodes;
     NodeData *nodeData;
-    uint32_t nNodes, nextFreeNode;
+    uint32_t nNodes;
 };
 
 
@@ -86,14 +88,39 @@ template <typename NodeData> struct CompareNode {
 };
 
 
+template <typename NodeData> class KdTreeBuildTask : public Task {
+public:
+    KdTreeBuildTask(KdTree<NodeData> *t, uint32_t n, int s, int e,
+                    const NodeData **b)
+        : tree(t), nodeNum(n), start(s), end(e), buildNodes(b) { }
+    void Run() { tree->recursiveBuild(nodeNum, start, end, buildNodes); }
+private:
+    KdTree<NodeData> *tree;
+    uint32_t nodeNum;
+    int start, end;
+    const NodeData **buildNodes;
+};
+
+
+inline int KdTreeLeftSubtreeSize(int n) {
+    // Return size of the left subtree of a left-balanced tree of _n_ nodes
+    if (n <= 1) return 0;
+    int h = 0;
+    while ((2 << h) <= n) ++h;
+    int lastLevel = n - ((1 << h) - 1);
+    int halfLastLevel = 1 << (h - 1);
+    return (halfLastLevel - 1) + min(lastLevel, halfLastLevel);
+}
+
+
 
 // KdTree Method Definitions
 template <typename NodeData>
 KdTree<NodeData>::KdTree(const vector<NodeData> &d) {
     nNodes = d.size();
-    nextFreeNode = 1;
-    nodes = AllocAligned<KdNode>(nNodes);
-    nodeData = AllocAligned<NodeData>(nNodes);
+    nodes = AllocAligned<KdNode>(max(nNodes, 1u));
+    nodeData = AllocAligned<NodeData>(max(nNodes, 1u));
+    if (nNodes == 0) return;
     vector<const NodeData *> buildNodes(nNodes, NULL);
     for (uint32_t i = 0; i < nNodes; ++i)
         buildNodes[i] = &d[i];
@@ -119,22 +146,29 @@ KdTree<NodeData>::recursiveBuild(uint32_t nodeNum, int start, int end,
     for (int i = start; i < end; ++i)
         bound = Union(bound, buildNodes[i]->p);
     int splitAxis = bound.MaximumExtent();
-    int splitPos = (start+end)/2;
+    int splitPos = start + KdTreeLeftSubtreeSize(end - start);
     std::nth_element(&buildNodes[start], &buildNodes[splitPos],
                      &buildNodes[end], CompareNode<NodeData>(splitAxis));
 
-    // Allocate kd-tree node and continue recursively
+    // Initialize kd-tree node and continue recursively
     nodes[nodeNum].init(buildNodes[splitPos]->p[splitAxis], splitAxis);
     nodeData[nodeNum] = *buildNodes[splitPos];
-    if (start < splitPos) {
-        nodes[nodeNum].hasLeftChild = 1;
-        uint32_t childNum = nextFreeNode++;
-        recursiveBuild(childNum, start, splitPos, buildNodes);
+    uint32_t leftChild = 2 * nodeNum + 1, rightChild = 2 * nodeNum + 2;
+    if (end - start < 65536 || PbrtOptions.nCores == 1) {
+        recursiveBuild(leftChild, start, splitPos, buildNodes);
+        if (splitPos+1 < end)
+            recursiveBuild(rightChild, splitPos+1, end, buildNodes);
     }
-    if (splitPos+1 < end) {
-        nodes[nodeNum].rightChild = nextFreeNode++;
-        recursiveBuild(nodes[nodeNum].rightChild, splitPos+1,
-                       end, buildNodes);
+    else {
+        // Build both subtrees of large nodes in parallel
+        KdTreeBuildTask<NodeData> left(this, leftChild, start, splitPos,
+                                       buildNodes);
+        KdTreeBuildTask<NodeData> right(this, rightChild, splitPos+1, end,
+                                        buildNodes);
+        vector<Task *> tasks;
+        tasks.push_back(&left);
+        tasks.push_back(&right);
+        RunTasks(tasks);
     }
 }
 
@@ -142,29 +176,30 @@ KdTree<NodeData>::recursiveBuild(uint32_t nodeNum, int start, int end,
 template <typename NodeData> template <typename LookupProc>
 void KdTree<NodeData>::Lookup(const Point &p, LookupProc &proc,
                               float &maxDistSquared) const {
-    privateLookup(0, p, proc, maxDistSquared);
+    if (nNodes > 0)
+        privateLookup(0, p, proc, maxDistSquared);
 }
 
 
 template <typename NodeData> template <typename LookupProc>
 void KdTree<NodeData>::privateLookup(uint32_t nodeNum, const Point &p,
         LookupProc &process, float &maxDistSquared) const {
-    KdNode *node = &nodes[nodeNum];
+    const KdNode *node = &nodes[nodeNum];
     // Process kd-tree node's children
     int axis = node->splitAxis;
     if (axis != 3) {
         float dist2 = (p[axis] - node->splitPos) * (p[axis] - node->splitPos);
+        uint32_t leftChild = 2 * nodeNum + 1, rightChild = leftChild + 1;
         if (p[axis] <= node->splitPos) {
-            if (node->hasLeftChild)
-                privateLookup(nodeNum+1, p, process, maxDistSquared);
-            if (dist2 < maxDistSquared && node->rightChild < nNodes)
-                privateLookup(node->rightChild, p, process, maxDistSquared);
+            privateLookup(leftChild, p, process, maxDistSquared);
+            if (dist2 < maxDistSquared && rightChild < nNodes)
+                privateLookup(rightChild, p, process, maxDistSquared);
         }
         else {
-            if (node->rightChild < nNodes)
-                privateLookup(node->rightChild, p, process, maxDistSquared);
-            if (dist2 < maxDistSquared && node->hasLeftChild)
-                privateLookup(nodeNum+1, p, process, maxDistSquared);
+            if (rightChild < nNodes)
+                privateLookup(rightChild, p, process, maxDistSquared);
+            if (dist2 < maxDistSquared)
+                privateLookup(leftChild, p, process, maxDistSquared);
         }
     }
 
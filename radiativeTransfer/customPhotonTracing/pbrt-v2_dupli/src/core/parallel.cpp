@@ -39,6 +39,11 @@
 #include <errno.h>
 #endif 
 #include <list>
+#include <deque>
+#include "timer.h"
+#if !defined(PBRT_IS_WINDOWS)
+#include <sched.h>
+#endif
 
 // Parallel Local Declarations
 #if defined(PBRT_IS_WINDOWS)
@@ -50,8 +55,57 @@ static pthread_t *threads;
 static dispatch_queue_t gcdQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
 static dispatch_group_t gcdGroup = dispatch_group_create();
 #else
-static Mutex *taskQueueMutex = Mutex::Create();
-static std::vector<Task *> taskQueue;
+// Each worker thread owns a deque of tasks; it runs the most recently
+// queued task of its own deque first and, once it is empty, steals the
+// oldest task of another worker's deque
+struct TaskBatch {
+    AtomicInt32 unfinished;
+    bool done;                    // set under _finished_ by the last task
+    ConditionVariable *finished;
+};
+
+
+struct QueuedTask {
+    QueuedTask(Task *t = NULL, TaskBatch *b = NULL)
+        : task(t), batch(b) { }
+    Task *task;
+    TaskBatch *batch;  // batch of the _RunTasks()_ call, or NULL
+};
+
+
+struct WorkerQueue {
+    WorkerQueue() { mutex = Mutex::Create(); }
+    ~WorkerQueue() { Mutex::Destroy(mutex); }
+    Mutex *mutex;
+    std::deque<QueuedTask> tasks;
+};
+
+
+struct WorkerStats {
+    WorkerStats() : nTasks(0), nSteals(0), waitTime(0.), claimTime(0.),
+                    lastFinish(0.) { }
+    int nTasks, nSteals;
+    double waitTime, claimTime;
+    volatile double lastFinish;
+    Timer timer;
+};
+
+
+// Yields of a _RunTasks()_ caller with no queued task before it sleeps
+static const int RUN_TASKS_MAX_YIELDS = 16;
+static int nWorkers;
+static WorkerQueue *workerQueues;
+static WorkerStats *workerStats;
+static AtomicInt32 nextWorkerQueue;
+static volatile bool workersExit;
+static Timer *schedulerTimer;
+static double batchStart, maxTailTime, totalTailTime;
+static int nWaits;
+#if defined(PBRT_IS_WINDOWS)
+static __declspec(thread) int workerIndex = -1;
+#else
+static __thread int workerIndex = -1;
+#endif
 #endif // PBRT_USE_GRAND_CENTRAL_DISPATCH
 #ifndef PBRT_USE_GRAND_CENTRAL_DISPATCH
 static Semaphore *workerSemaphore;
@@ -718,6 +772,14 @@ void TasksInit() {
     return;
 #else // PBRT_USE_GRAND_CENTRAL_DISPATCH
     static const int nThreads = NumSystemCores();
+    nWorkers = nThreads;
+    workersExit = false;
+    workerQueues = new WorkerQueue[nThreads];
+    workerStats = new WorkerStats[nThreads];
+    schedulerTimer = new Timer;
+    schedulerTimer->Start();
+    for (int i = 0; i < nThreads; ++i)
+        workerStats[i].timer.Start();
     workerSemaphore = new Semaphore;
     tasksRunningCondition = new ConditionVariable;
 #if !defined(PBRT_IS_WINDOWS)
@@ -745,13 +807,15 @@ void TasksCleanup() {
 #ifdef PBRT_USE_GRAND_CENTRAL_DISPATCH
     return;
 #else // // PBRT_USE_GRAND_CENTRAL_DISPATCH
-    if (!taskQueueMutex || !workerSemaphore)
+    if (!workerQueues || !workerSemaphore)
         return;
-    { MutexLock lock(*taskQueueMutex);
-    Assert(taskQueue.size() == 0);
+    for (int i = 0; i < nWorkers; ++i) {
+        MutexLock lock(*workerQueues[i].mutex);
+        Assert(workerQueues[i].tasks.size() == 0);
     }
 
     static const int nThreads = NumSystemCores();
+    workersExit = true;
     if (workerSemaphore != NULL)
         workerSemaphore->Post(nThreads);
 
@@ -771,6 +835,26 @@ void TasksCleanup() {
         delete[] threads;
         threads = NULL;
     }
+
+    // Report scheduling overhead and tail latency of the task batches
+    int nTasks = 0, nSteals = 0;
+    double waitTime = 0., claimTime = 0.;
+    for (int i = 0; i < nWorkers; ++i) {
+        nTasks += workerStats[i].nTasks;
+        nSteals += workerStats[i].nSteals;
+        waitTime += workerStats[i].waitTime;
+        claimTime += workerStats[i].claimTime;
+    }
+    double elapsed = schedulerTimer->Time();
+    Info("Task scheduler: %d workers ran %d tasks (%d stolen), "
+         "%.3f ms claiming tasks (%.2f us per task), %.1f%% of worker time idle",
+         nWorkers, nTasks, nSteals, 1000. * claimTime,
+         nTasks ? 1e6 * claimTime / nTasks : 0.,
+         elapsed > 0. ? 100. * waitTime / (elapsed * nWorkers) : 0.);
+    if (nWaits > 0)
+        Info("Task scheduler: %d task batches ran with idle workers for "
+             "%.3f s on average, %.3f s at worst", nWaits,
+             totalTailTime / nWaits, maxTailTime);
 #endif // PBRT_USE_GRAND_CENTRAL_DISPATCH
 }
 
@@ -788,6 +872,88 @@ static void lRunTask(void *t) {
 }
 
 
+#else
+static void YieldWorker() {
+#if defined(PBRT_IS_WINDOWS)
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+
+static void PushTasks(const vector<Task *> &tasks, TaskBatch *batch) {
+    if (workerIndex >= 0) {
+        // Keep tasks spawned by a running task in its worker's deque
+        WorkerQueue &queue = workerQueues[workerIndex];
+        MutexLock lock(*queue.mutex);
+        for (uint32_t i = 0; i < tasks.size(); ++i)
+            queue.tasks.push_back(QueuedTask(tasks[i], batch));
+    }
+    else {
+        // Spread tasks from other threads over the workers' deques
+        for (uint32_t i = 0; i < tasks.size(); ++i) {
+            uint32_t q = uint32_t(AtomicAdd(&nextWorkerQueue, 1)) % nWorkers;
+            MutexLock lock(*workerQueues[q].mutex);
+            workerQueues[q].tasks.push_back(QueuedTask(tasks[i], batch));
+        }
+    }
+}
+
+
+static bool ClaimTask(QueuedTask *qt) {
+    // Take the most recently queued task of our own deque
+    int self = workerIndex;
+    if (self >= 0) {
+        WorkerQueue &queue = workerQueues[self];
+        MutexLock lock(*queue.mutex);
+        if (queue.tasks.size() > 0) {
+            *qt = queue.tasks.back();
+            queue.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Steal the oldest task of another worker
+    int first = max(self, 0);
+    for (int i = 1; i <= nWorkers; ++i) {
+        int victim = (first + i) % nWorkers;
+        if (victim == self) continue;
+        WorkerQueue &queue = workerQueues[victim];
+        MutexLock lock(*queue.mutex);
+        if (queue.tasks.size() > 0) {
+            *qt = queue.tasks.front();
+            queue.tasks.pop_front();
+            if (self >= 0) ++workerStats[self].nSteals;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static void RunQueuedTask(const QueuedTask &qt) {
+    PBRT_STARTED_TASK(qt.task);
+    qt.task->Run();
+    PBRT_FINISHED_TASK(qt.task);
+    if (qt.batch) {
+        if (AtomicAdd(&qt.batch->unfinished, -1) == 0) {
+            qt.batch->finished->Lock();
+            qt.batch->done = true;
+            qt.batch->finished->Signal();
+            qt.batch->finished->Unlock();
+        }
+    }
+    else {
+        tasksRunningCondition->Lock();
+        int unfinished = --numUnfinishedTasks;
+        if (unfinished == 0)
+            tasksRunningCondition->Signal();
+        tasksRunningCondition->Unlock();
+    }
+}
+
+
 #endif
 void EnqueueTasks(const vector<Task *> &tasks) {
     if (PbrtOptions.nCores == 1) {
@@ -802,11 +968,10 @@ void EnqueueTasks(const vector<Task *> &tasks) {
     if (!threads)
         TasksInit();
 
-    { MutexLock lock(*taskQueueMutex);
-    for (unsigned int i = 0; i < tasks.size(); ++i)
-        taskQueue.push_back(tasks[i]);
-    }
+    PushTasks(tasks, NULL);
     tasksRunningCondition->Lock();
+    if (numUnfinishedTasks == 0)
+        batchStart = schedulerTimer->Time();
     numUnfinishedTasks += tasks.size();
     tasksRunningCondition->Unlock();
 
@@ -815,32 +980,90 @@ void EnqueueTasks(const vector<Task *> &tasks) {
 }
 
 
+void RunTasks(const vector<Task *> &tasks) {
+    if (PbrtOptions.nCores == 1 || tasks.size() <= 1) {
+        for (unsigned int i = 0; i < tasks.size(); ++i)
+            tasks[i]->Run();
+        return;
+    }
+#ifdef PBRT_USE_GRAND_CENTRAL_DISPATCH
+    dispatch_group_t group = dispatch_group_create();
+    for (uint32_t i = 0; i < tasks.size(); ++i)
+        dispatch_group_async_f(group, gcdQueue, tasks[i], lRunTask);
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+#else
+    if (!threads)
+        TasksInit();
+    ConditionVariable finished;
+    TaskBatch batch;
+    batch.unfinished = tasks.size();
+    batch.done = false;
+    batch.finished = &finished;
+    PushTasks(tasks, &batch);
+    workerSemaphore->Post(tasks.size());
+
+    // Run queued tasks until all of _tasks_ are done, so that a task waiting
+    // for the tasks it spawned never blocks a worker. Once no task is queued
+    // the rest of the batch is running elsewhere: yield a few times for
+    // short tasks, then sleep until the last one signals _finished_
+    int nYields = 0;
+    while (batch.unfinished > 0 && nYields <= RUN_TASKS_MAX_YIELDS) {
+        if (!workerSemaphore->TryWait()) {
+            ++nYields;
+            YieldWorker();
+            continue;
+        }
+        nYields = 0;
+        QueuedTask qt;
+        while (!ClaimTask(&qt))
+            YieldWorker();
+        if (workerIndex >= 0)
+            ++workerStats[workerIndex].nTasks;
+        RunQueuedTask(qt);
+    }
+
+    // _done_ is also awaited when the batch is over, so that the last task
+    // is out of _finished_ before it goes out of scope
+    double t0 = workerIndex >= 0 ? workerStats[workerIndex].timer.Time() : 0.;
+    finished.Lock();
+    while (!batch.done)
+        finished.Wait();
+    finished.Unlock();
+    if (workerIndex >= 0)
+        workerStats[workerIndex].waitTime +=
+            workerStats[workerIndex].timer.Time() - t0;
+#endif
+}
+
+
 #ifndef PBRT_USE_GRAND_CENTRAL_DISPATCH
 #if defined(PBRT_IS_WINDOWS)
 static DWORD WINAPI taskEntry(LPVOID arg) {
 #else
 static void *taskEntry(void *arg) {
 #endif
+    workerIndex = int(reinterpret_cast<intptr_t>(arg));
+    WorkerStats &stats = workerStats[workerIndex];
     while (true) {
+        double t0 = stats.timer.Time();
         workerSemaphore->Wait();
-        // Try to get task from task queue
-        Task *myTask = NULL;
-        { MutexLock lock(*taskQueueMutex);
-        if (taskQueue.size() == 0)
+        if (workersExit)
             break;
-        myTask = taskQueue.back();
-        taskQueue.pop_back();
-        }
+        // Get a task from our deque or steal one; the semaphore count
+        // guarantees that a task is queued somewhere
+        double t1 = stats.timer.Time();
+        QueuedTask myTask;
+        while (!ClaimTask(&myTask))
+            YieldWorker();
+        double t2 = stats.timer.Time();
+        stats.waitTime += t1 - t0;
+        stats.claimTime += t2 - t1;
+        ++stats.nTasks;
 
         // Do work for _myTask_
-        PBRT_STARTED_TASK(myTask);
-        myTask->Run();
-        PBRT_FINISHED_TASK(myTask);
-        tasksRunningCondition->Lock();
-        int unfinished = --numUnfinishedTasks;
-        if (unfinished == 0)
-            tasksRunningCondition->Signal();
-        tasksRunningCondition->Unlock();
+        RunQueuedTask(myTask);
+        stats.lastFinish = stats.timer.Time();
     }
     // Cleanup from task thread and exit
 #if !defined(PBRT_IS_WINDOWS)
@@ -863,10 +1086,19 @@ void WaitForAllTasks() {
     while (numUnfinishedTasks > 0)
         tasksRunningCondition->Wait();
     tasksRunningCondition->Unlock();
+
+    // Record how long the batch ran with at least one worker out of work
+    double firstIdle = INFINITY;
+    for (int i = 0; i < nWorkers; ++i)
+        firstIdle = min(firstIdle, max(batchStart,
+                                       (double)workerStats[i].lastFinish));
+    double tail = max(0., schedulerTimer->Time() - firstIdle);
+    maxTailTime = max(maxTailTime, tail);
+    totalTailTime += tail;
+    ++nWaits;
 #endif
 }
 
-
 int NumSystemCores() {
     if (PbrtOptions.nCores > 0) return PbrtOptions.nCores;
 #if defined(PBRT_IS_WINDOWS)
@@ -332,6 +332,7 @@ public:
 
 
 void EnqueueTasks(const vector<Task *> &tasks);
+void RunTasks(const vector<Task *> &tasks);
 void WaitForAllTasks();
 int NumSystemCores();
 
@@ -39,6 +39,16 @@
             return (vec)[i]->data; \
         } \
     return NULL
+#define ADOPT_PARAM_TYPE(T, vec) \
+    (vec).push_back(new ParamSetItem<T>(name, \
+        Reference<ParamSetArray<T> >(new ParamSetArray<T>(data, nItems, true))))
+#define LOOKUP_ARRAY(T, vec) \
+    for (uint32_t i = 0; i < (vec).size(); ++i) \
+        if ((vec)[i]->name == name) { \
+            (vec)[i]->lookedUp = true; \
+            return (vec)[i]->array; \
+        } \
+    return Reference<ParamSetArray<T> >(NULL)
 #define LOOKUP_ONE(vec) \
     for (uint32_t i = 0; i < (vec).size(); ++i) { \
         if ((vec)[i]->name == name && \
@@ -179,6 +189,36 @@ void ParamSet::AddSampledSpectrumFiles(const string &name, const char **names,
 }
 
 
+void ParamSet::AdoptFloat(const string &name, float *data, int nItems) {
+    EraseFloat(name);
+    ADOPT_PARAM_TYPE(float, floats);
+}
+
+
+void ParamSet::AdoptInt(const string &name, int *data, int nItems) {
+    EraseInt(name);
+    ADOPT_PARAM_TYPE(int, ints);
+}
+
+
+void ParamSet::AdoptPoint(const string &name, Point *data, int nItems) {
+    ErasePoint(name);
+    ADOPT_PARAM_TYPE(Point, points);
+}
+
+
+void ParamSet::AdoptVector(const string &name, Vector *data, int nItems) {
+    EraseVector(name);
+    ADOPT_PARAM_TYPE(Vector, vectors);
+}
+
+
+void ParamSet::AdoptNormal(const string &name, Normal *data, int nItems) {
+    EraseNormal(name);
+    ADOPT_PARAM_TYPE(Normal, normals);
+}
+
+
 map<string, Spectrum> ParamSet::cachedSpectra;
 void ParamSet::AddString(const string &name, const string *data, int nItems) {
     EraseString(name);
@@ -368,6 +408,31 @@ const string *ParamSet::FindString(const string &name, int *nItems) const {
 }
 
 
+Reference<ParamSetArray<float> > ParamSet::FindFloatArray(const string &name) const {
+    LOOKUP_ARRAY(float, floats);
+}
+
+
+Reference<ParamSetArray<int> > ParamSet::FindIntArray(const string &name) const {
+    LOOKUP_ARRAY(int, ints);
+}
+
+
+Reference<ParamSetArray<Point> > ParamSet::FindPointArray(const string &name) const {
+    LOOKUP_ARRAY(Point, points);
+}
+
+
+Reference<ParamSetArray<Vector> > ParamSet::FindVectorArray(const string &name) const {
+    LOOKUP_ARRAY(Vector, vectors);
+}
+
+
+Reference<ParamSetArray<Normal> > ParamSet::FindNormalArray(const string &name) const {
+    LOOKUP_ARRAY(Normal, normals);
+}
+
+
 string ParamSet::FindOneString(const string &name, const string &d) const {
     LOOKUP_ONE(strings);
 }
@@ -59,6 +59,11 @@ public:
     void AddBlackbodySpectrum(const string &, const float *, int nItems);
     void AddSampledSpectrumFiles(const string &, const char **, int nItems);
     void AddSampledSpectrum(const string &, const float *, int nItems);
+    void AdoptFloat(const string &, float *, int nItems);
+    void AdoptInt(const string &, int *, int nItems);
+    void AdoptPoint(const string &, Point *, int nItems);
+    void AdoptVector(const string &, Vector *, int nItems);
+    void AdoptNormal(const string &, Normal *, int nItems);
     bool EraseInt(const string &);
     bool EraseBool(const string &);
     bool EraseFloat(const string &);
@@ -87,6 +92,11 @@ public:
     const Normal *FindNormal(const string &, int *nItems) const;
     const Spectrum *FindSpectrum(const string &, int *nItems) const;
     const string *FindString(const string &, int *nItems) const;
+    Reference<ParamSetArray<float> > FindFloatArray(const string &) const;
+    Reference<ParamSetArray<int> > FindIntArray(const string &) const;
+    Reference<ParamSetArray<Point> > FindPointArray(const string &) const;
+    Reference<ParamSetArray<Vector> > FindVectorArray(const string &) const;
+    Reference<ParamSetArray<Normal> > FindNormalArray(const string &) const;
     void ReportUnused() const;
     void Clear();
     string ToString() const;
@@ -106,17 +116,51 @@ private:
 };
 
 
+//[DGtal les valeurs des parametres sont dans un tableau partage (compteur
+// de references) : le tableau rempli par le parser est adopte sans copie
+// (Adopt*), et les formes le gardent (Find*Array) au lieu de le recopier.
+// Un tableau adopte a ete alloue par malloc() et n'est donc utilise que
+// pour des types sans constructeur (int, float, Point, Vector, Normal).]
+template <typename T> struct ParamSetArray : public ReferenceCounted {
+    // ParamSetArray Public Methods
+    ParamSetArray(int n) {
+        nItems = n;
+        data = new T[nItems];
+        adopted = false;
+    }
+    ParamSetArray(const T *v, int n) {
+        nItems = n;
+        data = new T[nItems];
+        for (int i = 0; i < nItems; ++i) data[i] = v[i];
+        adopted = false;
+    }
+    ParamSetArray(T *v, int n, bool) {
+        nItems = n;
+        data = v;
+        adopted = true;
+    }
+    ~ParamSetArray() {
+        if (adopted) free(data);
+        else delete[] data;
+    }
+
+    // ParamSetArray Data
+    int nItems;
+    T *data;
+    bool adopted;
+};
+
+
 template <typename T> struct ParamSetItem : public ReferenceCounted {
     // ParamSetItem Public Methods
     ParamSetItem(const string &name, const T *val, int nItems = 1);
-    ~ParamSetItem() {
-        delete[] data;
-    }
+    ParamSetItem(const string &name, const Reference<ParamSetArray<T> > &a);
 
     // ParamSetItem Data
     string name;
     int nItems;
     T *data;
+    Reference<ParamSetArray<T> > array;
     mutable bool lookedUp;
 };
 
@@ -124,11 +168,22 @@ template <typename T> struct ParamSetItem : public ReferenceCounted {
 
 // ParamSetItem Methods
 template <typename T>
-ParamSetItem<T>::ParamSetItem(const string &n, const T *v, int ni) {
+ParamSetItem<T>::ParamSetItem(const string &n, const T *v, int ni)
+    : array(new ParamSetArray<T>(v, ni)) {
     name = n;
     nItems = ni;
-    data = new T[nItems];
-    for (int i = 0; i < nItems; ++i) data[i] = v[i];
+    data = array->data;
+    lookedUp = false;
+}
+
+
+template <typename T>
+ParamSetItem<T>::ParamSetItem(const string &n,
+                              const Reference<ParamSetArray<T> > &a)
+    : array(a) {
+    name = n;
+    nItems = array->nItems;
+    data = array->data;
     lookedUp = false;
 }
 
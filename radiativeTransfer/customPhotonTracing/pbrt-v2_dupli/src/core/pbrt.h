@@ -115,6 +115,7 @@ class RWMutex;
 class Shape;
 class ParamSet;
 template <typename T> struct ParamSetItem;
+template <typename T> struct ParamSetArray;
 struct Options {
     Options() { nCores = 0;
                 quickRender = quiet = openWindow = verbose = false;
@@ -130,6 +131,25 @@ struct Options {
 	float resolPixel;
 	string filename;
 	bool photon;
+	string batchFile;
+};
+
+
+//[DGtal parametres d'un lancer de photons : ceux de la ligne de commande, ou
+// ceux d'une ligne du fichier de travaux (--batch), qui partagent alors la
+// meme scene et le meme BVH]
+struct PhotonJob {
+    PhotonJob() { wavelength = 700; nt = 1.3069; absorb = 0.000000029;
+                  dimx = dimy = dimz = 512; resolPixel = 8.59f;
+                  fileName = "fichierSortie"; nPhotons = 0;
+                  lightDir[0] = lightDir[1] = lightDir[2] = 0.f; }
+	int wavelength;
+	double nt, absorb;
+	int dimx, dimy, dimz;
+	float resolPixel;
+	string fileName;
+	int nPhotons;        // 0 : "causticphotons" de la scene
+	float lightDir[3];   // vers la lumiere, (0,0,0) : direction de la scene
 };
 
 
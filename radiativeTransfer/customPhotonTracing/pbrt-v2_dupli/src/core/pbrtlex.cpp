@@ -714,6 +714,15 @@ char *yytext;
 #include "pbrt.h"
 #include "api.h"
 #include "fileutil.h"
+#include "parallel.h"
+#include "timer.h"
+#include "shapeinclude.h"
+#if !defined(PBRT_IS_WINDOWS)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 struct ParamArray;
 
@@ -725,10 +734,24 @@ struct ParamArray;
 #endif
 #include "pbrtparse.hpp"
 
+//[DGtal le lexer flex est appele a travers yylex() ci-dessous, qui rend
+// d'abord les nombres deja decodes par ReadNumArray()]
+#define YY_DECL int yylex_flex()
+int yylex_flex();
+extern bool AdoptArrayElements(float *values, int n, int allocated);
+
+struct MappedSceneFile {
+    char *base;
+    size_t length;
+};
+
+
 struct IncludeInfo {
     string filename;
     YY_BUFFER_STATE bufState;
     int lineNum;
+    MappedSceneFile map;
+    double numArrayBytes, numArrayTime;
 };
 
 
@@ -743,23 +766,226 @@ void add_string_char(char c) {
 }
 
 
+//[DGtal lecture rapide des grands tableaux de nombres (fichiers de geometrie
+// ecrits par Noff2Pbrt) : les fichiers inclus sont projetes en memoire et
+// donnes a flex d'un seul bloc ; quand un "[" ouvre un tableau qui ne
+// contient que des nombres et des blancs, il est decode directement, en
+// parallele par morceaux coupes sur des blancs, et flex reprend sur le "]".
+// Des qu'un caractere sort de la regle NUMBER (commentaire, chaine...), le
+// tableau est laisse a flex : le resultat est identique.]
+#define NUM_ARRAY_MIN_BYTES 4096
+#define NUM_ARRAY_CHUNK_BYTES (1 << 20)
+static MappedSceneFile currentMap = { NULL, 0 };
+static double numArrayBytes = 0., numArrayTime = 0.;
+static float *numArray = NULL;
+static int numArraySize = 0, numArrayNext = 0;
+
+static bool MapSceneFile(const string &filename, MappedSceneFile *map) {
+#if !defined(PBRT_IS_WINDOWS)
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    // flex needs two writable NUL bytes after the text: reserve zeroed
+    // pages one past the end of the file and map the file over them
+    size_t length = st.st_size;
+    char *base = (char *)mmap(NULL, length + 2, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    if (mmap(base, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fd, 0) == MAP_FAILED) {
+        munmap(base, length + 2);
+        close(fd);
+        return false;
+    }
+    close(fd);
+    posix_madvise(base, length, POSIX_MADV_SEQUENTIAL);
+    // A NUL byte would end the flex buffer early
+    if (memchr(base, '\0', length)) {
+        munmap(base, length + 2);
+        return false;
+    }
+    map->base = base;
+    map->length = length;
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+static void UnmapSceneFile(MappedSceneFile *map) {
+#if !defined(PBRT_IS_WINDOWS)
+    if (map->base) munmap(map->base, map->length + 2);
+#endif
+    map->base = NULL;
+    map->length = 0;
+}
+
+
+static inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+
+// Decodes the numbers of [_begin_, _end_), false if anything else is found
+static bool DecodeNumbers(const char *begin, const char *end, float *values,
+                          int *nValues, int *nLines) {
+    const char *p = begin;
+    int n = 0, lines = 0;
+    while (p < end) {
+        char c = *p;
+        if (c == ' ' || c == '\t' || c == '\r') { ++p; continue; }
+        if (c == '\n') { ++lines; ++p; continue; }
+        if (!IsDigit(c) && c != '-' && c != '+' && c != '.') return false;
+        if (!DecodeNumber(p, end, &values[n])) return false;
+        ++n;
+    }
+    *nValues = n;
+    *nLines = lines;
+    return true;
+}
+
+
+class NumArrayTask : public Task {
+public:
+    NumArrayTask(const char *b, const char *e, float *v)
+        : begin(b), end(e), values(v), nValues(0), nLines(0), ok(false) { }
+    void Run() {
+        ok = DecodeNumbers(begin, end, values, &nValues, &nLines);
+    }
+    const char *begin, *end;
+    float *values;
+    int nValues, nLines;
+    bool ok;
+};
+
+
+// Called on "[": decodes the array up to "]" if it is only numbers
+static void ReadNumArray() {
+    // The whole array must already be in the flex buffer
+    char *start = yy_c_buf_p;
+    char *end = YY_CURRENT_BUFFER_LVALUE->yy_ch_buf + yy_n_chars;
+    if (start >= end) return;
+    *start = yy_hold_char;
+    char *close = (char *)memchr(start, ']', end - start);
+    if (!close || close - start < NUM_ARRAY_MIN_BYTES) {
+        *start = '\0';
+        return;
+    }
+    Timer timer;
+    timer.Start();
+
+    // Split the text on blanks; each chunk has at most (bytes+1)/2 numbers
+    vector<Task *> tasks;
+    size_t capacity = 0;
+    vector<size_t> offsets;
+    for (const char *b = start; b < close; ) {
+        const char *e = min(b + NUM_ARRAY_CHUNK_BYTES, (const char *)close);
+        while (e < close && *e != ' ' && *e != '\t' && *e != '\r' &&
+               *e != '\n')
+            ++e;
+        offsets.push_back(capacity);
+        capacity += (e - b + 1) / 2;
+        tasks.push_back(new NumArrayTask(b, e, NULL));
+        b = e;
+    }
+    float *values = (float *)malloc(capacity * sizeof(float));
+    for (uint32_t i = 0; i < tasks.size(); ++i)
+        ((NumArrayTask *)tasks[i])->values = values + offsets[i];
+    if (tasks.size() == 1) tasks[0]->Run();
+    else {
+        EnqueueTasks(tasks);
+        WaitForAllTasks();
+    }
+
+    // Pack the chunks' numbers together
+    bool ok = true;
+    int n = 0, lines = 0;
+    for (uint32_t i = 0; i < tasks.size(); ++i) {
+        NumArrayTask *task = (NumArrayTask *)tasks[i];
+        if (ok && task->ok) {
+            memmove(values + n, task->values, task->nValues * sizeof(float));
+            n += task->nValues;
+            lines += task->nLines;
+        }
+        else ok = false;
+        delete task;
+    }
+    if (!ok || n == 0) {
+        free(values);
+        *start = '\0';
+        return;
+    }
+    numArray = (float *)realloc(values, n * sizeof(float));
+    numArraySize = n;
+    numArrayNext = 0;
+    line_num += lines;
+
+    // Resume flex on the closing bracket
+    yy_c_buf_p = close;
+    yy_hold_char = *close;
+    *close = '\0';
+    timer.Stop();
+    numArrayBytes += close - start;
+    numArrayTime += timer.Time();
+}
+
+
+int yylex() {
+    if (!numArray) return yylex_flex();
+    // Hand all but the last number to the parser's current array at once
+    if (numArrayNext == 0 && numArraySize > 1 &&
+        AdoptArrayElements(numArray, numArraySize - 1, numArraySize)) {
+        yylval.num = numArray[numArraySize - 1];
+        numArray = NULL;
+        return NUM;
+    }
+    yylval.num = numArray[numArrayNext++];
+    if (numArrayNext == numArraySize) {
+        free(numArray);
+        numArray = NULL;
+    }
+    return NUM;
+}
+
+
 void include_push(char *filename) {
     if (includeStack.size() > 32)
         Severe("Only 32 levels of nested Include allowed in scene files.");
+    //[DGtal fichier qui ne contient que des Shape : lu en parallele]
+    if (pbrtShapeInclude(AbsolutePath(ResolveFilename(filename))))
+        return;
     IncludeInfo ii;
     extern string current_file;
     ii.filename = current_file;
     ii.bufState = YY_CURRENT_BUFFER;
     ii.lineNum = line_num;
+    ii.map = currentMap;
+    ii.numArrayBytes = numArrayBytes;
+    ii.numArrayTime = numArrayTime;
     includeStack.push_back(ii);
 
     current_file = AbsolutePath(ResolveFilename(filename));
     line_num = 1;
+    numArrayBytes = numArrayTime = 0.;
 
+    if (MapSceneFile(current_file, &currentMap)) {
+        yyin = NULL;
+        yy_scan_buffer(currentMap.base, currentMap.length + 2);
+        return;
+    }
+    currentMap.base = NULL;
     yyin = fopen(current_file.c_str(), "r");
     if (!yyin)
         Severe("Unable to open included scene file \"%s\"", current_file.c_str());
-    yy_switch_to_buffer(yy_create_buffer(yyin,YY_BUF_SIZE));
+    yy_switch_to_buffer(yy_create_buffer(yyin, YY_BUF_SIZE));
 }
 
 
@@ -767,17 +993,25 @@ void include_push(char *filename) {
 void include_pop() {
     extern int line_num;
     extern string current_file;
-    fclose(yyin);
+    if (numArrayBytes > 0.)
+        Info("Read %.1f MB of numeric arrays (%.1f MB/s)",
+             numArrayBytes / (1024. * 1024.),
+             numArrayBytes / (1024. * 1024.) / max(numArrayTime, 1e-6));
+    if (yyin) fclose(yyin);
     yy_delete_buffer(YY_CURRENT_BUFFER);
+    UnmapSceneFile(&currentMap);
     yy_switch_to_buffer(includeStack.back().bufState);
     current_file = includeStack.back().filename;
     line_num = includeStack.back().lineNum;
+    currentMap = includeStack.back().map;
+    numArrayBytes = includeStack.back().numArrayBytes;
+    numArrayTime = includeStack.back().numArrayTime;
     includeStack.pop_back();
 }
 
 
 
-#line 781 "core/pbrtlex.cpp"
+#line 1073 "core/pbrtlex.cpp"
 
 #define INITIAL 0
 #define STR 1
@@ -961,10 +1195,10 @@ YY_DECL
 	register char *yy_cp, *yy_bp;
 	register int yy_act;
     
-#line 101 "core/pbrtlex.ll"
+#line 394 "core/pbrtlex.ll"
 
 
-#line 968 "core/pbrtlex.cpp"
+#line 1260 "core/pbrtlex.cpp"
 
 	if ( !(yy_init) )
 		{
@@ -1049,239 +1283,239 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 103 "core/pbrtlex.ll"
+#line 396 "core/pbrtlex.ll"
 { BEGIN COMMENT; }
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 104 "core/pbrtlex.ll"
+#line 397 "core/pbrtlex.ll"
 /* eat it up */
 	YY_BREAK
 case 3:
 /* rule 3 can match eol */
 YY_RULE_SETUP
-#line 105 "core/pbrtlex.ll"
+#line 398 "core/pbrtlex.ll"
 { line_num++; BEGIN INITIAL; }
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 106 "core/pbrtlex.ll"
+#line 399 "core/pbrtlex.ll"
 { return ACCELERATOR; }
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 107 "core/pbrtlex.ll"
+#line 400 "core/pbrtlex.ll"
 { return ACTIVETRANSFORM; }
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 108 "core/pbrtlex.ll"
+#line 401 "core/pbrtlex.ll"
 { return ALL; }
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 109 "core/pbrtlex.ll"
+#line 402 "core/pbrtlex.ll"
 { return AREALIGHTSOURCE; }
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 110 "core/pbrtlex.ll"
+#line 403 "core/pbrtlex.ll"
 { return ATTRIBUTEBEGIN; }
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 111 "core/pbrtlex.ll"
+#line 404 "core/pbrtlex.ll"
 { return ATTRIBUTEEND; }
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 112 "core/pbrtlex.ll"
+#line 405 "core/pbrtlex.ll"
 { return CAMERA; }
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 113 "core/pbrtlex.ll"
+#line 406 "core/pbrtlex.ll"
 { return CONCATTRANSFORM; }
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 114 "core/pbrtlex.ll"
+#line 407 "core/pbrtlex.ll"
 { return COORDINATESYSTEM; }
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 115 "core/pbrtlex.ll"
+#line 408 "core/pbrtlex.ll"
 { return COORDSYSTRANSFORM; }
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 116 "core/pbrtlex.ll"
+#line 409 "core/pbrtlex.ll"
 { return ENDTIME; }
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 117 "core/pbrtlex.ll"
+#line 410 "core/pbrtlex.ll"
 { return FILM; }
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 118 "core/pbrtlex.ll"
+#line 411 "core/pbrtlex.ll"
 { return IDENTITY; }
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
-#line 119 "core/pbrtlex.ll"
+#line 412 "core/pbrtlex.ll"
 { return INCLUDE; }
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 120 "core/pbrtlex.ll"
+#line 413 "core/pbrtlex.ll"
 { return LIGHTSOURCE; }
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 121 "core/pbrtlex.ll"
+#line 414 "core/pbrtlex.ll"
 { return LOOKAT; }
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 122 "core/pbrtlex.ll"
+#line 415 "core/pbrtlex.ll"
 { return MAKENAMEDMATERIAL; }
 	YY_BREAK
 case 21:
 YY_RULE_SETUP
-#line 123 "core/pbrtlex.ll"
+#line 416 "core/pbrtlex.ll"
 { return MATERIAL; }
 	YY_BREAK
 case 22:
 YY_RULE_SETUP
-#line 124 "core/pbrtlex.ll"
+#line 417 "core/pbrtlex.ll"
 { return NAMEDMATERIAL; }
 	YY_BREAK
 case 23:
 YY_RULE_SETUP
-#line 125 "core/pbrtlex.ll"
+#line 418 "core/pbrtlex.ll"
 { return OBJECTBEGIN; }
 	YY_BREAK
 case 24:
 YY_RULE_SETUP
-#line 126 "core/pbrtlex.ll"
+#line 419 "core/pbrtlex.ll"
 { return OBJECTEND; }
 	YY_BREAK
 case 25:
 YY_RULE_SETUP
-#line 127 "core/pbrtlex.ll"
+#line 420 "core/pbrtlex.ll"
 { return OBJECTINSTANCE; }
 	YY_BREAK
 case 26:
 YY_RULE_SETUP
-#line 128 "core/pbrtlex.ll"
+#line 421 "core/pbrtlex.ll"
 { return PIXELFILTER; }
 	YY_BREAK
 case 27:
 YY_RULE_SETUP
-#line 129 "core/pbrtlex.ll"
+#line 422 "core/pbrtlex.ll"
 { return RENDERER; }
 	YY_BREAK
 case 28:
 YY_RULE_SETUP
-#line 130 "core/pbrtlex.ll"
+#line 423 "core/pbrtlex.ll"
 { return REVERSEORIENTATION; }
 	YY_BREAK
 case 29:
 YY_RULE_SETUP
-#line 131 "core/pbrtlex.ll"
+#line 424 "core/pbrtlex.ll"
 { return ROTATE; }
 	YY_BREAK
 case 30:
 YY_RULE_SETUP
-#line 132 "core/pbrtlex.ll"
+#line 425 "core/pbrtlex.ll"
 { return SAMPLER; }
 	YY_BREAK
 case 31:
 YY_RULE_SETUP
-#line 133 "core/pbrtlex.ll"
+#line 426 "core/pbrtlex.ll"
 { return SCALE; }
 	YY_BREAK
 case 32:
 YY_RULE_SETUP
-#line 134 "core/pbrtlex.ll"
+#line 427 "core/pbrtlex.ll"
 { return SHAPE; }
 	YY_BREAK
 case 33:
 YY_RULE_SETUP
-#line 135 "core/pbrtlex.ll"
+#line 428 "core/pbrtlex.ll"
 { return STARTTIME; }
 	YY_BREAK
 case 34:
 YY_RULE_SETUP
-#line 136 "core/pbrtlex.ll"
+#line 429 "core/pbrtlex.ll"
 { return SURFACEINTEGRATOR; }
 	YY_BREAK
 case 35:
 YY_RULE_SETUP
-#line 137 "core/pbrtlex.ll"
+#line 430 "core/pbrtlex.ll"
 { return TEXTURE; }
 	YY_BREAK
 case 36:
 YY_RULE_SETUP
-#line 138 "core/pbrtlex.ll"
+#line 431 "core/pbrtlex.ll"
 { return TRANSFORMBEGIN; }
 	YY_BREAK
 case 37:
 YY_RULE_SETUP
-#line 139 "core/pbrtlex.ll"
+#line 432 "core/pbrtlex.ll"
 { return TRANSFORMEND; }
 	YY_BREAK
 case 38:
 YY_RULE_SETUP
-#line 140 "core/pbrtlex.ll"
+#line 433 "core/pbrtlex.ll"
 { return TRANSFORMTIMES; }
 	YY_BREAK
 case 39:
 YY_RULE_SETUP
-#line 141 "core/pbrtlex.ll"
+#line 434 "core/pbrtlex.ll"
 { return TRANSFORM; }
 	YY_BREAK
 case 40:
 YY_RULE_SETUP
-#line 142 "core/pbrtlex.ll"
+#line 435 "core/pbrtlex.ll"
 { return TRANSLATE; }
 	YY_BREAK
 case 41:
 YY_RULE_SETUP
-#line 143 "core/pbrtlex.ll"
+#line 436 "core/pbrtlex.ll"
 { return VOLUME; }
 	YY_BREAK
 case 42:
 YY_RULE_SETUP
-#line 144 "core/pbrtlex.ll"
+#line 437 "core/pbrtlex.ll"
 { return VOLUMEINTEGRATOR; }
 	YY_BREAK
 case 43:
 YY_RULE_SETUP
-#line 145 "core/pbrtlex.ll"
+#line 438 "core/pbrtlex.ll"
 { return WORLDBEGIN; }
 	YY_BREAK
 case 44:
 YY_RULE_SETUP
-#line 146 "core/pbrtlex.ll"
+#line 439 "core/pbrtlex.ll"
 { return WORLDEND; }
 	YY_BREAK
 case 45:
 YY_RULE_SETUP
-#line 147 "core/pbrtlex.ll"
+#line 440 "core/pbrtlex.ll"
 /* do nothing */
 	YY_BREAK
 case 46:
 /* rule 46 can match eol */
 YY_RULE_SETUP
-#line 148 "core/pbrtlex.ll"
+#line 441 "core/pbrtlex.ll"
 { line_num++; }
 	YY_BREAK
 case 47:
 YY_RULE_SETUP
-#line 149 "core/pbrtlex.ll"
+#line 442 "core/pbrtlex.ll"
 {
     yylval.num = (float) atof(yytext);
     return NUM;
@@ -1289,7 +1523,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 48:
 YY_RULE_SETUP
-#line 155 "core/pbrtlex.ll"
+#line 448 "core/pbrtlex.ll"
 {
     strcpy(yylval.string, yytext);
     return ID;
@@ -1297,57 +1531,57 @@ YY_RULE_SETUP
 	YY_BREAK
 case 49:
 YY_RULE_SETUP
-#line 161 "core/pbrtlex.ll"
-{ return LBRACK; }
+#line 454 "core/pbrtlex.ll"
+{ ReadNumArray(); return LBRACK; }
 	YY_BREAK
 case 50:
 YY_RULE_SETUP
-#line 162 "core/pbrtlex.ll"
+#line 455 "core/pbrtlex.ll"
 { return RBRACK; }
 	YY_BREAK
 case 51:
 YY_RULE_SETUP
-#line 163 "core/pbrtlex.ll"
+#line 456 "core/pbrtlex.ll"
 { BEGIN STR; str_pos = 0; }
 	YY_BREAK
 case 52:
 YY_RULE_SETUP
-#line 164 "core/pbrtlex.ll"
+#line 457 "core/pbrtlex.ll"
 {add_string_char('\n');}
 	YY_BREAK
 case 53:
 YY_RULE_SETUP
-#line 165 "core/pbrtlex.ll"
+#line 458 "core/pbrtlex.ll"
 {add_string_char('\t');}
 	YY_BREAK
 case 54:
 YY_RULE_SETUP
-#line 166 "core/pbrtlex.ll"
+#line 459 "core/pbrtlex.ll"
 {add_string_char('\r');}
 	YY_BREAK
 case 55:
 YY_RULE_SETUP
-#line 167 "core/pbrtlex.ll"
+#line 460 "core/pbrtlex.ll"
 {add_string_char('\b');}
 	YY_BREAK
 case 56:
 YY_RULE_SETUP
-#line 168 "core/pbrtlex.ll"
+#line 461 "core/pbrtlex.ll"
 {add_string_char('\f');}
 	YY_BREAK
 case 57:
 YY_RULE_SETUP
-#line 169 "core/pbrtlex.ll"
+#line 462 "core/pbrtlex.ll"
 {add_string_char('\"');}
 	YY_BREAK
 case 58:
 YY_RULE_SETUP
-#line 170 "core/pbrtlex.ll"
+#line 463 "core/pbrtlex.ll"
 {add_string_char('\\');}
 	YY_BREAK
 case 59:
 YY_RULE_SETUP
-#line 171 "core/pbrtlex.ll"
+#line 464 "core/pbrtlex.ll"
 {
   int val = atoi(yytext+1);
   while (val > 256)
@@ -1358,41 +1592,41 @@ YY_RULE_SETUP
 case 60:
 /* rule 60 can match eol */
 YY_RULE_SETUP
-#line 179 "core/pbrtlex.ll"
+#line 472 "core/pbrtlex.ll"
 {line_num++;}
 	YY_BREAK
 case 61:
 YY_RULE_SETUP
-#line 180 "core/pbrtlex.ll"
+#line 473 "core/pbrtlex.ll"
 { add_string_char(yytext[1]);}
 	YY_BREAK
 case 62:
 YY_RULE_SETUP
-#line 181 "core/pbrtlex.ll"
+#line 474 "core/pbrtlex.ll"
 {BEGIN INITIAL; return STRING;}
 	YY_BREAK
 case 63:
 YY_RULE_SETUP
-#line 182 "core/pbrtlex.ll"
+#line 475 "core/pbrtlex.ll"
 {add_string_char(yytext[0]);}
 	YY_BREAK
 case 64:
 /* rule 64 can match eol */
 YY_RULE_SETUP
-#line 183 "core/pbrtlex.ll"
+#line 476 "core/pbrtlex.ll"
 {Error("Unterminated string!");}
 	YY_BREAK
 case 65:
 YY_RULE_SETUP
-#line 185 "core/pbrtlex.ll"
+#line 478 "core/pbrtlex.ll"
 { Error( "Illegal character: %c (0x%x)", yytext[0], int(yytext[0])); }
 	YY_BREAK
 case 66:
 YY_RULE_SETUP
-#line 186 "core/pbrtlex.ll"
+#line 479 "core/pbrtlex.ll"
 ECHO;
 	YY_BREAK
-#line 1396 "core/pbrtlex.cpp"
+#line 1688 "core/pbrtlex.cpp"
 case YY_STATE_EOF(INITIAL):
 case YY_STATE_EOF(STR):
 case YY_STATE_EOF(COMMENT):
@@ -2357,7 +2591,7 @@ void yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 186 "core/pbrtlex.ll"
+#line 479 "core/pbrtlex.ll"
 
 
 int yywrap() {
@@ -30,6 +30,15 @@
 #include "pbrt.h"
 #include "api.h"
 #include "fileutil.h"
+#include "parallel.h"
+#include "timer.h"
+#include "shapeinclude.h"
+#if !defined(PBRT_IS_WINDOWS)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 struct ParamArray;
 
@@ -41,10 +50,24 @@ struct ParamArray;
 #endif
 #include "pbrtparse.hpp"
 
+//[DGtal le lexer flex est appele a travers yylex() ci-dessous, qui rend
+// d'abord les nombres deja decodes par ReadNumArray()]
+#define YY_DECL int yylex_flex()
+int yylex_flex();
+extern bool AdoptArrayElements(float *values, int n, int allocated);
+
+struct MappedSceneFile {
+    char *base;
+    size_t length;
+};
+
+
 struct IncludeInfo {
     string filename;
     YY_BUFFER_STATE bufState;
     int lineNum;
+    MappedSceneFile map;
+    double numArrayBytes, numArrayTime;
 };
 
 
@@ -59,19 +82,222 @@ void add_string_char(char c) {
 }
 
 
+//[DGtal lecture rapide des grands tableaux de nombres (fichiers de geometrie
+// ecrits par Noff2Pbrt) : les fichiers inclus sont projetes en memoire et
+// donnes a flex d'un seul bloc ; quand un "[" ouvre un tableau qui ne
+// contient que des nombres et des blancs, il est decode directement, en
+// parallele par morceaux coupes sur des blancs, et flex reprend sur le "]".
+// Des qu'un caractere sort de la regle NUMBER (commentaire, chaine...), le
+// tableau est laisse a flex : le resultat est identique.]
+#define NUM_ARRAY_MIN_BYTES 4096
+#define NUM_ARRAY_CHUNK_BYTES (1 << 20)
+static MappedSceneFile currentMap = { NULL, 0 };
+static double numArrayBytes = 0., numArrayTime = 0.;
+static float *numArray = NULL;
+static int numArraySize = 0, numArrayNext = 0;
+
+static bool MapSceneFile(const string &filename, MappedSceneFile *map) {
+#if !defined(PBRT_IS_WINDOWS)
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    // flex needs two writable NUL bytes after the text: reserve zeroed
+    // pages one past the end of the file and map the file over them
+    size_t length = st.st_size;
+    char *base = (char *)mmap(NULL, length + 2, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    if (mmap(base, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fd, 0) == MAP_FAILED) {
+        munmap(base, length + 2);
+        close(fd);
+        return false;
+    }
+    close(fd);
+    posix_madvise(base, length, POSIX_MADV_SEQUENTIAL);
+    // A NUL byte would end the flex buffer early
+    if (memchr(base, '\0', length)) {
+        munmap(base, length + 2);
+        return false;
+    }
+    map->base = base;
+    map->length = length;
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+static void UnmapSceneFile(MappedSceneFile *map) {
+#if !defined(PBRT_IS_WINDOWS)
+    if (map->base) munmap(map->base, map->length + 2);
+#endif
+    map->base = NULL;
+    map->length = 0;
+}
+
+
+static inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+
+// Decodes the numbers of [_begin_, _end_), false if anything else is found
+static bool DecodeNumbers(const char *begin, const char *end, float *values,
+                          int *nValues, int *nLines) {
+    const char *p = begin;
+    int n = 0, lines = 0;
+    while (p < end) {
+        char c = *p;
+        if (c == ' ' || c == '\t' || c == '\r') { ++p; continue; }
+        if (c == '\n') { ++lines; ++p; continue; }
+        if (!IsDigit(c) && c != '-' && c != '+' && c != '.') return false;
+        if (!DecodeNumber(p, end, &values[n])) return false;
+        ++n;
+    }
+    *nValues = n;
+    *nLines = lines;
+    return true;
+}
+
+
+class NumArrayTask : public Task {
+public:
+    NumArrayTask(const char *b, const char *e, float *v)
+        : begin(b), end(e), values(v), nValues(0), nLines(0), ok(false) { }
+    void Run() {
+        ok = DecodeNumbers(begin, end, values, &nValues, &nLines);
+    }
+    const char *begin, *end;
+    float *values;
+    int nValues, nLines;
+    bool ok;
+};
+
+
+// Called on "[": decodes the array up to "]" if it is only numbers
+static void ReadNumArray() {
+    // The whole array must already be in the flex buffer
+    char *start = yy_c_buf_p;
+    char *end = YY_CURRENT_BUFFER_LVALUE->yy_ch_buf + yy_n_chars;
+    if (start >= end) return;
+    *start = yy_hold_char;
+    char *close = (char *)memchr(start, ']', end - start);
+    if (!close || close - start < NUM_ARRAY_MIN_BYTES) {
+        *start = '\0';
+        return;
+    }
+    Timer timer;
+    timer.Start();
+
+    // Split the text on blanks; each chunk has at most (bytes+1)/2 numbers
+    vector<Task *> tasks;
+    size_t capacity = 0;
+    vector<size_t> offsets;
+    for (const char *b = start; b < close; ) {
+        const char *e = min(b + NUM_ARRAY_CHUNK_BYTES, (const char *)close);
+        while (e < close && *e != ' ' && *e != '\t' && *e != '\r' &&
+               *e != '\n')
+            ++e;
+        offsets.push_back(capacity);
+        capacity += (e - b + 1) / 2;
+        tasks.push_back(new NumArrayTask(b, e, NULL));
+        b = e;
+    }
+    float *values = (float *)malloc(capacity * sizeof(float));
+    for (uint32_t i = 0; i < tasks.size(); ++i)
+        ((NumArrayTask *)tasks[i])->values = values + offsets[i];
+    if (tasks.size() == 1) tasks[0]->Run();
+    else {
+        EnqueueTasks(tasks);
+        WaitForAllTasks();
+    }
+
+    // Pack the chunks' numbers together
+    bool ok = true;
+    int n = 0, lines = 0;
+    for (uint32_t i = 0; i < tasks.size(); ++i) {
+        NumArrayTask *task = (NumArrayTask *)tasks[i];
+        if (ok && task->ok) {
+            memmove(values + n, task->values, task->nValues * sizeof(float));
+            n += task->nValues;
+            lines += task->nLines;
+        }
+        else ok = false;
+        delete task;
+    }
+    if (!ok || n == 0) {
+        free(values);
+        *start = '\0';
+        return;
+    }
+    numArray = (float *)realloc(values, n * sizeof(float));
+    numArraySize = n;
+    numArrayNext = 0;
+    line_num += lines;
+
+    // Resume flex on the closing bracket
+    yy_c_buf_p = close;
+    yy_hold_char = *close;
+    *close = '\0';
+    timer.Stop();
+    numArrayBytes += close - start;
+    numArrayTime += timer.Time();
+}
+
+
+int yylex() {
+    if (!numArray) return yylex_flex();
+    // Hand all but the last number to the parser's current array at once
+    if (numArrayNext == 0 && numArraySize > 1 &&
+        AdoptArrayElements(numArray, numArraySize - 1, numArraySize)) {
+        yylval.num = numArray[numArraySize - 1];
+        numArray = NULL;
+        return NUM;
+    }
+    yylval.num = numArray[numArrayNext++];
+    if (numArrayNext == numArraySize) {
+        free(numArray);
+        numArray = NULL;
+    }
+    return NUM;
+}
+
+
 void include_push(char *filename) {
     if (includeStack.size() > 32)
         Severe("Only 32 levels of nested Include allowed in scene files.");
+    //[DGtal fichier qui ne contient que des Shape : lu en parallele]
+    if (pbrtShapeInclude(AbsolutePath(ResolveFilename(filename))))
+        return;
     IncludeInfo ii;
     extern string current_file;
     ii.filename = current_file;
     ii.bufState = YY_CURRENT_BUFFER;
     ii.lineNum = line_num;
+    ii.map = currentMap;
+    ii.numArrayBytes = numArrayBytes;
+    ii.numArrayTime = numArrayTime;
     includeStack.push_back(ii);
 
     current_file = AbsolutePath(ResolveFilename(filename));
     line_num = 1;
-
+    numArrayBytes = numArrayTime = 0.;
+
+    if (MapSceneFile(current_file, &currentMap)) {
+        yyin = NULL;
+        yy_scan_buffer(currentMap.base, currentMap.length + 2);
+        return;
+    }
+    currentMap.base = NULL;
     yyin = fopen(current_file.c_str(), "r");
     if (!yyin)
         Severe("Unable to open included scene file \"%s\"", current_file.c_str());
@@ -83,15 +309,24 @@ void include_push(char *filename) {
 void include_pop() {
     extern int line_num;
     extern string current_file;
-    fclose(yyin);
+    if (numArrayBytes > 0.)
+        Info("Read %.1f MB of numeric arrays (%.1f MB/s)",
+             numArrayBytes / (1024. * 1024.),
+             numArrayBytes / (1024. * 1024.) / max(numArrayTime, 1e-6));
+    if (yyin) fclose(yyin);
     yy_delete_buffer(YY_CURRENT_BUFFER);
+    UnmapSceneFile(&currentMap);
     yy_switch_to_buffer(includeStack.back().bufState);
     current_file = includeStack.back().filename;
     line_num = includeStack.back().lineNum;
+    currentMap = includeStack.back().map;
+    numArrayBytes = includeStack.back().numArrayBytes;
+    numArrayTime = includeStack.back().numArrayTime;
     includeStack.pop_back();
 }
 
 
+
 %}
 %option nounput
 WHITESPACE [ \t\r]+
@@ -158,7 +393,7 @@ WorldEnd                { return WORLDEND; }
 }
 
 
-"[" { return LBRACK; }
+"[" { ReadNumArray(); return LBRACK; }
 "]" { return RBRACK; }
 \" { BEGIN STR; str_pos = 0; }
 <STR>\\n {add_string_char('\n');}
@@ -649,6 +649,20 @@ static const char *paramTypeToName(int type) {
 }
 
 
+//[DGtal le lexer a decode d'un coup un grand tableau de nombres : le
+// tableau (malloc, de capacite _allocated_) devient le tableau courant]
+bool AdoptArrayElements(float *values, int n, int allocated) {
+    if (!cur_array || cur_array->nelems != 0 || cur_array->isString)
+        return false;
+    free(cur_array->array);
+    cur_array->element_size = sizeof(float);
+    cur_array->array = values;
+    cur_array->nelems = n;
+    cur_array->allocated = allocated;
+    return true;
+}
+
+
 static void InitParamSet(ParamSet &ps, SpectrumType type) {
     ps.Clear();
     for (uint32_t i = 0; i < cur_paramlist.size(); ++i) {
@@ -672,15 +686,26 @@ static void InitParamSet(ParamSet &ps, SpectrumType type) {
             }
             void *data = cur_paramlist[i].arg;
             int nItems = cur_paramlist[i].size;
+            //[DGtal les tableaux numeriques du parser sont adoptes par le
+            // ParamSet sans copie ; FreeArgs() ne doit alors plus les liberer]
+            bool adopt = nItems > 0 && !cur_paramlist[i].isString &&
+                (type == PARAM_TYPE_INT || type == PARAM_TYPE_FLOAT ||
+                 type == PARAM_TYPE_POINT || type == PARAM_TYPE_VECTOR ||
+                 type == PARAM_TYPE_NORMAL);
+            if (adopt) {
+                data = realloc(data, nItems * sizeof(float));
+                cur_paramlist[i].arg = NULL;
+            }
             if (type == PARAM_TYPE_INT) {
                 // parser doesn't handle ints, so convert from floats here....
-                int nAlloc = nItems;
-                int *idata = new int[nAlloc];
-                float *fdata = (float *)cur_paramlist[i].arg;
-                for (int j = 0; j < nAlloc; ++j)
-                    idata[j] = int(fdata[j]);
-                ps.AddInt(name, idata, nItems);
-                delete[] idata;
+                float *fdata = (float *)data;
+                int *idata = (int *)data;
+                for (int j = 0; j < nItems; ++j) {
+                    int v = int(fdata[j]);
+                    memcpy(&idata[j], &v, sizeof(int));
+                }
+                if (adopt) ps.AdoptInt(name, idata, nItems);
+                else ps.AddInt(name, idata, nItems);
             }
             else if (type == PARAM_TYPE_BOOL) {
                 // strings -> bools
@@ -700,22 +725,26 @@ static void InitParamSet(ParamSet &ps, SpectrumType type) {
                 delete[] bdata;
             }
             else if (type == PARAM_TYPE_FLOAT) {
-                ps.AddFloat(name, (float *)data, nItems);
+                if (adopt) ps.AdoptFloat(name, (float *)data, nItems);
+                else ps.AddFloat(name, (float *)data, nItems);
             } else if (type == PARAM_TYPE_POINT) {
                 if ((nItems % 3) != 0)
                     Warning("Excess values given with point parameter \"%s\". "
                             "Ignoring last %d of them", cur_paramlist[i].name, nItems % 3);
-                ps.AddPoint(name, (Point *)data, nItems / 3);
+                if (adopt) ps.AdoptPoint(name, (Point *)data, nItems / 3);
+                else ps.AddPoint(name, (Point *)data, nItems / 3);
             } else if (type == PARAM_TYPE_VECTOR) {
                 if ((nItems % 3) != 0)
                     Warning("Excess values given with vector parameter \"%s\". "
                             "Ignoring last %d of them", cur_paramlist[i].name, nItems % 3);
-                ps.AddVector(name, (Vector *)data, nItems / 3);
+                if (adopt) ps.AdoptVector(name, (Vector *)data, nItems / 3);
+                else ps.AddVector(name, (Vector *)data, nItems / 3);
             } else if (type == PARAM_TYPE_NORMAL) {
                 if ((nItems % 3) != 0)
                     Warning("Excess values given with normal parameter \"%s\". "
                             "Ignoring last %d of them", cur_paramlist[i].name, nItems % 3);
-                ps.AddNormal(name, (Normal *)data, nItems / 3);
+                if (adopt) ps.AdoptNormal(name, (Normal *)data, nItems / 3);
+                else ps.AddNormal(name, (Normal *)data, nItems / 3);
             } else if (type == PARAM_TYPE_RGB) {
                 if ((nItems % 3) != 0)
                     Warning("Excess RGB values given with parameter \"%s\". "
@@ -152,7 +152,7 @@ static void addTracker(StatTracker *newTracker) {
 
 
 // Statistics Counters Function Definitions
-void ProbesPrint(FILE *dest) {
+void ProbesPrint(FILE *dest, const string &baseName) {
     fprintf(dest, "Statistics:\n");
     TrackerMap::iterator iter = trackers.begin();
     string lastCategory;
@@ -356,3 +356,260 @@ void PBRT_STARTED_SPECULAR_REFRACTION_RAY(const RayDifferential *) {
 
 
 #endif // PBRT_PROBES_COUNTERS
+#ifdef PBRT_PROBES_THREAD
+#include "parallel.h"
+#include <stdarg.h>
+#if !defined(PBRT_IS_WINDOWS)
+#include <time.h>
+#endif
+
+//[DGtal le resume des sondes est ajoute au fichier _stat.txt du lancer de
+// photons et ecrit en JSON dans le fichier _probes.json]
+extern bool PhotonImage;
+
+// Per-Thread Probes Local Declarations
+#if defined(PBRT_IS_WINDOWS)
+__declspec(thread) ThreadProbes *threadProbes = NULL;
+#else
+__thread ThreadProbes *threadProbes = NULL;
+#endif
+static vector<ThreadProbes *> allThreadProbes;
+static const char *phaseNames[PROBES_PHASE_COUNT] = {
+    "parse", "build", "shoot", "write"
+};
+
+
+static Mutex *ThreadProbesMutex() {
+    static Mutex *mutex = Mutex::Create();
+    return mutex;
+}
+
+
+static uint64_t ProbesTime() {
+    // Return a monotonic time in nanoseconds
+#if defined(PBRT_IS_WINDOWS)
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return uint64_t(double(count.QuadPart) * 1e9 / double(frequency.QuadPart));
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+#endif
+}
+
+
+static void ProbesPrintLine(FILE *dest, const char *name, const char *fmt, ...) {
+    fprintf(dest, "    %s", name);
+    int paddingSpaces = 56 - (int)strlen(name);
+    while (paddingSpaces-- > 0)
+        putc(' ', dest);
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(dest, fmt, args);
+    va_end(args);
+    putc('\n', dest);
+}
+
+
+static void BounceBucketRange(int bucket, int *lo, int *hi) {
+    // Bucket 0 holds paths without bounces, bucket $k$ holds $[2^{k-1}, 2^k)$
+    *lo = bucket == 0 ? 0 : (1 << (bucket - 1));
+    *hi = bucket == 0 ? 0 : (bucket == PROBES_BOUNCE_BUCKETS-1 ? -1 :
+                             (1 << bucket) - 1);
+}
+
+
+static void ProbesPrintSummary(FILE *dest, const ThreadProbes &sum,
+                               int nThreads) {
+    uint64_t nRays = sum.rays + sum.shadowRays;
+    fprintf(dest, "Statistics (%d thread%s):\n", nThreads,
+            nThreads > 1 ? "s" : "");
+    fprintf(dest, "Rays\n");
+    ProbesPrintLine(dest, "Rays traced", "%llu",
+                    (unsigned long long)sum.rays);
+    ProbesPrintLine(dest, "Shadow rays traced", "%llu",
+                    (unsigned long long)sum.shadowRays);
+    ProbesPrintLine(dest, "Triangle tests per ray", "%.2f",
+                    nRays ? double(sum.triangleTests) / nRays : 0.);
+    ProbesPrintLine(dest, "Triangle hits per ray", "%.2f",
+                    nRays ? double(sum.triangleHits) / nRays : 0.);
+    ProbesPrintLine(dest, "Accelerator nodes visited per ray", "%.2f",
+                    nRays ? double(sum.nodes) / nRays : 0.);
+    if (sum.photonPaths > 0) {
+        fprintf(dest, "Photons\n");
+        ProbesPrintLine(dest, "Photon paths", "%llu",
+                        (unsigned long long)sum.photonPaths);
+        ProbesPrintLine(dest, "Bounces per photon", "%.2f",
+                        double(sum.photonBounces) / sum.photonPaths);
+        for (int i = 0; i < PROBES_BOUNCE_BUCKETS; ++i) {
+            if (sum.bounceHistogram[i] == 0) continue;
+            int lo, hi;
+            BounceBucketRange(i, &lo, &hi);
+            char name[64];
+            if (hi < 0)       sprintf(name, "%d+ bounces", lo);
+            else if (lo == hi) sprintf(name, "%d bounce%s", lo, lo == 1 ? "" : "s");
+            else              sprintf(name, "%d-%d bounces", lo, hi);
+            ProbesPrintLine(dest, name, "%llu (%.2f%%)",
+                (unsigned long long)sum.bounceHistogram[i],
+                100. * double(sum.bounceHistogram[i]) / sum.photonPaths);
+        }
+    }
+    fprintf(dest, "Time (s)\n");
+    for (int i = 0; i < PROBES_PHASE_COUNT; ++i)
+        ProbesPrintLine(dest, phaseNames[i], "%.3f", 1e-9 * sum.phaseTime[i]);
+}
+
+
+static void ProbesWriteJSON(const string &filename, const ThreadProbes &sum,
+                            int nThreads) {
+    FILE *f = fopen(filename.c_str(), "w");
+    if (!f) {
+        Error("Unable to open probes file \"%s\"", filename.c_str());
+        return;
+    }
+    uint64_t nRays = sum.rays + sum.shadowRays;
+    fprintf(f, "{\n  \"threads\": %d,\n", nThreads);
+    fprintf(f, "  \"rays\": %llu,\n  \"shadowRays\": %llu,\n",
+            (unsigned long long)sum.rays, (unsigned long long)sum.shadowRays);
+    fprintf(f, "  \"triangleTests\": %llu,\n  \"triangleHits\": %llu,\n",
+            (unsigned long long)sum.triangleTests,
+            (unsigned long long)sum.triangleHits);
+    fprintf(f, "  \"nodesVisited\": %llu,\n",
+            (unsigned long long)sum.nodes);
+    fprintf(f, "  \"triangleTestsPerRay\": %g,\n  \"nodesPerRay\": %g,\n",
+            nRays ? double(sum.triangleTests) / nRays : 0.,
+            nRays ? double(sum.nodes) / nRays : 0.);
+    fprintf(f, "  \"photonPaths\": %llu,\n  \"bouncesPerPhoton\": %g,\n",
+            (unsigned long long)sum.photonPaths,
+            sum.photonPaths ? double(sum.photonBounces) / sum.photonPaths : 0.);
+    fprintf(f, "  \"bounceHistogram\": [");
+    bool first = true;
+    for (int i = 0; i < PROBES_BOUNCE_BUCKETS; ++i) {
+        if (sum.bounceHistogram[i] == 0) continue;
+        int lo, hi;
+        BounceBucketRange(i, &lo, &hi);
+        fprintf(f, "%s\n    { \"min\": %d, \"max\": ", first ? "" : ",", lo);
+        if (hi < 0) fprintf(f, "null");
+        else        fprintf(f, "%d", hi);
+        fprintf(f, ", \"count\": %llu }",
+                (unsigned long long)sum.bounceHistogram[i]);
+        first = false;
+    }
+    fprintf(f, "%s],\n  \"phaseSeconds\": {", first ? "" : "\n  ");
+    for (int i = 0; i < PROBES_PHASE_COUNT; ++i)
+        fprintf(f, "%s \"%s\": %.6f", i ? "," : "", phaseNames[i],
+                1e-9 * sum.phaseTime[i]);
+    fprintf(f, " }\n}\n");
+    fclose(f);
+}
+
+
+
+// Per-Thread Probes Function Definitions
+ThreadProbes *ThreadProbesCreate() {
+    ThreadProbes *tp = new ThreadProbes;
+    memset(tp, 0, sizeof(ThreadProbes));
+    { MutexLock lock(*ThreadProbesMutex());
+    allThreadProbes.push_back(tp);
+    }
+    threadProbes = tp;
+    return tp;
+}
+
+
+void ProbesStartPhase(ProbesPhase phase) {
+    ThreadProbes *tp = CurrentThreadProbes();
+    uint64_t now = ProbesTime();
+    // Time spent in nested phases is not charged to the enclosing phase
+    if (tp->phaseDepth > 0)
+        tp->phaseTime[tp->phaseStack[tp->phaseDepth-1]] += now - tp->phaseStart;
+    if (tp->phaseDepth < PROBES_MAX_PHASE_DEPTH)
+        tp->phaseStack[tp->phaseDepth++] = phase;
+    tp->phaseStart = now;
+}
+
+
+void ProbesFinishPhase(ProbesPhase phase) {
+    ThreadProbes *tp = CurrentThreadProbes();
+    if (tp->phaseDepth == 0 || tp->phaseStack[tp->phaseDepth-1] != phase)
+        return;
+    uint64_t now = ProbesTime();
+    tp->phaseTime[phase] += now - tp->phaseStart;
+    --tp->phaseDepth;
+    tp->phaseStart = now;
+}
+
+
+void ProbesPhotonPath(int bounces) {
+    ThreadProbes *tp = CurrentThreadProbes();
+    ++tp->photonPaths;
+    tp->photonBounces += bounces;
+    int bucket = 0;
+    while (bucket < PROBES_BOUNCE_BUCKETS-1 && (1 << bucket) <= bounces)
+        ++bucket;
+    ++tp->bounceHistogram[bucket];
+}
+
+
+void ProbesPrint(FILE *dest, const string &baseName) {
+    // Sum the counters of all threads, charging phases still running
+    ThreadProbes sum;
+    memset(&sum, 0, sizeof(ThreadProbes));
+    uint64_t now = ProbesTime();
+    MutexLock lock(*ThreadProbesMutex());
+    int nThreads = allThreadProbes.size();
+    for (int i = 0; i < nThreads; ++i) {
+        ThreadProbes *tp = allThreadProbes[i];
+        if (tp->phaseDepth > 0) {
+            tp->phaseTime[tp->phaseStack[tp->phaseDepth-1]] += now - tp->phaseStart;
+            tp->phaseStart = now;
+        }
+        sum.rays += tp->rays;
+        sum.shadowRays += tp->shadowRays;
+        sum.triangleTests += tp->triangleTests;
+        sum.triangleHits += tp->triangleHits;
+        sum.nodes += tp->nodes;
+        sum.photonPaths += tp->photonPaths;
+        sum.photonBounces += tp->photonBounces;
+        for (int j = 0; j < PROBES_BOUNCE_BUCKETS; ++j)
+            sum.bounceHistogram[j] += tp->bounceHistogram[j];
+        for (int j = 0; j < PROBES_PHASE_COUNT; ++j)
+            sum.phaseTime[j] += tp->phaseTime[j];
+
+        // Reset counters so that each rendered scene is reported on its own
+        int depth = tp->phaseDepth;
+        int stack[PROBES_MAX_PHASE_DEPTH];
+        memcpy(stack, tp->phaseStack, sizeof(stack));
+        memset(tp, 0, sizeof(ThreadProbes));
+        tp->phaseDepth = depth;
+        memcpy(tp->phaseStack, stack, sizeof(stack));
+        tp->phaseStart = now;
+    }
+    ProbesPrintSummary(dest, sum, nThreads);
+
+    //[DGtal resume ajoute au fichier de statistiques et version JSON]
+    if (PhotonImage) {
+        string statName = baseName + "_stat.txt";
+        FILE *stat = fopen(statName.c_str(), "a");
+        if (stat) {
+            fprintf(stat, "\n\n");
+            ProbesPrintSummary(stat, sum, nThreads);
+            fclose(stat);
+        }
+    }
+    ProbesWriteJSON(baseName + "_probes.json", sum, nThreads);
+}
+
+
+void ProbesCleanup() {
+    MutexLock lock(*ThreadProbesMutex());
+    for (uint32_t i = 0; i < allThreadProbes.size(); ++i)
+        delete allThreadProbes[i];
+    allThreadProbes.erase(allThreadProbes.begin(), allThreadProbes.end());
+    threadProbes = NULL;
+}
+
+
+#endif // PBRT_PROBES_THREAD
@@ -0,0 +1,297 @@
+
+/*
+    pbrt source code Copyright(c) 1998-2010 Matt Pharr and Greg Humphreys.
+
+    This file is part of pbrt.
+
+    pbrt is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.  Note that the text contents of
+    the book "Physically Based Rendering" are *not* licensed under the
+    GNU GPL.
+
+    pbrt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+// core/shapeinclude.cpp*
+#include "stdafx.h"
+#include "shapeinclude.h"
+#include <stdio.h>
+
+// Shape Include Local Declarations
+static inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+
+struct ShapeIncludeLexer {
+    ShapeIncludeLexer(const char *b, const char *e)
+        : p(b), end(e), line(1) { }
+    void SkipSpace() {
+        while (p < end) {
+            if (*p == '\n') { ++line; ++p; }
+            else if (*p == ' ' || *p == '\t' || *p == '\r') ++p;
+            else if (*p == '#') {
+                while (p < end && *p != '\n') ++p;
+            }
+            else break;
+        }
+    }
+    bool AtEnd() { SkipSpace(); return p >= end; }
+    bool Peek(char c) { SkipSpace(); return p < end && *p == c; }
+    bool String(string *s) {
+        SkipSpace();
+        if (p >= end || *p != '"') return false;
+        const char *start = ++p;
+        while (p < end && *p != '"' && *p != '\n') ++p;
+        if (p >= end || *p != '"') return false;
+        s->assign(start, p - start);
+        ++p;
+        return true;
+    }
+    bool Word(string *s) {
+        SkipSpace();
+        const char *start = p;
+        while (p < end && (isalnum(*p) || *p == '_')) ++p;
+        s->assign(start, p - start);
+        return p > start;
+    }
+    bool Number(float *f) {
+        SkipSpace();
+        const char *start = p;
+        if (!DecodeNumber(p, end, f)) {
+            p = start;
+            return false;
+        }
+        return true;
+    }
+    const char *p, *end;
+    int line;
+};
+
+
+// Numeric values are read in a malloc()-ed array adopted by the _ParamSet_
+struct ShapeIncludeValues {
+    ShapeIncludeValues() : nums(NULL), nNums(0), allocated(0) { }
+    ~ShapeIncludeValues() { free(nums); }
+    void Add(float f) {
+        if (nNums == allocated) {
+            allocated = 2 * allocated + 16;
+            nums = (float *)realloc(nums, allocated * sizeof(float));
+        }
+        nums[nNums++] = f;
+    }
+    float *Release() {
+        float *r = (float *)realloc(nums, max(nNums, 1) * sizeof(float));
+        nums = NULL;
+        nNums = allocated = 0;
+        return r;
+    }
+    float *nums;
+    int nNums, allocated;
+    vector<string> strs;
+};
+
+
+static bool ReadValues(ShapeIncludeLexer &lex, bool strings,
+                       ShapeIncludeValues *values) {
+    bool bracket = lex.Peek('[');
+    if (bracket) ++lex.p;
+    do {
+        if (bracket && lex.Peek(']')) { ++lex.p; return true; }
+        if (strings) {
+            string s;
+            if (!lex.String(&s)) return false;
+            values->strs.push_back(s);
+        }
+        else {
+            float f;
+            if (!lex.Number(&f)) return false;
+            values->Add(f);
+        }
+    } while (bracket);
+    return true;
+}
+
+
+static bool AddParam(ParamSet &ps, const string &decl,
+                     ShapeIncludeValues &values) {
+    // Split _decl_ into type and parameter name
+    size_t sep = decl.find_first_of(" \t");
+    if (sep == string::npos) return false;
+    string type = decl.substr(0, sep);
+    size_t start = decl.find_first_not_of(" \t", sep);
+    if (start == string::npos) return false;
+    string name = decl.substr(start);
+    const vector<string> &strs = values.strs;
+    int n = values.nNums;
+    if (type == "integer") {
+        float *f = values.Release();
+        int *ints = (int *)f;
+        for (int i = 0; i < n; ++i) {
+            int v = int(f[i]);
+            memcpy(&ints[i], &v, sizeof(int));
+        }
+        ps.AdoptInt(name, ints, n);
+    }
+    else if (type == "float")
+        ps.AdoptFloat(name, values.Release(), n);
+    else if (type == "point" || type == "vector" || type == "normal" ||
+             type == "color" || type == "rgb") {
+        if (n % 3 != 0) return false;
+        if (type == "point")
+            ps.AdoptPoint(name, (Point *)values.Release(), n / 3);
+        else if (type == "vector")
+            ps.AdoptVector(name, (Vector *)values.Release(), n / 3);
+        else if (type == "normal")
+            ps.AdoptNormal(name, (Normal *)values.Release(), n / 3);
+        else
+            ps.AddRGBSpectrum(name, values.nums, n);
+    }
+    else if (type == "string")
+        ps.AddString(name, strs.size() ? &strs[0] : NULL, strs.size());
+    else if (type == "bool") {
+        bool *b = new bool[strs.size() + 1];
+        for (uint32_t i = 0; i < strs.size(); ++i)
+            b[i] = (strs[i] == "true");
+        ps.AddBool(name, b, strs.size());
+        delete[] b;
+    }
+    else
+        return false;
+    return true;
+}
+
+
+
+// Shape Include Method Definitions
+
+// Decodes one NUMBER token at _p_ exactly as atof() would; also used by
+// the flex lexer for large numeric arrays
+bool DecodeNumber(const char *&p, const char *end, float *value) {
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+        1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+        1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+    uint64_t mantissa = 0;
+    int nDigits = 0, exponent = 0;
+    bool exact = true, anyDigit = false;
+    for (; p < end && IsDigit(*p); ++p) {
+        anyDigit = true;
+        if (mantissa == 0 && *p == '0') continue;
+        if (++nDigits > 19) { exact = false; continue; }
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        for (; p < end && IsDigit(*p); ++p) {
+            anyDigit = true;
+            if (mantissa == 0 && *p == '0') { --exponent; continue; }
+            if (++nDigits > 19) { exact = false; continue; }
+            mantissa = mantissa * 10 + (*p - '0');
+            --exponent;
+        }
+    }
+    if (!anyDigit) return false;
+    // The exponent only belongs to the number if digits follow
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *e = p + 1;
+        bool negativeExp = false;
+        if (e < end && (*e == '-' || *e == '+')) negativeExp = (*e++ == '-');
+        if (e < end && IsDigit(*e)) {
+            int exp = 0;
+            for (; e < end && IsDigit(*e); ++e)
+                if (exp < 10000) exp = exp * 10 + (*e - '0');
+            exponent += negativeExp ? -exp : exp;
+            p = e;
+        }
+    }
+    double v;
+    if (mantissa == 0 && exact)
+        v = 0.;
+    else if (exact && mantissa <= (1ull << 53) && exponent >= -22 &&
+             exponent <= 22)
+        v = exponent < 0 ? double(mantissa) / powers[-exponent] :
+                           double(mantissa) * powers[exponent];
+    else {
+        // Rare long or extreme numbers: use the same conversion as flex
+        string token(start, p - start);
+        *value = (float)atof(token.c_str());
+        return true;
+    }
+    *value = (float)(negative ? -v : v);
+    return true;
+}
+
+
+bool IsShapeInclude(const string &filename) {
+    FILE *f = fopen(filename.c_str(), "r");
+    if (!f) return false;
+    char line[64];
+    bool marked = fgets(line, sizeof(line), f) &&
+        strncmp(line, SHAPE_INCLUDE_MARKER, strlen(SHAPE_INCLUDE_MARKER)) == 0;
+    fclose(f);
+    return marked;
+}
+
+
+bool ParseShapeInclude(const string &filename,
+                       vector<ShapeIncludeEntry> *shapes) {
+    // Read whole file in memory
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f) {
+        Error("Unable to open included scene file \"%s\"", filename.c_str());
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    vector<char> buf(size + 1, '\0');
+    if (size > 0 && fread(&buf[0], 1, size, f) != (size_t)size) {
+        Error("Unable to read \"%s\"", filename.c_str());
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+
+    // Parse _Shape_ statements and their parameter lists
+    ShapeIncludeLexer lex(&buf[0], &buf[0] + size);
+    while (!lex.AtEnd()) {
+        string keyword;
+        ShapeIncludeEntry entry;
+        if (!lex.Word(&keyword) || keyword != "Shape" ||
+            !lex.String(&entry.name)) {
+            Error("%s(%d): only Shape statements are allowed in a "
+                  "shapes-only include", filename.c_str(), lex.line);
+            return false;
+        }
+        while (lex.Peek('"')) {
+            string decl;
+            ShapeIncludeValues values;
+            lex.String(&decl);
+            bool strings = decl.compare(0, 6, "string") == 0 ||
+                           decl.compare(0, 4, "bool") == 0;
+            if (!ReadValues(lex, strings, &values) ||
+                !AddParam(entry.params, decl, values)) {
+                Error("%s(%d): bad parameter \"%s\"", filename.c_str(),
+                      lex.line, decl.c_str());
+                return false;
+            }
+        }
+        shapes->push_back(entry);
+    }
+    return true;
+}
+
+
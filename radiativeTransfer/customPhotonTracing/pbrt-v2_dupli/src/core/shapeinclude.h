@@ -0,0 +1,54 @@
+
+/*
+    pbrt source code Copyright(c) 1998-2010 Matt Pharr and Greg Humphreys.
+
+    This file is part of pbrt.
+
+    pbrt is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.  Note that the text contents of
+    the book "Physically Based Rendering" are *not* licensed under the
+    GNU GPL.
+
+    pbrt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef PBRT_CORE_SHAPEINCLUDE_H
+#define PBRT_CORE_SHAPEINCLUDE_H
+
+// core/shapeinclude.h*
+#include "pbrt.h"
+#include "paramset.h"
+
+//[DGtal fichiers inclus qui ne contiennent que des Shape (morceaux ecrits
+// par Noff2Pbrt --shards). Leur premiere ligne est SHAPE_INCLUDE_MARKER ;
+// ils sont lus sans le lexer flex, qui n'est pas reentrant, et peuvent
+// donc l'etre en parallele.]
+#define SHAPE_INCLUDE_MARKER "#pbrt shapes-only"
+
+struct ShapeIncludeEntry {
+    string name;
+    ParamSet params;
+};
+
+// Shape Include Declarations
+//[DGtal lit un nombre a _p_ exactement comme atof() (le lexer flex) : les
+// deux chemins de lecture donnent les memes floats.]
+bool DecodeNumber(const char *&p, const char *end, float *value);
+bool IsShapeInclude(const string &filename);
+bool ParseShapeInclude(const string &filename,
+                       vector<ShapeIncludeEntry> *shapes);
+
+#endif // PBRT_CORE_SHAPEINCLUDE_H
@@ -29,9 +29,90 @@
 #include "parallel.h"
 #include "imageio.h"
 
+// ImageFilm Local Declarations
+
+// Guide images of the joint bilateral denoiser, one value per pixel
+struct DenoiseGuide {
+    int xRes, yRes, radius;
+    float sigmaColor2, invSigmaNormal2, invSigmaDepth2, invSigmaAlbedo2;
+    vector<float> spatialWeights;
+    vector<float> n, albedo, depth, lum, lumVariance;
+    vector<float> irradiance, modulation;
+    float *out;
+};
+
+
+static void DenoiseRows(const DenoiseGuide &g, int yStart, int yEnd) {
+    int r = g.radius;
+    for (int y = yStart; y < yEnd; ++y) {
+        for (int x = 0; x < g.xRes; ++x) {
+            int p = y * g.xRes + x;
+            float sum[3] = { 0.f, 0.f, 0.f }, weightSum = 0.f;
+            for (int qy = max(0, y - r); qy <= min(g.yRes - 1, y + r); ++qy) {
+                for (int qx = max(0, x - r); qx <= min(g.xRes - 1, x + r); ++qx) {
+                    int q = qy * g.xRes + qx;
+                    // Compute edge-stopping weight of pixel _q_ for _p_
+                    float dn = 0.f, da = 0.f;
+                    for (int c = 0; c < 3; ++c) {
+                        dn += (g.n[3*p+c] - g.n[3*q+c]) * (g.n[3*p+c] - g.n[3*q+c]);
+                        da += (g.albedo[3*p+c] - g.albedo[3*q+c]) *
+                              (g.albedo[3*p+c] - g.albedo[3*q+c]);
+                    }
+                    float dd = 0.f;
+                    if (g.depth[p] > 0.f && g.depth[q] > 0.f)
+                        dd = (g.depth[p] - g.depth[q]) / g.depth[p];
+                    // Compare 3x3 luminance patches around _p_ and _q_,
+                    // discounting the expected difference due to noise
+                    float dc = 0.f;
+                    int nPatch = 0;
+                    for (int oy = -1; oy <= 1; ++oy) {
+                        int py = y + oy, qyy = qy + oy;
+                        if (py < 0 || py >= g.yRes || qyy < 0 || qyy >= g.yRes) continue;
+                        for (int ox = -1; ox <= 1; ++ox) {
+                            int px = x + ox, qxx = qx + ox;
+                            if (px < 0 || px >= g.xRes || qxx < 0 || qxx >= g.xRes) continue;
+                            int pp = py * g.xRes + px, qq = qyy * g.xRes + qxx;
+                            float vp = g.lumVariance[pp], vq = g.lumVariance[qq];
+                            float dl = g.lum[pp] - g.lum[qq];
+                            dc += (dl * dl - (vp + min(vp, vq))) /
+                                  (1e-10f + g.sigmaColor2 * (vp + vq));
+                            ++nPatch;
+                        }
+                    }
+                    dc = max(0.f, dc / nPatch);
+                    float e = dn * g.invSigmaNormal2 + da * g.invSigmaAlbedo2 +
+                              dd * dd * g.invSigmaDepth2 + 2.f * dc;
+                    float w = g.spatialWeights[abs(qy - y) * (r + 1) + abs(qx - x)] *
+                              expf(-.5f * e);
+                    sum[0] += w * g.irradiance[3*q];
+                    sum[1] += w * g.irradiance[3*q+1];
+                    sum[2] += w * g.irradiance[3*q+2];
+                    weightSum += w;
+                }
+            }
+            for (int c = 0; c < 3; ++c)
+                g.out[3*p+c] = sum[c] / weightSum * g.modulation[3*p+c];
+        }
+    }
+}
+
+
+class DenoiseTask : public Task {
+public:
+    DenoiseTask(const DenoiseGuide &gg, int y0, int y1)
+        : g(gg), yStart(y0), yEnd(y1) { }
+    void Run() { DenoiseRows(g, yStart, yEnd); }
+private:
+    const DenoiseGuide &g;
+    int yStart, yEnd;
+};
+
+
+
 // ImageFilm Method Definitions
 ImageFilm::ImageFilm(int xres, int yres, Filter *filt, const float crop[4],
-                     const string &fn, bool openWindow)
+                     const string &fn, bool openWindow, bool dn, bool wf,
+                     int dr, const float sigmas[4])
     : Film(xres, yres) {
     filter = filt;
     memcpy(cropWindow, crop, 4 * sizeof(float));
@@ -59,6 +140,17 @@ ImageFilm::ImageFilm(int xres, int yres, Filter *filt, const float crop[4],
         }
     }
 
+    // Allocate feature buffers for the denoiser
+    denoise = dn;
+    writeFeatures = wf;
+    denoiseRadius = max(dr, 1);
+    sigmaColor  = sigmas ? sigmas[0] : 1.f;
+    sigmaNormal = sigmas ? sigmas[1] : .3f;
+    sigmaDepth  = sigmas ? sigmas[2] : .05f;
+    sigmaAlbedo = sigmas ? sigmas[3] : .1f;
+    if (denoise || writeFeatures)
+        features.resize(xPixelCount * yPixelCount);
+
     // Possibly open window for image display
     if (openWindow || PbrtOptions.openWindow) {
         Warning("Support for opening image display window not available in this build.");
@@ -146,6 +238,32 @@ void ImageFilm::Splat(const CameraSample &sample, const Spectrum &L) {
 }
 
 
+void ImageFilm::AddFeatures(const CameraSample &sample, const Spectrum &L,
+        const Normal &n, const Spectrum &albedo, float depth) {
+    // Features go to the pixel holding the sample; pixels are rendered by a
+    // single task, so no synchronization is needed
+    int x = Floor2Int(sample.imageX) - xPixelStart;
+    int y = Floor2Int(sample.imageY) - yPixelStart;
+    if (x < 0 || x >= xPixelCount || y < 0 || y >= yPixelCount) return;
+    PixelFeatures &f = features[y * xPixelCount + x];
+    float lum = L.y();
+    f.lumSum += lum;
+    f.lumSquaredSum += lum * lum;
+    f.nSamples += 1.f;
+    if (depth > 0.f) {
+        float rgb[3];
+        albedo.ToRGB(rgb);
+        f.n[0] += n.x;
+        f.n[1] += n.y;
+        f.n[2] += n.z;
+        for (int c = 0; c < 3; ++c)
+            f.albedo[c] += rgb[c];
+        f.depth += depth;
+        f.nHits += 1.f;
+    }
+}
+
+
 void ImageFilm::GetSampleExtent(int *xstart, int *xend,
                                 int *ystart, int *yend) const {
     *xstart = Floor2Int(xPixelStart + 0.5f - filter->xWidth);
@@ -196,6 +314,22 @@ void ImageFilm::WriteImage(float splatScale) {
         }
     }
 
+    // Denoise image using the feature buffers
+    if (writeFeatures)
+        WriteFeatures(rgb);
+    bool hasFeatures = false;
+    for (uint32_t i = 0; i < features.size() && !hasFeatures; ++i)
+        hasFeatures = features[i].nSamples > 0.f;
+    if (denoise && !hasFeatures)
+        Warning("No samples recorded features for \"%s\"; not denoising",
+                filename.c_str());
+    else if (denoise) {
+        float *denoised = new float[3*nPix];
+        Denoise(rgb, denoised);
+        std::swap(rgb, denoised);
+        delete[] denoised;
+    }
+
     // Write RGB image
     ::WriteImage(filename, rgb, NULL, xPixelCount, yPixelCount,
                  xResolution, yResolution, xPixelStart, yPixelStart);
@@ -210,6 +344,108 @@ void ImageFilm::UpdateDisplay(int x0, int y0, int x1, int y1,
 }
 
 
+void ImageFilm::Denoise(const float *rgb, float *out) const {
+    // Compute guide images from the feature buffers
+    int nPix = xPixelCount * yPixelCount;
+    DenoiseGuide g;
+    g.xRes = xPixelCount;
+    g.yRes = yPixelCount;
+    g.radius = denoiseRadius;
+    g.sigmaColor2     = sigmaColor * sigmaColor;
+    g.invSigmaNormal2 = 1.f / (sigmaNormal * sigmaNormal);
+    g.invSigmaDepth2  = 1.f / (sigmaDepth * sigmaDepth);
+    g.invSigmaAlbedo2 = 1.f / (sigmaAlbedo * sigmaAlbedo);
+    g.n.resize(3*nPix);
+    g.albedo.resize(3*nPix);
+    g.depth.resize(nPix);
+    g.lum.resize(nPix);
+    g.lumVariance.resize(nPix);
+    g.irradiance.resize(3*nPix);
+    g.modulation.resize(3*nPix);
+    g.out = out;
+    for (int i = 0; i < nPix; ++i) {
+        const PixelFeatures &f = features[i];
+        float invSamples = f.nSamples > 0.f ? 1.f / f.nSamples : 0.f;
+        for (int c = 0; c < 3; ++c) {
+            // Normals and albedo are averaged over all samples of the
+            // pixel, so that they also separate covered from empty pixels
+            g.n[3*i+c] = f.n[c] * invSamples;
+            g.albedo[3*i+c] = f.albedo[c] * invSamples;
+
+            // Filter irradiance rather than radiance to keep texture
+            g.modulation[3*i+c] = f.nHits > 0.f ? max(g.albedo[3*i+c], .01f) : 1.f;
+            g.irradiance[3*i+c] = rgb[3*i+c] / g.modulation[3*i+c];
+        }
+        g.depth[i] = f.nHits > 0.f ? f.depth / f.nHits : 0.f;
+        g.lum[i] = .212671f * rgb[3*i] + .715160f * rgb[3*i+1] +
+                   .072169f * rgb[3*i+2];
+
+        // Estimate variance of the pixel mean from its samples
+        if (f.nSamples > 1.f) {
+            float mean = f.lumSum * invSamples;
+            float var = max(0.f, f.lumSquaredSum * invSamples - mean * mean);
+            g.lumVariance[i] = var / (f.nSamples - 1.f);
+        }
+        else
+            g.lumVariance[i] = 1e10f;
+    }
+    float sigmaSpatial = .5f * denoiseRadius;
+    for (int dy = 0; dy <= denoiseRadius; ++dy)
+        for (int dx = 0; dx <= denoiseRadius; ++dx)
+            g.spatialWeights.push_back(expf(-(dx*dx + dy*dy) /
+                                            (2.f * sigmaSpatial * sigmaSpatial)));
+
+    // Run joint bilateral filter over bands of rows
+    vector<Task *> tasks;
+    int nTasks = min(yPixelCount, 8 * NumSystemCores());
+    for (int i = 0; i < nTasks; ++i)
+        tasks.push_back(new DenoiseTask(g, i * yPixelCount / nTasks,
+                                        (i + 1) * yPixelCount / nTasks));
+    RunTasks(tasks);
+    for (uint32_t i = 0; i < tasks.size(); ++i)
+        delete tasks[i];
+}
+
+
+void ImageFilm::WriteFeatures(const float *rgb) const {
+    // Write noisy image and feature buffers next to the image file
+    string base = filename, ext;
+    size_t dot = filename.rfind('.');
+    if (dot != string::npos) {
+        base = filename.substr(0, dot);
+        ext = filename.substr(dot);
+    }
+    int nPix = xPixelCount * yPixelCount;
+    float *buf = new float[3*nPix];
+    ::WriteImage(base + "_noisy" + ext, const_cast<float *>(rgb), NULL,
+                 xPixelCount, yPixelCount, xResolution, yResolution,
+                 xPixelStart, yPixelStart);
+    float maxDepth = 0.f;
+    for (int i = 0; i < nPix; ++i)
+        if (features[i].nHits > 0.f)
+            maxDepth = max(maxDepth, features[i].depth / features[i].nHits);
+    for (int pass = 0; pass < 3; ++pass) {
+        for (int i = 0; i < nPix; ++i) {
+            const PixelFeatures &f = features[i];
+            float invHits = f.nHits > 0.f ? 1.f / f.nHits : 0.f;
+            for (int c = 0; c < 3; ++c) {
+                if (pass == 0)
+                    buf[3*i+c] = f.nHits > 0.f ? .5f + .5f * f.n[c] * invHits : 0.f;
+                else if (pass == 1)
+                    buf[3*i+c] = f.albedo[c] * invHits;
+                else
+                    buf[3*i+c] = maxDepth > 0.f ? f.depth * invHits / maxDepth : 0.f;
+            }
+        }
+        const char *suffix[3] = { "_normal", "_albedo", "_depth" };
+        ::WriteImage(base + suffix[pass] + ext, buf, NULL, xPixelCount,
+                     yPixelCount, xResolution, yResolution, xPixelStart,
+                     yPixelStart);
+    }
+    delete[] buf;
+}
+
+
 ImageFilm *CreateImageFilm(const ParamSet &params, Filter *filter) {
     string filename = params.FindOneString("filename", PbrtOptions.imageFile);
     if (filename == "")
@@ -234,7 +470,15 @@ ImageFilm *CreateImageFilm(const ParamSet &params, Filter *filter) {
         crop[3] = Clamp(max(cr[2], cr[3]), 0., 1.);
     }
 
-    return new ImageFilm(xres, yres, filter, crop, filename, openwin);
+    bool denoise = params.FindOneBool("denoise", false);
+    bool writeFeatures = params.FindOneBool("writefeatures", false);
+    int denoiseRadius = params.FindOneInt("denoiseradius", 7);
+    float sigmas[4] = { params.FindOneFloat("denoisecolor", 1.f),
+                        params.FindOneFloat("denoisenormal", .3f),
+                        params.FindOneFloat("denoisedepth", .05f),
+                        params.FindOneFloat("denoisealbedo", .1f) };
+    return new ImageFilm(xres, yres, filter, crop, filename, openwin,
+                         denoise, writeFeatures, denoiseRadius, sigmas);
 }
 
 
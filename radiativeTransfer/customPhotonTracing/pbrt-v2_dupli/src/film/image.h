@@ -40,7 +40,9 @@ class ImageFilm : public Film {
 public:
     // ImageFilm Public Methods
     ImageFilm(int xres, int yres, Filter *filt, const float crop[4],
-              const string &filename, bool openWindow);
+              const string &filename, bool openWindow, bool denoise = false,
+              bool writeFeatures = false, int denoiseRadius = 7,
+              const float denoiseSigmas[4] = NULL);
     ~ImageFilm() {
         delete pixels;
         delete filter;
@@ -52,7 +54,14 @@ public:
     void GetPixelExtent(int *xstart, int *xend, int *ystart, int *yend) const;
     void WriteImage(float splatScale);
     void UpdateDisplay(int x0, int y0, int x1, int y1, float splatScale);
+    bool WantsFeatures() const { return denoise || writeFeatures; }
+    void AddFeatures(const CameraSample &sample, const Spectrum &L,
+                     const Normal &n, const Spectrum &albedo, float depth);
 private:
+    // ImageFilm Private Methods
+    void Denoise(const float *rgb, float *out) const;
+    void WriteFeatures(const float *rgb) const;
+
     // ImageFilm Private Data
     Filter *filter;
     float cropWindow[4];
@@ -70,6 +79,22 @@ private:
     };
     BlockedArray<Pixel> *pixels;
     float *filterTable;
+
+    // First-hit normal, albedo and depth averaged per pixel, with the
+    // luminance statistics of the samples, for the denoiser
+    struct PixelFeatures {
+        PixelFeatures() {
+            for (int i = 0; i < 3; ++i) n[i] = albedo[i] = 0.f;
+            depth = nHits = lumSum = lumSquaredSum = nSamples = 0.f;
+        }
+        float n[3], albedo[3];
+        float depth, nHits;
+        float lumSum, lumSquaredSum, nSamples;
+    };
+    bool denoise, writeFeatures;
+    int denoiseRadius;
+    float sigmaColor, sigmaNormal, sigmaDepth, sigmaAlbedo;
+    vector<PixelFeatures> features;
 };
 
 
@@ -40,14 +40,8 @@
 #include <map>
 #include <cmath>
 #define M_Ni 1.0
-//[DGtal on recupere les variables globales pour l'absorption et la declaration de fichier]
-extern double M_Nt;
-extern double M_ABSORB;
-extern int dimensionImageX;
-extern int dimensionImageY;
-extern int dimensionImageZ;
-extern float resolutionPixel;
-extern string fileName;
+//[DGtal les parametres d'absorption et les noms de fichier sont ceux du
+// _PhotonJob_ de l'integrateur]
 extern bool PhotonImage;
 
 //[DGtal : une structure qui contient les coordonnes spheriques (pour la BRDF)]
@@ -278,9 +272,9 @@ public:
         vector<RadiancePhoton> &rps, const vector<Spectrum> &rhor,
         const vector<Spectrum> &rhot,
         uint32_t nlookup, float md2,
-        int ndirect, KdTree<Photon> *direct,
-        int nindirect, KdTree<Photon> *indirect,
-        int ncaus, KdTree<Photon> *caustic)
+        int ndirect, PhotonIndex<Photon> *direct,
+        int nindirect, PhotonIndex<Photon> *indirect,
+        int ncaus, PhotonIndex<Photon> *caustic)
         : progress(prog), taskNum(tn), numTasks(nt), radiancePhotons(rps),
           rpReflectances(rhor), rpTransmittances(rhot), nLookup(nlookup),
           maxDistSquared(md2),
@@ -296,7 +290,7 @@ private:
     uint32_t nLookup;
     float maxDistSquared;
     int nDirectPaths, nIndirectPaths, nCausticPaths;
-    KdTree<Photon> *directMap, *indirectMap, *causticMap;
+    PhotonIndex<Photon> *directMap, *indirectMap, *causticMap;
 };
 
 
@@ -349,10 +343,10 @@ struct RadiancePhotonProcess {
 
 
 inline float kernel(const Photon *photon, const Point &p, float maxDist2);
-static Spectrum LPhoton(KdTree<Photon> *map, int nPaths, int nLookup,
+static Spectrum LPhoton(PhotonIndex<Photon> *map, int nPaths, int nLookup,
     ClosePhoton *lookupBuf, BSDF *bsdf, RNG &rng, const Intersection &isect,
     const Vector &w, float maxDistSquared);
-static Spectrum EPhoton(KdTree<Photon> *map, int count, int nLookup,
+static Spectrum EPhoton(PhotonIndex<Photon> *map, int count, int nLookup,
     ClosePhoton *lookupBuf, float maxDist2, const Point &p, const Normal &n);
 
 // PhotonIntegrator Local Definitions
@@ -388,7 +382,7 @@ inline float kernel(const Photon *photon, const Point &p,
 }
 
 
-Spectrum LPhoton(KdTree<Photon> *map, int nPaths, int nLookup,
+Spectrum LPhoton(PhotonIndex<Photon> *map, int nPaths, int nLookup,
       ClosePhoton *lookupBuf, BSDF *bsdf, RNG &rng,
       const Intersection &isect, const Vector &wo, float maxDist2) {
     Spectrum L(0.);
@@ -437,7 +431,7 @@ Spectrum LPhoton(KdTree<Photon> *map, int nPaths, int nLookup,
 }
 
 
-Spectrum EPhoton(KdTree<Photon> *map, int count, int nLookup,
+Spectrum EPhoton(PhotonIndex<Photon> *map, int count, int nLookup,
         ClosePhoton *lookupBuf, float maxDist2, const Point &p,
         const Normal &n) {
     if (!map) return 0.f;
@@ -462,7 +456,8 @@ Spectrum EPhoton(KdTree<Photon> *map, int count, int nLookup,
 // PhotonIntegrator Method Definitions
 PhotonIntegrator::PhotonIntegrator(int ncaus, int nind,
         int nl, int mdepth, int mphodepth, float mdist, bool fg,
-        int gs, float ga) {
+        int gs, float ga, bool grid, const PhotonJob &pj)
+    : job(pj) {
     nCausticPhotonsWanted = ncaus;
     nIndirectPhotonsWanted = nind;
     nLookup = nl;
@@ -472,6 +467,7 @@ PhotonIntegrator::PhotonIntegrator(int ncaus, int nind,
     finalGather = fg;
     cosGatherAngle = cos(Radians(ga));
     gatherSamples = gs;
+    gridLookup = grid;
     nCausticPaths = nIndirectPaths = 0;
     causticMap = indirectMap = NULL;
     radianceMap = NULL;
@@ -547,14 +543,15 @@ void PhotonIntegrator::Preprocess(const Scene *scene,
     Mutex::Destroy(mutex);
     progress.Done();
 
-    // Build kd-trees for indirect and caustic photons
-    KdTree<Photon> *directMap = NULL;
+    // Build lookup structures for indirect and caustic photons
+    float cellSize = sqrtf(maxDistSquared);
+    PhotonIndex<Photon> *directMap = NULL;
     if (directPhotons.size() > 0)
-        directMap = new KdTree<Photon>(directPhotons);
+        directMap = new PhotonIndex<Photon>(directPhotons, gridLookup, cellSize);
     if (causticPhotons.size() > 0)
-        causticMap = new KdTree<Photon>(causticPhotons);
+        causticMap = new PhotonIndex<Photon>(causticPhotons, gridLookup, cellSize);
     if (indirectPhotons.size() > 0)
-        indirectMap = new KdTree<Photon>(indirectPhotons);
+        indirectMap = new PhotonIndex<Photon>(indirectPhotons, gridLookup, cellSize);
 
     // Precompute radiance at a subset of the photons
     if (finalGather && radiancePhotons.size()) {
@@ -573,7 +570,8 @@ void PhotonIntegrator::Preprocess(const Scene *scene,
         for (uint32_t i = 0; i < radianceTasks.size(); ++i)
             delete radianceTasks[i];
         progRadiance.Done();
-        radianceMap = new KdTree<RadiancePhoton>(radiancePhotons);
+        radianceMap = new PhotonIndex<RadiancePhoton>(radiancePhotons,
+                                                      gridLookup, 0.f);
     }
     delete directMap;
 }
@@ -592,14 +590,14 @@ void PhotonShootingTask::Run() {
     vector<Spectrum> localRpReflectances, localRpTransmittances;
 
 if (PhotonImage){
-
+const PhotonJob &job = integrator->job;
 
 	//[DGtal declaration des fichiers de sortie
-string fichier(fileName+"_stat.txt");
+string fichier(job.fileName+"_stat.txt");
 std::ofstream fichierStat(fichier.c_str());
-fichier=fileName+"_absorb.txt";
+fichier=job.fileName+"_absorb.txt";
 std::ofstream fichierAbsorb(fichier.c_str());
-fichier=fileName+"_brdf.txt";
+fichier=job.fileName+"_brdf.txt";
 std::ofstream fichierBRDF(fichier.c_str());
 
 //DGtal declaration de variables pour le lanceur de photons
@@ -609,8 +607,10 @@ std::map<float,int> stockePhoton;
 map<angles, int> energieBRDF;   
 int compteurPhotonPerdu(0), compteurAlbedo(0);
 int depasseDepth(0);
-double facteur(dimensionImageZ/256.0);
-double maxX(dimensionImageX*256/dimensionImageZ), maxY(dimensionImageY*256/dimensionImageZ);
+//[DGtal nombre total d'intersections, pour le banc d'essai snowBenchmark]
+long long compteurIntersections(0);
+double facteur(job.dimz/256.0);
+double maxX(job.dimx*256/job.dimz), maxY(job.dimy*256/job.dimz);
 
     while (true) {
         // Follow photon paths for a block of samples
@@ -660,7 +660,7 @@ double maxX(dimensionImageX*256/dimensionImageZ), maxY(dimensionImageY*256/dimen
 		bool dansMatiere(false);
 		bool arret_boucle(false);
 		bool duplicate(false);
-		float ni(M_Ni),nt(M_Nt);
+		float ni(M_Ni),nt(job.nt);
 		bool depositedPhoton =false;
          	float arretPhoton(rng.RandomFloat());
 
@@ -694,7 +694,7 @@ double maxX(dimensionImageX*256/dimensionImageZ), maxY(dimensionImageY*256/dimen
 			
 			//[DGtal on absorbe un peu du spectre si on est dans la matière]
 			if (dansMatiere){		
-				spectre*=expf(- Distance(photonRay.o,photonIsect.dg.p) * M_ABSORB);
+				spectre*=expf(- Distance(photonRay.o,photonIsect.dg.p) * job.absorb);
 			}
 
 			Vector wo=photonRay.d;
@@ -830,14 +830,14 @@ double maxX(dimensionImageX*256/dimensionImageZ), maxY(dimensionImageY*256/dimen
 			if (Dot(wi,normal)<=0) 
 			{  
 				dansMatiere=true;
-				ni=M_Nt;
+				ni=job.nt;
 				nt=M_Ni;			
 			}
 			else 
 			{
 				dansMatiere=false;			
 				ni=M_Ni;
-				nt=M_Nt;			
+				nt=job.nt;			
 			}
 
 
@@ -869,6 +869,8 @@ double maxX(dimensionImageX*256/dimensionImageZ), maxY(dimensionImageY*256/dimen
 	}
                 
 		}
+                compteurIntersections += nIntersections;
+                PBRT_PHOTON_MAP_PATH_BOUNCES(nIntersections);
                 PBRT_PHOTON_MAP_FINISHED_RAY_PATH(&photonRay, &alpha);
 	
 
@@ -942,19 +944,20 @@ double maxX(dimensionImageX*256/dimensionImageZ), maxY(dimensionImageY*256/dimen
 
 
 //[DGtal on ecrit les resultats dans les 3 fichiers de resultat]
+PBRT_STARTED_WRITING_RESULTS();
 		
 
 int nombrePhotonTotal=compteurPhotonAbsorbe+ depasseDepth + compteurAlbedo;
 
 //[DGtal le fichier de Stat]
-fichierStat  << "Statistics: \nlaunched photons : "<< nombrePhotonTotal+compteurPhotonPerdu <<"\nabsorbed photons : " << compteurPhotonAbsorbe <<"\nphoton out of depth : " << depasseDepth << "\nalbedo photons : " << compteurAlbedo << "   albedo : "<<(float)compteurAlbedo/nombrePhotonTotal << "\nlost photons : " << compteurPhotonPerdu;
+fichierStat  << "Statistics: \nlaunched photons : "<< nombrePhotonTotal+compteurPhotonPerdu <<"\nabsorbed photons : " << compteurPhotonAbsorbe <<"\nphoton out of depth : " << depasseDepth << "\nalbedo photons : " << compteurAlbedo << "   albedo : "<<(float)compteurAlbedo/nombrePhotonTotal << "\nlost photons : " << compteurPhotonPerdu << "\nintersections per photon : " << (double)compteurIntersections/(nombrePhotonTotal+compteurPhotonPerdu);
 
 //[DGtal le fichier d'absorbance]
 fichierAbsorb << "#profondeur(m) || %% d'absorption \n#pour le tracer sous gnuplot :\n#set xrange[0:0.25]\n#set yrange [0:1]\n# plot \"fichier.txt\" using 1:2:(1.0) smooth cumulative\n1.0 0\n# la premiere ligne : \"1.0 0\" sert juste a aller jusqu'a 1 metre de profond pour tracer sous gnuplot\n#le reste sont les valeurs" ; 
 for(map<float, int >::iterator it=stockePhoton.begin(); it!=stockePhoton.end(); ++it)
     {	
 	if (it->first!=0)
-        	fichierAbsorb << -it->first*resolutionPixel*dimensionImageZ/256000000 << " " << (double)it->second/nombrePhotonTotal << std::endl;
+        	fichierAbsorb << -it->first*job.resolPixel*job.dimz/256000000 << " " << (double)it->second/nombrePhotonTotal << std::endl;
 	else 
 		fichierAbsorb << "0 " << (double)it->second/nombrePhotonTotal << std::endl;
 	
@@ -969,6 +972,7 @@ for(map<angles, int >::iterator it=energieBRDF.begin(); it!=energieBRDF.end(); +
     }
 
 printf("\nstatistics :\nlaunched %d photons\nabsorbed photons : %d\nalbedo photons : %d   albedo : %f\nlost photons %d\n",nombrePhotonTotal+compteurPhotonPerdu,compteurPhotonAbsorbe,compteurAlbedo, (float)compteurAlbedo/nombrePhotonTotal,compteurPhotonPerdu); 
+PBRT_FINISHED_WRITING_RESULTS();
 
 
 }
@@ -1072,6 +1076,7 @@ else {
                     photonRay = RayDifferential(photonIsect.dg.p, wi, photonRay,
                                                 photonIsect.rayEpsilon);
                 }
+                PBRT_PHOTON_MAP_PATH_BOUNCES(nIntersections);
                 PBRT_PHOTON_MAP_FINISHED_RAY_PATH(&photonRay, &alpha);
             }
             arena.FreeAll();
@@ -1360,8 +1365,10 @@ Spectrum PhotonIntegrator::Li(const Scene *scene, const Renderer *renderer,
 }
 
 
-PhotonIntegrator *CreatePhotonMapSurfaceIntegrator(const ParamSet &params) {
+PhotonIntegrator *CreatePhotonMapSurfaceIntegrator(const ParamSet &params,
+        const PhotonJob &job) {
     int nCaustic = params.FindOneInt("causticphotons", 20000);
+    if (job.nPhotons > 0) nCaustic = job.nPhotons;
     int nIndirect = params.FindOneInt("indirectphotons", 100000);
     int nUsed = params.FindOneInt("nused", 50);
     if (PbrtOptions.quickRender) nCaustic = nCaustic / 10;
@@ -1374,9 +1381,15 @@ PhotonIntegrator *CreatePhotonMapSurfaceIntegrator(const ParamSet &params) {
     if (PbrtOptions.quickRender) gatherSamples = max(1, gatherSamples / 4);
     float maxDist = params.FindOneFloat("maxdist", .1f);
     float gatherAngle = params.FindOneFloat("gatherangle", 10.f);
+    string lookup = params.FindOneString("photonlookup", "kdtree");
+    if (lookup != "kdtree" && lookup != "grid") {
+        Warning("Photon lookup \"%s\" unknown. Using \"kdtree\".",
+                lookup.c_str());
+        lookup = "kdtree";
+    }
     return new PhotonIntegrator(nCaustic, nIndirect,
         nUsed, maxSpecularDepth, maxPhotonDepth, maxDist, finalGather, gatherSamples,
-        gatherAngle);
+        gatherAngle, lookup == "grid", job);
 }
 
 
@@ -32,6 +32,7 @@
 #include "pbrt.h"
 #include "integrator.h"
 #include "kdtree.h"
+#include "hashgrid.h"
 
 
 
@@ -42,13 +43,37 @@ struct PhotonProcess;
 struct RadiancePhotonProcess;
 
 
+// Photon maps are looked up either through a kd-tree or a hashed grid,
+// chosen with the "photonlookup" parameter
+template <typename NodeData> class PhotonIndex {
+public:
+    PhotonIndex(const vector<NodeData> &data, bool useGrid, float cellSize)
+        : tree(NULL), grid(NULL) {
+        if (useGrid) grid = new HashGrid<NodeData>(data, cellSize);
+        else         tree = new KdTree<NodeData>(data);
+    }
+    ~PhotonIndex() {
+        delete tree;
+        delete grid;
+    }
+    template <typename LookupProc> void Lookup(const Point &p,
+            LookupProc &process, float &maxDistSquared) const {
+        if (grid) grid->Lookup(p, process, maxDistSquared);
+        else      tree->Lookup(p, process, maxDistSquared);
+    }
+private:
+    KdTree<NodeData> *tree;
+    HashGrid<NodeData> *grid;
+};
+
+
 // PhotonIntegrator Declarations
 class PhotonIntegrator : public SurfaceIntegrator {
 public:
     // PhotonIntegrator Public Methods
     PhotonIntegrator(int ncaus, int nindir, int nLookup, int maxspecdepth,
         int maxphotondepth, float maxdist, bool finalGather, int gatherSamples,
-        float ga);
+        float ga, bool gridLookup, const PhotonJob &job);
     ~PhotonIntegrator();
     Spectrum Li(const Scene *scene, const Renderer *renderer,
         const RayDifferential &ray, const Intersection &isect, const Sample *sample,
@@ -66,18 +91,21 @@ private:
     bool finalGather;
     int gatherSamples;
     float cosGatherAngle;
+    bool gridLookup;
+    PhotonJob job;
 
     // Declare sample parameters for light source sampling
     LightSampleOffsets *lightSampleOffsets;
     BSDFSampleOffsets *bsdfSampleOffsets;
     BSDFSampleOffsets bsdfGatherSampleOffsets, indirGatherSampleOffsets;
     int nCausticPaths, nIndirectPaths;
-    KdTree<Photon> *causticMap;
-    KdTree<Photon> *indirectMap;
-    KdTree<RadiancePhoton> *radianceMap;
+    PhotonIndex<Photon> *causticMap;
+    PhotonIndex<Photon> *indirectMap;
+    PhotonIndex<RadiancePhoton> *radianceMap;
 };
 
 
-PhotonIntegrator *CreatePhotonMapSurfaceIntegrator(const ParamSet &params);
+PhotonIntegrator *CreatePhotonMapSurfaceIntegrator(const ParamSet &params,
+        const PhotonJob &job);
 
 #endif // PBRT_INTEGRATORS_PHOTONMAP_H
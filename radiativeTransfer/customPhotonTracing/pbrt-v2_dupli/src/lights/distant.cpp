@@ -29,19 +29,25 @@
 #include "montecarlo.h"
 
 
-//[DGtal : ajout pour avoir la lumière sur l'échantillon]
-extern int dimensionImageX;
-extern int dimensionImageY;
-extern int dimensionImageZ;
-
 extern bool PhotonImage;
 
 // DistantLight Method Definitions
 DistantLight::DistantLight(const Transform &light2world,
-        const Spectrum &radiance, const Vector &dir)
+        const Spectrum &radiance, const Vector &dir, const PhotonJob &job)
     : Light(light2world) {
-    lightDir = Normalize(LightToWorld(dir));
+    sceneLightDir = Normalize(LightToWorld(dir));
     L = radiance;
+    SetPhotonJob(job);
+}
+
+
+//[DGtal : ajout pour avoir la lumière sur l'échantillon, la direction peut
+// etre changee par un travail du mode --batch]
+void DistantLight::SetPhotonJob(const PhotonJob &job) {
+    Vector dir(job.lightDir[0], job.lightDir[1], job.lightDir[2]);
+    lightDir = dir.LengthSquared() > 0.f ? Normalize(dir) : sceneLightDir;
+    photonX = job.dimx*256/job.dimz;
+    photonY = job.dimy*256/job.dimz;
 }
 
 
@@ -64,13 +70,13 @@ Spectrum DistantLight::Power(const Scene *scene) const {
 
 
 DistantLight *CreateDistantLight(const Transform &light2world,
-        const ParamSet &paramSet) {
+        const ParamSet &paramSet, const PhotonJob &job) {
     Spectrum L = paramSet.FindOneSpectrum("L", Spectrum(1.0));
     Spectrum sc = paramSet.FindOneSpectrum("scale", Spectrum(1.0));
     Point from = paramSet.FindOnePoint("from", Point(0,0,0));
     Point to = paramSet.FindOnePoint("to", Point(0,0,1));
     Vector dir = from-to;
-    return new DistantLight(light2world, L * sc, dir);
+    return new DistantLight(light2world, L * sc, dir, job);
 }
 
 
@@ -91,7 +97,7 @@ Point Pdisk (0,0,256);
 
 //AJOUT POUR QUE LA LUMIERE ARRIVE SUR LA FACE DU DESSUS DU CUBE
 if (PhotonImage){
-	Vector	v1(dimensionImageX*256/dimensionImageZ,0,0), v2(0,dimensionImageY*256/dimensionImageZ,0); 	
+	Vector	v1(photonX,0,0), v2(0,photonY,0); 	
 	Vector v3(ls.uPos[0]*v1 + ls.uPos[1]*v2);
 	Pdisk+=v3;	
 }
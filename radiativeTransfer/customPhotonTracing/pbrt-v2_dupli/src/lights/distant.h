@@ -38,7 +38,9 @@
 class DistantLight : public Light {
 public:
     // DistantLight Public Methods
-    DistantLight(const Transform &light2world, const Spectrum &radiance, const Vector &dir);
+    DistantLight(const Transform &light2world, const Spectrum &radiance,
+                 const Vector &dir, const PhotonJob &job);
+    void SetPhotonJob(const PhotonJob &job);
     bool IsDeltaLight() const { return true; }
     Spectrum Sample_L(const Point &p, float pEpsilon, const LightSample &ls,
         float time, Vector *wi, float *pdf, VisibilityTester *) const;
@@ -48,12 +50,14 @@ public:
     float Pdf(const Point &, const Vector &) const;
 private:
     // DistantLight Private Data
-    Vector lightDir;
+    Vector lightDir, sceneLightDir;
     Spectrum L;
+    //[DGtal face du dessus de l'echantillon, eclairee en mode photon]
+    float photonX, photonY;
 };
 
 
 DistantLight *CreateDistantLight(const Transform &light2world,
-        const ParamSet &paramSet);
+        const ParamSet &paramSet, const PhotonJob &job);
 
 #endif // PBRT_LIGHTS_DISTANT_H
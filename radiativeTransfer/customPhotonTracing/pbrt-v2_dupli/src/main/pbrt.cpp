@@ -53,7 +53,7 @@ int main(int argc, char *argv[]) {
         else if (!strcmp(argv[i], "--verbose")) options.verbose = true;
         else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
             printf("usage: pbrt  [--image || -i ] file.pbrt \n"
-                   "pbrt [--photon || -p] [--wavelength wavelength(nm) || -w wavelength(nm)] [-x dimImageY] [-y dimImageY] [-z dimImageZ] [--resPixel PixelResolution(micrometer) || -r PixelResolution(micrometer)] [ <filenamePhoton.pbrt> ...\n");
+                   "pbrt [--photon || -p] [--wavelength wavelength(nm) || -w wavelength(nm)] [-x dimImageY] [-y dimImageY] [-z dimImageZ] [--resPixel PixelResolution(micrometer) || -r PixelResolution(micrometer)] [--batch jobs.txt || -b jobs.txt] [ <filenamePhoton.pbrt> ...\n");
            return 0;
         }
 	//[DGtal ajout option pour faire de l'absorption]
@@ -64,6 +64,8 @@ int main(int argc, char *argv[]) {
 	else if ((!strcmp(argv[i],"--resPixel")) || (!strcmp(argv[i],"-r"))) { options.resolPixel=atof(argv[++i]); resPix=true; }
 	else if ((!strcmp(argv[i],"--photon")) || (!strcmp(argv[i],"-p"))){ImagePhoton=true; options.photon=true;options.nCores=1;}	
 	else if ((!strcmp(argv[i],"--image")) || (!strcmp(argv[i],"-i"))) { ImagePhoton=true; options.photon=false;}
+	//[DGtal mode batch : une scene, plusieurs lancers de photons]
+	else if ((!strcmp(argv[i],"--batch")) || (!strcmp(argv[i],"-b"))) options.batchFile=argv[++i];
 
         else {
 		filenames.push_back(argv[i]);
@@ -73,11 +75,11 @@ int main(int argc, char *argv[]) {
 
 	//[DGtal : test arguments]
 	if (!ImagePhoton) {printf("usage: pbrt  [--image || -i ] file.pbrt \n"
-                   "pbrt [--photon || -p] [--wavelength wavelength(nm) || -w wavelength(nm)] [-x dimImageY] [-y dimImageY] [-z dimImageZ] [--resPixel PixelResolution(micrometer) || -r PixelResolution(micrometer)] [ <filenamePhoton.pbrt> ...\n"); exit(1);}
-	else if (options.photon && ((!wavelength) || (!dimensionX) || (!dimensionY) || (!dimensionZ) || (!resPix)))
+                   "pbrt [--photon || -p] [--wavelength wavelength(nm) || -w wavelength(nm)] [-x dimImageY] [-y dimImageY] [-z dimImageZ] [--resPixel PixelResolution(micrometer) || -r PixelResolution(micrometer)] [--batch jobs.txt || -b jobs.txt] [ <filenamePhoton.pbrt> ...\n"); exit(1);}
+	else if (options.photon && (((!wavelength) && options.batchFile.empty()) || (!dimensionX) || (!dimensionY) || (!dimensionZ) || (!resPix) || (options.batchFile=="-" && filenames.size()==0)))
 	{
             printf("usage: pbrt  [--image || -i ] file.pbrt \n"
-                   "pbrt [--photon || -p] [--wavelength wavelength(nm) || -w wavelength(nm)] [-x dimImageY] [-y dimImageY] [-z dimImageZ] [--resPixel PixelResolution(micrometer) || -r PixelResolution(micrometer)] [ <filenamePhoton.pbrt> ...\n");
+                   "pbrt [--photon || -p] [--wavelength wavelength(nm) || -w wavelength(nm)] [-x dimImageY] [-y dimImageY] [-z dimImageZ] [--resPixel PixelResolution(micrometer) || -r PixelResolution(micrometer)] [--batch jobs.txt || -b jobs.txt] [ <filenamePhoton.pbrt> ...\n");
 	exit(1);
 	}
 
@@ -0,0 +1,212 @@
+
+/*
+    pbrt source code Copyright(c) 1998-2010 Matt Pharr and Greg Humphreys.
+
+    This file is part of pbrt.
+
+    pbrt is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.  Note that the text contents of
+    the book "Physically Based Rendering" are *not* licensed under the
+    GNU GPL.
+
+    pbrt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+// renderers/accelbench.cpp*
+#include "stdafx.h"
+#include "renderers/accelbench.h"
+#include "scene.h"
+#include "camera.h"
+#include "film.h"
+#include "sampler.h"
+#include "paramset.h"
+#include "montecarlo.h"
+#include "primitive.h"
+#include "intersection.h"
+#include "timer.h"
+#include "probes.h"
+#include "accelerators/trianglesoup.h"
+
+extern Primitive *MakeAccelerator(const string &name,
+        const vector<Reference<Primitive> > &prims, const ParamSet &paramSet);
+
+// AcceleratorBenchmark Local Declarations
+static const char *raySetNames[ACCELBENCH_RAY_SETS] = {
+    "uniform", "cosine", "camera"
+};
+
+// AcceleratorBenchmark Method Definitions
+AcceleratorBenchmark::AcceleratorBenchmark(const vector<string> &accels,
+        int nrays, Camera *c, const vector<Reference<Primitive> > &p,
+        const vector<AccelBenchMesh> &m)
+    : accelerators(accels), nRays(nrays), camera(c), primitives(p), meshes(m) {
+}
+
+
+AcceleratorBenchmark::~AcceleratorBenchmark() {
+    delete camera;
+}
+
+
+AcceleratorBenchmark *CreateAcceleratorBenchmarkRenderer(const ParamSet &params,
+        Camera *camera, const vector<Reference<Primitive> > &primitives,
+        const vector<AccelBenchMesh> &meshes) {
+    int nrays = params.FindOneInt("nrays", 1000000);
+    int na;
+    const string *names = params.FindString("accelerators", &na);
+    vector<string> accelerators;
+    if (names)
+        accelerators.assign(names, names + na);
+    else {
+        accelerators.push_back("bvh");
+        accelerators.push_back("grid");
+        accelerators.push_back("kdtree");
+        accelerators.push_back("trianglesoup");
+    }
+    return new AcceleratorBenchmark(accelerators, max(nrays, 1), camera,
+                                    primitives, meshes);
+}
+
+
+void AcceleratorBenchmark::GenerateRays(const BBox &bounds) {
+    RNG rng;
+    for (int s = 0; s < ACCELBENCH_RAY_SETS; ++s)
+        rays[s].reserve(nRays);
+
+    // Generate incoherent photon-like rays inside _bounds_
+    for (int i = 0; i < nRays; ++i) {
+        Point org(Lerp(rng.RandomFloat(), bounds.pMin.x, bounds.pMax.x),
+                  Lerp(rng.RandomFloat(), bounds.pMin.y, bounds.pMax.y),
+                  Lerp(rng.RandomFloat(), bounds.pMin.z, bounds.pMax.z));
+        Vector dir = UniformSampleSphere(rng.RandomFloat(), rng.RandomFloat());
+        rays[ACCELBENCH_UNIFORM].push_back(Ray(org, dir, 0.f));
+        Vector w = CosineSampleHemisphere(rng.RandomFloat(), rng.RandomFloat());
+        rays[ACCELBENCH_COSINE].push_back(Ray(org, Vector(w.x, w.y, -w.z), 0.f));
+    }
+
+    // Generate coherent camera rays in scanline order over the whole film
+    const Film *film = camera->film;
+    uint64_t nPixels = uint64_t(film->xResolution) * film->yResolution;
+    CameraSample cs;
+    cs.lensU = cs.lensV = 0.5f;
+    cs.time = camera->shutterOpen;
+    for (int i = 0; i < nRays; ++i) {
+        uint64_t pixel = uint64_t(i) * nPixels / nRays;
+        cs.imageX = pixel % film->xResolution + rng.RandomFloat();
+        cs.imageY = pixel / film->xResolution + rng.RandomFloat();
+        Ray ray;
+        camera->GenerateRay(cs, &ray);
+        rays[ACCELBENCH_CAMERA].push_back(ray);
+    }
+}
+
+
+Reference<Primitive> AcceleratorBenchmark::MakeCandidate(const string &name) const {
+    if (name != "trianglesoup")
+        return MakeAccelerator(name, primitives, ParamSet());
+    // One _TriangleSoupPrimitive_ per mesh under a BVH, as in a scene
+    // rendered with the default "bool trianglesoup"
+    if (meshes.size() == 0) {
+        Warning("No \"trianglemesh\" for the \"trianglesoup\" candidate");
+        return NULL;
+    }
+    vector<Reference<Primitive> > soups(primitives);
+    for (uint32_t i = 0; i < meshes.size(); ++i)
+        soups[meshes[i].primitive] = new TriangleSoupPrimitive(
+            (TriangleMesh *)meshes[i].mesh.GetPtr(), meshes[i].material);
+    if (soups.size() == 1) return soups[0];
+    return MakeAccelerator("bvh", soups, ParamSet());
+}
+
+
+void AcceleratorBenchmark::Benchmark(const string &name) const {
+    // Build accelerator and report construction time
+    Timer buildTimer;
+    buildTimer.Start();
+    Reference<Primitive> accel = MakeCandidate(name);
+    buildTimer.Stop();
+    if (!accel) return;
+    printf("%s: built in %.3f s\n", name.c_str(), buildTimer.Time());
+
+    for (int s = 0; s < ACCELBENCH_RAY_SETS; ++s) {
+        const vector<Ray> &set = rays[s];
+#ifdef PBRT_PROBES_THREAD
+        ThreadProbes before = *CurrentThreadProbes();
+#endif
+        // Time _Intersect()_ for the rays of _set_
+        Timer timer;
+        uint32_t nHits = 0;
+        Intersection isect;
+        timer.Start();
+        for (uint32_t i = 0; i < set.size(); ++i) {
+            Ray ray = set[i];
+            if (accel->Intersect(ray, &isect)) ++nHits;
+        }
+        timer.Stop();
+        double intersectTime = timer.Time();
+#ifdef PBRT_PROBES_THREAD
+        const ThreadProbes &after = *CurrentThreadProbes();
+        float nodesPerRay = float(after.nodes - before.nodes) / set.size();
+        float trisPerRay = float(after.triangleTests - before.triangleTests) /
+                           set.size();
+#endif
+
+        // Time _IntersectP()_ for the rays of _set_
+        Timer timerP;
+        uint32_t nHitsP = 0;
+        timerP.Start();
+        for (uint32_t i = 0; i < set.size(); ++i)
+            if (accel->IntersectP(set[i])) ++nHitsP;
+        timerP.Stop();
+        double intersectPTime = timerP.Time();
+
+        printf("    %-8s Intersect %8.3f Mrays/s  IntersectP %8.3f Mrays/s  "
+               "hits %u/%u", raySetNames[s],
+               1e-6 * set.size() / max(intersectTime, 1e-9),
+               1e-6 * set.size() / max(intersectPTime, 1e-9), nHits, nHitsP);
+#ifdef PBRT_PROBES_THREAD
+        printf("  nodes/ray %.2f  triangles/ray %.2f", nodesPerRay, trisPerRay);
+#endif
+        printf("\n");
+        fflush(stdout);
+    }
+}
+
+
+void AcceleratorBenchmark::Render(const Scene *scene) {
+    GenerateRays(scene->WorldBound());
+    printf("Accelerator benchmark: %d scene primitives (%d triangle meshes), "
+           "%d rays per set\n", (int)primitives.size(), (int)meshes.size(),
+           nRays);
+#ifndef PBRT_PROBES_THREAD
+    printf("(build with PBRT_PROBES_THREAD for nodes and triangles per ray)\n");
+#endif
+    for (uint32_t i = 0; i < accelerators.size(); ++i)
+        Benchmark(accelerators[i]);
+}
+
+
+Spectrum AcceleratorBenchmark::Li(const Scene *scene,
+        const RayDifferential &ray, const Sample *sample, RNG &rng,
+        MemoryArena &arena, Intersection *isect, Spectrum *T) const {
+    return 0.f;
+}
+
+
+Spectrum AcceleratorBenchmark::Transmittance(const Scene *scene,
+        const RayDifferential &ray, const Sample *sample, RNG &rng,
+        MemoryArena &arena) const {
+    return 0.f;
+}
+
+
@@ -0,0 +1,99 @@
+
+/*
+    pbrt source code Copyright(c) 1998-2010 Matt Pharr and Greg Humphreys.
+
+    This file is part of pbrt.
+
+    pbrt is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.  Note that the text contents of
+    the book "Physically Based Rendering" are *not* licensed under the
+    GNU GPL.
+
+    pbrt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef PBRT_RENDERERS_ACCELBENCH_H
+#define PBRT_RENDERERS_ACCELBENCH_H
+
+// renderers/accelbench.h*
+#include "pbrt.h"
+#include "renderer.h"
+#include "geometry.h"
+#include "memory.h"
+#include "shape.h"
+#include "material.h"
+
+//[DGtal banc d'essai des accelerateurs : chaque accelerateur de la liste
+// "string accelerators" est construit sur les primitives de la scene puis
+// chronometre sur trois jeux de rayons identiques pour tous. Avec ce rendu,
+// les "trianglemesh" restent des _GeometricPrimitive_ raffinees en triangles
+// par les accelerateurs ; le candidat "trianglesoup" refait une
+// _TriangleSoupPrimitive_ par maillage, sous un "bvh", comme une scene
+// ordinaire. Les jeux de rayons :
+//   uniform : origines uniformes dans la boite de l'echantillon, directions
+//             uniformes sur la sphere (rayons de photons incoherents)
+//   cosine  : memes origines, directions cosinus autour de -z (photons
+//             entrant par le haut de l'echantillon)
+//   camera  : rayons coherents de la camera, ligne par ligne sur toute
+//             l'image]
+enum AccelBenchRaySet { ACCELBENCH_UNIFORM, ACCELBENCH_COSINE,
+                        ACCELBENCH_CAMERA, ACCELBENCH_RAY_SETS };
+
+// un maillage que pbrt aurait mis dans une _TriangleSoupPrimitive_ : la
+// primitive _primitive_ de la scene, son maillage et son materiau
+struct AccelBenchMesh {
+    uint32_t primitive;
+    Reference<Shape> mesh;
+    Reference<Material> material;
+};
+
+
+// AcceleratorBenchmark Declarations
+class AcceleratorBenchmark : public Renderer {
+public:
+    // AcceleratorBenchmark Public Methods
+    AcceleratorBenchmark(const vector<string> &accelerators, int nRays,
+                         Camera *camera,
+                         const vector<Reference<Primitive> > &primitives,
+                         const vector<AccelBenchMesh> &meshes);
+    ~AcceleratorBenchmark();
+    void Render(const Scene *scene);
+    Spectrum Li(const Scene *scene, const RayDifferential &ray,
+        const Sample *sample, RNG &rng, MemoryArena &arena, Intersection *isect = NULL,
+        Spectrum *T = NULL) const;
+    Spectrum Transmittance(const Scene *scene, const RayDifferential &ray,
+            const Sample *sample, RNG &rng, MemoryArena &arena) const;
+private:
+    // AcceleratorBenchmark Private Methods
+    void GenerateRays(const BBox &bounds);
+    Reference<Primitive> MakeCandidate(const string &name) const;
+    void Benchmark(const string &name) const;
+
+    // AcceleratorBenchmark Private Data
+    vector<string> accelerators;
+    int nRays;
+    Camera *camera;
+    vector<Reference<Primitive> > primitives;
+    vector<AccelBenchMesh> meshes;
+    vector<Ray> rays[ACCELBENCH_RAY_SETS];
+};
+
+
+AcceleratorBenchmark *CreateAcceleratorBenchmarkRenderer(const ParamSet &params,
+    Camera *camera, const vector<Reference<Primitive> > &primitives,
+    const vector<AccelBenchMesh> &meshes);
+
+#endif // PBRT_RENDERERS_ACCELBENCH_H
@@ -469,7 +469,7 @@ Spectrum MetropolisRenderer::Lbidir(const Scene *scene,
 
 MetropolisRenderer::MetropolisRenderer(int perPixelSamples,
         int nboot, int dps, float lsp, bool dds, int mr, int md,
-        Camera *c, bool db) {
+        Camera *c, bool db, float tb, float fi, int mp) {
     camera = c;
 
     nPixelSamples = perPixelSamples;
@@ -489,7 +489,11 @@ MetropolisRenderer::MetropolisRenderer(int perPixelSamples,
 
     maxDepth = md;
     maxConsecutiveRejects = mr;
-    nTasksFinished  = 0;
+    nSampleChunks = 0;
+    timeBudget = tb;
+    flushInterval = fi;
+    maxPasses = mp;
+    budget = NULL;
     directLighting = dds ? new DirectLightingIntegrator(SAMPLE_ALL_UNIFORM, maxDepth) : NULL;
     bidirectional = db;
 }
@@ -511,6 +515,10 @@ MetropolisRenderer *CreateMetropolisRenderer(const ParamSet &params,
     int mr = params.FindOneInt("maxconsecutiverejects", 512);
     int md = params.FindOneInt("maxdepth", 7);
     bool doBidirectional = params.FindOneBool("bidirectional", true);
+    float timeBudget = params.FindOneFloat("timebudget", 0.f);
+    float flushInterval = params.FindOneFloat("flushinterval",
+                                              timeBudget > 0.f ? 60.f : 0.f);
+    int maxPasses = params.FindOneInt("maxpasses", timeBudget > 0.f ? 0 : 1);
 
     if (PbrtOptions.quickRender) {
         perPixelSamples = max(1, perPixelSamples / 4);
@@ -520,12 +528,17 @@ MetropolisRenderer *CreateMetropolisRenderer(const ParamSet &params,
 
     return new MetropolisRenderer(perPixelSamples, nBootstrap,
         nDirectPixelSamples, largeStepProbability, doDirectSeparately,
-        mr, md, camera, doBidirectional);
+        mr, md, camera, doBidirectional, timeBudget, flushInterval, maxPasses);
 }
 
 
 void MetropolisRenderer::Render(const Scene *scene) {
     PBRT_MLT_STARTED_RENDERING();
+    if (camera->film->WantsFeatures())
+        Warning("Metropolis does not record per-pixel features: \"denoise\" and "
+                "\"writefeatures\" only see the direct lighting samples, if any");
+    RenderBudget renderBudget(timeBudget, flushInterval);
+    budget = &renderBudget;
     if (scene->lights.size() > 0) {
         int x0, x1, y0, y1;
         camera->film->GetPixelExtent(&x0, &x1, &y0, &y1);
@@ -554,7 +567,9 @@ void MetropolisRenderer::Render(const Scene *scene) {
                 delete sample;
                 directProgress.Done();
             }
+            PBRT_STARTED_WRITING_RESULTS();
             camera->film->WriteImage();
+            PBRT_FINISHED_WRITING_RESULTS();
             PBRT_MLT_FINISHED_DIRECTLIGHTING();
         }
         // Take initial set of samples to compute $b$
@@ -600,32 +615,44 @@ void MetropolisRenderer::Render(const Scene *scene) {
                 break;
         }
 
-        // Launch tasks to generate Metropolis samples
+        // Launch tasks to generate Metropolis samples, one pass over the
+        // image at a time until the budget is spent
         uint32_t nTasks = largeStepsPerPixel;
         uint32_t largeStepRate = nPixelSamples / largeStepsPerPixel;
         Info("MLT running %d tasks, large step rate %d", nTasks, largeStepRate);
-        ProgressReporter progress(nTasks * largeStepRate, "Metropolis");
-        vector<Task *> tasks;
+        bool progressive = timeBudget > 0.f || maxPasses != 1;
         Mutex *filmMutex = Mutex::Create();
         Assert(IsPowerOf2(nTasks));
         uint32_t scramble[2] = { rng.RandomUInt(), rng.RandomUInt() };
         uint32_t pfreq = (x1-x0) * (y1-y0);
-        for (uint32_t i = 0; i < nTasks; ++i) {
-            float d[2];
-            Sample02(i, scramble, d);
-            tasks.push_back(new MLTTask(progress, pfreq, i,
-                d[0], d[1], x0, x1, y0, y1, t0, t1, b, initialSample,
-                scene, camera, this, filmMutex, lightDistribution));
+        for (uint32_t pass = 0; ; ++pass) {
+            char title[64];
+            if (progressive) sprintf(title, "Metropolis (pass %d)", pass + 1);
+            else             sprintf(title, "Metropolis");
+            ProgressReporter progress(nTasks * largeStepRate, title);
+            vector<Task *> tasks;
+            for (uint32_t i = 0; i < nTasks; ++i) {
+                float d[2];
+                Sample02(pass * nTasks + i, scramble, d);
+                tasks.push_back(new MLTTask(progress, pfreq, pass * nTasks + i,
+                    d[0], d[1], x0, x1, y0, y1, t0, t1, b, initialSample,
+                    scene, camera, this, filmMutex, lightDistribution));
+            }
+            EnqueueTasks(tasks);
+            WaitForAllTasks();
+            for (uint32_t i = 0; i < tasks.size(); ++i)
+                delete tasks[i];
+            progress.Done();
+            if (!progressive || renderBudget.Expired()) break;
+            if (maxPasses > 0 && int(pass) + 1 >= maxPasses) break;
         }
-        EnqueueTasks(tasks);
-        WaitForAllTasks();
-        for (uint32_t i = 0; i < tasks.size(); ++i)
-            delete tasks[i];
-        progress.Done();
         Mutex::Destroy(filmMutex);
         delete lightDistribution;
     }
-    camera->film->WriteImage();
+    PBRT_STARTED_WRITING_RESULTS();
+    camera->film->WriteImage(SplatScale());
+    PBRT_FINISHED_WRITING_RESULTS();
+    budget = NULL;
     PBRT_MLT_FINISHED_RENDERING();
 }
 
@@ -756,18 +783,26 @@ void MLTTask::Run() {
         if (--progressCounter == 0) {
             progress.Update();
             progressCounter = progressUpdateFrequency;
+
+            // Count splatted samples, then apply the time budget
+            AtomicAdd(&renderer->nSampleChunks, 1);
+            RenderBudget *budget = renderer->budget;
+            if (budget->Expired())
+                break;
+            if (budget->FlushDue())
+                budget->Flush(camera->film, renderer->SplatScale());
         }
     }
-    Assert(pixelNumOffset == nPixels);
+    Assert(pixelNumOffset == nPixels || renderer->budget->Expired());
     // Update display for recently computed Metropolis samples
     PBRT_MLT_STARTED_DISPLAY_UPDATE();
-    int ntf = AtomicAdd(&renderer->nTasksFinished, 1);
-    int64_t totalSamples = int64_t(nPixels) * int64_t(nPixelSamples);
-    float splatScale = float(double(totalSamples) / double(ntf * nTaskSamples));
+    float splatScale = renderer->SplatScale();
     camera->film->UpdateDisplay(x0, y0, x1, y1, splatScale);
-    if ((taskNum % 8) == 0) {
+    if ((taskNum % 8) == 0 && renderer->flushInterval == 0.f) {
         MutexLock lock(*filmMutex);
+        PBRT_STARTED_WRITING_RESULTS();
         camera->film->WriteImage(splatScale);
+        PBRT_FINISHED_WRITING_RESULTS();
     }
     PBRT_MLT_FINISHED_DISPLAY_UPDATE();
     PBRT_MLT_FINISHED_MLT_TASK(this);
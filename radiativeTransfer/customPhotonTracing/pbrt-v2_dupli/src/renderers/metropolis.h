@@ -35,6 +35,7 @@
 struct MLTSample;
 class DirectLightingIntegrator;
 struct LightingSample;
+class RenderBudget;
 
 // Metropolis Declarations
 struct PathVertex;
@@ -45,7 +46,8 @@ public:
     MetropolisRenderer(int perPixelSamples, int nBootstrap,
         int directPixelSamples, float largeStepProbability,
         bool doDirectSeparately, int maxConsecutiveRejects, int maxDepth,
-        Camera *camera, bool doBidirectional);
+        Camera *camera, bool doBidirectional, float timeBudget = 0.f,
+        float flushInterval = 0.f, int maxPasses = 1);
     ~MetropolisRenderer();
     void Render(const Scene *scene);
     Spectrum Li(const Scene *scene, const RayDifferential &ray,
@@ -69,6 +71,9 @@ private:
         MemoryArena &arena, const vector<LightingSample> &samples,
         RNG &rng, float time, const Distribution1D *lightDistribution,
         const RayDifferential &escapedRay, const Spectrum &escapedAlpha) const;
+    float SplatScale() const {
+        return nSampleChunks > 0 ? float(nPixelSamples) / nSampleChunks : 1.f;
+    }
 
     // MetropolisRenderer Private Data
     Camera *camera;
@@ -76,7 +81,11 @@ private:
     uint32_t nDirectPixelSamples, nPixelSamples, maxDepth;
     uint32_t largeStepsPerPixel, nBootstrap, maxConsecutiveRejects;
     DirectLightingIntegrator *directLighting;
-    AtomicInt32 nTasksFinished;
+    float timeBudget, flushInterval;
+    int maxPasses;
+    RenderBudget *budget;
+    // Number of samples splatted so far, in units of one sample per pixel
+    AtomicInt32 nSampleChunks;
     friend class MLTTask;
 };
 
@@ -33,6 +33,7 @@
 #include "progressreporter.h"
 #include "camera.h"
 #include "intersection.h"
+#include <functional>
 
 extern bool PhotonImage;
 
@@ -64,7 +65,7 @@ void SamplerRendererTask::Run() {
 
     // Declare local variables used for rendering loop
     MemoryArena arena;
-    RNG rng(taskNum);
+    RNG rng(taskNum + pass * taskCount);
 
     // Allocate space for samples and intersections
     int maxSamples = sampler->MaximumSampleCount();
@@ -73,10 +74,20 @@ void SamplerRendererTask::Run() {
     Spectrum *Ls = new Spectrum[maxSamples];
     Spectrum *Ts = new Spectrum[maxSamples];
     Intersection *isects = new Intersection[maxSamples];
+    bool features = camera->film->WantsFeatures() && !visualizeObjectIds;
+    RNG featureRng(taskNum + pass * taskCount);
 
     // Get samples from _Sampler_ and update image
-    int sampleCount;
+    int sampleCount, nBatches = 0;
     while ((sampleCount = sampler->GetMoreSamples(samples, rng)) > 0) {
+        // Stop refining once the time budget is spent, write image if due
+        if (budget && (nBatches++ % 16) == 0) {
+            if (pass > 0 && budget->Expired())
+                break;
+            if (budget->FlushDue())
+                budget->Flush(camera->film);
+        }
+
         // Generate camera rays and compute radiance along rays
         for (int i = 0; i < sampleCount; ++i) {
             // Find camera ray for _sample[i]_
@@ -100,6 +111,7 @@ void SamplerRendererTask::Run() {
                     Ls[i] = 0.f;
             }
             else {
+            isects[i].primitive = NULL;
             if (rayWeight > 0.f)
                 Ls[i] = rayWeight * renderer->Li(scene, rays[i], &samples[i], rng,
                                                  arena, &isects[i], &Ts[i]);
@@ -135,6 +147,24 @@ void SamplerRendererTask::Run() {
             {
                 PBRT_STARTED_ADDING_IMAGE_SAMPLE(&samples[i], &rays[i], &Ls[i], &Ts[i]);
                 camera->film->AddSample(samples[i], Ls[i]);
+                if (noise) noise->AddSample(samples[i], Ls[i]);
+                if (features) {
+                    // Record first-hit features of the sample for the film
+                    Normal n;
+                    Spectrum albedo(0.f);
+                    float depth = 0.f;
+                    if (isects[i].primitive) {
+                        n = isects[i].dg.nn;
+                        BSDF *bsdf = isects[i].GetBSDF(rays[i], arena);
+                        if (bsdf) {
+                            n = bsdf->dgShading.nn;
+                            albedo = bsdf->rho(-rays[i].d, featureRng, BSDF_ALL, 2);
+                        }
+                        n = Faceforward(n, -rays[i].d);
+                        depth = rays[i].maxt;
+                    }
+                    camera->film->AddFeatures(samples[i], Ls[i], n, albedo, depth);
+                }
                 PBRT_FINISHED_ADDING_IMAGE_SAMPLE();
             }
         }
@@ -158,15 +188,116 @@ void SamplerRendererTask::Run() {
 
 
 
+// RenderBudget Method Definitions
+RenderBudget::RenderBudget(float tb, float fi)
+    : timeBudget(tb), flushInterval(fi), nextFlush(fi) {
+    mutex = Mutex::Create();
+    timer.Start();
+}
+
+
+float RenderBudget::Elapsed() {
+    MutexLock lock(*mutex);
+    return timer.Time();
+}
+
+
+void RenderBudget::Flush(Film *film, float splatScale) {
+    // Only write the image if no other task did since _FlushDue()_
+    if (Elapsed() < nextFlush) return;
+    MutexLock lock(*mutex);
+    if (timer.Time() < nextFlush) return;
+    PBRT_STARTED_WRITING_RESULTS();
+    film->WriteImage(splatScale);
+    PBRT_FINISHED_WRITING_RESULTS();
+    nextFlush = timer.Time() + flushInterval;
+}
+
+
+
+// PixelNoise Method Definitions
+PixelNoise::PixelNoise(const Film *film) {
+    film->GetPixelExtent(&x0, &x1, &y0, &y1);
+    int nPixels = (x1 - x0) * (y1 - y0);
+    nPasses = 0;
+    passSum.resize(nPixels, 0.f);
+    passCount.resize(nPixels, 0.f);
+    sum.resize(nPixels, 0.);
+    sumSquared.resize(nPixels, 0.);
+    pixelPasses.resize(nPixels, 0);
+}
+
+
+void PixelNoise::AddSample(const CameraSample &sample, const Spectrum &L) {
+    // Pixels are covered by a single task, so no locking is needed
+    int x = Floor2Int(sample.imageX), y = Floor2Int(sample.imageY);
+    if (x < x0 || x >= x1 || y < y0 || y >= y1) return;
+    int offset = (y - y0) * (x1 - x0) + (x - x0);
+    passSum[offset] += L.y();
+    passCount[offset] += 1.f;
+}
+
+
+void PixelNoise::EndPass() {
+    for (uint32_t i = 0; i < passSum.size(); ++i) {
+        if (passCount[i] == 0.f) continue;
+        float v = passSum[i] / passCount[i];
+        sum[i] += v;
+        sumSquared[i] += double(v) * double(v);
+        ++pixelPasses[i];
+        passSum[i] = passCount[i] = 0.f;
+    }
+    ++nPasses;
+}
+
+
+float PixelNoise::RelativeNoise() const {
+    // Return RMS standard error of the pixels relative to the mean luminance
+    if (sum.size() == 0) return 0.f;
+    double mean = 0., variance = 0.;
+    for (uint32_t i = 0; i < sum.size(); ++i) {
+        int n = pixelPasses[i];
+        if (n < 2) return INFINITY;
+        mean += sum[i] / n;
+        variance += Variance(i) / n;
+    }
+    mean /= sum.size();
+    variance /= sum.size();
+    if (mean <= 0.) return variance > 0. ? INFINITY : 0.f;
+    return float(sqrt(variance) / mean);
+}
+
+
+double PixelNoise::RefinementGain(int xs, int xe, int ys, int ye) const {
+    // Return decrease of the squared pixel errors if region gets one more pass
+    double gain = 0.;
+    for (int y = max(ys, y0); y < min(ye, y1); ++y)
+        for (int x = max(xs, x0); x < min(xe, x1); ++x) {
+            int offset = (y - y0) * (x1 - x0) + (x - x0);
+            int n = max(pixelPasses[offset], 1);
+            gain += Variance(offset) / (n * (n + 1));
+        }
+    return gain;
+}
+
+
+
 // SamplerRenderer Method Definitions
 SamplerRenderer::SamplerRenderer(Sampler *s, Camera *c,
                                  SurfaceIntegrator *si, VolumeIntegrator *vi,
-                                 bool visIds) {
+                                 bool visIds, float tb, float fi, float tn,
+                                 int mp, bool at, float af) {
     sampler = s;
     camera = c;
     surfaceIntegrator = si;
     volumeIntegrator = vi;
     visualizeObjectIds = visIds;
+    timeBudget = tb;
+    flushInterval = fi;
+    targetNoise = tn;
+    maxPasses = mp;
+    adaptiveTiles = at;
+    adaptiveFraction = Clamp(af, 0.f, 1.f);
 }
 
 
@@ -202,25 +333,94 @@ if (!PhotonImage) {
     int nPixels = camera->film->xResolution * camera->film->yResolution;
     int nTasks = max(32 * NumSystemCores(), nPixels / (16*16));
     nTasks = RoundUpPow2(nTasks);
-    ProgressReporter reporter(nTasks, "Rendering");
-    vector<Task *> renderTasks;
-
-
 
+    // Render passes over the image until the budget or target noise is met
+    bool progressive = timeBudget > 0.f || targetNoise > 0.f || maxPasses != 1;
+    RenderBudget budget(timeBudget, flushInterval);
+    PixelNoise *noise = (targetNoise > 0.f || (progressive && adaptiveTiles)) ?
+        new PixelNoise(camera->film) : NULL;
+    vector<int> tileBounds;
+    if (progressive && adaptiveTiles) {
+        // Record the pixel window of each task to estimate its noise
+        tileBounds.resize(4 * nTasks, 0);
+        for (int i = 0; i < nTasks; ++i) {
+            Sampler *s = sampler->GetSubSampler(i, nTasks);
+            if (!s) continue;
+            tileBounds[4*i]   = s->xPixelStart;
+            tileBounds[4*i+1] = s->xPixelEnd;
+            tileBounds[4*i+2] = s->yPixelStart;
+            tileBounds[4*i+3] = s->yPixelEnd;
+            delete s;
+        }
+    }
+    vector<int> passTasks;
     for (int i = 0; i < nTasks; ++i)
-        renderTasks.push_back(new SamplerRendererTask(scene, this, camera,
-                                                      reporter, sampler, sample, 
-                                                      visualizeObjectIds, 
-                                                      nTasks-1-i, nTasks));
-    EnqueueTasks(renderTasks);
-    WaitForAllTasks();
-    for (uint32_t i = 0; i < renderTasks.size(); ++i)
-        delete renderTasks[i];
-    reporter.Done();
+        passTasks.push_back(nTasks-1-i);
+    uint64_t nTilePasses = 0;
+    for (int pass = 0; ; ++pass) {
+        char title[64];
+        if (progressive) sprintf(title, "Rendering (pass %d)", pass + 1);
+        else             sprintf(title, "Rendering");
+        ProgressReporter reporter(passTasks.size(), title);
+        vector<Task *> renderTasks;
+        for (uint32_t i = 0; i < passTasks.size(); ++i)
+            renderTasks.push_back(new SamplerRendererTask(scene, this, camera,
+                                                          reporter, sampler, sample, 
+                                                          visualizeObjectIds, 
+                                                          passTasks[i], nTasks,
+                                                          &budget, pass, noise));
+        EnqueueTasks(renderTasks);
+        WaitForAllTasks();
+        for (uint32_t i = 0; i < renderTasks.size(); ++i)
+            delete renderTasks[i];
+        reporter.Done();
+        nTilePasses += passTasks.size();
+
+        // Decide whether to render another pass
+        if (!progressive || budget.Expired()) break;
+        if (maxPasses > 0 && pass + 1 >= maxPasses) break;
+        if (noise) {
+            noise->EndPass();
+            float relNoise = noise->RelativeNoise();
+            if (noise->Passes() > 1)
+                Info("Pass %d: relative noise %f after %.1fs", pass + 1,
+                     relNoise, budget.Elapsed());
+            if (targetNoise > 0.f && relNoise <= targetNoise) break;
+        }
+        if (budget.FlushDue()) budget.Flush(camera->film);
+
+        // Select the tiles to refine in the next pass
+        if (tileBounds.size() && noise->Passes() >= 2 && ((pass + 1) % 8) != 0) {
+            // Keep the tiles whose next pass reduces the squared error most;
+            // every eighth pass covers the whole image to refresh estimates
+            vector<std::pair<double, int> > gains(nTasks);
+            for (int i = 0; i < nTasks; ++i)
+                gains[i] = std::make_pair(noise->RefinementGain(tileBounds[4*i],
+                    tileBounds[4*i+1], tileBounds[4*i+2], tileBounds[4*i+3]), i);
+            int nSelected = max(1, Ceil2Int(adaptiveFraction * nTasks));
+            std::partial_sort(gains.begin(), gains.begin() + nSelected,
+                              gains.end(), std::greater<std::pair<double, int> >());
+            passTasks.clear();
+            for (int i = 0; i < nSelected; ++i)
+                if (gains[i].first > 0. || i == 0)
+                    passTasks.push_back(gains[i].second);
+        }
+        else {
+            passTasks.clear();
+            for (int i = 0; i < nTasks; ++i)
+                passTasks.push_back(nTasks-1-i);
+        }
+    }
+    if (progressive)
+        Info("Rendered %llu tile passes of %d tiles", (unsigned long long)nTilePasses,
+             nTasks);
+    delete noise;
     PBRT_FINISHED_RENDERING();
     // Clean up after rendering and store final image
     delete sample;
+    PBRT_STARTED_WRITING_RESULTS();
     camera->film->WriteImage();
+    PBRT_FINISHED_WRITING_RESULTS();
 }
 }
 
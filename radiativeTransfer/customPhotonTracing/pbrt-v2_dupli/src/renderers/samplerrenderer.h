@@ -32,13 +32,74 @@
 #include "pbrt.h"
 #include "renderer.h"
 #include "parallel.h"
+#include "timer.h"
+
+// RenderBudget Declarations
+
+// Wall-clock budget of a progressive render and periodic writing of the
+// image rendered so far; shared by the rendering tasks
+class RenderBudget {
+public:
+    // RenderBudget Public Methods
+    RenderBudget(float timeBudget, float flushInterval);
+    ~RenderBudget() { Mutex::Destroy(mutex); }
+    bool Limited() const { return timeBudget > 0.f; }
+    float Elapsed();
+    bool Expired() { return timeBudget > 0.f && Elapsed() >= timeBudget; }
+    bool FlushDue() {
+        return flushInterval > 0.f && Elapsed() >= nextFlush;
+    }
+    void Flush(Film *film, float splatScale = 1.f);
+private:
+    // RenderBudget Private Data
+    float timeBudget, flushInterval;
+    double nextFlush;
+    Timer timer;
+    Mutex *mutex;
+};
+
+
+// PixelNoise Declarations
+
+// Luminance of each pixel averaged per rendering pass; the spread of the
+// pass averages gives the standard error of the pixel values.  Passes may
+// cover only part of the image, so pass counts are kept per pixel
+class PixelNoise {
+public:
+    // PixelNoise Public Methods
+    PixelNoise(const Film *film);
+    void AddSample(const CameraSample &sample, const Spectrum &L);
+    void EndPass();
+    float RelativeNoise() const;
+    double RefinementGain(int xs, int xe, int ys, int ye) const;
+    int Passes() const { return nPasses; }
+private:
+    // PixelNoise Private Methods
+    double Variance(int offset) const {
+        int n = pixelPasses[offset];
+        if (n < 2) return 0.;
+        double m = sum[offset] / n;
+        return max(0., sumSquared[offset] / n - m * m) * n / (n - 1);
+    }
+
+    // PixelNoise Private Data
+    int x0, x1, y0, y1, nPasses;
+    vector<float> passSum, passCount;
+    vector<double> sum, sumSquared;
+    vector<int> pixelPasses;
+};
+
+
 
 // SamplerRenderer Declarations
 class SamplerRenderer : public Renderer {
 public:
     // SamplerRenderer Public Methods
     SamplerRenderer(Sampler *s, Camera *c, SurfaceIntegrator *si,
-                    VolumeIntegrator *vi, bool visIds);
+                    VolumeIntegrator *vi, bool visIds, float timeBudget = 0.f,
+                    float flushInterval = 0.f, float targetNoise = 0.f,
+                    int maxPasses = 1, bool adaptiveTiles = false,
+                    float adaptiveFraction = .25f);
     ~SamplerRenderer();
     void Render(const Scene *scene);
     Spectrum Li(const Scene *scene, const RayDifferential &ray,
@@ -53,6 +114,10 @@ private:
     Camera *camera;
     SurfaceIntegrator *surfaceIntegrator;
     VolumeIntegrator *volumeIntegrator;
+    float timeBudget, flushInterval, targetNoise;
+    int maxPasses;
+    bool adaptiveTiles;
+    float adaptiveFraction;
 };
 
 
@@ -63,11 +128,13 @@ public:
     // SamplerRendererTask Public Methods
     SamplerRendererTask(const Scene *sc, Renderer *ren, Camera *c,
                         ProgressReporter &pr, Sampler *ms, Sample *sam, 
-                        bool visIds, int tn, int tc)
+                        bool visIds, int tn, int tc, RenderBudget *bud = NULL,
+                        int p = 0, PixelNoise *pn = NULL)
       : reporter(pr)
     {
         scene = sc; renderer = ren; camera = c; mainSampler = ms;
         origSample = sam; visualizeObjectIds = visIds; taskNum = tn; taskCount = tc;
+        budget = bud; pass = p; noise = pn;
     }
     void Run();
 private:
@@ -80,6 +147,9 @@ private:
     Sample *origSample;
     bool visualizeObjectIds;
     int taskNum, taskCount;
+    RenderBudget *budget;
+    int pass;
+    PixelNoise *noise;
 };
 
 
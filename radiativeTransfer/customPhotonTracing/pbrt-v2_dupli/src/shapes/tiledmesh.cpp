@@ -0,0 +1,606 @@
+
+/*
+    pbrt source code Copyright(c) 1998-2010 Matt Pharr and Greg Humphreys.
+
+    This file is part of pbrt.
+
+    pbrt is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.  Note that the text contents of
+    the book "Physically Based Rendering" are *not* licensed under the
+    GNU GPL.
+
+    pbrt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+// shapes/tiledmesh.cpp*
+#include "stdafx.h"
+#include "shapes/tiledmesh.h"
+#include "paramset.h"
+#include "fileutil.h"
+#if !defined(PBRT_IS_WINDOWS)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+extern bool PhotonImage;
+
+// TiledMesh Local Definitions
+static const uint32_t TILEDMESH_VERSION = 1;
+static const int32_t TILE_EVICTING = -(1 << 30);
+
+static inline size_t TileBytes(const TiledMeshTileInfo &ti) {
+    return ti.nNodes * sizeof(TiledMeshNode) +
+           2 * 3 * ti.nVerts * sizeof(float) +
+           3 * ti.nTris * sizeof(int32_t);
+}
+
+
+static inline bool IntersectP(const float bounds[2][3], const Ray &ray,
+        const Vector &invDir, const uint32_t dirIsNeg[3]) {
+    // Same slab test as _TriangleSoupPrimitive_, far distances enlarged
+    const float farScale = 1.f + 2.f * 3.f * 0.5f * 1.19209290e-07f;
+    float tmin =  (bounds[  dirIsNeg[0]][0] - ray.o.x) * invDir.x;
+    float tmax =  (bounds[1-dirIsNeg[0]][0] - ray.o.x) * invDir.x * farScale;
+    float tymin = (bounds[  dirIsNeg[1]][1] - ray.o.y) * invDir.y;
+    float tymax = (bounds[1-dirIsNeg[1]][1] - ray.o.y) * invDir.y * farScale;
+    if ((tmin > tymax) || (tymin > tmax))
+        return false;
+    if (tymin > tmin) tmin = tymin;
+    if (tymax < tmax) tmax = tymax;
+    float tzmin = (bounds[  dirIsNeg[2]][2] - ray.o.z) * invDir.z;
+    float tzmax = (bounds[1-dirIsNeg[2]][2] - ray.o.z) * invDir.z * farScale;
+    if ((tmin > tzmax) || (tzmin > tmax))
+        return false;
+    if (tzmin > tmin)
+        tmin = tzmin;
+    if (tzmax < tmax)
+        tmax = tzmax;
+    return (tmin < ray.maxt) && (tmax > ray.mint);
+}
+
+
+static inline bool IntersectTriangle(const Ray &ray, const float *p1,
+        const float *p2, const float *p3, float *tHit, float *b1Hit,
+        float *b2Hit) {
+    Vector e1(p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2]);
+    Vector e2(p3[0] - p1[0], p3[1] - p1[1], p3[2] - p1[2]);
+    Vector s1 = Cross(ray.d, e2);
+    float divisor = Dot(s1, e1);
+    if (divisor == 0.)
+        return false;
+    float invDivisor = 1.f / divisor;
+
+    // Compute first barycentric coordinate
+    Vector d(ray.o.x - p1[0], ray.o.y - p1[1], ray.o.z - p1[2]);
+    float b1 = Dot(d, s1) * invDivisor;
+    if (b1 < 0. || b1 > 1.)
+        return false;
+
+    // Compute second barycentric coordinate
+    Vector s2 = Cross(d, e1);
+    float b2 = Dot(ray.d, s2) * invDivisor;
+    if (b2 < 0. || b1 + b2 > 1.)
+        return false;
+
+    // Compute _t_ to intersection point
+    float t = Dot(e2, s2) * invDivisor;
+    if (t < ray.mint || t > ray.maxt)
+        return false;
+    *tHit = t;
+    *b1Hit = b1;
+    *b2Hit = b2;
+    return true;
+}
+
+
+static void TransformBounds(const Transform &t, float bounds[2][3]) {
+    BBox b = t(BBox(Point(bounds[0][0], bounds[0][1], bounds[0][2]),
+                    Point(bounds[1][0], bounds[1][1], bounds[1][2])));
+    bounds[0][0] = b.pMin.x;  bounds[0][1] = b.pMin.y;  bounds[0][2] = b.pMin.z;
+    bounds[1][0] = b.pMax.x;  bounds[1][1] = b.pMax.y;  bounds[1][2] = b.pMax.z;
+}
+
+
+struct TopBuildInfo {
+    uint32_t tile;
+    float centroid[3];
+};
+
+
+struct CompareTopCentroids {
+    CompareTopCentroids(int d) { dim = d; }
+    int dim;
+    bool operator()(const TopBuildInfo &a, const TopBuildInfo &b) const {
+        return a.centroid[dim] < b.centroid[dim];
+    }
+};
+
+
+static uint32_t buildTopNodes(const vector<TiledMeshTileInfo> &tiles,
+        vector<TopBuildInfo> &buildData, uint32_t start, uint32_t end,
+        vector<TiledMeshNode> &nodes) {
+    uint32_t nodeNum = nodes.size();
+    nodes.push_back(TiledMeshNode());
+    TiledMeshNode node;
+    for (int a = 0; a < 3; ++a) {
+        node.bounds[0][a] =  INFINITY;
+        node.bounds[1][a] = -INFINITY;
+    }
+    float cmin[3] = { INFINITY, INFINITY, INFINITY };
+    float cmax[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (uint32_t i = start; i < end; ++i) {
+        const TiledMeshTileInfo &ti = tiles[buildData[i].tile];
+        for (int a = 0; a < 3; ++a) {
+            node.bounds[0][a] = min(node.bounds[0][a], ti.bounds[0][a]);
+            node.bounds[1][a] = max(node.bounds[1][a], ti.bounds[1][a]);
+            cmin[a] = min(cmin[a], buildData[i].centroid[a]);
+            cmax[a] = max(cmax[a], buildData[i].centroid[a]);
+        }
+    }
+    if (end - start == 1) {
+        // One tile per leaf, so that tiles are visited front to back
+        node.offset = buildData[start].tile;
+        node.nTris = 1;
+        node.axis = 0;
+        nodes[nodeNum] = node;
+        return nodeNum;
+    }
+    int dim = 0;
+    for (int a = 1; a < 3; ++a)
+        if (cmax[a] - cmin[a] > cmax[dim] - cmin[dim]) dim = a;
+    uint32_t mid = (start + end) / 2;
+    std::nth_element(&buildData[start], &buildData[mid],
+                     &buildData[end-1]+1, CompareTopCentroids(dim));
+    buildTopNodes(tiles, buildData, start, mid, nodes);
+    node.offset = buildTopNodes(tiles, buildData, mid, end, nodes);
+    node.nTris = 0;
+    node.axis = dim;
+    nodes[nodeNum] = node;
+    return nodeNum;
+}
+
+
+
+// TiledMesh Method Definitions
+TiledMesh::TiledMesh(const Transform *o2w, const Transform *w2o, bool ro,
+        const string &fn, uint64_t maxResidentBytes)
+    : Shape(o2w, w2o, ro), filename(fn) {
+    fd = -1;
+    nTris = 0;
+    maxResident = maxResidentBytes;
+    resident = useCounter = 0;
+    pageIns = 0;
+    mutex = Mutex::Create();
+#if defined(PBRT_IS_WINDOWS)
+    Error("\"tiledmesh\" shapes are not supported on Windows");
+#else
+    // Read _TiledMeshHeader_ and tile table from _filename_
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        Error("Unable to open tiled mesh file \"%s\"", filename.c_str());
+        return;
+    }
+    TiledMeshHeader header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        strncmp(header.magic, "PBRTTILE", 8) != 0 ||
+        header.version != TILEDMESH_VERSION) {
+        Error("\"%s\" is not a tiled mesh file (version %u expected)",
+              filename.c_str(), TILEDMESH_VERSION);
+        close(fd);
+        fd = -1;
+        return;
+    }
+    tiles.resize(header.nTiles);
+    size_t tableBytes = header.nTiles * sizeof(TiledMeshTileInfo);
+    if (header.nTiles > 0 &&
+        pread(fd, &tiles[0], tableBytes, sizeof(header)) != (ssize_t)tableBytes) {
+        Error("Truncated tile table in \"%s\"", filename.c_str());
+        tiles.clear();
+        return;
+    }
+    nTris = header.nTris;
+    objectBound = BBox(Point(header.bounds[0][0], header.bounds[0][1], header.bounds[0][2]),
+                       Point(header.bounds[1][0], header.bounds[1][1], header.bounds[1][2]));
+
+    // Build top-level BVH over the world space tile bounds
+    for (uint32_t i = 0; i < tiles.size(); ++i)
+        TransformBounds(*ObjectToWorld, tiles[i].bounds);
+    if (tiles.size() > 0) {
+        vector<TopBuildInfo> buildData(tiles.size());
+        for (uint32_t i = 0; i < tiles.size(); ++i) {
+            buildData[i].tile = i;
+            for (int a = 0; a < 3; ++a)
+                buildData[i].centroid[a] = .5f * (tiles[i].bounds[0][a] +
+                                                  tiles[i].bounds[1][a]);
+        }
+        topNodes.reserve(2 * tiles.size());
+        buildTopNodes(tiles, buildData, 0, tiles.size(), topNodes);
+    }
+    slots.resize(tiles.size());
+    for (uint32_t i = 0; i < slots.size(); ++i) {
+        slots[i].map = slots[i].data = NULL;
+        slots[i].mapLength = 0;
+        slots[i].pins = 0;
+        slots[i].lastUse = 0;
+    }
+    Info("Tiled mesh \"%s\": %llu triangles in %d tiles, %.1f MB resident max",
+         filename.c_str(), (unsigned long long)nTris, (int)tiles.size(),
+         float(maxResident) / (1024.f*1024.f));
+#endif
+}
+
+
+TiledMesh::~TiledMesh() {
+#if !defined(PBRT_IS_WINDOWS)
+    for (uint32_t i = 0; i < slots.size(); ++i)
+        if (slots[i].map) munmap(slots[i].map, slots[i].mapLength);
+    if (fd >= 0) {
+        close(fd);
+        Info("Tiled mesh \"%s\": %u tile page-ins", filename.c_str(), pageIns);
+    }
+#endif
+    Mutex::Destroy(mutex);
+}
+
+
+BBox TiledMesh::ObjectBound() const {
+    return objectBound;
+}
+
+
+bool TiledMesh::AcquireTile(uint32_t tile, TileView *tv) const {
+    TileSlot &slot = slots[tile];
+    const TiledMeshTileInfo &ti = tiles[tile];
+    char *data = NULL;
+
+    // Pin resident tile without locking; fall back to _mutex_ on a miss.
+    // _lastUse_ only counts page-ins, which is enough to order evictions
+    if (AtomicAdd(&slot.pins, 1) > 0 && (data = slot.data) != NULL) {
+        if (slot.lastUse != useCounter) slot.lastUse = useCounter;
+    }
+    else {
+        AtomicAdd(&slot.pins, -1);
+        MutexLock lock(*mutex);
+        AtomicAdd(&slot.pins, 1);
+        data = slot.data;
+#if !defined(PBRT_IS_WINDOWS)
+        if (!data) {
+            // Map tile from disk, starting at the enclosing page boundary
+            uint64_t pageSize = sysconf(_SC_PAGESIZE);
+            uint64_t start = ti.offset - ti.offset % pageSize;
+            size_t length = TileBytes(ti) + size_t(ti.offset - start);
+            void *m = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                           fd, start);
+            if (m == MAP_FAILED)
+                Severe("Unable to map tile %u of \"%s\"", tile, filename.c_str());
+            posix_madvise(m, length, POSIX_MADV_WILLNEED);
+            slot.map = (char *)m;
+            slot.mapLength = length;
+            data = slot.map + (ti.offset - start);
+            TiledMeshNode *nodes = (TiledMeshNode *)data;
+            float *P = (float *)(data + ti.nNodes * sizeof(TiledMeshNode));
+
+            // Move private copy of tile to world space, as _TriangleMesh_ does
+            for (uint32_t i = 0; i < ti.nVerts; ++i) {
+                Point pw = (*ObjectToWorld)(Point(P[3*i], P[3*i+1], P[3*i+2]));
+                P[3*i] = pw.x;  P[3*i+1] = pw.y;  P[3*i+2] = pw.z;
+            }
+            for (uint32_t i = 0; i < ti.nNodes; ++i)
+                TransformBounds(*ObjectToWorld, nodes[i].bounds);
+            AtomicCompareAndSwapPointer(&slot.data, data, (char *)NULL);
+            resident += length;
+            ++pageIns;
+            slot.lastUse = ++useCounter;
+            EvictTiles();
+        }
+#endif
+        if (!data) return false;
+    }
+
+    // Tile layout follows from _data_ and the tile table
+    tv->nodes = (const TiledMeshNode *)data;
+    data += ti.nNodes * sizeof(TiledMeshNode);
+    tv->P = (const float *)data;
+    data += 3 * ti.nVerts * sizeof(float);
+    tv->N = (const float *)data;
+    data += 3 * ti.nVerts * sizeof(float);
+    tv->indices = (const int32_t *)data;
+    return true;
+}
+
+
+void TiledMesh::ReleaseTile(uint32_t tile) const {
+    AtomicAdd(&slots[tile].pins, -1);
+}
+
+
+void TiledMesh::EvictTiles() const {
+#if !defined(PBRT_IS_WINDOWS)
+    // Unmap least recently used tiles until under the residency limit
+    if (resident <= maxResident) return;
+    vector<std::pair<uint64_t, uint32_t> > victims;
+    for (uint32_t i = 0; i < slots.size(); ++i)
+        if (slots[i].data && slots[i].pins == 0)
+            victims.push_back(std::make_pair(uint64_t(slots[i].lastUse), i));
+    std::sort(victims.begin(), victims.end());
+    for (uint32_t i = 0; i < victims.size() && resident > maxResident; ++i) {
+        // Skip tiles pinned since the scan; readers retry under _mutex_
+        TileSlot &slot = slots[victims[i].second];
+        if (AtomicCompareAndSwap(&slot.pins, TILE_EVICTING, 0) != 0)
+            continue;
+        slot.data = NULL;
+        munmap(slot.map, slot.mapLength);
+        resident -= slot.mapLength;
+        slot.map = NULL;
+        slot.mapLength = 0;
+        AtomicAdd(&slot.pins, -TILE_EVICTING);
+    }
+#endif
+}
+
+
+bool TiledMesh::IntersectTile(const TileView &tv, const Ray &ray,
+        uint32_t *hitTri, float *tHit, float *b1Hit, float *b2Hit,
+        bool anyHit) const {
+    bool hit = false;
+    Vector invDir(1.f / ray.d.x, 1.f / ray.d.y, 1.f / ray.d.z);
+    uint32_t dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+    uint32_t todoOffset = 0, nodeNum = 0;
+    uint32_t todo[64];
+    while (true) {
+        const TiledMeshNode *node = &tv.nodes[nodeNum];
+        if (::IntersectP(node->bounds, ray, invDir, dirIsNeg)) {
+            if (node->nTris > 0) {
+                const int32_t *v = &tv.indices[3 * node->offset];
+                for (uint32_t i = 0; i < node->nTris; ++i, v += 3) {
+                    if (anyHit) {
+                        PBRT_RAY_TRIANGLE_INTERSECTIONP_TEST(const_cast<Ray *>(&ray), (Triangle *)NULL);
+                    }
+                    else {
+                        PBRT_RAY_TRIANGLE_INTERSECTION_TEST(const_cast<Ray *>(&ray), (Triangle *)NULL);
+                    }
+                    float t, b1, b2;
+                    if (IntersectTriangle(ray, &tv.P[3*v[0]], &tv.P[3*v[1]],
+                                          &tv.P[3*v[2]], &t, &b1, &b2)) {
+                        if (anyHit) {
+                            PBRT_RAY_TRIANGLE_INTERSECTIONP_HIT(const_cast<Ray *>(&ray), t);
+                            return true;
+                        }
+                        PBRT_RAY_TRIANGLE_INTERSECTION_HIT(const_cast<Ray *>(&ray), t);
+                        hit = true;
+                        *hitTri = node->offset + i;
+                        *tHit = t;
+                        *b1Hit = b1;
+                        *b2Hit = b2;
+                        ray.maxt = t;
+                    }
+                }
+                if (todoOffset == 0) break;
+                nodeNum = todo[--todoOffset];
+            }
+            else {
+                if (dirIsNeg[node->axis]) {
+                   todo[todoOffset++] = nodeNum + 1;
+                   nodeNum = node->offset;
+                }
+                else {
+                   todo[todoOffset++] = node->offset;
+                   nodeNum = nodeNum + 1;
+                }
+            }
+        }
+        else {
+            if (todoOffset == 0) break;
+            nodeNum = todo[--todoOffset];
+        }
+    }
+    return hit;
+}
+
+
+bool TiledMesh::Intersect(const Ray &r, float *tHit, float *rayEpsilon,
+                          DifferentialGeometry *dg) const {
+    if (topNodes.size() == 0) return false;
+    Ray ray(r.o, r.d, r.mint, r.maxt, r.time, r.depth);
+    Vector invDir(1.f / ray.d.x, 1.f / ray.d.y, 1.f / ray.d.z);
+    uint32_t dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+
+    // Visit tiles front to back, keeping the closest hit
+    bool hit = false;
+    uint64_t hitTri = 0;
+    float t = 0.f, b1 = 0.f, b2 = 0.f;
+    Point p[3];
+    Normal n0;
+    uint32_t todoOffset = 0, nodeNum = 0;
+    uint32_t todo[64];
+    while (true) {
+        const TiledMeshNode *node = &topNodes[nodeNum];
+        if (::IntersectP(node->bounds, ray, invDir, dirIsNeg)) {
+            if (node->nTris > 0) {
+                uint32_t tile = node->offset;
+                TileView tv;
+                uint32_t tri;
+                if (AcquireTile(tile, &tv) &&
+                    IntersectTile(tv, ray, &tri, &t, &b1, &b2, false)) {
+                    // Copy hit triangle before the tile can be evicted
+                    const int32_t *v = &tv.indices[3 * tri];
+                    for (int i = 0; i < 3; ++i)
+                        p[i] = Point(tv.P[3*v[i]], tv.P[3*v[i]+1], tv.P[3*v[i]+2]);
+                    n0 = Normal(tv.N[3*v[0]], tv.N[3*v[0]+1], tv.N[3*v[0]+2]);
+                    hitTri = tiles[tile].firstTri + tri;
+                    hit = true;
+                }
+                ReleaseTile(tile);
+                if (todoOffset == 0) break;
+                nodeNum = todo[--todoOffset];
+            }
+            else {
+                if (dirIsNeg[node->axis]) {
+                   todo[todoOffset++] = nodeNum + 1;
+                   nodeNum = node->offset;
+                }
+                else {
+                   todo[todoOffset++] = node->offset;
+                   nodeNum = nodeNum + 1;
+                }
+            }
+        }
+        else {
+            if (todoOffset == 0) break;
+            nodeNum = todo[--todoOffset];
+        }
+    }
+    if (!hit) return false;
+
+    // Fill in _DifferentialGeometry_ as _Triangle::Intersect()_ does
+    const Point &p1 = p[0], &p2 = p[1], &p3 = p[2];
+    const float uvs[3][2] = { { 0.f, 0.f }, { 1.f, 0.f }, { 1.f, 1.f } };
+    float du1 = uvs[0][0] - uvs[2][0];
+    float du2 = uvs[1][0] - uvs[2][0];
+    float dv1 = uvs[0][1] - uvs[2][1];
+    float dv2 = uvs[1][1] - uvs[2][1];
+    Vector dp1 = p1 - p3, dp2 = p2 - p3;
+    float invdet = 1.f / (du1 * dv2 - dv1 * du2);
+    Vector dpdu = ( dv2 * dp1 - dv1 * dp2) * invdet;
+    Vector dpdv = (-du2 * dp1 + du1 * dp2) * invdet;
+    float b0 = 1 - b1 - b2;
+    float tu = b0*uvs[0][0] + b1*uvs[1][0] + b2*uvs[2][0];
+    float tv = b0*uvs[0][1] + b1*uvs[1][1] + b2*uvs[2][1];
+    if (PhotonImage) {
+        Normal normalMesh = (*ObjectToWorld)(n0);
+        if (Dot(normalMesh, Cross(dpdu, dpdv)) < 0)
+            dpdu = -dpdu;
+    }
+    *dg = DifferentialGeometry(ray(t), dpdu, dpdv,
+                               Normal(0,0,0), Normal(0,0,0),
+                               tu, tv, this);
+    dg->faceIndex = hitTri;
+    *tHit = t;
+    *rayEpsilon = 1e-3f * *tHit;
+    return true;
+}
+
+
+bool TiledMesh::IntersectP(const Ray &r) const {
+    if (topNodes.size() == 0) return false;
+    Ray ray(r.o, r.d, r.mint, r.maxt, r.time, r.depth);
+    Vector invDir(1.f / ray.d.x, 1.f / ray.d.y, 1.f / ray.d.z);
+    uint32_t dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+    uint32_t todoOffset = 0, nodeNum = 0;
+    uint32_t todo[64];
+    while (true) {
+        const TiledMeshNode *node = &topNodes[nodeNum];
+        if (::IntersectP(node->bounds, ray, invDir, dirIsNeg)) {
+            if (node->nTris > 0) {
+                uint32_t tile = node->offset, tri;
+                float t, b1, b2;
+                TileView tv;
+                bool hit = AcquireTile(tile, &tv) &&
+                           IntersectTile(tv, ray, &tri, &t, &b1, &b2, true);
+                ReleaseTile(tile);
+                if (hit) return true;
+                if (todoOffset == 0) break;
+                nodeNum = todo[--todoOffset];
+            }
+            else {
+                if (dirIsNeg[node->axis]) {
+                   todo[todoOffset++] = nodeNum + 1;
+                   nodeNum = node->offset;
+                }
+                else {
+                   todo[todoOffset++] = node->offset;
+                   nodeNum = nodeNum + 1;
+                }
+            }
+        }
+        else {
+            if (todoOffset == 0) break;
+            nodeNum = todo[--todoOffset];
+        }
+    }
+    return false;
+}
+
+
+void TiledMesh::GetShadingGeometry(const Transform &obj2world,
+        const DifferentialGeometry &dg,
+        DifferentialGeometry *dgShading) const {
+    // Find tile holding _dg.faceIndex_ and fetch its vertex normals
+    uint32_t tile = 0, lo = 0, hi = tiles.size();
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (tiles[mid].firstTri <= (uint64_t)dg.faceIndex) {
+            tile = mid;
+            lo = mid + 1;
+        }
+        else
+            hi = mid;
+    }
+    Normal n[3];
+    TileView tv;
+    if (!AcquireTile(tile, &tv)) {
+        ReleaseTile(tile);
+        *dgShading = dg;
+        return;
+    }
+    const int32_t *v = &tv.indices[3 * (dg.faceIndex - tiles[tile].firstTri)];
+    for (int i = 0; i < 3; ++i)
+        n[i] = Normal(tv.N[3*v[i]], tv.N[3*v[i]+1], tv.N[3*v[i]+2]);
+    ReleaseTile(tile);
+
+    // Barycentrics follow from the default $(u,v)$ set in _Intersect()_,
+    // computed as _TriangleMesh::GetTriangleShadingGeometry()_ does
+    float b[3];
+    b[1] = dg.u - dg.v;
+    b[2] = dg.v;
+    b[0] = 1.f - b[1] - b[2];
+    Normal ns = Normalize(obj2world(b[0] * n[0] + b[1] * n[1] + b[2] * n[2]));
+    Vector ss = Normalize(dg.dpdu);
+    Vector ts = Cross(ss, ns);
+    if (ts.LengthSquared() > 0.f) {
+        ts = Normalize(ts);
+        ss = Cross(ts, ns);
+    }
+    else
+        CoordinateSystem((Vector)ns, &ss, &ts);
+
+    // Default $(u,v)$ deltas are $du_1=-1, du_2=0, dv_1=dv_2=-1$
+    Normal dn1 = n[0] - n[2];
+    Normal dn2 = n[1] - n[2];
+    Normal dndu = -dn1 + dn2;
+    Normal dndv = -dn2;
+    *dgShading = DifferentialGeometry(dg.p, ss, ts,
+        (*ObjectToWorld)(dndu), (*ObjectToWorld)(dndv),
+        dg.u, dg.v, dg.shape);
+    dgShading->faceIndex = dg.faceIndex;
+    dgShading->dudx = dg.dudx;  dgShading->dvdx = dg.dvdx;
+    dgShading->dudy = dg.dudy;  dgShading->dvdy = dg.dvdy;
+    dgShading->dpdx = dg.dpdx;  dgShading->dpdy = dg.dpdy;
+}
+
+
+TiledMesh *CreateTiledMeshShape(const Transform *o2w, const Transform *w2o,
+        bool reverseOrientation, const ParamSet &params) {
+    string filename = params.FindOneString("filename", "");
+    if (filename == "") {
+        Error("No \"filename\" provided for \"tiledmesh\" shape");
+        return NULL;
+    }
+    filename = AbsolutePath(ResolveFilename(filename));
+    int maxResidentMB = params.FindOneInt("maxresidentmb", 4096);
+    return new TiledMesh(o2w, w2o, reverseOrientation, filename,
+                         uint64_t(max(maxResidentMB, 1)) * 1024 * 1024);
+}
+
+
@@ -0,0 +1,139 @@
+
+/*
+    pbrt source code Copyright(c) 1998-2010 Matt Pharr and Greg Humphreys.
+
+    This file is part of pbrt.
+
+    pbrt is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.  Note that the text contents of
+    the book "Physically Based Rendering" are *not* licensed under the
+    GNU GPL.
+
+    pbrt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef PBRT_SHAPES_TILEDMESH_H
+#define PBRT_SHAPES_TILEDMESH_H
+
+// shapes/tiledmesh.h*
+#include "shape.h"
+#include "parallel.h"
+
+//[DGtal maillage decoupe en tuiles sur disque, pour les echantillons qui ne
+// tiennent pas en memoire. Fichier ecrit par Noff2Pbrt --tiles ou volRemesh
+// (qui garde dans pad le numero de la brique de chaque tuile) :
+//   TiledMeshHeader
+//   TiledMeshTileInfo[nTiles]
+//   pour chaque tuile, a tile.offset (aligne sur 4096 octets) :
+//     TiledMeshNode[nNodes]     BVH de la tuile, en profondeur d'abord
+//     float P[3*nVerts]         sommets (repere objet)
+//     float N[3*nVerts]         normales
+//     int32 indices[3*nTris]    triangles dans l'ordre des feuilles
+// Les tuiles sont projetees en memoire (mmap prive) a la demande, passees
+// en repere monde, et liberees (LRU) au dela de "integer maxresidentmb".
+// Une tuile deja chargee est prise par un simple compteur atomique ; le
+// verrou ne sert qu'aux chargements et aux liberations.
+// Les impacts sont ceux de _TriangleMesh_ aux arrondis pres : avec des faces
+// confondues (echantillon pose sur une paroi), le triangle retenu a distance
+// egale depend de l'ordre de parcours de l'accelerateur, et les chemins des
+// photons divergent ensuite ; les statistiques (albedo, absorption) restent
+// egales aux fluctuations du tirage pres.]
+struct TiledMeshHeader {
+    char magic[8];        // "PBRTTILE"
+    uint32_t version;
+    uint32_t nTiles;
+    uint64_t nTris;
+    float bounds[2][3];
+};
+
+
+struct TiledMeshTileInfo {
+    float bounds[2][3];
+    uint64_t offset;
+    uint64_t firstTri;
+    uint32_t nVerts, nTris, nNodes;
+    uint32_t pad;
+};
+
+
+struct TiledMeshNode {
+    float bounds[2][3];
+    uint32_t offset;      // leaf: first triangle, interior: second child
+    uint8_t nTris;        // 0 -> interior node
+    uint8_t axis;
+    uint8_t pad[2];
+};
+
+
+// TiledMesh Declarations
+class TiledMesh : public Shape {
+public:
+    // TiledMesh Public Methods
+    TiledMesh(const Transform *o2w, const Transform *w2o, bool ro,
+              const string &filename, uint64_t maxResidentBytes);
+    ~TiledMesh();
+    BBox ObjectBound() const;
+    bool Intersect(const Ray &ray, float *tHit, float *rayEpsilon,
+                   DifferentialGeometry *dg) const;
+    bool IntersectP(const Ray &ray) const;
+    void GetShadingGeometry(const Transform &obj2world,
+            const DifferentialGeometry &dg,
+            DifferentialGeometry *dgShading) const;
+private:
+    // TiledMesh Private Types
+    struct TileView {
+        const TiledMeshNode *nodes;
+        const float *P, *N;
+        const int32_t *indices;
+    };
+    //[DGtal _data_ n'est publie qu'une fois la tuile passee en repere monde ;
+    // _pins_ vaut TILE_EVICTING (negatif) pendant une liberation, ce qui
+    // renvoie les lecteurs vers le verrou.]
+    struct TileSlot {
+        char *map;
+        size_t mapLength;
+        char *data;
+        AtomicInt32 pins;
+        volatile uint64_t lastUse;
+    };
+
+    // TiledMesh Private Methods
+    bool AcquireTile(uint32_t tile, TileView *tv) const;
+    void ReleaseTile(uint32_t tile) const;
+    void EvictTiles() const;
+    bool IntersectTile(const TileView &tv, const Ray &ray, uint32_t *hitTri,
+                       float *tHit, float *b1Hit, float *b2Hit,
+                       bool anyHit) const;
+
+    // TiledMesh Private Data
+    string filename;
+    int fd;
+    BBox objectBound;
+    uint64_t nTris;
+    vector<TiledMeshTileInfo> tiles;
+    vector<TiledMeshNode> topNodes;
+    uint64_t maxResident;
+    mutable vector<TileSlot> slots;
+    mutable uint64_t resident, useCounter;
+    mutable uint32_t pageIns;
+    Mutex *mutex;
+};
+
+
+TiledMesh *CreateTiledMeshShape(const Transform *o2w, const Transform *w2o,
+        bool reverseOrientation, const ParamSet &params);
+
+#endif // PBRT_SHAPES_TILEDMESH_H
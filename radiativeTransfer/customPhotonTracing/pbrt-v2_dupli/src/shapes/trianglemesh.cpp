@@ -40,38 +40,57 @@ TriangleMesh::TriangleMesh(const Transform *o2w, const Transform *w2o,
     : Shape(o2w, w2o, ro), alphaTexture(atex) {
     ntris = nt;
     nverts = nv;
-    vertexIndex = new int[3 * ntris];
-    memcpy(vertexIndex, vi, 3 * ntris * sizeof(int));
     // Copy _uv_, _N_, and _S_ vertex data, if present
-    if (uv) {
-        uvs = new float[2*nverts];
-        memcpy(uvs, uv, 2*nverts*sizeof(float));
-    }
-    else uvs = NULL;
-    p = new Point[nverts];
-    if (N) {
-        n = new Normal[nverts];
-        memcpy(n, N, nverts*sizeof(Normal));
-    }
-    else n = NULL;
-    if (S) {
-        s = new Vector[nverts];
-        memcpy(s, S, nverts*sizeof(Vector));
-    }
-    else s = NULL;
+    SetArrays(new ParamSetArray<int>(vi, 3 * ntris),
+              new ParamSetArray<Point>(P, nverts),
+              N ? new ParamSetArray<Normal>(N, nverts) : NULL,
+              S ? new ParamSetArray<Vector>(S, nverts) : NULL,
+              uv ? new ParamSetArray<float>(uv, 2 * nverts) : NULL);
+}
+
+
+TriangleMesh::TriangleMesh(const Transform *o2w, const Transform *w2o,
+        bool ro, int nt, int nv, const Reference<ParamSetArray<int> > &vi,
+        const Reference<ParamSetArray<Point> > &P,
+        const Reference<ParamSetArray<Normal> > &N,
+        const Reference<ParamSetArray<Vector> > &S,
+        const Reference<ParamSetArray<float> > &uv,
+        const Reference<Texture<float> > &atex)
+    : Shape(o2w, w2o, ro), alphaTexture(atex) {
+    ntris = nt;
+    nverts = nv;
+    SetArrays(vi, P, N, S, uv);
+}
 
-    // Transform mesh vertices to world space
-    for (int i = 0; i < nverts; ++i)
-        p[i] = (*ObjectToWorld)(P[i]);
+
+void TriangleMesh::SetArrays(const Reference<ParamSetArray<int> > &vi,
+        const Reference<ParamSetArray<Point> > &P,
+        const Reference<ParamSetArray<Normal> > &N,
+        const Reference<ParamSetArray<Vector> > &S,
+        const Reference<ParamSetArray<float> > &uv) {
+    // Share vertex data arrays with the caller
+    vertexIndexArray = vi;
+    nArray = N;
+    sArray = S;
+    uvArray = uv;
+    vertexIndex = vertexIndexArray->data;
+    n = nArray ? nArray->data : NULL;
+    s = sArray ? sArray->data : NULL;
+    uvs = uvArray ? uvArray->data : NULL;
+
+    // Transform mesh vertices to world space, in place if _P_ is not shared
+    if (ObjectToWorld->IsIdentity() || P->nReferences == 1)
+        pArray = P;
+    else
+        pArray = new ParamSetArray<Point>(nverts);
+    if (!ObjectToWorld->IsIdentity())
+        for (int i = 0; i < nverts; ++i)
+            pArray->data[i] = (*ObjectToWorld)(P->data[i]);
+    p = pArray->data;
 }
 
 
 TriangleMesh::~TriangleMesh() {
-    delete[] vertexIndex;
-    delete[] p;
-    delete[] s;
-    delete[] n;
-    delete[] uvs;
 }
 
 
@@ -185,7 +204,9 @@ bool Triangle::Intersect(const Ray &ray, float *tHit, float *rayEpsilon,
 	
 
 //AJOUT POUR ABSORPTION VOLUME
-	if (PhotonImage){
+	//[DGtal sans "normal N" (Noff2Pbrt --photon), l'ordre des sommets donne
+	// deja l'orientation, comme dans _TriangleSoupPrimitive_]
+	if (PhotonImage && mesh->n){
 	Normal &normalMesh=mesh->n[v[0]];
 	if (Dot(normalMesh,Cross(dpdu,dpdv)) <0)
 	{
@@ -321,7 +342,14 @@ float Triangle::Area() const {
 void Triangle::GetShadingGeometry(const Transform &obj2world,
         const DifferentialGeometry &dg,
         DifferentialGeometry *dgShading) const {
-    if (!mesh->n && !mesh->s) {
+    mesh->GetTriangleShadingGeometry(v, obj2world, dg, dgShading);
+}
+
+
+void TriangleMesh::GetTriangleShadingGeometry(const int *v,
+        const Transform &obj2world, const DifferentialGeometry &dg,
+        DifferentialGeometry *dgShading) const {
+    if (!n && !s) {
         *dgShading = dg;
         return;
     }
@@ -332,7 +360,7 @@ void Triangle::GetShadingGeometry(const Transform &obj2world,
 
     // Initialize _A_ and _C_ matrices for barycentrics
     float uv[3][2];
-    GetUVs(uv);
+    GetTriangleUVs(v, uv);
     float A[2][2] =
         { { uv[1][0] - uv[0][0], uv[2][0] - uv[0][0] },
           { uv[1][1] - uv[0][1], uv[2][1] - uv[0][1] } };
@@ -347,13 +375,13 @@ void Triangle::GetShadingGeometry(const Transform &obj2world,
     // Use _n_ and _s_ to compute shading tangents for triangle, _ss_ and _ts_
     Normal ns;
     Vector ss, ts;
-    if (mesh->n) ns = Normalize(obj2world(b[0] * mesh->n[v[0]] +
-                                          b[1] * mesh->n[v[1]] +
-                                          b[2] * mesh->n[v[2]]));
+    if (n) ns = Normalize(obj2world(b[0] * n[v[0]] +
+                                    b[1] * n[v[1]] +
+                                    b[2] * n[v[2]]));
     else   ns = dg.nn;
-    if (mesh->s) ss = Normalize(obj2world(b[0] * mesh->s[v[0]] +
-                                          b[1] * mesh->s[v[1]] +
-                                          b[2] * mesh->s[v[2]]));
+    if (s) ss = Normalize(obj2world(b[0] * s[v[0]] +
+                                    b[1] * s[v[1]] +
+                                    b[2] * s[v[2]]));
     else   ss = Normalize(dg.dpdu);
     
     ts = Cross(ss, ns);
@@ -366,16 +394,14 @@ void Triangle::GetShadingGeometry(const Transform &obj2world,
     Normal dndu, dndv;
 
     // Compute $\dndu$ and $\dndv$ for triangle shading geometry
-    if (mesh->n) {
-        float uvs[3][2];
-        GetUVs(uvs);
+    if (n) {
         // Compute deltas for triangle partial derivatives of normal
-        float du1 = uvs[0][0] - uvs[2][0];
-        float du2 = uvs[1][0] - uvs[2][0];
-        float dv1 = uvs[0][1] - uvs[2][1];
-        float dv2 = uvs[1][1] - uvs[2][1];
-        Normal dn1 = mesh->n[v[0]] - mesh->n[v[2]];
-        Normal dn2 = mesh->n[v[1]] - mesh->n[v[2]];
+        float du1 = uv[0][0] - uv[2][0];
+        float du2 = uv[1][0] - uv[2][0];
+        float dv1 = uv[0][1] - uv[2][1];
+        float dv2 = uv[1][1] - uv[2][1];
+        Normal dn1 = n[v[0]] - n[v[2]];
+        Normal dn2 = n[v[1]] - n[v[2]];
         float determinant = du1 * dv2 - dv1 * du2;
         if (determinant == 0.f)
             dndu = dndv = Normal(0,0,0);
@@ -390,6 +416,7 @@ void Triangle::GetShadingGeometry(const Transform &obj2world,
     *dgShading = DifferentialGeometry(dg.p, ss, ts,
         (*ObjectToWorld)(dndu), (*ObjectToWorld)(dndv),
         dg.u, dg.v, dg.shape);
+    dgShading->faceIndex = dg.faceIndex;
     dgShading->dudx = dg.dudx;  dgShading->dvdx = dg.dvdx;
     dgShading->dudy = dg.dudy;  dgShading->dvdy = dg.dvdy;
     dgShading->dpdx = dg.dpdx;  dgShading->dpdy = dg.dpdy;
@@ -464,8 +491,17 @@ TriangleMesh *CreateTriangleMeshShape(const Transform *o2w, const Transform *w2o
     }
     else if (params.FindOneFloat("alpha", 1.f) == 0.f)
         alphaTex = new ConstantTexture<float>(0.f);
-    return new TriangleMesh(o2w, w2o, reverseOrientation, nvi/3, npi, vi, P,
-        N, S, uvs, alphaTex);
+    // Share the parameter arrays with the mesh instead of copying them
+    Reference<ParamSetArray<float> > uvArray = params.FindFloatArray("uv");
+    if (!uvArray) uvArray = params.FindFloatArray("st");
+    if (!uvs) uvArray = NULL;
+    Reference<ParamSetArray<Vector> > sArray;
+    if (S) sArray = params.FindVectorArray("S");
+    Reference<ParamSetArray<Normal> > nArray;
+    if (N) nArray = params.FindNormalArray("N");
+    return new TriangleMesh(o2w, w2o, reverseOrientation, nvi/3, npi,
+        params.FindIntArray("indices"), params.FindPointArray("P"),
+        nArray, sArray, uvArray, alphaTex);
 }
 
 
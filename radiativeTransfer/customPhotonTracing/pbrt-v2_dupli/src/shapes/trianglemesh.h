@@ -30,6 +30,7 @@
 
 // shapes/trianglemesh.h*
 #include "shape.h"
+#include "paramset.h"
 #include <map>
 using std::map;
 
@@ -41,14 +42,48 @@ public:
                  int ntris, int nverts, const int *vptr,
                  const Point *P, const Normal *N, const Vector *S,
                  const float *uv, const Reference<Texture<float> > &atex);
+    TriangleMesh(const Transform *o2w, const Transform *w2o, bool ro,
+                 int ntris, int nverts,
+                 const Reference<ParamSetArray<int> > &vi,
+                 const Reference<ParamSetArray<Point> > &P,
+                 const Reference<ParamSetArray<Normal> > &N,
+                 const Reference<ParamSetArray<Vector> > &S,
+                 const Reference<ParamSetArray<float> > &uv,
+                 const Reference<Texture<float> > &atex);
     ~TriangleMesh();
     BBox ObjectBound() const;
     BBox WorldBound() const;
     bool CanIntersect() const { return false; }
     void Refine(vector<Reference<Shape> > &refined) const;
+    void GetTriangleUVs(const int *v, float uv[3][2]) const {
+        if (uvs) {
+            uv[0][0] = uvs[2*v[0]];
+            uv[0][1] = uvs[2*v[0]+1];
+            uv[1][0] = uvs[2*v[1]];
+            uv[1][1] = uvs[2*v[1]+1];
+            uv[2][0] = uvs[2*v[2]];
+            uv[2][1] = uvs[2*v[2]+1];
+        }
+        else {
+            uv[0][0] = 0.; uv[0][1] = 0.;
+            uv[1][0] = 1.; uv[1][1] = 0.;
+            uv[2][0] = 1.; uv[2][1] = 1.;
+        }
+    }
+    void GetTriangleShadingGeometry(const int *v, const Transform &obj2world,
+            const DifferentialGeometry &dg,
+            DifferentialGeometry *dgShading) const;
     friend class Triangle;
+    friend class TriangleSoupPrimitive;
     template <typename T> friend class VertexTexture;
 protected:
+    // TriangleMesh Protected Methods
+    void SetArrays(const Reference<ParamSetArray<int> > &vi,
+                   const Reference<ParamSetArray<Point> > &P,
+                   const Reference<ParamSetArray<Normal> > &N,
+                   const Reference<ParamSetArray<Vector> > &S,
+                   const Reference<ParamSetArray<float> > &uv);
+
     // TriangleMesh Protected Data
     int ntris, nverts;
     int *vertexIndex;
@@ -56,6 +91,13 @@ protected:
     Normal *n;
     Vector *s;
     float *uvs;
+    //[DGtal tableaux qui portent les donnees ci-dessus ; partages avec le
+    // ParamSet de la forme quand elle est creee par CreateTriangleMeshShape]
+    Reference<ParamSetArray<int> > vertexIndexArray;
+    Reference<ParamSetArray<Point> > pArray;
+    Reference<ParamSetArray<Normal> > nArray;
+    Reference<ParamSetArray<Vector> > sArray;
+    Reference<ParamSetArray<float> > uvArray;
     Reference<Texture<float> > alphaTexture;
 };
 
@@ -76,19 +118,7 @@ public:
                    DifferentialGeometry *dg) const;
     bool IntersectP(const Ray &ray) const;
     void GetUVs(float uv[3][2]) const {
-        if (mesh->uvs) {
-            uv[0][0] = mesh->uvs[2*v[0]];
-            uv[0][1] = mesh->uvs[2*v[0]+1];
-            uv[1][0] = mesh->uvs[2*v[1]];
-            uv[1][1] = mesh->uvs[2*v[1]+1];
-            uv[2][0] = mesh->uvs[2*v[2]];
-            uv[2][1] = mesh->uvs[2*v[2]+1];
-        }
-        else {
-            uv[0][0] = 0.; uv[0][1] = 0.;
-            uv[1][0] = 1.; uv[1][1] = 0.;
-            uv[2][0] = 1.; uv[2][1] = 1.;
-        }
+        mesh->GetTriangleUVs(v, uv);
     }
     float Area() const;
     virtual void GetShadingGeometry(const Transform &obj2world,
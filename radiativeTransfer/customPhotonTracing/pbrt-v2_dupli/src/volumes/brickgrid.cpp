@@ -0,0 +1,339 @@
+
+/*
+    pbrt source code Copyright(c) 1998-2010 Matt Pharr and Greg Humphreys.
+
+    This file is part of pbrt.
+
+    pbrt is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.  Note that the text contents of
+    the book "Physically Based Rendering" are *not* licensed under the
+    GNU GPL.
+
+    pbrt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+// volumes/brickgrid.cpp*
+#include "stdafx.h"
+#include "volumes/brickgrid.h"
+#include "paramset.h"
+#include "parallel.h"
+#include "fileutil.h"
+#if !defined(PBRT_IS_WINDOWS)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// BrickGridDensity Local Declarations
+class BrickGridBuildTask : public Task {
+public:
+    BrickGridBuildTask(BrickGridDensity *g, int z, const void *v, float s,
+                       float t)
+        : grid(g), brickZ(z), voxels((const uint8_t *)v), scale(s),
+          threshold(t) { }
+    void Run();
+    float Voxel(int x, int y, int z) const {
+        uint64_t i = (uint64_t(z) * grid->ny + y) * grid->nx + x;
+        float v;
+        if (grid->floatVoxels) memcpy(&v, voxels + 4 * i, sizeof(float));
+        else v = voxels[i];
+        return v > threshold ? v : 0.f;
+    }
+
+    BrickGridDensity *grid;
+    int brickZ;
+    const uint8_t *voxels;
+    float scale, threshold;
+    // Payload of the non-constant bricks of this layer, offsets are local
+    vector<uint8_t> bytes;
+    vector<float> floats;
+    uint32_t nStored;
+};
+
+
+void BrickGridBuildTask::Run() {
+    const int S = BRICKGRID_SIZE;
+    float values[BRICKGRID_VOXELS];
+    nStored = 0;
+    int z0 = brickZ * S, z1 = min(z0 + S, grid->nz);
+    for (int by = 0; by < grid->by; ++by) {
+        int y0 = by * S, y1 = min(y0 + S, grid->ny);
+        for (int bx = 0; bx < grid->bx; ++bx) {
+            int x0 = bx * S, x1 = min(x0 + S, grid->nx);
+            int b = grid->Brick(bx, by, brickZ);
+            // Gather brick voxels and check whether the brick is constant
+            float vmin = INFINITY, vmax = -INFINITY;
+            for (int i = 0; i < BRICKGRID_VOXELS; ++i) values[i] = 0.f;
+            for (int z = z0; z < z1; ++z)
+                for (int y = y0; y < y1; ++y)
+                    for (int x = x0; x < x1; ++x) {
+                        float v = Voxel(x, y, z);
+                        values[((z-z0) * S + (y-y0)) * S + (x-x0)] = v;
+                        vmin = min(vmin, v);
+                        vmax = max(vmax, v);
+                    }
+            if (vmin == vmax) {
+                grid->brickOffset[b] = -1;
+                grid->brickValue[b] = grid->floatVoxels ? scale * vmin :
+                                                          grid->byteScale * vmin;
+            }
+            else {
+                grid->brickOffset[b] = nStored++;
+                grid->brickValue[b] = 0.f;
+                for (int i = 0; i < BRICKGRID_VOXELS; ++i) {
+                    if (grid->floatVoxels) floats.push_back(scale * values[i]);
+                    else bytes.push_back(uint8_t(values[i]));
+                }
+            }
+
+            // Bound density over the interpolation footprint of the brick
+            float m = 0.f;
+            int zs = max(z0 - 1, 0), ze = min(z1 + 1, grid->nz);
+            int ys = max(y0 - 1, 0), ye = min(y1 + 1, grid->ny);
+            int xs = max(x0 - 1, 0), xe = min(x1 + 1, grid->nx);
+            for (int z = zs; z < ze; ++z)
+                for (int y = ys; y < ye; ++y)
+                    for (int x = xs; x < xe; ++x)
+                        m = max(m, Voxel(x, y, z));
+            grid->brickMax[b] = grid->floatVoxels ? scale * m :
+                                                    grid->byteScale * m;
+        }
+    }
+}
+
+
+
+// BrickGridDensity Method Definitions
+BrickGridDensity::BrickGridDensity(const Spectrum &sa, const Spectrum &ss,
+        float gg, const Spectrum &emit, const BBox &e, const Transform &v2w,
+        int x, int y, int z, const void *voxels, bool fv, float scale,
+        float threshold)
+    : DensityRegion(sa, ss, gg, emit, v2w), nx(x), ny(y), nz(z), extent(e) {
+    floatVoxels = fv;
+    byteScale = scale;
+    bx = (nx + BRICKGRID_SIZE - 1) / BRICKGRID_SIZE;
+    by = (ny + BRICKGRID_SIZE - 1) / BRICKGRID_SIZE;
+    bz = (nz + BRICKGRID_SIZE - 1) / BRICKGRID_SIZE;
+    int nBricks = bx * by * bz;
+    brickOffset.resize(nBricks);
+    brickValue.resize(nBricks);
+    brickMax.resize(nBricks);
+
+    // Split voxels into bricks, one task per layer of bricks
+    vector<BrickGridBuildTask *> layers;
+    vector<Task *> tasks;
+    for (int i = 0; i < bz; ++i) {
+        layers.push_back(new BrickGridBuildTask(this, i, voxels, scale,
+                                                threshold));
+        tasks.push_back(layers.back());
+    }
+    RunTasks(tasks);
+
+    // Concatenate the layers payloads and rebase brick offsets
+    uint32_t nStored = 0;
+    for (int i = 0; i < bz; ++i)
+        nStored += layers[i]->nStored;
+    if (floatVoxels) floatData.reserve(size_t(nStored) * BRICKGRID_VOXELS);
+    else byteData.reserve(size_t(nStored) * BRICKGRID_VOXELS);
+    uint32_t base = 0;
+    for (int i = 0; i < bz; ++i) {
+        BrickGridBuildTask *l = layers[i];
+        for (int b = i * bx * by; b < (i + 1) * bx * by; ++b)
+            if (brickOffset[b] >= 0) brickOffset[b] += base;
+        base += l->nStored;
+        floatData.insert(floatData.end(), l->floats.begin(), l->floats.end());
+        byteData.insert(byteData.end(), l->bytes.begin(), l->bytes.end());
+        delete l;
+    }
+    int nEmpty = 0;
+    for (int b = 0; b < nBricks; ++b)
+        if (brickMax[b] == 0.f) ++nEmpty;
+    Info("Brick grid %dx%dx%d: %d bricks, %d empty, %u stored (%.1f MB)",
+         nx, ny, nz, nBricks, nEmpty, nStored,
+         float(nStored) * BRICKGRID_VOXELS * (floatVoxels ? 4 : 1) /
+         (1024.f * 1024.f));
+}
+
+
+float BrickGridDensity::Density(const Point &Pobj) const {
+    if (!extent.Inside(Pobj)) return 0;
+    // Compute voxel coordinates and offsets for _Pobj_
+    Vector vox = extent.Offset(Pobj);
+    vox.x = vox.x * nx;
+    vox.y = vox.y * ny;
+    vox.z = vox.z * nz;
+    int b = Brick(Clamp(Floor2Int(vox.x) >> BRICKGRID_LOG2_SIZE, 0, bx-1),
+                  Clamp(Floor2Int(vox.y) >> BRICKGRID_LOG2_SIZE, 0, by-1),
+                  Clamp(Floor2Int(vox.z) >> BRICKGRID_LOG2_SIZE, 0, bz-1));
+    if (brickMax[b] == 0.f) return 0;
+    vox.x -= .5f;
+    vox.y -= .5f;
+    vox.z -= .5f;
+    int vx = Floor2Int(vox.x), vy = Floor2Int(vox.y), vz = Floor2Int(vox.z);
+    float dx = vox.x - vx, dy = vox.y - vy, dz = vox.z - vz;
+
+    // Trilinearly interpolate density values to compute local density
+    float d00 = Lerp(dx, D(vx, vy, vz),     D(vx+1, vy, vz));
+    float d10 = Lerp(dx, D(vx, vy+1, vz),   D(vx+1, vy+1, vz));
+    float d01 = Lerp(dx, D(vx, vy, vz+1),   D(vx+1, vy, vz+1));
+    float d11 = Lerp(dx, D(vx, vy+1, vz+1), D(vx+1, vy+1, vz+1));
+    float d0 = Lerp(dy, d00, d10);
+    float d1 = Lerp(dy, d01, d11);
+    return Lerp(dz, d0, d1);
+}
+
+
+Spectrum BrickGridDensity::tau(const Ray &r, float stepSize, float u) const {
+    float t0, t1;
+    float length = r.d.Length();
+    if (length == 0.f) return 0.f;
+    Ray rn(r.o, r.d / length, r.mint * length, r.maxt * length, r.time);
+    if (!IntersectP(rn, &t0, &t1)) return 0.;
+
+    // Set up 3D DDA over bricks for the volume space ray
+    Ray vr = WorldToVolume(rn);
+    Point p = vr(t0);
+    int n[3] = { nx, ny, nz }, nb[3] = { bx, by, bz };
+    int pos[3], step[3], out[3];
+    float nextT[3], deltaT[3];
+    for (int a = 0; a < 3; ++a) {
+        float w = (extent.pMax[a] - extent.pMin[a]) * BRICKGRID_SIZE / n[a];
+        pos[a] = Clamp(Floor2Int((p[a] - extent.pMin[a]) / w), 0, nb[a] - 1);
+        if (vr.d[a] == 0.f) {
+            nextT[a] = INFINITY;
+            deltaT[a] = INFINITY;
+            step[a] = 0;
+            out[a] = -1;
+        }
+        else if (vr.d[a] > 0.f) {
+            nextT[a] = t0 + (extent.pMin[a] + (pos[a] + 1) * w - p[a]) / vr.d[a];
+            deltaT[a] = w / vr.d[a];
+            step[a] = 1;
+            out[a] = nb[a];
+        }
+        else {
+            nextT[a] = t0 + (extent.pMin[a] + pos[a] * w - p[a]) / vr.d[a];
+            deltaT[a] = -w / vr.d[a];
+            step[a] = -1;
+            out[a] = -1;
+        }
+    }
+
+    // March through the bricks, sampling only those with nonzero density
+    Spectrum tau(0.);
+    float t = t0 + u * stepSize;
+    for (;;) {
+        int axis = (nextT[0] < nextT[1]) ? (nextT[0] < nextT[2] ? 0 : 2) :
+                                           (nextT[1] < nextT[2] ? 1 : 2);
+        float tExit = min(nextT[axis], t1);
+        if (brickMax[Brick(pos[0], pos[1], pos[2])] > 0.f) {
+            while (t < tExit) {
+                tau += sigma_t(rn(t), -rn.d, r.time);
+                t += stepSize;
+            }
+        }
+        else if (t < tExit)
+            t += Ceil2Int((tExit - t) / stepSize) * stepSize;
+        if (tExit >= t1) break;
+        pos[axis] += step[axis];
+        if (pos[axis] == out[axis]) break;
+        nextT[axis] += deltaT[axis];
+    }
+    return tau * stepSize;
+}
+
+
+BrickGridDensity *CreateBrickGridVolumeRegion(const Transform &volume2world,
+        const ParamSet &params) {
+    // Initialize common volume region parameters
+    Spectrum sigma_a = params.FindOneSpectrum("sigma_a", 0.);
+    Spectrum sigma_s = params.FindOneSpectrum("sigma_s", 0.);
+    float g = params.FindOneFloat("g", 0.);
+    Spectrum Le = params.FindOneSpectrum("Le", 0.);
+    string filename = params.FindOneString("filename", "");
+    if (filename == "") {
+        Error("No \"filename\" provided for \"brickgrid\" volume");
+        return NULL;
+    }
+    filename = AbsolutePath(ResolveFilename(filename));
+#if defined(PBRT_IS_WINDOWS)
+    Error("\"brickgrid\" volumes are not supported on Windows");
+    return NULL;
+#else
+    // Map voxel file in memory
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        Error("Unable to open voxel file \"%s\"", filename.c_str());
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    size_t length = st.st_size;
+    void *map = length > 0 ? mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0)
+                           : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        Error("Unable to map voxel file \"%s\"", filename.c_str());
+        return NULL;
+    }
+    const char *data = (const char *)map;
+
+    // Read grid resolution from the _.vol_ header, or from the parameters
+    int nx = params.FindOneInt("nx", 1);
+    int ny = params.FindOneInt("ny", 1);
+    int nz = params.FindOneInt("nz", 1);
+    size_t headerBytes = params.FindOneInt("headerbytes", 0);
+    bool floatVoxels = params.FindOneString("voxeltype", "uint8") == "float";
+    bool vol = filename.size() > 4 &&
+        filename.compare(filename.size() - 4, 4, ".vol") == 0;
+    if (vol) {
+        // DGtal _.vol_: "Key: value" lines ended by a "." line, then uint8
+        floatVoxels = false;
+        headerBytes = 0;
+        while (headerBytes < length) {
+            const char *line = data + headerBytes;
+            const char *eol = (const char *)memchr(line, '\n', length - headerBytes);
+            if (!eol) break;
+            headerBytes = eol + 1 - data;
+            string key(line, eol - line);
+            if (key == ".") break;
+            if (key.compare(0, 3, "X: ") == 0) nx = atoi(key.c_str() + 3);
+            else if (key.compare(0, 3, "Y: ") == 0) ny = atoi(key.c_str() + 3);
+            else if (key.compare(0, 3, "Z: ") == 0) nz = atoi(key.c_str() + 3);
+        }
+    }
+    size_t voxelBytes = (floatVoxels ? 4 : 1);
+    if (nx <= 0 || ny <= 0 || nz <= 0 ||
+        headerBytes + voxelBytes * nx * ny * nz > length) {
+        Error("Voxel file \"%s\" is too short for %dx%dx%d voxels",
+              filename.c_str(), nx, ny, nz);
+        munmap(map, length);
+        return NULL;
+    }
+    madvise(map, length, MADV_SEQUENTIAL);
+
+    float scale = params.FindOneFloat("densityscale",
+                                      floatVoxels ? 1.f : 1.f / 255.f);
+    float threshold = params.FindOneFloat("threshold", 0.f);
+    Point p0 = params.FindOnePoint("p0", Point(0, 0, 0));
+    Point p1 = params.FindOnePoint("p1", Point(nx, ny, nz));
+    BrickGridDensity *grid = new BrickGridDensity(sigma_a, sigma_s, g, Le,
+        BBox(p0, p1), volume2world, nx, ny, nz, data + headerBytes,
+        floatVoxels, scale, threshold);
+    munmap(map, length);
+    return grid;
+#endif
+}
+
+
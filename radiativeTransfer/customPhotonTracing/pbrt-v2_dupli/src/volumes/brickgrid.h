@@ -0,0 +1,97 @@
+
+/*
+    pbrt source code Copyright(c) 1998-2010 Matt Pharr and Greg Humphreys.
+
+    This file is part of pbrt.
+
+    pbrt is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.  Note that the text contents of
+    the book "Physically Based Rendering" are *not* licensed under the
+    GNU GPL.
+
+    pbrt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef PBRT_VOLUMES_BRICKGRID_H
+#define PBRT_VOLUMES_BRICKGRID_H
+
+// volumes/brickgrid.h*
+#include "volume.h"
+
+//[DGtal milieu participant lu directement dans un fichier .vol (DGtal) ou
+// un fichier brut (uint8 ou float), projete en memoire (mmap) le temps du
+// chargement, et range par briques de 8^3 voxels :
+//   - les briques constantes (air, interieur des grains) ne stockent que
+//     leur valeur ;
+//   - les autres stockent leurs 512 voxels, au format du fichier.
+// Chaque brique garde un majorant de la densite interpolee dans son
+// domaine : Density() sort tout de suite dans les briques vides, et tau()
+// parcourt les briques par DDA sans echantillonner celles de majorant nul.]
+#define BRICKGRID_LOG2_SIZE 3
+#define BRICKGRID_SIZE (1 << BRICKGRID_LOG2_SIZE)
+#define BRICKGRID_VOXELS (BRICKGRID_SIZE * BRICKGRID_SIZE * BRICKGRID_SIZE)
+
+// BrickGridDensity Declarations
+class BrickGridDensity : public DensityRegion {
+public:
+    // BrickGridDensity Public Methods
+    BrickGridDensity(const Spectrum &sa, const Spectrum &ss, float gg,
+            const Spectrum &emit, const BBox &e, const Transform &v2w,
+            int x, int y, int z, const void *voxels, bool floatVoxels,
+            float scale, float threshold);
+    BBox WorldBound() const { return Inverse(WorldToVolume)(extent); }
+    bool IntersectP(const Ray &r, float *t0, float *t1) const {
+        Ray ray = WorldToVolume(r);
+        return extent.IntersectP(ray, t0, t1);
+    }
+    float Density(const Point &Pobj) const;
+    Spectrum tau(const Ray &r, float stepSize, float offset) const;
+    float D(int x, int y, int z) const {
+        x = Clamp(x, 0, nx-1);
+        y = Clamp(y, 0, ny-1);
+        z = Clamp(z, 0, nz-1);
+        int b = Brick(x >> BRICKGRID_LOG2_SIZE, y >> BRICKGRID_LOG2_SIZE,
+                      z >> BRICKGRID_LOG2_SIZE);
+        int32_t offset = brickOffset[b];
+        if (offset < 0) return brickValue[b];
+        const int m = BRICKGRID_SIZE - 1;
+        uint32_t v = uint32_t(offset) * BRICKGRID_VOXELS +
+            ((((z & m) << BRICKGRID_LOG2_SIZE) + (y & m)) << BRICKGRID_LOG2_SIZE) +
+            (x & m);
+        return floatVoxels ? floatData[v] : byteScale * byteData[v];
+    }
+private:
+    // BrickGridDensity Private Methods
+    int Brick(int x, int y, int z) const { return (z * by + y) * bx + x; }
+
+    // BrickGridDensity Private Data
+    const int nx, ny, nz;
+    int bx, by, bz;
+    const BBox extent;
+    bool floatVoxels;
+    float byteScale;
+    vector<int32_t> brickOffset;   // -1 for constant bricks
+    vector<float> brickValue, brickMax;
+    vector<uint8_t> byteData;
+    vector<float> floatData;
+    friend class BrickGridBuildTask;
+};
+
+
+BrickGridDensity *CreateBrickGridVolumeRegion(const Transform &volume2world,
+        const ParamSet &params);
+
+#endif // PBRT_VOLUMES_BRICKGRID_H
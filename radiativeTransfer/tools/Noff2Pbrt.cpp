@@ -5,17 +5,34 @@
 #include <cctype>
 #include <cstring>
 #include <algorithm>
+#include <vector>
+#include <sstream>
+#include <cstdio>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <cmath>
 
 
 using namespace std;
-//variables globales qui cernent la bounding box
-double minX(0), maxX(0), minY(0), maxY(0), minZ(0), maxZ(0);
+
+#include "scenePbrt.h"
+#include "tuilesPbrt.h"
+
+//nombre de threads qui lisent le fichier noff (0 : un par coeur)
+int nThreads(0);
 
 void ecritFichierGeometrie(string fichierNoff, string fichierGeomPbrt);
 
-void ecritFichierPbrt(string fichierPbrt, string fichierGeomPbrt, string fichierEXR);
+void ecritFichierGeometriePhoton(string fichierNoff, string fichierGeomPbrt);
+
+void ecritFichierTuiles(string fichierNoff, string fichierTuiles, string fichierGeomPbrt, int nTuiles);
+
+void ecritFichierMorceaux(string fichierNoff, string fichier_sortie, string fichierGeomPbrt, int nMorceaux);
 
-void ecritFichierPhoton(string fichierPhoton, string fichierGeomPbrt);
 
 
 
@@ -30,12 +47,25 @@ int main(int argc, char *argv[])
 
   string fichierNoff, fichier_sortie;
   bool entre(false), sortie(false);
+  //nombre de tuiles par axe pour le maillage hors memoire (0 : fichier pbrt classique)
+  int nTuiles(0);
+  //nombre de fichiers de geometrie lus en parallele par pbrt (0 : un seul fichier)
+  int nMorceaux(0);
+  //duree en secondes du rendu progressif de l'image (0 : rendu complet)
+  float tempsApercu(0);
+  //geometrie reduite pour le lanceur de photons seulement
+  bool photonSeul(false);
 
 
   for (int i=1; i<argc;i++){
-    if (!strcmp(argv[i],"--help") || !strcmp(argv[i],"--help")){cout << "syntax : <command> -i input.noff -o output\n"; return 0;}
+    if (!strcmp(argv[i],"--help") || !strcmp(argv[i],"--help")){cout << "syntax : <command> -i input.noff -o output [--tiles n | --shards n | --photon] [--preview seconds] [--threads n]\n"; return 0;}
     else if (!strcmp(argv[i],"--input") || !strcmp(argv[i],"-i")) {fichierNoff=argv[++i]; entre=true;}
     else if (!strcmp(argv[i],"--output") || !strcmp(argv[i],"-o")) {fichier_sortie=argv[++i]; sortie=true;}
+    else if (!strcmp(argv[i],"--tiles") || !strcmp(argv[i],"-t")) {nTuiles=atoi(argv[++i]);}
+    else if (!strcmp(argv[i],"--shards") || !strcmp(argv[i],"-s")) {nMorceaux=atoi(argv[++i]);}
+    else if (!strcmp(argv[i],"--preview") || !strcmp(argv[i],"-p")) {tempsApercu=atof(argv[++i]);}
+    else if (!strcmp(argv[i],"--threads") || !strcmp(argv[i],"-j")) {nThreads=atoi(argv[++i]);}
+    else if (!strcmp(argv[i],"--photon")) photonSeul=true;
   }
 
   if (!entre || !sortie) 
@@ -43,6 +73,11 @@ int main(int argc, char *argv[])
       cout << "syntax : <command> -i input.noff -o output\n"; 
       exit(1);
     }
+  if (photonSeul && (nTuiles>0 || nMorceaux>1))
+    {
+      cout << "--photon cannot be used with --tiles or --shards\n";
+      exit(1);
+    }
   //on prend en entrée un fichier noff et on sort 2 fichier : un de geometrie et le corps du fichier .pbrt
 
 
@@ -58,9 +93,16 @@ int main(int argc, char *argv[])
   fichierEXR+=".exr";
 
 
-  ecritFichierGeometrie(fichierNoff, fichierGeomPbrt);
+  if (nTuiles>0)
+    ecritFichierTuiles(fichierNoff, fichier_sortie+"Geometry.tiles", fichierGeomPbrt, nTuiles);
+  else if (nMorceaux>1)
+    ecritFichierMorceaux(fichierNoff, fichier_sortie, fichierGeomPbrt, nMorceaux);
+  else if (photonSeul)
+    ecritFichierGeometriePhoton(fichierNoff, fichierGeomPbrt);
+  else
+    ecritFichierGeometrie(fichierNoff, fichierGeomPbrt);
 
-  ecritFichierPbrt(fichierPbrt,fichierGeomPbrt,fichierEXR);
+  ecritFichierPbrt(fichierPbrt,fichierGeomPbrt,fichierEXR,tempsApercu);
 
   ecritFichierPhoton(fichierPhoton, fichierGeomPbrt);
 
@@ -70,162 +112,600 @@ int main(int argc, char *argv[])
 }
 
 
-//la fonction qui ecrit le fichier de geometrie
+//la lecture du fichier noff se fait sans flux ni fichier temporaire : le
+//fichier est projete en memoire et decoupe en morceaux de lignes entieres ;
+//chaque thread lit un morceau, met en forme sa partie du fichier de geometrie
+//dans son propre tampon et calcule sa bounding box, puis les tampons sont
+//ecrits dans l'ordre
 
-void ecritFichierGeometrie(string fichierNoff, string fichierGeomPbrt)
+//taille (en octets du fichier noff) d'un morceau lu par un thread
+const size_t tailleMorceau=4<<20;
+
+static inline bool estBlanc(char c)
 {
+  return c==' ' || c=='\n' || c=='\t' || c=='\r' || c=='\v' || c=='\f';
+}
 
+static inline const char *sauteBlancs(const char *p, const char *fin)
+{
+  while (p<fin && estBlanc(*p)) p++;
+  return p;
+}
 
-  ifstream fichierEntree(fichierNoff.c_str());
-  ofstream fichierSortieGeom(fichierGeomPbrt.c_str());
+//lit un entier, renvoie NULL si le texte n'en est pas un
+static inline const char *litEntier(const char *p, const char *fin, int &v)
+{
+  p=sauteBlancs(p,fin);
+  bool negatif(false);
+  if (p<fin && (*p=='-' || *p=='+')) negatif=(*p++=='-');
+  if (p==fin || !isdigit(*p)) return NULL;
+  long n(0);
+  while (p<fin && isdigit(*p)) n=10*n+(*p++-'0');
+  v=negatif ? -n : n;
+  return p;
+}
+
+//lit un reel, renvoie NULL si le texte n'en est pas un. Quand la mantisse
+//(< 2^24) et la puissance de 10 (<= 10^10) sont exactes en float, une seule
+//operation donne le float correctement arrondi, comme >> ; sinon strtof
+static inline const char *litReel(const char *p, const char *fin, float &v)
+{
+  static const float puissances[11]={1e0f,1e1f,1e2f,1e3f,1e4f,1e5f,1e6f,1e7f,1e8f,1e9f,1e10f};
+  p=sauteBlancs(p,fin);
+  const char *debut=p;
+  bool negatif(false), exact(true), chiffre(false);
+  if (p<fin && (*p=='-' || *p=='+')) negatif=(*p++=='-');
+  uint32_t mantisse(0);
+  int exposant(0);
+  while (p<fin && isdigit(*p)){
+    if (exact && mantisse<(1<<24)) mantisse=10*mantisse+(*p-'0');
+    if (mantisse>=(1<<24)) exact=false;
+    p++; chiffre=true;
+  }
+  if (p<fin && *p=='.'){
+    p++;
+    while (p<fin && isdigit(*p)){
+      if (exact && mantisse<(1<<24)) mantisse=10*mantisse+(*p-'0');
+      if (mantisse>=(1<<24)) exact=false;
+      exposant--; p++; chiffre=true;
+    }
+  }
+  if (!chiffre) exact=false;
+  if (p<fin && (*p=='e' || *p=='E')){
+    const char *q=p+1;
+    bool negatifExposant(false);
+    if (q<fin && (*q=='-' || *q=='+')) negatifExposant=(*q++=='-');
+    if (q<fin && isdigit(*q)){
+      int e(0);
+      while (q<fin && isdigit(*q)){ if (e<10000) e=10*e+(*q-'0'); q++; }
+      exposant+=negatifExposant ? -e : e;
+      p=q;
+    }
+  }
+  if (exact && (p==fin || estBlanc(*p)) && exposant>=-10 && exposant<=10){
+    float f=(float)mantisse;
+    f=exposant<0 ? f/puissances[-exposant] : f*puissances[exposant];
+    v=negatif ? -f : f;
+    return p;
+  }
+  //cas general (beaucoup de chiffres, inf, nan...)
+  char tampon[64];
+  size_t n(0);
+  for (const char *q=debut; q<fin && !estBlanc(*q) && n<sizeof(tampon)-1; q++) tampon[n++]=*q;
+  tampon[n]=0;
+  char *finLu;
+  v=strtof(tampon,&finLu);
+  if (finLu==tampon) return NULL;
+  return debut+(finLu-tampon);
+}
 
+//comptage des lignes d'une zone du fichier
+struct ZoneLignes {
+  const char *debut, *fin;
+  uint64_t nombre;
+};
 
+void *compteLignes(void *arg)
+{
+  ZoneLignes &z=*(ZoneLignes *)arg;
+  z.nombre=0;
+  for (const char *p=z.debut; (p=(const char *)memchr(p,'\n',z.fin-p)); p++) z.nombre++;
+  return NULL;
+}
 
-  //on a 2 fichiers temporaires qui contiennent les points et les vecteurs normaux
-  ofstream fichierPoint("pointTemp.txt");
-  ofstream fichierVecteur("vecteurTemp.txt");
+//positions[i] : debut de la ligne numero lignes[i] (croissants) comptee a partir de debut
+void chercheLignes(const char *debut, const char *fin, const uint64_t *lignes, const char **positions, int nLignes, int n)
+{
+  vector<ZoneLignes> zones(n);
+  for (int i=0;i<n;i++){
+    zones[i].debut=debut+(fin-debut)*i/n;
+    zones[i].fin=debut+(fin-debut)*(i+1)/n;
+  }
+  executeEnParallele(&zones[0], n, compteLignes);
+  int l(0);
+  while (l<nLignes && lignes[l]==0) positions[l++]=debut;
+  uint64_t avant(0);
+  for (int z=0; z<n && l<nLignes; z++){
+    if (lignes[l]<=avant+zones[z].nombre){
+      uint64_t compte(avant);
+      for (const char *p=zones[z].debut; l<nLignes && (p=(const char *)memchr(p,'\n',zones[z].fin-p)); ){
+	p++; compte++;
+	while (l<nLignes && lignes[l]==compte) positions[l++]=p;
+      }
+    }
+    avant+=zones[z].nombre;
+  }
+  //fichier qui ne finit pas par un retour a la ligne
+  for (; l<nLignes; l++) positions[l]=fin;
+}
 
-  //initialisation des variables : nombrePoints et nombreFaces sont explicites
-  //nombreVertex sert pour compter le nombre de sommets d'une face
-  //min et max servent à calculer la bounding box
-  string ligne;
-  int i(0),j(0),nombrePoints(0), nombreFaces(0), nombreVertex(0);
-  size_t pos1;
-  string a;
-  char b;
-  int indice(0), indice1(0);
-  float point[3], vecteur[3];
 
-  //on se place à l'entrée du fichier et on saute les commentaires
+//un morceau de la liste des sommets : ses points et ses normales retournees
+//mises en forme, et sa bounding box
+struct MorceauSommets {
+  const char *debut, *fin;
+  string points, normales;
+  uint64_t nombre;
+  float bornes[2][3];
+  bool erreur;
+};
 
-  fichierEntree.seekg(0,ios::beg);
-  while (true)
-    {	
-      fichierEntree >> a;
-      if (isdigit(a.c_str()[0])) break;
-      else if (a.c_str()[0]=='#')
-	{
-	  fichierEntree.get(b);
-	  if (b!='\n') getline(fichierEntree,ligne);
-	}
+void *litSommets(void *arg)
+{
+  MorceauSommets &m=*(MorceauSommets *)arg;
+  m.nombre=0;
+  m.erreur=false;
+  for (int k=0;k<3;k++){ m.bornes[0][k]=INFINITY; m.bornes[1][k]=-INFINITY; }
+  m.points.reserve(m.fin-m.debut);
+  m.normales.reserve(m.fin-m.debut);
+  const char *p=m.debut;
+  float sommet[6];
+  while (sauteBlancs(p,m.fin)<m.fin)
+    {
+      for (int k=0;k<6;k++)
+	if (!(p=litReel(p,m.fin,sommet[k]))){ m.erreur=true; return NULL; }
+      for (int k=0;k<3;k++){
+	if (sommet[k]<m.bornes[0][k]) m.bornes[0][k]=sommet[k];
+	if (sommet[k]>m.bornes[1][k]) m.bornes[1][k]=sommet[k];
+	ajouteReel(m.points,sommet[k]);
+	m.points+=(k<2 ? ' ' : '\n');
+	ajouteReel(m.normales,-sommet[3+k]);
+	m.normales+=(k<2 ? ' ' : '\n');
+      }
+      m.nombre++;
     }
+  return NULL;
+}
+
 
+//un morceau de la liste des faces, triangulees en eventail
+struct MorceauFaces {
+  const char *debut, *fin;
+  string indices;
+  uint64_t nombre;
+  bool erreur;
+};
+
+void *litFaces(void *arg)
+{
+  MorceauFaces &m=*(MorceauFaces *)arg;
+  m.nombre=0;
+  m.erreur=false;
+  m.indices.reserve(m.fin-m.debut);
+  const char *p=m.debut;
+  int nombreVertex, indice, indice1;
+  while (sauteBlancs(p,m.fin)<m.fin)
+    {
+      if (!(p=litEntier(p,m.fin,nombreVertex)) || !(p=litEntier(p,m.fin,indice)) || !(p=litEntier(p,m.fin,indice1))){ m.erreur=true; return NULL; }
+      for (int j=0; j<nombreVertex-2; j++){
+	ajouteEntier(m.indices,indice);
+	m.indices+=' ';
+	ajouteEntier(m.indices,indice1);
+	m.indices+=' ';
+	if (!(p=litEntier(p,m.fin,indice1))){ m.erreur=true; return NULL; }
+	ajouteEntier(m.indices,indice1);
+	m.indices+='\n';
+      }
+      m.nombre++;
+    }
+  return NULL;
+}
+
+
+//decoupe [debut, fin) en morceaux d'environ tailleMorceau octets finissant en fin de ligne
+void decoupe(const char *debut, const char *fin, vector<const char *> &coupes)
+{
+  coupes.assign(1,debut);
+  const char *p=debut;
+  while ((size_t)(fin-p)>tailleMorceau){
+    const char *q=(const char *)memchr(p+tailleMorceau,'\n',fin-p-tailleMorceau);
+    if (!q) break;
+    p=q+1;
+    coupes.push_back(p);
+  }
+  if (coupes.back()!=fin) coupes.push_back(fin);
+}
+
+
+//le fichier noff projete en memoire, et les limites de ses listes de
+//sommets et de faces
+struct FichierNoff {
+  int descripteur;
+  size_t taille;
+  const char *donnees, *fin;
+  const char *sommets, *finSommets, *finFaces;
+  int nombrePoints, nombreFaces;
+};
+
+void ouvreNoff(string fichierNoff, FichierNoff &f, int n)
+{
+  f.descripteur=open(fichierNoff.c_str(),O_RDONLY);
+  struct stat infos;
+  if (f.descripteur<0 || fstat(f.descripteur,&infos)!=0){cout << "unable to open " << fichierNoff << endl; exit(3);}
+  f.taille=infos.st_size;
+  f.donnees=(const char *)mmap(NULL, max(f.taille,(size_t)1), PROT_READ, MAP_PRIVATE, f.descripteur, 0);
+  if (f.donnees==MAP_FAILED){cout << "unable to map " << fichierNoff << endl; exit(3);}
+  madvise((void *)f.donnees, max(f.taille,(size_t)1), MADV_SEQUENTIAL);
+  const char *fin=f.fin=f.donnees+f.taille;
+
+  //on saute l'entete et les commentaires
+  const char *p=f.donnees;
+  while (true)
+    {
+      p=sauteBlancs(p,fin);
+      if (p==fin) break;
+      if (isdigit(*p)) break;
+      if (*p=='#'){
+	const char *q=(const char *)memchr(p,'\n',fin-p);
+	p=q ? q : fin;
+      }
+      else while (p<fin && !estBlanc(*p)) p++;
+    }
 
   // on initialise le nombre de points et le nombre de faces
-  nombrePoints=atoi(a.c_str());
-  fichierEntree >> nombreFaces;
-  getline(fichierEntree,ligne);
+  f.nombrePoints=f.nombreFaces=0;
+  if (!(p=litEntier(p,fin,f.nombrePoints)) || !(p=litEntier(p,fin,f.nombreFaces))){cout << "no vertex and face numbers in " << fichierNoff << endl; exit(3);}
+  const char *q=(const char *)memchr(p,'\n',fin-p);
+  p=q ? q+1 : fin;
+
+  //les sommets sont les nombrePoints lignes suivantes, puis viennent les faces
+  uint64_t lignes[2]={(uint64_t)f.nombrePoints,(uint64_t)f.nombrePoints+f.nombreFaces};
+  const char *positions[2];
+  chercheLignes(p, fin, lignes, positions, 2, n);
+  f.sommets=p;
+  f.finSommets=positions[0];
+  f.finFaces=positions[1];
+}
 
- 
-  //initialisation des min et max
-  fichierEntree >> point[0];
-  minX=point[0];
-  maxX=point[0];	
+void fermeNoff(FichierNoff &f)
+{
+  munmap((void *)f.donnees, max(f.taille,(size_t)1));
+  close(f.descripteur);
+}
 
 
-  fichierEntree >> point[1];
-  minY=point[1];
-  maxY=point[1];	
+//la fonction qui ecrit le fichier de geometrie
 
+void ecritFichierGeometrie(string fichierNoff, string fichierGeomPbrt)
+{
+  int n=nThreads>0 ? nThreads : max(1L,sysconf(_SC_NPROCESSORS_ONLN));
+
+  FichierNoff f;
+  ouvreNoff(fichierNoff, f, n);
+  const char *p=f.sommets, *finSommets=f.finSommets, *finFaces=f.finFaces;
+  int nombrePoints=f.nombrePoints, nombreFaces=f.nombreFaces;
+
+  FILE *fichierSortieGeom=fopen(fichierGeomPbrt.c_str(),"wb");
+  if (!fichierSortieGeom){cout << "unable to create " << fichierGeomPbrt << endl; exit(3);}
+
+  //les points sont ecrits des que leur morceau est lu, les normales a la fin
+  fputs("Shape \"trianglemesh\" \"point P\" [ \n", fichierSortieGeom);
+  vector<const char *> coupes;
+  decoupe(p, finSommets, coupes);
+  vector<MorceauSommets> sommets(coupes.size()-1);
+  for (size_t i=0;i<sommets.size();i++){ sommets[i].debut=coupes[i]; sommets[i].fin=coupes[i+1]; }
+  float bornes[2][3]={{INFINITY,INFINITY,INFINITY},{-INFINITY,-INFINITY,-INFINITY}};
+  uint64_t nombreLus(0);
+  for (size_t r=0;r<sommets.size();r+=n)
+    {
+      int nr=min((size_t)n,sommets.size()-r);
+      executeEnParallele(&sommets[r], nr, litSommets);
+      for (int i=0;i<nr;i++){
+	MorceauSommets &m=sommets[r+i];
+	if (m.erreur){cout << "bad vertex line in " << fichierNoff << endl; exit(3);}
+	fwrite(m.points.data(), 1, m.points.size(), fichierSortieGeom);
+	string().swap(m.points);
+	nombreLus+=m.nombre;
+	for (int k=0;k<3;k++){
+	  bornes[0][k]=min(bornes[0][k],m.bornes[0][k]);
+	  bornes[1][k]=max(bornes[1][k],m.bornes[1][k]);
+	}
+      }
+    }
+  if (nombreLus!=(uint64_t)nombrePoints){cout << nombreLus << " vertices read instead of " << nombrePoints << " in " << fichierNoff << endl; exit(3);}
+  if (nombrePoints>0){
+    minX=bornes[0][0]; minY=bornes[0][1]; minZ=bornes[0][2];
+    maxX=bornes[1][0]; maxY=bornes[1][1]; maxZ=bornes[1][2];
+  }
 
-  fichierEntree >> point[2];
-  minZ=point[2];
-  maxZ=point[2];	
+  fputs("] \"normal N\" [\n", fichierSortieGeom);
+  for (size_t i=0;i<sommets.size();i++)
+    fwrite(sommets[i].normales.data(), 1, sommets[i].normales.size(), fichierSortieGeom);
+  vector<MorceauSommets>().swap(sommets);
 
+  //on écrit les indices des faces
+  fputs("] \"integer indices\" [", fichierSortieGeom);
+  decoupe(finSommets, finFaces, coupes);
+  vector<MorceauFaces> faces(n);
+  nombreLus=0;
+  for (size_t r=0;r+1<coupes.size();r+=n)
+    {
+      int nr=min((size_t)n,coupes.size()-1-r);
+      for (int i=0;i<nr;i++){ faces[i].debut=coupes[r+i]; faces[i].fin=coupes[r+i+1]; }
+      executeEnParallele(&faces[0], nr, litFaces);
+      for (int i=0;i<nr;i++){
+	if (faces[i].erreur){cout << "bad face line in " << fichierNoff << endl; exit(3);}
+	fwrite(faces[i].indices.data(), 1, faces[i].indices.size(), fichierSortieGeom);
+	string().swap(faces[i].indices);
+	nombreLus+=faces[i].nombre;
+      }
+    }
+  if (nombreLus!=(uint64_t)nombreFaces){cout << nombreLus << " faces read instead of " << nombreFaces << " in " << fichierNoff << endl; exit(3);}
+  fputs("]", fichierSortieGeom);
+  fclose(fichierSortieGeom);
 
-  fichierEntree >> vecteur[0];
-  fichierEntree >> vecteur[1];
-  fichierEntree >> vecteur[2];
+  fermeNoff(f);
 
-  //on commence à remplir les fichiers point et vecteur
+  cout << "geometry file has been released"<<endl; 
 
-  fichierPoint << point[0] << " ";
-  fichierPoint << point[1]<< " ";
-  fichierPoint << point[2] << "\n";
+}
 
 
-  fichierVecteur << -vecteur[0] <<" " ;
 
-  fichierVecteur << -vecteur[1] << " ";
 
-  fichierVecteur << -vecteur[2] <<"\n";
 
 
-  // on remplit les fichiers points et vecteur jusqu'à ce qu'il n'y ait plus de points
-  for (i=1;i<nombrePoints;i++)
-    {
-	
-      fichierEntree >> point[0];
-      if (point[0]<minX) minX=point[0];	
-      if (point[0]>maxX) maxX=point[0];	
-      fichierPoint << point[0] << " "; 
-
-      fichierEntree >> point[1];
-      if (point[1]<minY) minY=point[1];	
-      if (point[1]>maxY) maxY=point[1];		
-      fichierPoint << point[1]<< " "; 
-
-      fichierEntree >> point[2];
-      if (point[2]<minZ) minZ=point[2];	
-      if (point[2]>maxZ) maxZ=point[2];	
-      fichierPoint << point[2] << "\n"; 
-	
-      fichierEntree >> vecteur[0];
-      fichierEntree >> vecteur[1];
-      fichierEntree >> vecteur[2];
-      fichierVecteur << -vecteur[0] << " ";
-      fichierVecteur << -vecteur[1] << " ";
-      fichierVecteur << -vecteur[2] << "\n";
 
+//mode --photon : le lanceur de photons ne se sert de la normale d'un
+//triangle que pour orienter sa normale geometrique (mesh->n[v[0]] dans
+//Triangle::Intersect). Les sommets de meme position sont donc fusionnes,
+//chaque triangle est tourne pour que sa normale geometrique soit du cote
+//de la normale de son premier sommet, et le fichier de geometrie n'a plus
+//de "normal N" : pbrt oriente alors les triangles par l'ordre de leurs sommets
+
+//un morceau de la liste des sommets, lu en binaire
+struct SommetsBinaires {
+  const char *debut, *fin;
+  vector<float> points, normales;
+  bool erreur;
+};
+
+void *litSommetsBinaires(void *arg)
+{
+  SommetsBinaires &m=*(SommetsBinaires *)arg;
+  m.erreur=false;
+  const char *p=m.debut;
+  float sommet[6];
+  while (sauteBlancs(p,m.fin)<m.fin)
+    {
+      for (int k=0;k<6;k++)
+	if (!(p=litReel(p,m.fin,sommet[k]))){ m.erreur=true; return NULL; }
+      m.points.insert(m.points.end(), sommet, sommet+3);
+      for (int k=3;k<6;k++) m.normales.push_back(-sommet[k]);
     }
+  return NULL;
+}
 
-  fichierPoint.close();
-  fichierVecteur.close();
 
+//tri des sommets par position (puis par numero) pour la fusion, par
+//morceaux en parallele puis par fusions successives
+struct OrdrePoints {
+  const float *p;
+  bool operator()(uint32_t a, uint32_t b) const {
+    for (int k=0;k<3;k++)
+      if (p[3*a+k]!=p[3*b+k]) return p[3*a+k]<p[3*b+k];
+    return a<b;
+  }
+};
 
-  //on remplit le fichier de geométrie avec les points et vecteurs
+struct MorceauTri {
+  uint32_t *debut, *fin;
+  OrdrePoints ordre;
+};
 
-  fichierSortieGeom << "Shape \"trianglemesh\" \"point P\" [ \n";
+void *trieMorceau(void *arg)
+{
+  MorceauTri &m=*(MorceauTri *)arg;
+  sort(m.debut, m.fin, m.ordre);
+  return NULL;
+}
 
-  ifstream fichierpoint("pointTemp.txt");
-  while (getline(fichierpoint, ligne)){
-    fichierSortieGeom << ligne;
-    fichierSortieGeom << "\n";
-  }
 
+//un morceau de la liste des faces : triangles orientes et renumerotes
+struct FacesPhoton {
+  const char *debut, *fin;
+  const float *points, *normales;
+  const uint32_t *numero;
+  int nombrePoints;
+  string indices;
+  uint64_t nombre, triangles, degeneres;
+  bool erreur;
+};
 
+void *litFacesPhoton(void *arg)
+{
+  FacesPhoton &m=*(FacesPhoton *)arg;
+  m.nombre=m.triangles=m.degeneres=0;
+  m.erreur=false;
+  m.indices.reserve(m.fin-m.debut);
+  const char *p=m.debut;
+  int nombreVertex, s[3];
+  while (sauteBlancs(p,m.fin)<m.fin)
+    {
+      if (!(p=litEntier(p,m.fin,nombreVertex)) || !(p=litEntier(p,m.fin,s[0])) || !(p=litEntier(p,m.fin,s[1]))){ m.erreur=true; return NULL; }
+      for (int j=0; j<nombreVertex-2; j++){
+	if (!(p=litEntier(p,m.fin,s[2]))){ m.erreur=true; return NULL; }
+	int t[3]={s[0],s[1],s[2]};
+	s[1]=s[2];
+	for (int k=0;k<3;k++) if (t[k]<0 || t[k]>=m.nombrePoints){ m.erreur=true; return NULL; }
+	uint32_t u[3]={m.numero[t[0]],m.numero[t[1]],m.numero[t[2]]};
+	//deux sommets fusionnes : triangle d'aire nulle, jamais touche
+	if (u[0]==u[1] || u[1]==u[2] || u[2]==u[0]){ m.degeneres++; continue; }
+	//meme test que Triangle::Intersect : Dot(n[v0], Cross(p1-p0, p2-p0)) < 0
+	const float *p0=m.points+3*t[0], *p1=m.points+3*t[1], *p2=m.points+3*t[2], *n=m.normales+3*t[0];
+	float e1[3]={p1[0]-p0[0],p1[1]-p0[1],p1[2]-p0[2]}, e2[3]={p2[0]-p0[0],p2[1]-p0[1],p2[2]-p0[2]};
+	float produit=n[0]*(e1[1]*e2[2]-e1[2]*e2[1])+n[1]*(e1[2]*e2[0]-e1[0]*e2[2])+n[2]*(e1[0]*e2[1]-e1[1]*e2[0]);
+	if (produit<0) swap(u[1],u[2]);
+	for (int k=0;k<3;k++){
+	  ajouteEntier(m.indices,u[k]);
+	  m.indices+=(k<2 ? ' ' : '\n');
+	}
+	m.triangles++;
+      }
+      m.nombre++;
+    }
+  return NULL;
+}
 
-  fichierSortieGeom << "] \"normal N\" [\n";
-  ifstream fichiervect("vecteurTemp.txt");
-  while (getline(fichiervect, ligne)){
-    fichierSortieGeom << ligne;
-    fichierSortieGeom << "\n";
-  }
 
+//mise en forme des points fusionnes, par tranches de la numerotation
+struct PointsPhoton {
+  const float *points;
+  const uint32_t *representants;
+  size_t debut, fin;
+  string texte;
+};
 
-  //on supprime les fichiers temporaires
-  remove("pointTemp.txt");
-  remove("vecteurTemp.txt");
+void *ecritPointsPhoton(void *arg)
+{
+  PointsPhoton &m=*(PointsPhoton *)arg;
+  m.texte.reserve((m.fin-m.debut)*24);
+  for (size_t i=m.debut;i<m.fin;i++)
+    for (int k=0;k<3;k++){
+      ajouteReel(m.texte,m.points[3*m.representants[i]+k]);
+      m.texte+=(k<2 ? ' ' : '\n');
+    }
+  return NULL;
+}
 
-  //on écrit les indices des faces
-  fichierSortieGeom << "] \"integer indices\" ["; 
 
-  for (i=0;i<nombreFaces ; i++)
+void ecritFichierGeometriePhoton(string fichierNoff, string fichierGeomPbrt)
+{
+  int n=nThreads>0 ? nThreads : max(1L,sysconf(_SC_NPROCESSORS_ONLN));
+
+  FichierNoff f;
+  ouvreNoff(fichierNoff, f, n);
+
+  //les sommets, en memoire : 24 octets par sommet
+  vector<const char *> coupes;
+  decoupe(f.sommets, f.finSommets, coupes);
+  vector<SommetsBinaires> morceaux(coupes.size()-1);
+  for (size_t i=0;i<morceaux.size();i++){ morceaux[i].debut=coupes[i]; morceaux[i].fin=coupes[i+1]; }
+  vector<float> points, normales;
+  points.reserve(3*(size_t)f.nombrePoints);
+  normales.reserve(3*(size_t)f.nombrePoints);
+  for (size_t r=0;r<morceaux.size();r+=n)
     {
-      fichierEntree >> nombreVertex;
-      fichierEntree >> indice;
-      fichierEntree >> indice1;
-	
-      for (j=0; j<nombreVertex -2;j++){
-	fichierSortieGeom << indice << " " <<indice1 << " ";	
-	fichierEntree >> indice1;
-	fichierSortieGeom << indice1 << "\n";
+      int nr=min((size_t)n,morceaux.size()-r);
+      executeEnParallele(&morceaux[r], nr, litSommetsBinaires);
+      for (int i=0;i<nr;i++){
+	SommetsBinaires &m=morceaux[r+i];
+	if (m.erreur){cout << "bad vertex line in " << fichierNoff << endl; exit(3);}
+	points.insert(points.end(), m.points.begin(), m.points.end());
+	normales.insert(normales.end(), m.normales.begin(), m.normales.end());
+	vector<float>().swap(m.points);
+	vector<float>().swap(m.normales);
       }
     }
-  fichierSortieGeom << "]";
+  if (points.size()!=3*(size_t)f.nombrePoints){cout << points.size()/3 << " vertices read instead of " << f.nombrePoints << " in " << fichierNoff << endl; exit(3);}
+  if (f.nombrePoints>0){
+    float bornes[2][3]={{INFINITY,INFINITY,INFINITY},{-INFINITY,-INFINITY,-INFINITY}};
+    for (size_t i=0;i<points.size();i+=3)
+      for (int k=0;k<3;k++){
+	bornes[0][k]=min(bornes[0][k],points[i+k]);
+	bornes[1][k]=max(bornes[1][k],points[i+k]);
+      }
+    minX=bornes[0][0]; minY=bornes[0][1]; minZ=bornes[0][2];
+    maxX=bornes[1][0]; maxY=bornes[1][1]; maxZ=bornes[1][2];
+  }
 
-  cout << "geometry file has been released"<<endl; 
+  //fusion : le representant d'un groupe de sommets de meme position est le
+  //premier du fichier, et les representants gardent l'ordre du fichier
+  size_t nombrePoints=f.nombrePoints;
+  vector<uint32_t> ordre(nombrePoints);
+  for (size_t i=0;i<nombrePoints;i++) ordre[i]=i;
+  OrdrePoints o; o.p=points.empty() ? NULL : &points[0];
+  int nTri=max(1,(int)min((size_t)n,nombrePoints/65536));
+  vector<MorceauTri> tris(nTri);
+  for (int i=0;i<nTri;i++){
+    tris[i].debut=&ordre[0]+nombrePoints*i/nTri;
+    tris[i].fin=&ordre[0]+nombrePoints*(i+1)/nTri;
+    tris[i].ordre=o;
+  }
+  if (nombrePoints>0) executeEnParallele(&tris[0], nTri, trieMorceau);
+  for (int largeur=1; largeur<nTri; largeur*=2)
+    for (int i=0;i+largeur<nTri;i+=2*largeur)
+      inplace_merge(tris[i].debut, tris[i+largeur].debut, tris[min(i+2*largeur,nTri)-1].fin, o);
+  vector<uint32_t> numero(nombrePoints);
+  for (size_t i=0;i<nombrePoints;i++){
+    bool meme=i>0 && !memcmp(&points[3*ordre[i]],&points[3*ordre[i-1]],3*sizeof(float));
+    numero[ordre[i]]=meme ? numero[ordre[i-1]] : ordre[i];
+  }
+  vector<uint32_t>().swap(ordre);
+  vector<uint32_t> representants;
+  for (size_t i=0;i<nombrePoints;i++)
+    if (numero[i]==i){ numero[i]=representants.size(); representants.push_back(i); }
+    else numero[i]=numero[numero[i]];
+
+  FILE *fichierSortieGeom=fopen(fichierGeomPbrt.c_str(),"wb");
+  if (!fichierSortieGeom){cout << "unable to create " << fichierGeomPbrt << endl; exit(3);}
+  fputs("# Noff2Pbrt --photon : welded vertices, no normals, triangles oriented by their vertex order (photon mode only)\n", fichierSortieGeom);
+  fputs("Shape \"trianglemesh\" \"point P\" [ \n", fichierSortieGeom);
+  vector<PointsPhoton> blocs(n);
+  for (int i=0;i<n;i++){
+    blocs[i].points=o.p;
+    blocs[i].representants=representants.empty() ? NULL : &representants[0];
+    blocs[i].debut=representants.size()*i/n;
+    blocs[i].fin=representants.size()*(i+1)/n;
+  }
+  executeEnParallele(&blocs[0], n, ecritPointsPhoton);
+  for (int i=0;i<n;i++){
+    fwrite(blocs[i].texte.data(), 1, blocs[i].texte.size(), fichierSortieGeom);
+    string().swap(blocs[i].texte);
+  }
 
+  //on écrit les indices des faces
+  fputs("] \"integer indices\" [", fichierSortieGeom);
+  decoupe(f.finSommets, f.finFaces, coupes);
+  vector<FacesPhoton> faces(n);
+  uint64_t nombreLus(0), triangles(0), degeneres(0);
+  for (size_t r=0;r+1<coupes.size();r+=n)
+    {
+      int nr=min((size_t)n,coupes.size()-1-r);
+      for (int i=0;i<nr;i++){
+	faces[i].debut=coupes[r+i]; faces[i].fin=coupes[r+i+1];
+	faces[i].points=o.p; faces[i].normales=normales.empty() ? NULL : &normales[0];
+	faces[i].numero=numero.empty() ? NULL : &numero[0];
+	faces[i].nombrePoints=f.nombrePoints;
+      }
+      executeEnParallele(&faces[0], nr, litFacesPhoton);
+      for (int i=0;i<nr;i++){
+	if (faces[i].erreur){cout << "bad face line in " << fichierNoff << endl; exit(3);}
+	fwrite(faces[i].indices.data(), 1, faces[i].indices.size(), fichierSortieGeom);
+	string().swap(faces[i].indices);
+	nombreLus+=faces[i].nombre;
+	triangles+=faces[i].triangles;
+	degeneres+=faces[i].degeneres;
+      }
+    }
+  if (nombreLus!=(uint64_t)f.nombreFaces){cout << nombreLus << " faces read instead of " << f.nombreFaces << " in " << fichierNoff << endl; exit(3);}
+  fputs("]", fichierSortieGeom);
+  fclose(fichierSortieGeom);
+
+  fermeNoff(f);
+
+  cout << "photon geometry file has been released : " << nombrePoints << " -> " << representants.size() << " vertices, "
+       << triangles << " triangles (" << degeneres << " degenerate removed)" << endl;
 }
 
 
@@ -233,53 +713,388 @@ void ecritFichierGeometrie(string fichierNoff, string fichierGeomPbrt)
 
 
 
-//la fonction qui sort le fichier pbrt lisible par le logiciel
-void ecritFichierPbrt(string fichierPbrt, string fichierGeomPbrt, string fichierEXR){
+//une face dans les fichiers temporaires, avec la tuile qui la contient
+struct FaceTemp {
+  uint32_t tuile;
+  int32_t indices[3];
+};
+
+
+
+//le maillage range par case d'une grille nTuiles^3, sans jamais etre entierement
+//en memoire : le fichier noff est lu par morceaux comme dans
+//ecritFichierGeometrie, les sommets et les faces passent par des fichiers
+//temporaires projetes en memoire
+struct MaillageTrie {
+  uint64_t nombreTriangles;
+  const float *sommets;      //6 floats par sommet : position puis normale retournee
+  size_t tailleSommets;
+  FaceTemp *faces;           //faces triees par case
+  size_t tailleFaces;
+  vector<uint64_t> compte;   //les faces de la case c sont [compte[c], compte[c+1])
+  FILE *fichierSommets, *fichierFaces, *fichierTrie;
+};
+
+
+//fichier temporaire dans le dossier de la sortie, efface des sa creation :
+//il disparait a sa fermeture, meme si le programme s'arrete sur une erreur
+FILE *fichierTemporaire(string sortie)
+{
+  size_t barre=sortie.rfind('/');
+  string modele=(barre==string::npos ? string() : sortie.substr(0,barre+1))+"Noff2PbrtTemp_XXXXXX";
+  vector<char> nom(modele.begin(), modele.end());
+  nom.push_back(0);
+  int descripteur=mkstemp(&nom[0]);
+  if (descripteur<0){cout << "unable to create a temporary file " << modele << endl; exit(3);}
+  unlink(&nom[0]);
+  FILE *fichier=fdopen(descripteur,"wb+");
+  if (!fichier){cout << "unable to open a temporary file " << modele << endl; exit(3);}
+  return fichier;
+}
 
-  ofstream fichierSortiePbrt(fichierPbrt.c_str());
-double Maximum(0);
 
-Maximum = max(max(maxX-minX, maxY-minY), maxZ-minZ);
-if (Maximum==0){cout << "geometry file is empty !!!" <<endl; Maximum=1;} 
+//un morceau de la liste des sommets : position puis normale retournee,
+//arrondies comme dans le fichier de geometrie texte
+struct SommetsTries {
+  const char *debut, *fin;
+  vector<float> sommets;
+  float bornes[2][3];
+  bool erreur;
+};
 
+void *litSommetsTries(void *arg)
+{
+  SommetsTries &m=*(SommetsTries *)arg;
+  m.erreur=false;
+  for (int k=0;k<3;k++){ m.bornes[0][k]=INFINITY; m.bornes[1][k]=-INFINITY; }
+  const char *p=m.debut;
+  float sommet[6];
+  while (sauteBlancs(p,m.fin)<m.fin)
+    {
+      for (int k=0;k<6;k++)
+	if (!(p=litReel(p,m.fin,sommet[k]))){ m.erreur=true; return NULL; }
+      for (int k=0;k<3;k++){
+	sommet[k]=reelRelu(sommet[k]);
+	sommet[3+k]=reelRelu(-sommet[3+k]);
+	m.bornes[0][k]=min(m.bornes[0][k],sommet[k]);
+	m.bornes[1][k]=max(m.bornes[1][k],sommet[k]);
+      }
+      m.sommets.insert(m.sommets.end(), sommet, sommet+6);
+    }
+  return NULL;
+}
 
-  // et on écrit dans le fichier qu'il faudra lancer sous pbrt
-  fichierSortiePbrt <<"## to have a nicest image level up the \"samplesperpixel\" of metropolis\n## to be more rapid, make this number down (but loose quality of image)\n \n \n";
 
-  //declaration des attributs generaux
-  fichierSortiePbrt << "Scale -1.000000 1.000000 1.000000 \n \nTranslate -278.000000 -273.000000 500.000000\n \nRenderer \"metropolis\" \"integer samplesperpixel\" [128]\n \nCamera \"perspective\" \"float fov\" [55.000000]\n \nFilm \"image\" \"integer xresolution\" [1000] \"integer yresolution\" [750]\n    \"string filename\" \""<< fichierEXR  <<"\"\n \nPixelFilter \"box\" \n \nWorldBegin\n \n AttributeBegin\nTranslate 340.000000 278.000000 -50\nLightSource \"point\" \"point from\" [0.000000 200.000000 -50.000000] \"color I\" [412300 341100 298600]\nAttributeEnd\n \n";
+//un morceau de la liste des faces, triangulees en eventail, avec leur case
+struct FacesTriees {
+  const char *debut, *fin;
+  const float *sommets;
+  int nombrePoints, nTuiles;
+  const double *origine, *taille;
+  vector<FaceTemp> faces;
+  uint64_t nombre;
+  bool erreur;
+};
 
-  //declaration du fond
-  fichierSortiePbrt << "#le fond \nAttributeBegin\nMaterial \"matte\" \"color Kd\" [.8 .8 .8]\nShape \"trianglemesh\"  \"integer indices\" [0 2 1 0 3 2] \"point P\" [800.000000 0.000000 0.000000 -250.000000 0.000000 0.000000 -250.000000 0.000000 1000.000000 800.000000 0.000000 1000.000000]\nAttributeEnd\n \n";
+void *litFacesTriees(void *arg)
+{
+  FacesTriees &m=*(FacesTriees *)arg;
+  m.nombre=0;
+  m.erreur=false;
+  const char *p=m.debut;
+  int nombreVertex, indice, indice1;
+  FaceTemp face;
+  while (sauteBlancs(p,m.fin)<m.fin)
+    {
+      if (!(p=litEntier(p,m.fin,nombreVertex)) || !(p=litEntier(p,m.fin,indice)) || !(p=litEntier(p,m.fin,indice1))){ m.erreur=true; return NULL; }
+      for (int j=0; j<nombreVertex-2; j++){
+	face.indices[0]=indice;
+	face.indices[1]=indice1;
+	if (!(p=litEntier(p,m.fin,indice1))){ m.erreur=true; return NULL; }
+	face.indices[2]=indice1;
+	for (int k=0;k<3;k++) if (face.indices[k]<0 || face.indices[k]>=m.nombrePoints){ m.erreur=true; return NULL; }
+	int c[3];
+	for (int k=0;k<3;k++){
+	  double centre=(m.sommets[6*face.indices[0]+k]+m.sommets[6*face.indices[1]+k]+m.sommets[6*face.indices[2]+k])/3.;
+	  c[k]=min(m.nTuiles-1,max(0,(int)((centre-m.origine[k])/m.taille[k])));
+	}
+	face.tuile=(c[2]*m.nTuiles+c[1])*m.nTuiles+c[0];
+	m.faces.push_back(face);
+      }
+      m.nombre++;
+    }
+  return NULL;
+}
 
-  //on inclut l'echantillon
-  fichierSortiePbrt << "#include of the sample\nAttributeBegin\nTranslate 180 180 386 \nRotate -30 1 0 0\nRotate 30 0 1 0\nScale "<< (double)256/Maximum << " " << (double)256/Maximum<<" " << (double)256/Maximum<<"\n Rotate -90 1 0 0 \nTranslate "<< -minX <<" " << -minY << " " <<-minZ <<"\nMaterial \"matte\" \"color Kd\" [1 1 1]\nInclude \"" << fichierGeomPbrt<<"\"\nAttributeEnd\n \nWorldEnd";
 
-  cout << "pbrt file generated"<<endl;
+void trieMaillage(string fichierNoff, int nTuiles, MaillageTrie &m, string sortie)
+{
+  int n=nThreads>0 ? nThreads : max(1L,sysconf(_SC_NPROCESSORS_ONLN));
+
+  FichierNoff f;
+  ouvreNoff(fichierNoff, f, n);
+  int nombrePoints=f.nombrePoints;
+
+  //1) les sommets et les normales (retournees) dans un fichier binaire temporaire
+  FILE *fichierSommets=m.fichierSommets=fichierTemporaire(sortie);
+  vector<const char *> coupes;
+  decoupe(f.sommets, f.finSommets, coupes);
+  vector<SommetsTries> morceaux(n);
+  float bornes[2][3]={{INFINITY,INFINITY,INFINITY},{-INFINITY,-INFINITY,-INFINITY}};
+  uint64_t nombreLus(0);
+  for (size_t r=0;r+1<coupes.size();r+=n)
+    {
+      int nr=min((size_t)n,coupes.size()-1-r);
+      for (int i=0;i<nr;i++){ morceaux[i].debut=coupes[r+i]; morceaux[i].fin=coupes[r+i+1]; }
+      executeEnParallele(&morceaux[0], nr, litSommetsTries);
+      for (int i=0;i<nr;i++){
+	SommetsTries &s=morceaux[i];
+	if (s.erreur){cout << "bad vertex line in " << fichierNoff << endl; exit(3);}
+	if (!s.sommets.empty() && fwrite(&s.sommets[0], sizeof(float), s.sommets.size(), fichierSommets)!=s.sommets.size()){cout << "unable to write a temporary file" << endl; exit(3);}
+	nombreLus+=s.sommets.size()/6;
+	vector<float>().swap(s.sommets);
+	for (int k=0;k<3;k++){
+	  bornes[0][k]=min(bornes[0][k],s.bornes[0][k]);
+	  bornes[1][k]=max(bornes[1][k],s.bornes[1][k]);
+	}
+      }
+    }
+  if (nombreLus!=(uint64_t)nombrePoints){cout << nombreLus << " vertices read instead of " << nombrePoints << " in " << fichierNoff << endl; exit(3);}
+  if (nombrePoints>0){
+    minX=bornes[0][0]; minY=bornes[0][1]; minZ=bornes[0][2];
+    maxX=bornes[1][0]; maxY=bornes[1][1]; maxZ=bornes[1][2];
+  }
+  fflush(fichierSommets);
+  size_t tailleSommets=(size_t)nombrePoints*6*sizeof(float);
+  const float *sommets=(const float *)mmap(NULL, max(tailleSommets,(size_t)1), PROT_READ, MAP_SHARED, fileno(fichierSommets), 0);
+  if (sommets==MAP_FAILED){cout << "unable to map the vertex file" << endl; exit(3);}
+
+  //2) les faces (triangulees en eventail) avec leur tuile
+  double origine[3]={minX,minY,minZ};
+  double taille[3]={(maxX-minX)/nTuiles,(maxY-minY)/nTuiles,(maxZ-minZ)/nTuiles};
+  for (int k=0;k<3;k++) if (taille[k]<=0) taille[k]=1;
+  vector<uint64_t> compte((size_t)nTuiles*nTuiles*nTuiles+1,0);
+  FILE *fichierFaces=m.fichierFaces=fichierTemporaire(sortie);
+  uint64_t nombreTriangles(0);
+  decoupe(f.finSommets, f.finFaces, coupes);
+  vector<FacesTriees> faces(n);
+  for (int i=0;i<n;i++){
+    faces[i].sommets=sommets;
+    faces[i].nombrePoints=nombrePoints;
+    faces[i].nTuiles=nTuiles;
+    faces[i].origine=origine;
+    faces[i].taille=taille;
+  }
+  nombreLus=0;
+  for (size_t r=0;r+1<coupes.size();r+=n)
+    {
+      int nr=min((size_t)n,coupes.size()-1-r);
+      for (int i=0;i<nr;i++){ faces[i].debut=coupes[r+i]; faces[i].fin=coupes[r+i+1]; }
+      executeEnParallele(&faces[0], nr, litFacesTriees);
+      for (int i=0;i<nr;i++){
+	FacesTriees &t=faces[i];
+	if (t.erreur){cout << "bad face line or vertex index out of range [0," << nombrePoints << ") in " << fichierNoff << endl; exit(3);}
+	for (size_t k=0;k<t.faces.size();k++) compte[t.faces[k].tuile+1]++;
+	if (!t.faces.empty() && fwrite(&t.faces[0], sizeof(FaceTemp), t.faces.size(), fichierFaces)!=t.faces.size()){cout << "unable to write a temporary file" << endl; exit(3);}
+	nombreTriangles+=t.faces.size();
+	nombreLus+=t.nombre;
+	vector<FaceTemp>().swap(t.faces);
+      }
+    }
+  if (nombreLus!=(uint64_t)f.nombreFaces){cout << nombreLus << " faces read instead of " << f.nombreFaces << " in " << fichierNoff << endl; exit(3);}
+  fflush(fichierFaces);
+  fermeNoff(f);
+
+  //3) tri des faces par tuile (tri par denombrement dans un second fichier)
+  for (size_t t=1;t<compte.size();t++) compte[t]+=compte[t-1];
+  size_t tailleFaces=nombreTriangles*sizeof(FaceTemp);
+  FILE *fichierTrie=m.fichierTrie=fichierTemporaire(sortie);
+  if (ftruncate(fileno(fichierTrie), tailleFaces)!=0){cout << "unable to create the sorted face file" << endl; exit(3);}
+  const FaceTemp *facesLues=(const FaceTemp *)mmap(NULL, max(tailleFaces,(size_t)1), PROT_READ, MAP_SHARED, fileno(fichierFaces), 0);
+  FaceTemp *facesTriees=(FaceTemp *)mmap(NULL, max(tailleFaces,(size_t)1), PROT_READ|PROT_WRITE, MAP_SHARED, fileno(fichierTrie), 0);
+  if (facesLues==MAP_FAILED || facesTriees==MAP_FAILED){cout << "unable to map the face files" << endl; exit(3);}
+  vector<uint64_t> position(compte.begin(), compte.end()-1);
+  for (uint64_t t=0;t<nombreTriangles;t++)
+    facesTriees[position[facesLues[t].tuile]++]=facesLues[t];
+  munmap((void *)facesLues, max(tailleFaces,(size_t)1));
+
+  m.nombreTriangles=nombreTriangles;
+  m.sommets=sommets;
+  m.tailleSommets=tailleSommets;
+  m.faces=facesTriees;
+  m.tailleFaces=tailleFaces;
+  m.compte.swap(compte);
 }
 
 
+void libereMaillage(MaillageTrie &m)
+{
+  //les fichiers temporaires, deja effaces, disparaissent a leur fermeture
+  munmap((void *)m.sommets, max(m.tailleSommets,(size_t)1));
+  munmap(m.faces, max(m.tailleFaces,(size_t)1));
+  fclose(m.fichierSommets);
+  fclose(m.fichierFaces);
+  fclose(m.fichierTrie);
+}
 
 
-//la fonction qui sort le fichier pour le lanceur de photon
-void ecritFichierPhoton(string fichierPhoton, string fichierGeomPbrt){
-  double facteur=(maxZ-minZ)/256;
+//la fonction qui ecrit le maillage decoupe en tuiles (forme "tiledmesh" de pbrt)
+//chaque tuile est traitee seule
+void ecritFichierTuiles(string fichierNoff, string fichierTuiles, string fichierGeomPbrt, int nTuiles)
+{
+  MaillageTrie m;
+  trieMaillage(fichierNoff, nTuiles, m, fichierTuiles);
+  const float *sommets=m.sommets;
+  const FaceTemp *facesTriees=m.faces;
+  const vector<uint64_t> &compte=m.compte;
+  uint64_t nombreTriangles=m.nombreTriangles;
+
+
+  //4) chaque tuile non vide : sommets locaux, BVH, ecriture alignee sur 4096 octets
+  vector<InfoTuile> infos;
+  FILE *fichierSortie=fopen(fichierTuiles.c_str(),"wb");
+  if (!fichierSortie){cout << "unable to create " << fichierTuiles << endl; exit(3);}
+  uint32_t nCases=nTuiles*nTuiles*nTuiles;
+  uint64_t nonVides(0);
+  for (uint32_t t=0;t<nCases;t++) if (compte[t+1]>compte[t]) nonVides++;
+  uint64_t decalage=sizeof(EnteteTuiles)+nonVides*sizeof(InfoTuile);
+  for (uint32_t t=0;t<nCases;t++)
+    {
+      uint64_t debut=compte[t], fin=compte[t+1];
+      if (fin==debut) continue;
+      vector<int32_t> globaux;
+      globaux.reserve(3*(fin-debut));
+      for (uint64_t f=debut;f<fin;f++)
+	for (int k=0;k<3;k++) globaux.push_back(facesTriees[f].indices[k]);
+      sort(globaux.begin(), globaux.end());
+      globaux.erase(unique(globaux.begin(), globaux.end()), globaux.end());
+
+      vector<float> P(3*globaux.size()), N(3*globaux.size());
+      for (size_t v=0;v<globaux.size();v++)
+	for (int k=0;k<3;k++){
+	  P[3*v+k]=sommets[6*globaux[v]+k];
+	  N[3*v+k]=sommets[6*globaux[v]+3+k];
+	}
+      vector<TriangleTuile> triangles(fin-debut);
+      for (uint64_t f=debut;f<fin;f++){
+	TriangleTuile &tri=triangles[f-debut];
+	for (int k=0;k<3;k++)
+	  tri.indices[k]=lower_bound(globaux.begin(), globaux.end(), facesTriees[f].indices[k])-globaux.begin();
+	for (int k=0;k<3;k++){
+	  float p0=P[3*tri.indices[0]+k], p1=P[3*tri.indices[1]+k], p2=P[3*tri.indices[2]+k];
+	  tri.bornes[0][k]=min(p0,min(p1,p2));
+	  tri.bornes[1][k]=max(p0,max(p1,p2));
+	  tri.centre[k]=.5f*(tri.bornes[0][k]+tri.bornes[1][k]);
+	}
+      }
+      vector<NoeudBVH> noeuds;
+      construitBVH(triangles, 0, triangles.size(), noeuds);
+      vector<int32_t> indices(3*triangles.size());
+      for (size_t i=0;i<triangles.size();i++)
+	for (int k=0;k<3;k++) indices[3*i+k]=triangles[i].indices[k];
+
+      InfoTuile info;
+      memcpy(info.bornes, noeuds[0].bornes, sizeof(info.bornes));
+      decalage=(decalage+alignement-1)/alignement*alignement;
+      info.decalage=decalage;
+      info.premierTriangle=debut;
+      info.nSommets=globaux.size();
+      info.nTriangles=triangles.size();
+      info.nNoeuds=noeuds.size();
+      info.pad=0;
+      infos.push_back(info);
+      fseeko(fichierSortie, decalage, SEEK_SET);
+      fwrite(&noeuds[0], sizeof(NoeudBVH), noeuds.size(), fichierSortie);
+      fwrite(&P[0], sizeof(float), P.size(), fichierSortie);
+      fwrite(&N[0], sizeof(float), N.size(), fichierSortie);
+      fwrite(&indices[0], sizeof(int32_t), indices.size(), fichierSortie);
+      decalage=ftello(fichierSortie);
+    }
 
-  ofstream fichierSortiePhoton(fichierPhoton.c_str());
+  //l'entete et la table des tuiles au debut du fichier
+  EnteteTuiles entete;
+  memcpy(entete.magic, magicTuiles, 8);
+  entete.version=versionTuiles;
+  entete.nTuiles=infos.size();
+  entete.nTriangles=nombreTriangles;
+  entete.bornes[0][0]=minX; entete.bornes[0][1]=minY; entete.bornes[0][2]=minZ;
+  entete.bornes[1][0]=maxX; entete.bornes[1][1]=maxY; entete.bornes[1][2]=maxZ;
+  fseeko(fichierSortie, 0, SEEK_SET);
+  fwrite(&entete, sizeof(EnteteTuiles), 1, fichierSortie);
+  if (infos.size()>0) fwrite(&infos[0], sizeof(InfoTuile), infos.size(), fichierSortie);
+  fclose(fichierSortie);
+
+  libereMaillage(m);
+
+  //le fichier de geometrie ne contient plus que la reference aux tuiles
+  ofstream fichierSortieGeom(fichierGeomPbrt.c_str());
+  fichierSortieGeom << "Shape \"tiledmesh\" \"string filename\" \"" << fichierTuiles << "\" \"integer maxresidentmb\" [4096]\n";
+
+  cout << "tiled geometry file has been released (" << infos.size() << " tiles, " << nombreTriangles << " triangles)" << endl;
+}
 
-  //on definit la photonmap
-  fichierSortiePhoton << "## causticphotons = number of launched photons;\n## maxdepth= max number of intersections for one photon before stopping\n\nSurfaceIntegrator \"photonmap\" \"integer indirectphotons\" [0] \"integer causticphotons\" [20000]\n\"integer maxspeculardepth\" [100000] \"integer maxphotondepth\" [100000]\n\n";
 
-  //definition de la source de lumiere
-  fichierSortiePhoton << "#ligth source : to change the direction of the source change point from and point to, only the direction is important \nWorldBegin\n \nAttributeBegin\nLightSource \"distant\" \"point from\" [0 0 50] \"point to\" [0 0 0]\nAttributeEnd\n\n";
 
-  //pour dupliquer l'echantillon et prendre en compte la profondeur
-  fichierSortiePhoton << "#to duplicate the sample and take care of the depth, we create a cube wich will surround the sample\n\nAttributeBegin\nMaterial \"glass\"\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [0 0 256.001 " << (maxX-minX)/facteur << " 0 256.001 0 " << (maxY-minY)/facteur << " 256.001]\n\"normal N\" [0 0 1 0 0 1 0 0 1]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [ "<< (maxX-minX)/facteur<< " 0 256.001 0 "<<(maxY-minY)/facteur<< " 256.001 "<<(maxX-minX)/facteur<< " "<<(maxY-minY)/facteur<< " 256.001]\n\"normal N\" [0 0 1 0 0 1 0 0 1]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [0 0 0 " << (maxX-minX)/facteur <<" 0 0 0 " << (maxY-minY)/facteur << " 0]\n\"normal N\" [0 0 -1 0 0 -1 0 0 -1]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [" << (maxX-minX)/facteur <<" 0 0 0 " << (maxY-minY)/facteur <<" 0 " << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 0]\n\"normal N\" [0 0 -1 0 0 -1 0 0 -1]\n\nShape \"trianglemesh\" \"integer indices\" [0 2 1]\n\"point P\" [0 0 0 " << (maxX-minX)/facteur <<" 0 0 0 0 256]\n\"normal N\" [0 -1 0 0 -1 0 0 -1 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 2 1]\n\"point P\" [" << (maxX-minX)/facteur <<" 0 0 0 0 256 " << (maxX-minX)/facteur <<" 0 256]\n\"normal N\" [0 -1 0 0 -1 0 0 -1 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [0 " << (maxY-minY)/facteur <<" 0 " << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 0 0 " << (maxY-minY)/facteur <<" 256]\n\"normal N\" [0 1 0 0 1 0 0 1 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 2 1]\n\"point P\" [" << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 0 0 " << (maxY-minY)/facteur <<" 256 " << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 256]\n\"normal N\" [0 1 0 0 1 0 0 1 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [" << (maxX-minX)/facteur <<" 0 256 " << (maxX-minX)/facteur <<" 0 0 " << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 0]\n\"normal N\" [1 0 0 1 0 0 1 0 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [" << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 0 " << (maxX-minX)/facteur <<" 0 256 " << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 256]\n\"normal N\" [1 0 0 1 0 0 1 0 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [0 0 0 0 0 256 0 " << (maxY-minY)/facteur <<" 0]\n\"normal N\" [-1 0 0 -1 0 0 -1 0 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [0 0 256 0 " << (maxY-minY)/facteur <<" 0 0 " << (maxY-minY)/facteur <<" 256]\n\"normal N\" [-1 0 0 -1 0 0 -1 0 0]\n\nAttributeEnd\n";
 
-  //on inclut le fichier de geometrie
-  fichierSortiePhoton <<"\n#path to the geometry file \nAttributeBegin\nMaterial \"glass\"\nScale "<<(double)256/(maxZ-minZ)<< " " << (double)256/(maxZ - minZ)<<" " << (double)256/(maxZ-minZ)<<"\nTranslate " <<-minX << " " << -minY <<" " << -minZ <<"\nInclude \""<< fichierGeomPbrt <<"\"\nAttributeEnd\n\nWorldEnd";
 
-  cout <<"photon pbrt file generated" <<endl;
 
+//la fonction qui ecrit le maillage en nMorceaux fichiers de geometrie
+//spatialement compacts, que pbrt lit en parallele ("#pbrt shapes-only")
+void ecritFichierMorceaux(string fichierNoff, string fichier_sortie, string fichierGeomPbrt, int nMorceaux)
+{
+  //grille fine dont les cases sont parcourues dans l'ordre de Morton
+  const int nCases=16;
+  MaillageTrie m;
+  trieMaillage(fichierNoff, nCases, m, fichierGeomPbrt);
+  vector<pair<uint32_t,uint32_t> > ordre;
+  for (uint32_t z=0;z<nCases;z++)
+    for (uint32_t y=0;y<nCases;y++)
+      for (uint32_t x=0;x<nCases;x++){
+	uint32_t morton=0;
+	for (int bit=0;bit<4;bit++)
+	  morton|=(((x>>bit)&1)<<(3*bit))|(((y>>bit)&1)<<(3*bit+1))|(((z>>bit)&1)<<(3*bit+2));
+	ordre.push_back(make_pair(morton,(z*nCases+y)*nCases+x));
+      }
+  sort(ordre.begin(), ordre.end());
 
+  ofstream fichierSortieGeom(fichierGeomPbrt.c_str());
+  uint64_t cible=(m.nombreTriangles+nMorceaux-1)/nMorceaux, accumule(0);
+  size_t premiereCase(0);
+  int morceau(0);
+  for (size_t c=0;c<ordre.size();c++)
+    {
+      accumule+=m.compte[ordre[c].second+1]-m.compte[ordre[c].second];
+      if (accumule<cible*(morceau+1) && c+1<ordre.size()) continue;
+
+      //les faces des cases [premiereCase, c] forment un morceau
+      vector<int32_t> globaux;
+      for (size_t k=premiereCase;k<=c;k++)
+	for (uint64_t f=m.compte[ordre[k].second];f<m.compte[ordre[k].second+1];f++)
+	  for (int i=0;i<3;i++) globaux.push_back(m.faces[f].indices[i]);
+      premiereCase=c+1;
+      if (globaux.empty()) continue;
+      vector<int32_t> indices(globaux);
+      sort(globaux.begin(), globaux.end());
+      globaux.erase(unique(globaux.begin(), globaux.end()), globaux.end());
+
+      ostringstream nom;
+      nom << fichier_sortie << "Geometry_" << morceau << ".pbrt";
+      ofstream fichierMorceau(nom.str().c_str());
+      fichierMorceau << "#pbrt shapes-only\nShape \"trianglemesh\" \"point P\" [\n";
+      for (size_t v=0;v<globaux.size();v++)
+	fichierMorceau << m.sommets[6*globaux[v]] << " " << m.sommets[6*globaux[v]+1] << " " << m.sommets[6*globaux[v]+2] << "\n";
+      fichierMorceau << "] \"normal N\" [\n";
+      for (size_t v=0;v<globaux.size();v++)
+	fichierMorceau << m.sommets[6*globaux[v]+3] << " " << m.sommets[6*globaux[v]+4] << " " << m.sommets[6*globaux[v]+5] << "\n";
+      fichierMorceau << "] \"integer indices\" [";
+      for (size_t i=0;i<indices.size();i+=3){
+	for (int k=0;k<3;k++)
+	  fichierMorceau << lower_bound(globaux.begin(), globaux.end(), indices[i+k])-globaux.begin() << (k<2 ? " " : "\n");
+      }
+      fichierMorceau << "]";
+      fichierSortieGeom << "Include \"" << nom.str() << "\"\n";
+      morceau++;
+    }
+  libereMaillage(m);
+  cout << "geometry has been released in " << morceau << " files" << endl;
 }
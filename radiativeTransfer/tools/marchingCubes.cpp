@@ -0,0 +1,427 @@
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include "ImageContainerByMmapVol.h"
+
+
+using namespace std;
+
+#include "scenePbrt.h"
+#include "tableMarchingCubes.h"
+
+//surface d'un echantillon par marching cubes, a la place de vol2normalField :
+//le volume (.vol ou .raw) est seuille, eventuellement lisse par un noyau
+//gaussien, puis l'isosurface 0.5 du champ est extraite en parallele par
+//tranches de z, avec les normales des sommets donnees par le gradient du
+//champ. Sortie : les 3 fichiers de Noff2Pbrt, ou un fichier NOFF.
+
+
+double maintenant()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+
+//le champ aux centres des voxels (1 : glace, 0 : air), entoure d'une couche
+//d'air comme avec volAddBorder : la surface est toujours fermee
+struct Champ {
+  int nx, ny, nz;   //dimensions, couche d'air comprise
+  vector<float> v;
+  size_t indice(int x, int y, int z) const { return ((size_t)z*ny+y)*nx+x; }
+  float operator()(int x, int y, int z) const { return v[indice(x,y,z)]; }
+};
+
+
+//1) seuillage du volume projete en memoire
+struct TrancheLecture {
+  const unsigned char *voxels;
+  int nx, ny, seuilMin, seuilMax;
+  Champ *champ;
+  int z0, z1;
+};
+
+void *litTranche(void *arg)
+{
+  TrancheLecture &t=*(TrancheLecture *)arg;
+  Champ &c=*t.champ;
+  for (int z=t.z0;z<t.z1;z++)
+    for (int y=0;y<t.ny;y++){
+      const unsigned char *ligne=t.voxels+((size_t)z*t.ny+y)*t.nx;
+      float *sortie=&c.v[c.indice(1,y+1,z+1)];
+      for (int x=0;x<t.nx;x++)
+	sortie[x]=(ligne[x]>t.seuilMin && ligne[x]<=t.seuilMax);
+    }
+  return NULL;
+}
+
+
+//2) lissage gaussien separable, un axe a la fois : plans de z pour les
+//axes x et y, lignes de y pour l'axe z
+struct TrancheLissage {
+  Champ *champ;
+  const vector<float> *noyau;
+  int axe, debut, fin;
+};
+
+void *lisseTranche(void *arg)
+{
+  TrancheLissage &t=*(TrancheLissage *)arg;
+  Champ &c=*t.champ;
+  const vector<float> &noyau=*t.noyau;
+  int r=noyau.size()/2;
+  int longueur=t.axe==0 ? c.nx : (t.axe==1 ? c.ny : c.nz);
+  int nLignes=t.axe==0 ? c.ny : c.nx;
+  size_t pas=t.axe==0 ? 1 : (t.axe==1 ? c.nx : (size_t)c.nx*c.ny);
+  //hors de la grille le champ est nul
+  vector<float> tampon(longueur+2*r,0.f);
+  for (int i=t.debut;i<t.fin;i++)
+    for (int j=0;j<nLignes;j++){
+      float *ligne=&c.v[t.axe==0 ? c.indice(0,j,i) : (t.axe==1 ? c.indice(j,0,i) : c.indice(j,i,0))];
+      for (int l=0;l<longueur;l++) tampon[l+r]=ligne[l*pas];
+      for (int l=0;l<longueur;l++){
+	float somme=0;
+	for (int d=0;d<=2*r;d++) somme+=noyau[d]*tampon[l+d];
+	ligne[l*pas]=somme;
+      }
+    }
+  return NULL;
+}
+
+
+//3) marching cubes. Un sommet est sur une arete de la grille coupee par
+//l'isosurface, identifiee par son point origine et son axe ; il appartient
+//au plan de z de ce point. Les sommets sont numerotes plan par plan, dans
+//l'ordre (y, x, axe), et les triangles couche de cubes par couche : un
+//premier passage compte les sommets et les triangles de chaque plan pour
+//que chaque tranche connaisse ses premiers numeros.
+static inline bool glace(const Champ &c, int x, int y, int z)
+{
+  return c(x,y,z)>isovaleur;
+}
+
+static inline int configuration(const Champ &c, int x, int y, int z)
+{
+  int cas=0;
+  for (int k=0;k<8;k++)
+    if (glace(c,x+(k&1),y+((k>>1)&1),z+((k>>2)&1))) cas|=1<<k;
+  return cas;
+}
+
+struct TrancheComptage {
+  const Champ *champ;
+  int z0, z1;
+  uint64_t *sommetsPlan, *trianglesPlan;
+};
+
+void *compteTranche(void *arg)
+{
+  TrancheComptage &t=*(TrancheComptage *)arg;
+  const Champ &c=*t.champ;
+  for (int z=t.z0;z<t.z1;z++){
+    uint64_t sommets=0, nTriangles=0;
+    for (int y=0;y<c.ny;y++)
+      for (int x=0;x<c.nx;x++){
+	bool g=glace(c,x,y,z);
+	if (x+1<c.nx && glace(c,x+1,y,z)!=g) sommets++;
+	if (y+1<c.ny && glace(c,x,y+1,z)!=g) sommets++;
+	if (z+1<c.nz && glace(c,x,y,z+1)!=g) sommets++;
+	if (x+1<c.nx && y+1<c.ny && z+1<c.nz)
+	  nTriangles+=triangles[configuration(c,x,y,z)].size()/3;
+      }
+    t.sommetsPlan[z]=sommets;
+    t.trianglesPlan[z]=nTriangles;
+  }
+  return NULL;
+}
+
+//numeros des sommets du plan z (-1 : pas de sommet), 3 par point
+static void numerotePlan(const Champ &c, int z, int64_t premier, vector<int64_t> &numeros)
+{
+  for (int y=0;y<c.ny;y++)
+    for (int x=0;x<c.nx;x++){
+      int64_t *n=&numeros[3*((size_t)y*c.nx+x)];
+      bool g=glace(c,x,y,z);
+      n[0]=(x+1<c.nx && glace(c,x+1,y,z)!=g) ? premier++ : -1;
+      n[1]=(y+1<c.ny && glace(c,x,y+1,z)!=g) ? premier++ : -1;
+      n[2]=(z+1<c.nz && glace(c,x,y,z+1)!=g) ? premier++ : -1;
+    }
+}
+
+//gradient par differences centrees (decentrees sur le bord de la grille)
+static void gradient(const Champ &c, int x, int y, int z, float g[3])
+{
+  const int p[3]={x,y,z}, n[3]={c.nx,c.ny,c.nz};
+  for (int k=0;k<3;k++){
+    int a[3]={x,y,z}, b[3]={x,y,z};
+    a[k]=max(p[k]-1,0);
+    b[k]=min(p[k]+1,n[k]-1);
+    g[k]=(c(b[0],b[1],b[2])-c(a[0],a[1],a[2]))/(b[k]-a[k]);
+  }
+}
+
+struct TrancheSurface {
+  const Champ *champ;
+  int z0, z1;
+  const uint64_t *premierSommet, *premierTriangle;  //par plan
+  bool noff;
+  string sommets, normales, indices;
+  float bornes[2][3];
+};
+
+void *extraitTranche(void *arg)
+{
+  TrancheSurface &t=*(TrancheSurface *)arg;
+  const Champ &c=*t.champ;
+  for (int k=0;k<3;k++){ t.bornes[0][k]=FLT_MAX; t.bornes[1][k]=-FLT_MAX; }
+  uint64_t nSommets=t.premierSommet[t.z1]-t.premierSommet[t.z0];
+  uint64_t nTriangles=t.premierTriangle[t.z1]-t.premierTriangle[t.z0];
+  t.sommets.reserve(nSommets*(t.noff ? 40 : 20));
+  if (!t.noff) t.normales.reserve(nSommets*24);
+  t.indices.reserve(nTriangles*(t.noff ? 24 : 22));
+  vector<int64_t> plan((size_t)3*c.nx*c.ny), planSuivant((size_t)3*c.nx*c.ny);
+  if (t.z0<t.z1) numerotePlan(c,t.z0,t.premierSommet[t.z0],plan);
+
+  for (int z=t.z0;z<t.z1;z++){
+    //sommets du plan z, dans l'ordre de leurs numeros
+    for (int y=0;y<c.ny;y++)
+      for (int x=0;x<c.nx;x++){
+	const int64_t *n=&plan[3*((size_t)y*c.nx+x)];
+	for (int k=0;k<3;k++){
+	  if (n[k]<0) continue;
+	  int q[3]={x,y,z};
+	  q[k]++;
+	  float f0=c(x,y,z), f1=c(q[0],q[1],q[2]);
+	  float s=(isovaleur-f0)/(f1-f0);
+	  //position : les voxels sont les cubes unite, sans la couche d'air
+	  float p[3]={x-.5f,y-.5f,z-.5f};
+	  p[k]+=s;
+	  //normale vers l'air : oppose du gradient, interpole sur l'arete
+	  float g0[3], g1[3], m[3];
+	  gradient(c,x,y,z,g0);
+	  gradient(c,q[0],q[1],q[2],g1);
+	  for (int i=0;i<3;i++) m[i]=-((1-s)*g0[i]+s*g1[i]);
+	  float longueur=sqrt(m[0]*m[0]+m[1]*m[1]+m[2]*m[2]);
+	  if (longueur>0)
+	    for (int i=0;i<3;i++) m[i]/=longueur;
+	  else {
+	    m[0]=m[1]=m[2]=0;
+	    m[k]=f0>isovaleur ? 1 : -1;
+	  }
+	  for (int i=0;i<3;i++){
+	    t.bornes[0][i]=min(t.bornes[0][i],p[i]);
+	    t.bornes[1][i]=max(t.bornes[1][i],p[i]);
+	    ajouteReel(t.sommets,p[i]);
+	    t.sommets+=(i<2 || t.noff ? ' ' : '\n');
+	  }
+	  //NOFF : normales vers la glace, comme vol2normalField
+	  string &normales=t.noff ? t.sommets : t.normales;
+	  for (int i=0;i<3;i++){
+	    ajouteReel(normales,t.noff ? -m[i] : m[i]);
+	    normales+=(i<2 ? ' ' : '\n');
+	  }
+	}
+      }
+    if (z+1>=c.nz) break;
+
+    //triangles de la couche de cubes entre les plans z et z+1
+    numerotePlan(c,z+1,t.premierSommet[z+1],planSuivant);
+    for (int y=0;y+1<c.ny;y++)
+      for (int x=0;x+1<c.nx;x++){
+	const vector<unsigned char> &aretes=triangles[configuration(c,x,y,z)];
+	for (size_t i=0;i<aretes.size();i+=3){
+	  if (t.noff) t.indices+="3 ";
+	  for (int j=0;j<3;j++){
+	    int a=aretes[i+j], coin=coinsArete[a][0];
+	    const vector<int64_t> &numeros=(coin&4) ? planSuivant : plan;
+	    ajouteEntier(t.indices,numeros[3*((size_t)(y+((coin>>1)&1))*c.nx+x+(coin&1))+axeArete[a]]);
+	    t.indices+=(j<2 ? ' ' : '\n');
+	  }
+	}
+      }
+    plan.swap(planSuivant);
+  }
+  return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+  string fichierVolume, fichier_sortie;
+  int nx(0), ny(0), nz(0);
+  //seuils de vol2normalField : la glace est dans ]seuilMin, seuilMax]
+  int seuilMin(0), seuilMax(255), nThreads(0);
+  float sigma(1), tempsApercu(0);
+  bool noff(false);
+  const char *syntaxe="syntax : <command> -i input.vol -o output [-x dimX -y dimY -z dimZ (input.raw)] [--min m] [--max M] [--sigma s] [--noff] [--preview seconds] [--threads n]\n";
+
+  for (int i=1; i<argc;i++){
+    if (!strcmp(argv[i],"--help") || !strcmp(argv[i],"-h")){cout << syntaxe; return 0;}
+    else if ((!strcmp(argv[i],"--input") || !strcmp(argv[i],"-i")) && i+1<argc) fichierVolume=argv[++i];
+    else if ((!strcmp(argv[i],"--output") || !strcmp(argv[i],"-o")) && i+1<argc) fichier_sortie=argv[++i];
+    else if (!strcmp(argv[i],"-x") && i+1<argc) nx=atoi(argv[++i]);
+    else if (!strcmp(argv[i],"-y") && i+1<argc) ny=atoi(argv[++i]);
+    else if (!strcmp(argv[i],"-z") && i+1<argc) nz=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--min") || !strcmp(argv[i],"-m")) && i+1<argc) seuilMin=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--max") || !strcmp(argv[i],"-M")) && i+1<argc) seuilMax=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--sigma") || !strcmp(argv[i],"-s")) && i+1<argc) sigma=atof(argv[++i]);
+    else if (!strcmp(argv[i],"--noff")) noff=true;
+    else if ((!strcmp(argv[i],"--preview") || !strcmp(argv[i],"-p")) && i+1<argc) tempsApercu=atof(argv[++i]);
+    else if ((!strcmp(argv[i],"--threads") || !strcmp(argv[i],"-j")) && i+1<argc) nThreads=atoi(argv[++i]);
+  }
+  if (fichierVolume.empty() || fichier_sortie.empty() || sigma<0){
+    cout << syntaxe;
+    exit(1);
+  }
+  int n=nThreads>0 ? nThreads : max(1L,sysconf(_SC_NPROCESSORS_ONLN));
+  double debut=maintenant(), etape=debut;
+  construitTable();
+
+  //1) lecture et seuillage : sans -x -y -z, le fichier est un .vol
+  size_t entete=0;
+  if (nx<=0 || ny<=0 || nz<=0){
+    int dimensions[3];
+    if (!DGtal::readVolHeader(fichierVolume,dimensions,entete)){cout << fichierVolume << " is not a vol file" << endl; exit(3);}
+    nx=dimensions[0]; ny=dimensions[1]; nz=dimensions[2];
+  }
+  int descripteur=open(fichierVolume.c_str(),O_RDONLY);
+  struct stat infos;
+  if (descripteur<0 || fstat(descripteur,&infos)!=0){cout << "unable to open " << fichierVolume << endl; exit(3);}
+  size_t taille=entete+(size_t)nx*ny*nz;
+  if ((size_t)infos.st_size<taille){cout << fichierVolume << " is smaller than " << nx << "*" << ny << "*" << nz << " voxels" << endl; exit(3);}
+  const unsigned char *fichier=(const unsigned char *)mmap(NULL, taille, PROT_READ, MAP_PRIVATE, descripteur, 0);
+  if (fichier==MAP_FAILED){cout << "unable to map " << fichierVolume << endl; exit(3);}
+  madvise((void *)fichier, taille, MADV_SEQUENTIAL);
+
+  Champ champ;
+  champ.nx=nx+2; champ.ny=ny+2; champ.nz=nz+2;
+  champ.v.assign((size_t)champ.nx*champ.ny*champ.nz,0.f);
+  int nTranches=min(n,nz);
+  vector<TrancheLecture> lectures(nTranches);
+  for (int i=0;i<nTranches;i++){
+    TrancheLecture &t=lectures[i];
+    t.voxels=fichier+entete; t.nx=nx; t.ny=ny;
+    t.seuilMin=seuilMin; t.seuilMax=seuilMax; t.champ=&champ;
+    t.z0=(int)((long)nz*i/nTranches);
+    t.z1=(int)((long)nz*(i+1)/nTranches);
+  }
+  executeEnParallele(&lectures[0], nTranches, litTranche);
+  munmap((void *)fichier, taille);
+  close(descripteur);
+  cout << "volume " << nx << "*" << ny << "*" << nz << " read in " << maintenant()-etape << " s" << endl;
+  etape=maintenant();
+
+  //2) lissage, puis la couche d'air est remise a zero pour fermer la surface
+  if (sigma>0){
+    int r=(int)ceil(3*sigma);
+    vector<float> noyau(2*r+1);
+    float somme=0;
+    for (int d=-r;d<=r;d++) somme+=noyau[d+r]=exp(-d*d/(2*sigma*sigma));
+    for (int d=0;d<=2*r;d++) noyau[d]/=somme;
+    for (int axe=0;axe<3;axe++){
+      int nLignes=axe<2 ? champ.nz : champ.ny;
+      int nLissages=min(n,nLignes);
+      vector<TrancheLissage> lissages(nLissages);
+      for (int i=0;i<nLissages;i++){
+	TrancheLissage &t=lissages[i];
+	t.champ=&champ; t.noyau=&noyau; t.axe=axe;
+	t.debut=(int)((long)nLignes*i/nLissages);
+	t.fin=(int)((long)nLignes*(i+1)/nLissages);
+      }
+      executeEnParallele(&lissages[0], nLissages, lisseTranche);
+    }
+    for (int z=0;z<champ.nz;z++)
+      for (int y=0;y<champ.ny;y++)
+	for (int x=0;x<champ.nx;x++){
+	  if (z>0 && z+1<champ.nz && y>0 && y+1<champ.ny && x==1) x=champ.nx-1;
+	  champ.v[champ.indice(x,y,z)]=0;
+	}
+    cout << "field smoothed (sigma " << sigma << ") in " << maintenant()-etape << " s" << endl;
+    etape=maintenant();
+  }
+
+  //3) marching cubes : comptage par plan, puis extraction par tranches
+  nTranches=min(n,champ.nz);
+  vector<uint64_t> sommetsPlan(champ.nz), trianglesPlan(champ.nz);
+  vector<TrancheComptage> comptages(nTranches);
+  for (int i=0;i<nTranches;i++){
+    TrancheComptage &t=comptages[i];
+    t.champ=&champ; t.sommetsPlan=&sommetsPlan[0]; t.trianglesPlan=&trianglesPlan[0];
+    t.z0=(int)((long)champ.nz*i/nTranches);
+    t.z1=(int)((long)champ.nz*(i+1)/nTranches);
+  }
+  executeEnParallele(&comptages[0], nTranches, compteTranche);
+  vector<uint64_t> premierSommet(champ.nz+1,0), premierTriangle(champ.nz+1,0);
+  for (int z=0;z<champ.nz;z++){
+    premierSommet[z+1]=premierSommet[z]+sommetsPlan[z];
+    premierTriangle[z+1]=premierTriangle[z]+trianglesPlan[z];
+  }
+  uint64_t nombreSommets=premierSommet[champ.nz], nombreTriangles=premierTriangle[champ.nz];
+
+  vector<TrancheSurface> surfaces(nTranches);
+  for (int i=0;i<nTranches;i++){
+    TrancheSurface &t=surfaces[i];
+    t.champ=&champ; t.noff=noff;
+    t.premierSommet=&premierSommet[0]; t.premierTriangle=&premierTriangle[0];
+    t.z0=comptages[i].z0; t.z1=comptages[i].z1;
+  }
+  executeEnParallele(&surfaces[0], nTranches, extraitTranche);
+  vector<float>().swap(champ.v);
+  if (nombreSommets>0){
+    float bornes[2][3]={{FLT_MAX,FLT_MAX,FLT_MAX},{-FLT_MAX,-FLT_MAX,-FLT_MAX}};
+    for (int i=0;i<nTranches;i++)
+      for (int k=0;k<3;k++){
+	bornes[0][k]=min(bornes[0][k],surfaces[i].bornes[0][k]);
+	bornes[1][k]=max(bornes[1][k],surfaces[i].bornes[1][k]);
+      }
+    minX=bornes[0][0]; minY=bornes[0][1]; minZ=bornes[0][2];
+    maxX=bornes[1][0]; maxY=bornes[1][1]; maxZ=bornes[1][2];
+  }
+  cout << nombreTriangles << " triangles and " << nombreSommets << " vertices extracted in " << maintenant()-etape << " s" << endl;
+  etape=maintenant();
+
+  //4) fichiers de sortie
+  if (noff){
+    string fichierNoff=fichier_sortie+".off";
+    FILE *sortie=fopen(fichierNoff.c_str(),"wb");
+    if (!sortie){cout << "unable to create " << fichierNoff << endl; exit(3);}
+    fprintf(sortie, "NOFF\n%llu %llu 0\n", (unsigned long long)nombreSommets, (unsigned long long)nombreTriangles);
+    for (int i=0;i<nTranches;i++) fwrite(surfaces[i].sommets.data(), 1, surfaces[i].sommets.size(), sortie);
+    for (int i=0;i<nTranches;i++) fwrite(surfaces[i].indices.data(), 1, surfaces[i].indices.size(), sortie);
+    fclose(sortie);
+    cout << "mesh " << fichierNoff << " written in " << maintenant()-etape << " s" << endl;
+    return 0;
+  }
+  string fichierGeomPbrt=fichier_sortie+"Geometry.pbrt";
+  FILE *fichierSortieGeom=fopen(fichierGeomPbrt.c_str(),"wb");
+  if (!fichierSortieGeom){cout << "unable to create " << fichierGeomPbrt << endl; exit(3);}
+  fputs("Shape \"trianglemesh\" \"point P\" [ \n", fichierSortieGeom);
+  for (int i=0;i<nTranches;i++) fwrite(surfaces[i].sommets.data(), 1, surfaces[i].sommets.size(), fichierSortieGeom);
+  fputs("] \"normal N\" [\n", fichierSortieGeom);
+  for (int i=0;i<nTranches;i++) fwrite(surfaces[i].normales.data(), 1, surfaces[i].normales.size(), fichierSortieGeom);
+  fputs("] \"integer indices\" [", fichierSortieGeom);
+  for (int i=0;i<nTranches;i++) fwrite(surfaces[i].indices.data(), 1, surfaces[i].indices.size(), fichierSortieGeom);
+  fputs("]", fichierSortieGeom);
+  fclose(fichierSortieGeom);
+  ecritFichierPbrt(fichier_sortie+"Image.pbrt",fichierGeomPbrt,fichier_sortie+".exr",tempsApercu);
+  ecritFichierPhoton(fichier_sortie+"Photon.pbrt",fichierGeomPbrt);
+  cout << "scene files written in " << maintenant()-etape << " s" << endl;
+
+  cout << "surface extracted in " << maintenant()-debut << " s ; photon launcher : pbrt -p -w <wavelength> -x " << nx << " -y " << ny << " -z " << nz << " -r <voxel size> " << fichier_sortie << "Photon.pbrt" << endl;
+  return 0;
+}
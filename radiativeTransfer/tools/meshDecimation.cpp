@@ -0,0 +1,562 @@
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <vector>
+#include <queue>
+#include <sstream>
+#include <cstdio>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+
+using namespace std;
+
+#include "scenePbrt.h"
+
+//decimation d'un maillage NOFF (vol2normalField, marchingCubes --noff) avant
+//Noff2Pbrt : les sommets identiques sont fusionnes, puis les aretes sont
+//contractees par ordre d'erreur quadrique (Garland et Heckbert) tant que la
+//distance aux plans des triangles d'origine reste sous la tolerance et que
+//les normales des triangles ne tournent pas plus que l'angle donne. Une
+//contraction garde l'un des deux sommets (avec sa position et sa normale) ;
+//les sommets du bord ne bougent pas et la condition de lien conserve la
+//topologie. Le maillage est decoupe en tranches traitees en parallele,
+//puis les tranches sont decalees d'une demi-largeur pour traiter les
+//coutures.
+
+
+double maintenant()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+
+struct Maillage {
+  vector<float> points, normales;  //3 par sommet
+  vector<int> triangles;           //3 par triangle
+};
+
+
+//lecture du fichier NOFF (ou OFF, les normales sont alors nulles) ;
+//les polygones sont triangules en eventail
+static const char *sauteBlancs(const char *p, const char *fin)
+{
+  while (p<fin){
+    if (*p=='#') while (p<fin && *p!='\n') p++;
+    else if (isspace((unsigned char)*p)) p++;
+    else break;
+  }
+  return p;
+}
+
+bool litNoff(const string &fichier, Maillage &m)
+{
+  FILE *entree=fopen(fichier.c_str(),"rb");
+  struct stat infos;
+  if (!entree) return false;
+  if (fstat(fileno(entree),&infos)!=0 || infos.st_size==0){ fclose(entree); return false; }
+  //un octet nul apres le fichier arrete strtod
+  vector<char> contenu(infos.st_size+1,0);
+  bool lu=fread(&contenu[0],1,infos.st_size,entree)==(size_t)infos.st_size;
+  fclose(entree);
+  if (!lu) return false;
+  const char *debut=&contenu[0];
+  const char *fin=debut+infos.st_size, *p=sauteBlancs(debut,fin);
+  bool normales=!strncmp(p,"NOFF",4);
+  if (!normales && strncmp(p,"OFF",3)) return false;
+  p+=normales ? 4 : 3;
+  char *suite;
+  long nSommets=strtol(p,&suite,10), nFaces=strtol(suite,&suite,10);
+  strtol(suite,&suite,10);
+  p=suite;
+  m.points.resize(3*nSommets);
+  m.normales.assign(3*nSommets,0.f);
+  for (long i=0;i<nSommets && p<fin;i++){
+    for (int k=0;k<3;k++){ m.points[3*i+k]=strtof(p,&suite); p=suite; }
+    if (normales)
+      for (int k=0;k<3;k++){ m.normales[3*i+k]=strtof(p,&suite); p=suite; }
+  }
+  m.triangles.reserve(6*nFaces);
+  bool correct=true;
+  for (long i=0;i<nFaces && p<fin;i++){
+    long n=strtol(p,&suite,10);
+    p=suite;
+    long s0=strtol(p,&suite,10), s1=strtol(suite,&suite,10);
+    p=suite;
+    for (long j=2;j<n;j++){
+      long s2=strtol(p,&suite,10);
+      p=suite;
+      if (s0<0 || s1<0 || s2<0 || s0>=nSommets || s1>=nSommets || s2>=nSommets) correct=false;
+      m.triangles.push_back(s0); m.triangles.push_back(s1); m.triangles.push_back(s2);
+      s1=s2;
+    }
+  }
+  return correct;
+}
+
+
+//fusion des sommets de meme position (un noff de vol2normalField a 4
+//sommets par surfel) : la normale est la moyenne des normales fusionnees ;
+//les triangles devenus degeneres sont supprimes
+struct OrdrePoints {
+  const float *p;
+  bool operator()(int a, int b) const {
+    for (int k=0;k<3;k++)
+      if (p[3*a+k]!=p[3*b+k]) return p[3*a+k]<p[3*b+k];
+    return a<b;
+  }
+};
+
+void fusionne(Maillage &m)
+{
+  size_t n=m.points.size()/3;
+  vector<int> ordre(n), nouveau(n);
+  for (size_t i=0;i<n;i++) ordre[i]=i;
+  OrdrePoints o; o.p=&m.points[0];
+  sort(ordre.begin(), ordre.end(), o);
+  vector<float> points, normales;
+  for (size_t i=0;i<n;i++){
+    int s=ordre[i];
+    bool meme=i>0 && !memcmp(&m.points[3*s],&m.points[3*ordre[i-1]],3*sizeof(float));
+    if (!meme){
+      for (int k=0;k<3;k++){ points.push_back(m.points[3*s+k]); normales.push_back(0.f); }
+    }
+    nouveau[s]=points.size()/3-1;
+    for (int k=0;k<3;k++) normales[normales.size()-3+k]+=m.normales[3*s+k];
+  }
+  for (size_t i=0;i<normales.size();i+=3){
+    float l=sqrt(normales[i]*normales[i]+normales[i+1]*normales[i+1]+normales[i+2]*normales[i+2]);
+    if (l>0) for (int k=0;k<3;k++) normales[i+k]/=l;
+  }
+  size_t t=0;
+  for (size_t i=0;i<m.triangles.size();i+=3){
+    int a=nouveau[m.triangles[i]], b=nouveau[m.triangles[i+1]], c=nouveau[m.triangles[i+2]];
+    if (a==b || b==c || a==c) continue;
+    m.triangles[t++]=a; m.triangles[t++]=b; m.triangles[t++]=c;
+  }
+  m.triangles.resize(t);
+  m.points.swap(points);
+  m.normales.swap(normales);
+}
+
+
+//quadrique : somme des carres des distances a des plans, matrice 4x4
+//symetrique (10 coefficients)
+struct Quadrique {
+  double q[10];
+  void plan(const double n[3], double d) {
+    q[0]=n[0]*n[0]; q[1]=n[0]*n[1]; q[2]=n[0]*n[2]; q[3]=n[0]*d;
+    q[4]=n[1]*n[1]; q[5]=n[1]*n[2]; q[6]=n[1]*d;
+    q[7]=n[2]*n[2]; q[8]=n[2]*d; q[9]=d*d;
+  }
+  void ajoute(const Quadrique &o) { for (int i=0;i<10;i++) q[i]+=o.q[i]; }
+  double erreur(const float p[3]) const {
+    double x=p[0], y=p[1], z=p[2];
+    return x*(q[0]*x+2*(q[1]*y+q[2]*z+q[3])) + y*(q[4]*y+2*(q[5]*z+q[6])) + z*(q[7]*z+2*q[8]) + q[9];
+  }
+};
+
+static void normaleTriangle(const float *a, const float *b, const float *c, double n[3])
+{
+  double u[3], v[3];
+  for (int k=0;k<3;k++){ u[k]=b[k]-a[k]; v[k]=c[k]-a[k]; }
+  n[0]=u[1]*v[2]-u[2]*v[1];
+  n[1]=u[2]*v[0]-u[0]*v[2];
+  n[2]=u[0]*v[1]-u[1]*v[0];
+}
+
+
+//valence maximale d'un sommet apres contraction
+static const size_t valenceMax=12;
+
+//meilleure contraction du sommet u (sur le sommet v) ; la version de u
+//invalide les candidates perimees
+struct Candidate {
+  double erreur;
+  int u, v;
+  unsigned int version;
+  bool operator<(const Candidate &o) const { return erreur>o.erreur; }
+};
+
+
+//une tranche de l'espace : ses triangles (numeros globaux des sommets)
+//sont decimes sans toucher aux autres tranches
+struct Tranche {
+  const Maillage *maillage;
+  const vector<char> *bloques;   //sommets des triangles a cheval sur deux tranches
+  double tolerance2, cosAngle;
+  vector<int> triangles;
+  size_t contractions;
+
+  //maillage local
+  vector<int> globaux;           //numero global de chaque sommet local
+  vector<int> faces;             //3 sommets locaux par triangle
+  vector<float> normalesFaces;   //normale d'origine de chaque triangle
+  vector<char> vivante, fixe;
+  vector<vector<int> > facesSommet;
+  vector<Quadrique> quadriques;
+  vector<unsigned int> versions;
+  priority_queue<Candidate> candidates;
+
+  const float *position(int s) const { return &maillage->points[3*globaux[s]]; }
+  void voisins(int s, vector<int> &v) const;
+  bool contractable(int u, int v, vector<int> &vu, vector<int> &vv) const;
+  void cibles(int u, vector<int> &v, vector<pair<double,int> > &c) const;
+  void evalue(int u, vector<int> &v, vector<pair<double,int> > &c);
+  void contracte(int u, int w);
+  void decime();
+};
+
+//sommets voisins de s, tries
+void Tranche::voisins(int s, vector<int> &v) const
+{
+  v.clear();
+  const vector<int> &f=facesSommet[s];
+  for (size_t i=0;i<f.size();i++)
+    if (vivante[f[i]])
+      for (int k=0;k<3;k++)
+	if (faces[3*f[i]+k]!=s) v.push_back(faces[3*f[i]+k]);
+  sort(v.begin(), v.end());
+  v.erase(unique(v.begin(), v.end()), v.end());
+}
+
+//la contraction de u sur v garde-t-elle la topologie, la tolerance et les
+//normales ?
+bool Tranche::contractable(int u, int v, vector<int> &vu, vector<int> &vv) const
+{
+  if (fixe[u]) return false;
+  Quadrique q=quadriques[u];
+  q.ajoute(quadriques[v]);
+  if (q.erreur(position(v))>tolerance2) return false;
+
+  //condition de lien : les voisins communs de u et v sont exactement les
+  //sommets opposes a l'arete uv, qui en a deux ; ceux-ci doivent garder au
+  //moins 3 voisins
+  voisins(u,vu);
+  voisins(v,vv);
+  vector<int> communs;
+  set_intersection(vu.begin(), vu.end(), vv.begin(), vv.end(), back_inserter(communs));
+  int opposes=0;
+  const vector<int> &fu=facesSommet[u];
+  for (size_t i=0;i<fu.size();i++){
+    int f=fu[i];
+    if (!vivante[f]) continue;
+    const int *s=&faces[3*f];
+    if (s[0]!=v && s[1]!=v && s[2]!=v) continue;
+    opposes++;
+    int w=s[0]!=u && s[0]!=v ? s[0] : (s[1]!=u && s[1]!=v ? s[1] : s[2]);
+    if (!binary_search(communs.begin(), communs.end(), w)) return false;
+  }
+  if (opposes!=2 || communs.size()!=2) return false;
+  //w herite des voisins de u : pas d'eventails de triangles effiles
+  if (vu.size()+vv.size()-4>valenceMax) return false;
+  vector<int> vw;
+  for (int i=0;i<2;i++){
+    voisins(communs[i],vw);
+    if (vw.size()<=3) return false;
+  }
+
+  //les triangles qui restent autour de u ne doivent pas trop tourner par
+  //rapport a leur normale d'origine (ce qui exclut aussi les retournements)
+  for (size_t i=0;i<fu.size();i++){
+    int f=fu[i];
+    if (!vivante[f]) continue;
+    const int *s=&faces[3*f];
+    if (s[0]==v || s[1]==v || s[2]==v) continue;
+    const float *p[3];
+    for (int k=0;k<3;k++) p[k]=position(s[k]==u ? v : s[k]);
+    double n[3];
+    normaleTriangle(p[0],p[1],p[2],n);
+    double l=sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+    const float *o=&normalesFaces[3*f];
+    if (l==0 || (n[0]*o[0]+n[1]*o[1]+n[2]*o[2])<cosAngle*l) return false;
+  }
+  return true;
+}
+
+//contractions de u dans la tolerance, par erreur croissante ; a erreur
+//egale (zones planes), les aretes courtes d'abord
+void Tranche::cibles(int u, vector<int> &v, vector<pair<double,int> > &c) const
+{
+  c.clear();
+  if (fixe[u] || facesSommet[u].empty()) return;
+  voisins(u,v);
+  const float *a=position(u);
+  for (size_t i=0;i<v.size();i++){
+    Quadrique q=quadriques[u];
+    q.ajoute(quadriques[v[i]]);
+    const float *b=position(v[i]);
+    double erreur=q.erreur(b);
+    if (erreur>tolerance2) continue;
+    double longueur2=(a[0]-b[0])*(a[0]-b[0])+(a[1]-b[1])*(a[1]-b[1])+(a[2]-b[2])*(a[2]-b[2]);
+    c.push_back(make_pair(erreur+1e-6*longueur2,v[i]));
+  }
+}
+
+//nouvelle meilleure contraction de u
+void Tranche::evalue(int u, vector<int> &v, vector<pair<double,int> > &c)
+{
+  versions[u]++;
+  cibles(u,v,c);
+  if (c.empty()) return;
+  Candidate meilleure;
+  meilleure.erreur=DBL_MAX;
+  for (size_t i=0;i<c.size();i++)
+    if (c[i].first<meilleure.erreur){ meilleure.erreur=c[i].first; meilleure.v=c[i].second; }
+  meilleure.u=u;
+  meilleure.version=versions[u];
+  candidates.push(meilleure);
+}
+
+//les triangles de l'arete uw disparaissent, les autres triangles de u
+//passent a w
+void Tranche::contracte(int u, int w)
+{
+  vector<int> &fu=facesSommet[u];
+  for (size_t i=0;i<fu.size();i++){
+    int f=fu[i];
+    if (!vivante[f]) continue;
+    int *s=&faces[3*f];
+    if (s[0]==w || s[1]==w || s[2]==w){ vivante[f]=0; continue; }
+    for (int k=0;k<3;k++) if (s[k]==u) s[k]=w;
+    facesSommet[w].push_back(f);
+  }
+  vector<int>().swap(fu);
+  vector<int> &fw=facesSommet[w];
+  size_t t=0;
+  for (size_t i=0;i<fw.size();i++) if (vivante[fw[i]]) fw[t++]=fw[i];
+  fw.resize(t);
+  quadriques[w].ajoute(quadriques[u]);
+  versions[u]++;
+  contractions++;
+}
+
+void Tranche::decime()
+{
+  contractions=0;
+  //numerotation locale des sommets
+  vector<int> locaux(maillage->points.size()/3,-1);
+  globaux.clear();
+  faces.resize(triangles.size());
+  for (size_t i=0;i<triangles.size();i++){
+    int &l=locaux[triangles[i]];
+    if (l<0){ l=globaux.size(); globaux.push_back(triangles[i]); }
+    faces[i]=l;
+  }
+  vector<int>().swap(locaux);
+  size_t nSommets=globaux.size(), nFaces=triangles.size()/3;
+
+  facesSommet.assign(nSommets, vector<int>());
+  {
+    vector<int> valences(nSommets,0);
+    for (size_t i=0;i<faces.size();i++) valences[faces[i]]++;
+    for (size_t s=0;s<nSommets;s++) facesSommet[s].reserve(valences[s]);
+  }
+  quadriques.assign(nSommets, Quadrique());
+  for (size_t s=0;s<nSommets;s++) memset(quadriques[s].q, 0, sizeof(quadriques[s].q));
+  normalesFaces.resize(3*nFaces);
+  vivante.assign(nFaces,1);
+  for (size_t f=0;f<nFaces;f++){
+    double n[3];
+    normaleTriangle(position(faces[3*f]),position(faces[3*f+1]),position(faces[3*f+2]),n);
+    double l=sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+    if (l>0) for (int k=0;k<3;k++) n[k]/=l;
+    for (int k=0;k<3;k++) normalesFaces[3*f+k]=n[k];
+    Quadrique q;
+    const float *a=position(faces[3*f]);
+    q.plan(n, -(n[0]*a[0]+n[1]*a[1]+n[2]*a[2]));
+    for (int k=0;k<3;k++){
+      facesSommet[faces[3*f+k]].push_back(f);
+      quadriques[faces[3*f+k]].ajoute(q);
+    }
+  }
+
+  //sommets fixes : bords de la tranche (aretes d'un seul triangle local),
+  //aretes non manifold et sommets bloques par les autres tranches
+  fixe.assign(nSommets,0);
+  for (size_t s=0;s<nSommets;s++) fixe[s]=(*bloques)[globaux[s]];
+  for (size_t f=0;f<nFaces;f++)
+    for (int k=0;k<3;k++){
+      int a=faces[3*f+k], b=faces[3*f+(k+1)%3], n=0;
+      const vector<int> &fa=facesSommet[a];
+      for (size_t i=0;i<fa.size();i++){
+	const int *t=&faces[3*fa[i]];
+	if (t[0]==b || t[1]==b || t[2]==b) n++;
+      }
+      if (n!=2) fixe[a]=fixe[b]=1;
+    }
+
+  versions.assign(nSommets,0);
+  vector<int> v, vu, vv;
+  vector<pair<double,int> > c;
+  for (size_t s=0;s<nSommets;s++) evalue(s,v,c);
+
+  while (!candidates.empty()){
+    Candidate meilleure=candidates.top();
+    candidates.pop();
+    int u=meilleure.u, w=meilleure.v;
+    if (meilleure.version!=versions[u]) continue;
+    if (!contractable(u,w,vu,vv)){
+      //les autres contractions de u, tant que son voisinage ne change pas
+      cibles(u,v,c);
+      sort(c.begin(), c.end());
+      w=-1;
+      for (size_t i=0;i<c.size() && w<0;i++)
+	if (c[i].second!=meilleure.v && contractable(u,c[i].second,vu,vv)) w=c[i].second;
+      if (w<0) continue;
+    }
+    contracte(u,w);
+    //w et ses voisins ont une nouvelle meilleure contraction
+    evalue(w,v,c);
+    vector<int> voisinsW(v);
+    for (size_t i=0;i<voisinsW.size();i++) evalue(voisinsW[i],v,c);
+  }
+
+  //resultat en numeros globaux
+  size_t t=0;
+  for (size_t f=0;f<nFaces;f++)
+    if (vivante[f])
+      for (int k=0;k<3;k++) triangles[t++]=globaux[faces[3*f+k]];
+  triangles.resize(t);
+  //memoire du maillage local
+  vector<vector<int> >().swap(facesSommet);
+  vector<Quadrique>().swap(quadriques);
+  vector<int>().swap(faces);
+  priority_queue<Candidate>().swap(candidates);
+}
+
+void *decimeTranche(void *arg)
+{
+  ((Tranche *)arg)->decime();
+  return NULL;
+}
+
+
+//un passage : le maillage est coupe en tranches le long de son plus grand
+//axe (decalees de decalage largeurs de tranche), chaque tranche est decimee
+//en parallele ; les triangles a cheval sur deux tranches restent tels quels
+size_t passage(Maillage &m, int nTranches, float decalage, double tolerance, double angle)
+{
+  size_t nSommets=m.points.size()/3;
+  float bornes[2][3]={{FLT_MAX,FLT_MAX,FLT_MAX},{-FLT_MAX,-FLT_MAX,-FLT_MAX}};
+  for (size_t s=0;s<nSommets;s++)
+    for (int k=0;k<3;k++){
+      bornes[0][k]=min(bornes[0][k],m.points[3*s+k]);
+      bornes[1][k]=max(bornes[1][k],m.points[3*s+k]);
+    }
+  int axe=0;
+  for (int k=1;k<3;k++) if (bornes[1][k]-bornes[0][k]>bornes[1][axe]-bornes[0][axe]) axe=k;
+  float largeur=max((bornes[1][axe]-bornes[0][axe])/nTranches,FLT_MIN);
+  if (decalage>0) nTranches++;
+  vector<int> tranche(nSommets);
+  for (size_t s=0;s<nSommets;s++){
+    int i=(int)floor((m.points[3*s+axe]-bornes[0][axe])/largeur+decalage);
+    tranche[s]=max(0,min(nTranches-1,i));
+  }
+
+  vector<Tranche> tranches(nTranches);
+  vector<char> bloques(nSommets,0);
+  vector<int> coutures;
+  for (size_t i=0;i<m.triangles.size();i+=3){
+    int a=m.triangles[i], b=m.triangles[i+1], c=m.triangles[i+2];
+    if (tranche[a]==tranche[b] && tranche[a]==tranche[c]){
+      vector<int> &t=tranches[tranche[a]].triangles;
+      t.push_back(a); t.push_back(b); t.push_back(c);
+    }
+    else {
+      bloques[a]=bloques[b]=bloques[c]=1;
+      coutures.push_back(a); coutures.push_back(b); coutures.push_back(c);
+    }
+  }
+  for (int i=0;i<nTranches;i++){
+    tranches[i].maillage=&m;
+    tranches[i].bloques=&bloques;
+    tranches[i].tolerance2=tolerance*tolerance;
+    tranches[i].cosAngle=cos(angle*M_PI/180);
+  }
+  executeEnParallele(&tranches[0], nTranches, decimeTranche);
+
+  size_t contractions=0;
+  m.triangles.swap(coutures);
+  for (int i=0;i<nTranches;i++){
+    m.triangles.insert(m.triangles.end(), tranches[i].triangles.begin(), tranches[i].triangles.end());
+    contractions+=tranches[i].contractions;
+  }
+  return contractions;
+}
+
+
+int main(int argc, char *argv[])
+{
+  string fichierEntree, fichierSortie;
+  double tolerance(0.5), angle(15);
+  int nThreads(0);
+  const char *syntaxe="syntax : <command> -i input.off -o output.off [--tolerance voxels] [--angle degrees] [--threads n]\n";
+
+  for (int i=1; i<argc;i++){
+    if (!strcmp(argv[i],"--help") || !strcmp(argv[i],"-h")){cout << syntaxe; return 0;}
+    else if ((!strcmp(argv[i],"--input") || !strcmp(argv[i],"-i")) && i+1<argc) fichierEntree=argv[++i];
+    else if ((!strcmp(argv[i],"--output") || !strcmp(argv[i],"-o")) && i+1<argc) fichierSortie=argv[++i];
+    else if ((!strcmp(argv[i],"--tolerance") || !strcmp(argv[i],"-t")) && i+1<argc) tolerance=atof(argv[++i]);
+    else if ((!strcmp(argv[i],"--angle") || !strcmp(argv[i],"-a")) && i+1<argc) angle=atof(argv[++i]);
+    else if ((!strcmp(argv[i],"--threads") || !strcmp(argv[i],"-j")) && i+1<argc) nThreads=atoi(argv[++i]);
+  }
+  if (fichierEntree.empty() || fichierSortie.empty() || tolerance<0 || angle<0){
+    cout << syntaxe;
+    exit(1);
+  }
+  int n=nThreads>0 ? nThreads : max(1L,sysconf(_SC_NPROCESSORS_ONLN));
+  double debut=maintenant(), etape=debut;
+
+  Maillage m;
+  if (!litNoff(fichierEntree,m)){cout << "unable to read the mesh " << fichierEntree << endl; exit(3);}
+  size_t trianglesEntree=m.triangles.size()/3;
+  fusionne(m);
+  cout << trianglesEntree << " triangles read, " << m.points.size()/3 << " vertices after welding, in " << maintenant()-etape << " s" << endl;
+  etape=maintenant();
+
+  //les coutures du premier passage sont au milieu des tranches du second
+  size_t contractions=passage(m,n,0,tolerance,angle);
+  if (n>1) contractions+=passage(m,n,0.5f,tolerance,angle);
+  cout << contractions << " edges collapsed in " << maintenant()-etape << " s : " << trianglesEntree << " -> " << m.triangles.size()/3 << " triangles" << endl;
+  etape=maintenant();
+
+  //ecriture des sommets restants, renumerotes
+  size_t nSommets=m.points.size()/3;
+  vector<int64_t> numero(nSommets,-1);
+  int64_t nUtilises=0;
+  for (size_t i=0;i<m.triangles.size();i++)
+    if (numero[m.triangles[i]]<0) numero[m.triangles[i]]=0;
+  for (size_t s=0;s<nSommets;s++) if (numero[s]==0) numero[s]=++nUtilises;
+  string texte;
+  texte.reserve(nUtilises*40+m.triangles.size()*8);
+  texte+="NOFF\n";
+  ajouteEntier(texte,nUtilises); texte+=' ';
+  ajouteEntier(texte,m.triangles.size()/3); texte+=" 0\n";
+  for (size_t s=0;s<nSommets;s++){
+    if (numero[s]<=0) continue;
+    for (int k=0;k<3;k++){ ajouteReel(texte,m.points[3*s+k]); texte+=' '; }
+    for (int k=0;k<3;k++){ ajouteReel(texte,m.normales[3*s+k]); texte+=(k<2 ? ' ' : '\n'); }
+  }
+  for (size_t i=0;i<m.triangles.size();i+=3){
+    texte+="3";
+    for (int k=0;k<3;k++){ texte+=' '; ajouteEntier(texte,numero[m.triangles[i+k]]-1); }
+    texte+='\n';
+  }
+  FILE *sortie=fopen(fichierSortie.c_str(),"wb");
+  if (!sortie || fwrite(texte.data(),1,texte.size(),sortie)!=texte.size()){cout << "unable to write " << fichierSortie << endl; exit(3);}
+  fclose(sortie);
+  cout << fichierSortie << " (" << nUtilises << " vertices) written in " << maintenant()-etape << " s ; total " << maintenant()-debut << " s" << endl;
+  return 0;
+}
@@ -3,136 +3,510 @@
 #include <fstream>
 #include <iostream>
 #include <cstring>
+#include <cctype>
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
 
 using namespace std;
 
-//fonction qui prend en entree un fichier brdf produit par pbrt version "photon" et en renvoie un propre a etre trace sous gnuplot
+#include "scenePbrt.h"
 
+//fonction qui prend en entree un ou plusieurs fichiers brdf produits par pbrt
+//version "photon" et en renvoie un propre a etre trace sous gnuplot. Les
+//fichiers (balayages en longueur d'onde et en incidence) sont lus en
+//parallele, les fichiers d'un meme lancer (longueur d'onde, incidence) sont
+//cumules, et les DCRF sont rangees dans un hypercube binaire
+//longueur d'onde x incidence x direction de sortie (--cube).
+//
+//le facteur de reflectance est R = BRDF * Pi / Albedo : pour une case de
+//direction de sortie, R = Pi * photons de la case / (photons sortis *
+//angle solide projete de la case), egal a 1 pour une surface lambertienne.
 
-int main(int argc, char *argv[]){
 
-  //deltaAngle est la precision que l'on aura sur theta et phi les coordonnees spheriques
-  int i;
-  float deltaAngle=15;
-  string fichier_entree, fichier_sortie;
-  bool entre(0), sortie(0);
+//les fichiers brdf sont des histogrammes a 1 degre : azimut (colonne
+//"theta", 0 a 359) et zenith (colonne "phi", 0 a 90 ; 90 compte avec 89)
+const int nAzimutsBRDF=360, nZenithsBRDF=90;
+
+
+//un fichier brdf et le lancer dont il provient
+struct Lancer {
+  string fichier;
+  double longueurOnde;        //nm, <0 si inconnue
+  double zenith, azimut;      //direction de la lumiere en degres, zenith<0 : celle de la scene
+  vector<double> photons;     //nZenithsBRDF x nAzimutsBRDF
+  double total;               //photons sortis
+  double albedo;              //du fichier _stat.txt, <0 s'il manque
+  bool lu;
+};
+
+
+//une case de l'hypercube : la somme des lancers de meme longueur d'onde et
+//de meme incidence
+struct Cellule {
+  vector<double> photons;
+  double total, lances;       //photons sortis, photons restes dans la scene
+  vector<float> dcrf;         //nZenith x nAzimut
+};
 
-  if (argc < 2) {cout <<" syntax is < command > -i input.txt -o output.txt [--dAngle int]"; return 0;}
 
-  for (i=1; i<argc;i++){
-    if (!strcmp(argv[i],"--dAngle")) deltaAngle=atof(argv[++i]);
-    else if (!strcmp(argv[i],"--help")){ cout <<" syntax is < command > filename.txt [--dAngle int]"; return 0;}
-    else if (!strcmp(argv[i],"--input") || !strcmp(argv[i],"-i")) {fichier_entree=argv[++i]; entre=true;}
-    else if (!strcmp(argv[i],"--output") || !strcmp(argv[i],"-o")) {fichier_sortie=argv[++i]; sortie=true;}
+//decoupage des directions de sortie : en angles egaux, en angles solides
+//egaux (couronnes de meme hauteur), ou noyau gaussien sur la sphere evalue
+//au centre des cases en angles egaux
+enum Mode { ANGLE, ANGLE_SOLIDE, GAUSSIEN };
+
+struct Grille {
+  Mode mode;
+  int nZenith, nAzimut;
+  vector<double> bordsZenith; //nZenith+1, en degres
+  double sigma;               //ecart type du noyau, en degres
+
+  int caseZenith(double zenith) const {
+    int i=upper_bound(bordsZenith.begin(), bordsZenith.end(), zenith)-bordsZenith.begin()-1;
+    return min(max(i,0),nZenith-1);
+  }
+  int caseAzimut(double azimut) const {
+    int j=(int)floor(azimut*nAzimut/360);
+    return min(max(j,0),nAzimut-1);
   }
+};
 
-  if (!entre || ! sortie)
-    {	
-      cout <<" syntax is < command > - i input.txt -o output.txt [--dAngle int]\n"; return 1;
+
+//lecture d'un fichier brdf ("theta phi photons" par ligne, # en tete)
+static const char *sauteBlancs(const char *p, const char *fin)
+{
+  while (p<fin){
+    if (*p=='#') while (p<fin && *p!='\n') p++;
+    else if (isspace((unsigned char)*p)) p++;
+    else break;
+  }
+  return p;
+}
+
+bool litBRDF(Lancer &l)
+{
+  FILE *entree=fopen(l.fichier.c_str(),"rb");
+  struct stat infos;
+  if (!entree) return false;
+  if (fstat(fileno(entree),&infos)!=0){ fclose(entree); return false; }
+  //un octet nul apres le fichier arrete strtod
+  vector<char> contenu(infos.st_size+1,0);
+  bool lu=fread(&contenu[0],1,infos.st_size,entree)==(size_t)infos.st_size;
+  fclose(entree);
+  if (!lu) return false;
+  l.photons.assign(nZenithsBRDF*nAzimutsBRDF,0);
+  l.total=0;
+  const char *fin=&contenu[0]+infos.st_size, *p=sauteBlancs(&contenu[0],fin);
+  char *suite;
+  while (p<fin){
+    double theta=strtod(p,&suite), phi=strtod(suite,&suite), n=strtod(suite,&suite);
+    if (suite==p) return false;
+    p=sauteBlancs(suite,fin);
+    int azimut=min(max((int)floor(theta),0),nAzimutsBRDF-1);
+    int zenith=min(max((int)floor(phi),0),nZenithsBRDF-1);
+    l.photons[zenith*nAzimutsBRDF+azimut]+=n;
+    l.total+=n;
+  }
+
+  //albedo du meme lancer : fichier_brdf.txt -> fichier_stat.txt
+  l.albedo=-1;
+  size_t pos=l.fichier.rfind("_brdf.txt");
+  if (pos!=string::npos){
+    ifstream stat((l.fichier.substr(0,pos)+"_stat.txt").c_str());
+    string ligne;
+    while (getline(stat,ligne)){
+      size_t a=ligne.find("albedo : ");
+      if (a!=string::npos) l.albedo=atof(ligne.c_str()+a+9);
     }
+  }
+  return true;
+}
 
-  deltaAngle=floor(deltaAngle);
 
-  if (deltaAngle<1) {
-    deltaAngle=1;
-    cout <<"la precision sur l'angle est de 1 degre\n";
+struct Lecture {
+  vector<Lancer> *lancers;
+  int debut, pas;
+};
+
+void *litLancers(void *arg)
+{
+  Lecture *l=(Lecture *)arg;
+  for (size_t i=l->debut;i<l->lancers->size();i+=l->pas)
+    (*l->lancers)[i].lu=litBRDF((*l->lancers)[i]);
+  return NULL;
+}
+
+
+//longueur d'onde d'un fichier de pbrt : nom_longueurOnde_brdf.txt
+double longueurOndeNom(const string &fichier)
+{
+  size_t fin=fichier.rfind("_brdf.txt");
+  if (fin==string::npos) return -1;
+  size_t debut=fichier.rfind('_',fin-1);
+  if (debut==string::npos || debut+1==fin) return -1;
+  for (size_t i=debut+1;i<fin;i++) if (!isdigit((unsigned char)fichier[i])) return -1;
+  return atof(fichier.c_str()+debut+1);
+}
+
+
+//lancers d'un fichier de travaux de pbrt --batch :
+//  longueurOnde(nm) [photons [dx dy dz [prefixe]]]
+//le fichier brdf est repertoire/prefixe_brdf.txt, le prefixe par defaut
+//etant celui de pbrt (scene_longueurOnde)
+bool litTravaux(const string &fichier, const string &repertoire, const string &scene, vector<Lancer> &lancers)
+{
+  ifstream in(fichier.c_str());
+  if (!in) return false;
+  string base(scene);
+  size_t pos=base.rfind('/');
+  if (pos!=string::npos) base=base.substr(pos+1);
+  pos=base.rfind('.');
+  if (pos!=string::npos) base=base.substr(0,pos);
+  string ligne;
+  while (getline(in,ligne)){
+    size_t debut=ligne.find_first_not_of(" \t\r");
+    if (debut==string::npos || ligne[debut]=='#') continue;
+    istringstream champs(ligne);
+    vector<string> mots;
+    string mot;
+    while (champs >> mot) mots.push_back(mot);
+    Lancer l;
+    l.longueurOnde=atof(mots[0].c_str());
+    l.zenith=l.azimut=-1;
+    if (mots.size()>=5){
+      double d[3];
+      for (int k=0;k<3;k++) d[k]=atof(mots[2+k].c_str());
+      double n=sqrt(d[0]*d[0]+d[1]*d[1]+d[2]*d[2]);
+      if (n>0){
+        l.zenith=acos(d[2]/n)*180/M_PI;
+        l.azimut=atan2(d[1],d[0])*180/M_PI;
+        if (l.azimut<0) l.azimut+=360;
+      }
+    }
+    string prefixe;
+    if (mots.size()>=6) prefixe=mots[5];
+    else {
+      if (base.empty()){ cout << fichier << ": --scene is needed for the lines without prefix" << endl; return false; }
+      ostringstream nom;
+      nom << base << "_" << mots[0];
+      prefixe=nom.str();
+    }
+    l.fichier=(repertoire.empty() ? "" : repertoire+"/")+prefixe+"_brdf.txt";
+    lancers.push_back(l);
   }
-  else if (deltaAngle > 90) 
-    {
-      deltaAngle=90;
-      cout <<"la precision sur l'angle est de 90 degre\n";
+  return true;
+}
+
+
+//angle solide projete (integrale de cos) de la case [z0,z1]x[a0,a1], en degres
+double angleSolideProjete(double z0, double z1, double a0, double a1)
+{
+  double s0=sin(z0*M_PI/180), s1=sin(z1*M_PI/180);
+  return (a1-a0)*M_PI/180*(s1*s1-s0*s0)/2;
+}
+
+
+//DCRF d'une cellule sur la grille
+void calculeDCRF(Cellule &c, const Grille &g)
+{
+  c.dcrf.assign(g.nZenith*g.nAzimut,0.f);
+  if (c.total<=0) return;
+  if (g.mode!=GAUSSIEN){
+    //une case de 1 degre a cheval sur deux cases se partage au prorata de
+    //l'angle solide projete (en azimut : de l'angle)
+    vector<vector<pair<int,double> > > partZenith(nZenithsBRDF), partAzimut(nAzimutsBRDF);
+    for (int z=0;z<nZenithsBRDF;z++){
+      double total=angleSolideProjete(z,z+1,0,1);
+      for (int i=g.caseZenith(z);i<g.nZenith && g.bordsZenith[i]<z+1;i++){
+        double z0=max<double>(z,g.bordsZenith[i]), z1=min<double>(z+1,g.bordsZenith[i+1]);
+        if (z1>z0) partZenith[z].push_back(make_pair(i,angleSolideProjete(z0,z1,0,1)/total));
+      }
+    }
+    for (int a=0;a<nAzimutsBRDF;a++)
+      for (int j=g.caseAzimut(a);j<g.nAzimut && j*360.0/g.nAzimut<a+1;j++){
+        double a0=max<double>(a,j*360.0/g.nAzimut), a1=min(a+1.0,(j+1)*360.0/g.nAzimut);
+        if (a1>a0) partAzimut[a].push_back(make_pair(j,a1-a0));
+      }
+    vector<double> somme(g.nZenith*g.nAzimut,0);
+    for (int z=0;z<nZenithsBRDF;z++)
+      for (int a=0;a<nAzimutsBRDF;a++){
+        double n=c.photons[z*nAzimutsBRDF+a];
+        if (n<=0) continue;
+        for (size_t p=0;p<partZenith[z].size();p++)
+          for (size_t q=0;q<partAzimut[a].size();q++)
+            somme[partZenith[z][p].first*g.nAzimut+partAzimut[a][q].first]+=n*partZenith[z][p].second*partAzimut[a][q].second;
+      }
+    for (int i=0;i<g.nZenith;i++)
+      for (int j=0;j<g.nAzimut;j++){
+        double omega=angleSolideProjete(g.bordsZenith[i], g.bordsZenith[i+1], j*360.0/g.nAzimut, (j+1)*360.0/g.nAzimut);
+        c.dcrf[i*g.nAzimut+j]=M_PI*somme[i*g.nAzimut+j]/(c.total*omega);
+      }
+    return;
+  }
+
+  //noyau de von Mises-Fisher de parametre 1/sigma^2, de densite
+  //k/(2 Pi (1-exp(-2k))) exp(k (cos(angle)-1)) par steradian, tronque a 4 sigma ;
+  //R = Pi * densite / cos(zenith)
+  double sigma=g.sigma*M_PI/180, k=1/(sigma*sigma);
+  double normalisation=k/(2*M_PI*(1-exp(-2*k)));
+  double coupure=cos(min(4*sigma,M_PI));
+  vector<double> cosZ(g.nZenith), sinZ(g.nZenith), cosA(g.nAzimut), sinA(g.nAzimut);
+  for (int i=0;i<g.nZenith;i++){
+    double z=(g.bordsZenith[i]+g.bordsZenith[i+1])/2*M_PI/180;
+    cosZ[i]=cos(z); sinZ[i]=sin(z);
+  }
+  for (int j=0;j<g.nAzimut;j++){
+    double a=(j+0.5)*2*M_PI/g.nAzimut;
+    cosA[j]=cos(a); sinA[j]=sin(a);
+  }
+  vector<double> densite(g.nZenith*g.nAzimut,0);
+  for (int z=0;z<nZenithsBRDF;z++){
+    double cz=cos((z+0.5)*M_PI/180), sz=sin((z+0.5)*M_PI/180);
+    for (int a=0;a<nAzimutsBRDF;a++){
+      double n=c.photons[z*nAzimutsBRDF+a];
+      if (n<=0) continue;
+      double ca=cos((a+0.5)*M_PI/180), sa=sin((a+0.5)*M_PI/180);
+      for (int i=0;i<g.nZenith;i++){
+        //cos(zenith - zenith du photon) majore le cosinus de l'angle
+        if (cz*cosZ[i]+sz*sinZ[i]<coupure) continue;
+        for (int j=0;j<g.nAzimut;j++){
+          double cosAngle=cz*cosZ[i]+sz*sinZ[i]*(ca*cosA[j]+sa*sinA[j]);
+          if (cosAngle>=coupure) densite[i*g.nAzimut+j]+=n*exp(k*(cosAngle-1));
+        }
+      }
     }
+  }
+  for (int i=0;i<g.nZenith;i++)
+    for (int j=0;j<g.nAzimut;j++)
+      c.dcrf[i*g.nAzimut+j]=M_PI*normalisation*densite[i*g.nAzimut+j]/(c.total*cosZ[i]);
+}
 
-  int j;
 
+struct Calcul {
+  vector<Cellule> *cellules;
+  const Grille *grille;
+  int debut, pas;
+};
 
-  ifstream fichierEntree(fichier_entree.c_str());
-  ofstream fichierSortie(fichier_sortie.c_str());
+void *calculeCellules(void *arg)
+{
+  Calcul *c=(Calcul *)arg;
+  for (size_t i=c->debut;i<c->cellules->size();i+=c->pas)
+    calculeDCRF((*c->cellules)[i], *c->grille);
+  return NULL;
+}
 
-  //theta et phi sont les coordonnes polaires, gain est un tableau dont la taille depend de deltaAngle 
-  float theta(0), phi(0), nombrePhoton(0);
-  int nLignes(floor(90/deltaAngle));
-  int nColonnes(4*nLignes);
-  float gain[nLignes][nColonnes];
-  int phiDegre(0), thetaDegre(0);
-  int nombrePhotonTotal(0);
-  char b;
-  string a,ligne;
 
-  for (i=0;i<nLignes;i++)
-    for (j=0;j<nColonnes; j++)
-      gain[i][j]=0;
+//le fichier gnuplot, comme l'ancien resizeDCRF : un point par degre
+void ecritGnuplot(const string &fichier, const Cellule &c, const Grille &g)
+{
+  ofstream fichierSortie(fichier.c_str());
+  fichierSortie <<"# this file provides the anisotropic reflectance factor R, a variant of the BRDF :\n# R = BRDF * Pi / Albedo \n# pour tracer avec gnuplot :\n#splot \"file.txt\" using 1:2:3:4 with pm3d\n";
+  for (int j=0;j<=360; j++){
+    int ja=g.caseAzimut((j%360)+0.5);
+    for (int i=0;i<90;i++)
+      fichierSortie << cos(j*M_PI/180)*cos((90-i)*M_PI/180) << " " << sin(j*M_PI/180)*cos((90-i)*M_PI/180) << " " << sin((90-i)*M_PI/180) << " " << c.dcrf[g.caseZenith(i+0.5)*g.nAzimut+ja] << endl;
+    if (j<360) fichierSortie << endl;
+  }
+}
+
+
+//nom du fichier gnuplot d'une cellule quand il y en a plusieurs :
+//sortie_<longueurOnde>nm[_i<zenith>_a<azimut>].txt
+string nomGnuplot(const string &sortie, double longueurOnde, double zenith, double azimut)
+{
+  string base(sortie), extension;
+  size_t pos=base.rfind('.');
+  if (pos!=string::npos && base.find('/',pos)==string::npos){ extension=base.substr(pos); base=base.substr(0,pos); }
+  ostringstream nom;
+  nom << base << "_";
+  if (longueurOnde<0) nom << "unknown"; else nom << longueurOnde << "nm";
+  if (zenith>=0) nom << "_i" << zenith << "_a" << azimut;
+  nom << extension;
+  return nom.str();
+}
 
 
-  fichierEntree.seekg(0,ios::beg);
+//ecriture en little endian, quelle que soit la machine
+void ecritFloat(string &tampon, float f)
+{
+  uint32_t u;
+  memcpy(&u,&f,4);
+  for (int k=0;k<4;k++) tampon+=(char)((u>>(8*k))&0xff);
+}
+
 
-  //on elimine les lignes de commentaires en tete de fichier
-  while (true)
-    {	
-      fichierEntree >> a ;
-      if (isdigit(a.c_str()[0])) break;
-      else if (a.c_str()[0]=='#')
-	{
-	  fichierEntree.get(b);
-	  if (b!='\n') getline(fichierEntree,ligne);
-	}
+int main(int argc, char *argv[]){
+
+  //deltaAngle est la precision que l'on aura sur theta et phi les coordonnees spheriques
+  float deltaAngle=15, deltaAzimut=-1, sigma=-1;
+  string fichier_sortie, fichier_cube, travaux, repertoire, scene;
+  Mode mode(ANGLE);
+  vector<string> entrees;
+  double zenithIncidence(-1), azimutIncidence(0);
+  int nThreads(0);
+  const char *syntaxe=" syntax is < command > -i input.txt [-i input2.txt ... | brdf files ... | --jobs jobs.txt [--dir directory] [--scene scene.pbrt]] [-o output.txt] [--cube output.dcrf] [--dAngle degrees] [--dAzimuth degrees] [--binning angle|solid|gaussian] [--sigma degrees] [--incidence zenith azimuth] [--threads n]\n";
+
+  if (argc < 2) {cout << syntaxe; return 0;}
+
+  for (int i=1; i<argc;i++){
+    if (!strcmp(argv[i],"--dAngle") && i+1<argc) deltaAngle=atof(argv[++i]);
+    else if (!strcmp(argv[i],"--dAzimuth") && i+1<argc) deltaAzimut=atof(argv[++i]);
+    else if (!strcmp(argv[i],"--help")){ cout << syntaxe; return 0;}
+    else if ((!strcmp(argv[i],"--input") || !strcmp(argv[i],"-i")) && i+1<argc) entrees.push_back(argv[++i]);
+    else if ((!strcmp(argv[i],"--output") || !strcmp(argv[i],"-o")) && i+1<argc) fichier_sortie=argv[++i];
+    else if (!strcmp(argv[i],"--cube") && i+1<argc) fichier_cube=argv[++i];
+    else if (!strcmp(argv[i],"--jobs") && i+1<argc) travaux=argv[++i];
+    else if (!strcmp(argv[i],"--dir") && i+1<argc) repertoire=argv[++i];
+    else if (!strcmp(argv[i],"--scene") && i+1<argc) scene=argv[++i];
+    else if (!strcmp(argv[i],"--sigma") && i+1<argc) sigma=atof(argv[++i]);
+    else if (!strcmp(argv[i],"--incidence") && i+2<argc){ zenithIncidence=atof(argv[++i]); azimutIncidence=atof(argv[++i]); }
+    else if ((!strcmp(argv[i],"--threads") || !strcmp(argv[i],"-j")) && i+1<argc) nThreads=atoi(argv[++i]);
+    else if (!strcmp(argv[i],"--binning") && i+1<argc){
+      i++;
+      if (!strcmp(argv[i],"angle")) mode=ANGLE;
+      else if (!strcmp(argv[i],"solid")) mode=ANGLE_SOLIDE;
+      else if (!strcmp(argv[i],"gaussian")) mode=GAUSSIEN;
+      else {cout << "unknown binning " << argv[i] << endl << syntaxe; return 1;}
     }
+    else if (argv[i][0]!='-') entrees.push_back(argv[i]);
+  }
 
+  if ((entrees.empty() && travaux.empty()) || (fichier_sortie.empty() && fichier_cube.empty()))
+    {
+      cout << syntaxe; return 1;
+    }
 
-  //on remplit le tableau gain avec la premiere ligne du fichier
-  theta=atof(a.c_str());
-  fichierEntree >>phi;
-  fichierEntree >> nombrePhoton;
-  phiDegre=floor(phi);
-  thetaDegre=floor(theta); 		
-  if (phiDegre>=90) phiDegre=89;
-  if (phiDegre<0) phiDegre=0;	
-  if (thetaDegre <0) thetaDegre=0;		
-  if (thetaDegre >= 360) thetaDegre=359;
-  if (thetaDegre < 0) thetaDegre=0;
-  gain[phiDegre*nLignes/90][thetaDegre*nLignes/90]+=nombrePhoton;
-  nombrePhotonTotal+=nombrePhoton;
-
-  //on remplit gain avec le reste du fichier
-  while (!fichierEntree.eof())
+  if (deltaAngle<1) {
+    deltaAngle=1;
+    cout <<"la precision sur l'angle est de 1 degre\n";
+  }
+  else if (deltaAngle > 90)
     {
-      fichierEntree >> theta;
-      fichierEntree >> phi;
-      fichierEntree >> nombrePhoton;
-
-      phiDegre=floor(phi);
-      thetaDegre=floor(theta); 			
-      if (phiDegre>=90) phiDegre=89;
-      if (phiDegre<0) phiDegre=0;	
-      if (thetaDegre <0) thetaDegre=0;		
-      if (thetaDegre >= 360) thetaDegre=359;
-      if (thetaDegre < 0) thetaDegre=0;
-      gain[phiDegre*nLignes/90][thetaDegre*nLignes/90]+=nombrePhoton;
-      nombrePhotonTotal+=nombrePhoton;
+      deltaAngle=90;
+      cout <<"la precision sur l'angle est de 90 degre\n";
     }
+  if (deltaAzimut<0) deltaAzimut=deltaAngle;
+  deltaAzimut=min(max(deltaAzimut,1.f),360.f);
+
+  //les cases : autant de couronnes que de pas de deltaAngle dans 90 degres
+  Grille g;
+  g.mode=mode;
+  g.nZenith=max(1,(int)floor(90/deltaAngle+0.5));
+  g.nAzimut=max(1,(int)floor(360/deltaAzimut+0.5));
+  g.sigma=sigma>0 ? sigma : 90.0/g.nZenith/2;
+  for (int i=0;i<=g.nZenith;i++)
+    g.bordsZenith.push_back(mode==ANGLE_SOLIDE ? acos(1-(double)i/g.nZenith)*180/M_PI : 90.0*i/g.nZenith);
+
+  vector<Lancer> lancers;
+  for (size_t i=0;i<entrees.size();i++){
+    Lancer l;
+    l.fichier=entrees[i];
+    l.longueurOnde=longueurOndeNom(l.fichier);
+    l.zenith=zenithIncidence;
+    l.azimut=zenithIncidence<0 ? -1 : azimutIncidence;
+    lancers.push_back(l);
+  }
+  if (!travaux.empty() && !litTravaux(travaux, repertoire, scene, lancers)){
+    cout << "unable to read the job file " << travaux << endl;
+    return 1;
+  }
 
+  //lecture en parallele
+  int n=nThreads>0 ? nThreads : max(1L,sysconf(_SC_NPROCESSORS_ONLN));
+  n=min(n,(int)lancers.size());
+  vector<Lecture> lectures(n);
+  for (int i=0;i<n;i++){ lectures[i].lancers=&lancers; lectures[i].debut=i; lectures[i].pas=n; }
+  executeEnParallele(&lectures[0], n, litLancers);
+  for (size_t i=0;i<lancers.size();i++)
+    if (!lancers[i].lu){ cout << "unable to read " << lancers[i].fichier << endl; return 1; }
 
+  //les axes de l'hypercube, puis la somme des lancers de chaque cellule
+  vector<double> longueursOnde;
+  vector<pair<double,double> > incidences;
+  for (size_t i=0;i<lancers.size();i++){
+    //incidence arrondie au centieme de degre
+    lancers[i].zenith=floor(lancers[i].zenith*100+0.5)/100;
+    lancers[i].azimut=floor(lancers[i].azimut*100+0.5)/100;
+    longueursOnde.push_back(lancers[i].longueurOnde);
+    incidences.push_back(make_pair(lancers[i].zenith, lancers[i].azimut));
+  }
+  sort(longueursOnde.begin(), longueursOnde.end());
+  longueursOnde.erase(unique(longueursOnde.begin(), longueursOnde.end()), longueursOnde.end());
+  sort(incidences.begin(), incidences.end());
+  incidences.erase(unique(incidences.begin(), incidences.end()), incidences.end());
+  int nLongueurs=longueursOnde.size(), nIncidences=incidences.size();
 
-  //on normalise le gain pour avoir la DCRF
-  for (i=0;i<nLignes;i++)
-    for (j=0;j<nColonnes;j++)
-      gain[i][j]=gain[i][j]*180/(M_PI*deltaAngle*cos(i*M_PI*deltaAngle/180)*fabs((cos((i+1)*M_PI*deltaAngle/180)-cos(i*M_PI*deltaAngle/180))));
-		
+  vector<Cellule> cellules(nLongueurs*nIncidences);
+  for (size_t i=0;i<cellules.size();i++){
+    cellules[i].photons.assign(nZenithsBRDF*nAzimutsBRDF,0);
+    cellules[i].total=cellules[i].lances=0;
+  }
+  for (size_t i=0;i<lancers.size();i++){
+    const Lancer &l=lancers[i];
+    int w=lower_bound(longueursOnde.begin(), longueursOnde.end(), l.longueurOnde)-longueursOnde.begin();
+    int inc=lower_bound(incidences.begin(), incidences.end(), make_pair(l.zenith,l.azimut))-incidences.begin();
+    Cellule &c=cellules[w*nIncidences+inc];
+    for (size_t k=0;k<c.photons.size();k++) c.photons[k]+=l.photons[k];
+    c.total+=l.total;
+    //albedo d'une cellule : photons sortis / photons restes dans la scene
+    if (c.lances>=0 && l.albedo>0) c.lances+=l.total/l.albedo;
+    else c.lances=-1;
+  }
 
+  n=min(n,(int)cellules.size());
+  vector<Calcul> calculs(n);
+  for (int i=0;i<n;i++){ calculs[i].cellules=&cellules; calculs[i].grille=&g; calculs[i].debut=i; calculs[i].pas=n; }
+  executeEnParallele(&calculs[0], n, calculeCellules);
+  cout << lancers.size() << " brdf files, " << nLongueurs << " wavelengths x " << nIncidences << " incidences x "
+       << g.nZenith << " x " << g.nAzimut << " exit directions" << endl;
 
-  //on renvoie dans le fichier de sortie les valeurs
-  fichierSortie <<"# this file provides the anisotropic reflectance factor R, a variant of the BRDF :\n# R = BRDF * Pi / Albedo \n# pour tracer avec gnuplot :\n#splot \"file.txt\" using 1:2:3:4 with pm3d\n"; 
-	
-  for (j=0;j<360; j++){
-    for (i=0;i<90;i++)
-      {fichierSortie << cos(j*M_PI/180)*cos((90-i)*M_PI/180) << " " << sin(j*M_PI/180)*cos((90-i)*M_PI/180) << " " << sin((90-i)*M_PI/180) << " " << gain[i*nLignes/90][j*nLignes/90]*M_PI/nombrePhotonTotal<< endl; 					
+  if (!fichier_sortie.empty())
+    for (int w=0;w<nLongueurs;w++)
+      for (int inc=0;inc<nIncidences;inc++){
+        const Cellule &c=cellules[w*nIncidences+inc];
+        if (c.total<=0) continue;
+        ecritGnuplot(cellules.size()==1 ? fichier_sortie : nomGnuplot(fichier_sortie, longueursOnde[w], incidences[inc].first, incidences[inc].second), c, g);
       }
 
-    fichierSortie << endl;		
-  }
+  //l'hypercube : un en-tete texte "Cle: valeurs" termine par ".", comme
+  //les fichiers vol, puis les float32 little endian de
+  //[longueur d'onde][incidence][zenith][azimut] ; une cellule sans lancer vaut NaN
+  if (!fichier_cube.empty()){
+    ostringstream entete;
+    const char *modes[3]={"angle", "solid", "gaussian"};
+    entete << "DCRF-Version: 1\nBinning: " << modes[mode] << "\n";
+    if (mode==GAUSSIEN) entete << "Sigma: " << g.sigma << "\n";
+    entete << "Wavelengths: " << nLongueurs << "\nIncidences: " << nIncidences
+           << "\nZeniths: " << g.nZenith << "\nAzimuths: " << g.nAzimut << "\nWavelength-nm:";
+    for (int w=0;w<nLongueurs;w++) entete << " " << longueursOnde[w];
+    entete << "\nIncidence-zenith:";
+    for (int inc=0;inc<nIncidences;inc++) entete << " " << incidences[inc].first;
+    entete << "\nIncidence-azimuth:";
+    for (int inc=0;inc<nIncidences;inc++) entete << " " << incidences[inc].second;
+    entete << "\nZenith-edges:";
+    for (int i=0;i<=g.nZenith;i++) entete << " " << g.bordsZenith[i];
+    entete << "\nExit-photons:";
+    for (size_t i=0;i<cellules.size();i++) entete << " " << cellules[i].total;
+    entete << "\nAlbedo:";
+    for (size_t i=0;i<cellules.size();i++) entete << " " << (cellules[i].lances>0 ? cellules[i].total/cellules[i].lances : -1);
+    entete << "\nData: float32 little-endian [wavelength][incidence][zenith][azimuth], R = BRDF * Pi / Albedo\n.\n";
 
-  for (i=0;i<90;i++)
-    fichierSortie << cos(360*M_PI/180)*cos((90-i)*M_PI/180) <<" " << sin(360*M_PI/180)*cos((90-i)*M_PI/180) << " " << sin((90-i)*M_PI/180) << " " << gain[i*nLignes/90][0]*M_PI/nombrePhotonTotal<< endl; 		
+    string tampon(entete.str());
+    tampon.reserve(tampon.size()+4*cellules.size()*g.nZenith*g.nAzimut);
+    for (size_t i=0;i<cellules.size();i++)
+      for (int k=0;k<g.nZenith*g.nAzimut;k++)
+        ecritFloat(tampon, cellules[i].total>0 ? cellules[i].dcrf[k] : NAN);
+    FILE *sortie=fopen(fichier_cube.c_str(),"wb");
+    if (!sortie || fwrite(tampon.data(),1,tampon.size(),sortie)!=tampon.size()){ cout << "unable to write " << fichier_cube << endl; return 1; }
+    fclose(sortie);
+  }
 
   return 0;
 
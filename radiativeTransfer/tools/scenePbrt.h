@@ -0,0 +1,115 @@
+//code commun a Noff2Pbrt et snowPrepare : bounding box de l'echantillon,
+//ecriture des fichiers pbrt qui incluent la geometrie, mise en forme rapide
+//des nombres et threads. A inclure apres "using namespace std;" dans un seul
+//fichier source par programme.
+
+#ifndef SCENEPBRT_H
+#define SCENEPBRT_H
+
+//variables globales qui cernent la bounding box
+double minX(0), maxX(0), minY(0), maxY(0), minZ(0), maxZ(0);
+
+
+static inline void ajouteEntier(string &s, long v)
+{
+  char tampon[24];
+  char *p=tampon+sizeof(tampon);
+  unsigned long u=v<0 ? -(unsigned long)v : v;
+  do { *--p='0'+u%10; u/=10; } while (u);
+  if (v<0) *--p='-';
+  s.append(p, tampon+sizeof(tampon)-p);
+}
+
+//meme ecriture qu'un ostream par defaut (%g, 6 chiffres significatifs)
+static inline void ajouteReel(string &s, float v)
+{
+  if (v==floorf(v) && fabsf(v)<1e6f){
+    if (v==0 && signbit(v)) s+="-0";
+    else ajouteEntier(s,(long)v);
+    return;
+  }
+  char tampon[32];
+  int n=snprintf(tampon, sizeof(tampon), "%g", v);
+  s.append(tampon, n);
+}
+
+//la valeur que pbrt relit apres ajouteReel : les tuiles binaires la gardent
+//pour avoir les memes triangles que le fichier de geometrie texte
+static inline float reelRelu(float v)
+{
+  string s;
+  ajouteReel(s,v);
+  return (float)atof(s.c_str());
+}
+
+
+template <typename Morceau>
+void executeEnParallele(Morceau *morceaux, int n, void *(*travail)(void *))
+{
+  if (n==1){ travail(morceaux); return; }
+  vector<pthread_t> threads(n);
+  for (int i=0;i<n;i++)
+    if (pthread_create(&threads[i], NULL, travail, morceaux+i)!=0){cout << "unable to create a thread" << endl; exit(3);}
+  for (int i=0;i<n;i++) pthread_join(threads[i], NULL);
+}
+
+
+
+
+
+//la fonction qui sort le fichier pbrt lisible par le logiciel
+void ecritFichierPbrt(string fichierPbrt, string fichierGeomPbrt, string fichierEXR, float tempsApercu){
+
+  ofstream fichierSortiePbrt(fichierPbrt.c_str());
+double Maximum(0);
+
+Maximum = max(max(maxX-minX, maxY-minY), maxZ-minZ);
+if (Maximum==0){cout << "geometry file is empty !!!" <<endl; Maximum=1;} 
+
+
+  // et on écrit dans le fichier qu'il faudra lancer sous pbrt
+  fichierSortiePbrt <<"## to have a nicest image level up the \"samplesperpixel\" of metropolis\n## to be more rapid, make this number down (but loose quality of image)\n \n \n";
+
+  //declaration des attributs generaux
+  //en mode apercu, metropolis affine l'image par passes et l'ecrit chaque minute jusqu'a la fin du temps alloue
+  ostringstream apercu;
+  if (tempsApercu>0)
+    apercu << " \"float timebudget\" [" << tempsApercu << "] \"float flushinterval\" [60]";
+  fichierSortiePbrt << "Scale -1.000000 1.000000 1.000000 \n \nTranslate -278.000000 -273.000000 500.000000\n \nRenderer \"metropolis\" \"integer samplesperpixel\" [128]" << apercu.str() << "\n \nCamera \"perspective\" \"float fov\" [55.000000]\n \nFilm \"image\" \"integer xresolution\" [1000] \"integer yresolution\" [750]\n    \"string filename\" \""<< fichierEXR  <<"\"\n \nPixelFilter \"box\" \n \nWorldBegin\n \n AttributeBegin\nTranslate 340.000000 278.000000 -50\nLightSource \"point\" \"point from\" [0.000000 200.000000 -50.000000] \"color I\" [412300 341100 298600]\nAttributeEnd\n \n";
+
+  //declaration du fond
+  fichierSortiePbrt << "#le fond \nAttributeBegin\nMaterial \"matte\" \"color Kd\" [.8 .8 .8]\nShape \"trianglemesh\"  \"integer indices\" [0 2 1 0 3 2] \"point P\" [800.000000 0.000000 0.000000 -250.000000 0.000000 0.000000 -250.000000 0.000000 1000.000000 800.000000 0.000000 1000.000000]\nAttributeEnd\n \n";
+
+  //on inclut l'echantillon
+  fichierSortiePbrt << "#include of the sample\nAttributeBegin\nTranslate 180 180 386 \nRotate -30 1 0 0\nRotate 30 0 1 0\nScale "<< (double)256/Maximum << " " << (double)256/Maximum<<" " << (double)256/Maximum<<"\n Rotate -90 1 0 0 \nTranslate "<< -minX <<" " << -minY << " " <<-minZ <<"\nMaterial \"matte\" \"color Kd\" [1 1 1]\nInclude \"" << fichierGeomPbrt<<"\"\nAttributeEnd\n \nWorldEnd";
+
+  cout << "pbrt file generated"<<endl;
+}
+
+
+
+
+//la fonction qui sort le fichier pour le lanceur de photon
+void ecritFichierPhoton(string fichierPhoton, string fichierGeomPbrt){
+  double facteur=(maxZ-minZ)/256;
+
+  ofstream fichierSortiePhoton(fichierPhoton.c_str());
+
+  //on definit la photonmap
+  fichierSortiePhoton << "## causticphotons = number of launched photons;\n## maxdepth= max number of intersections for one photon before stopping\n\nSurfaceIntegrator \"photonmap\" \"integer indirectphotons\" [0] \"integer causticphotons\" [20000]\n\"integer maxspeculardepth\" [100000] \"integer maxphotondepth\" [100000]\n\n";
+
+  //definition de la source de lumiere
+  fichierSortiePhoton << "#ligth source : to change the direction of the source change point from and point to, only the direction is important \nWorldBegin\n \nAttributeBegin\nLightSource \"distant\" \"point from\" [0 0 50] \"point to\" [0 0 0]\nAttributeEnd\n\n";
+
+  //pour dupliquer l'echantillon et prendre en compte la profondeur
+  fichierSortiePhoton << "#to duplicate the sample and take care of the depth, we create a cube wich will surround the sample\n\nAttributeBegin\nMaterial \"glass\"\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [0 0 256.001 " << (maxX-minX)/facteur << " 0 256.001 0 " << (maxY-minY)/facteur << " 256.001]\n\"normal N\" [0 0 1 0 0 1 0 0 1]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [ "<< (maxX-minX)/facteur<< " 0 256.001 0 "<<(maxY-minY)/facteur<< " 256.001 "<<(maxX-minX)/facteur<< " "<<(maxY-minY)/facteur<< " 256.001]\n\"normal N\" [0 0 1 0 0 1 0 0 1]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [0 0 0 " << (maxX-minX)/facteur <<" 0 0 0 " << (maxY-minY)/facteur << " 0]\n\"normal N\" [0 0 -1 0 0 -1 0 0 -1]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [" << (maxX-minX)/facteur <<" 0 0 0 " << (maxY-minY)/facteur <<" 0 " << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 0]\n\"normal N\" [0 0 -1 0 0 -1 0 0 -1]\n\nShape \"trianglemesh\" \"integer indices\" [0 2 1]\n\"point P\" [0 0 0 " << (maxX-minX)/facteur <<" 0 0 0 0 256]\n\"normal N\" [0 -1 0 0 -1 0 0 -1 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 2 1]\n\"point P\" [" << (maxX-minX)/facteur <<" 0 0 0 0 256 " << (maxX-minX)/facteur <<" 0 256]\n\"normal N\" [0 -1 0 0 -1 0 0 -1 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [0 " << (maxY-minY)/facteur <<" 0 " << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 0 0 " << (maxY-minY)/facteur <<" 256]\n\"normal N\" [0 1 0 0 1 0 0 1 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 2 1]\n\"point P\" [" << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 0 0 " << (maxY-minY)/facteur <<" 256 " << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 256]\n\"normal N\" [0 1 0 0 1 0 0 1 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [" << (maxX-minX)/facteur <<" 0 256 " << (maxX-minX)/facteur <<" 0 0 " << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 0]\n\"normal N\" [1 0 0 1 0 0 1 0 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [" << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 0 " << (maxX-minX)/facteur <<" 0 256 " << (maxX-minX)/facteur <<" " << (maxY-minY)/facteur <<" 256]\n\"normal N\" [1 0 0 1 0 0 1 0 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [0 0 0 0 0 256 0 " << (maxY-minY)/facteur <<" 0]\n\"normal N\" [-1 0 0 -1 0 0 -1 0 0]\n\nShape \"trianglemesh\" \"integer indices\" [0 1 2]\n\"point P\" [0 0 256 0 " << (maxY-minY)/facteur <<" 0 0 " << (maxY-minY)/facteur <<" 256]\n\"normal N\" [-1 0 0 -1 0 0 -1 0 0]\n\nAttributeEnd\n";
+
+  //on inclut le fichier de geometrie
+  fichierSortiePhoton <<"\n#path to the geometry file \nAttributeBegin\nMaterial \"glass\"\nScale "<<(double)256/(maxZ-minZ)<< " " << (double)256/(maxZ - minZ)<<" " << (double)256/(maxZ-minZ)<<"\nTranslate " <<-minX << " " << -minY <<" " << -minZ <<"\nInclude \""<< fichierGeomPbrt <<"\"\nAttributeEnd\n\nWorldEnd";
+
+  cout <<"photon pbrt file generated" <<endl;
+
+
+}
+
+#endif
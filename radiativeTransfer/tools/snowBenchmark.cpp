@@ -0,0 +1,505 @@
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <cstdio>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+
+using namespace std;
+
+//banc d'essai du lanceur de photons sur des microstructures de neige
+//synthetiques : pour chaque cas on genere un volume (empilement de spheres,
+//ellipsoides qui se recouvrent ou grains arrondis), on le maille comme
+//vol2normalField (fichier noff, normales vers l'interieur), on le passe a
+//Noff2Pbrt puis on lance pbrt en mode photon. Tout est deterministe (graine
+//fixe par cas, echantillonneur de Halton de pbrt) : seules les mesures de
+//temps et de memoire doivent varier d'une machine a l'autre.
+
+
+//generateur aleatoire (splitmix64) : rand() n'est pas le meme partout
+struct Alea {
+  Alea(uint64_t graine) : etat(graine) {}
+  uint64_t suivant() {
+    uint64_t z = (etat += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+  double uniforme() { return (suivant() >> 11) * (1.0 / 9007199254740992.0); }
+  uint64_t etat;
+};
+
+
+//un cas du banc d'essai
+struct Cas {
+  string forme;        //spheres, ellipsoids, grains
+  double densite;      //fraction volumique de glace visee
+  double rayon;        //rayon des grains en voxels
+  string nom;
+};
+
+
+//resultat d'un cas, tel qu'il est ecrit dans le fichier de reference
+struct Mesure {
+  double photonsParSeconde;
+  double intersectionsParPhoton;
+  double memoireMo;
+  double albedo;
+};
+
+
+//un grain : centre, rotation et demi-axes
+struct Grain {
+  double centre[3];
+  double rotation[3][3];
+  double axes[3];
+};
+
+
+void rotationAleatoire(Alea &alea, double r[3][3])
+{
+  //quaternion unitaire uniforme
+  double u1=alea.uniforme(), u2=2*M_PI*alea.uniforme(), u3=2*M_PI*alea.uniforme();
+  double a=sqrt(1-u1)*sin(u2), b=sqrt(1-u1)*cos(u2), c=sqrt(u1)*sin(u3), d=sqrt(u1)*cos(u3);
+  r[0][0]=1-2*(c*c+d*d); r[0][1]=2*(b*c-a*d);   r[0][2]=2*(b*d+a*c);
+  r[1][0]=2*(b*c+a*d);   r[1][1]=1-2*(b*b+d*d); r[1][2]=2*(c*d-a*b);
+  r[2][0]=2*(b*d-a*c);   r[2][1]=2*(c*d+a*b);   r[2][2]=1-2*(b*b+c*c);
+}
+
+
+//teste si le point p (repere du volume) est dans le grain
+bool dansGrain(const Grain &g, const string &forme, const double p[3])
+{
+  double v[3]={p[0]-g.centre[0], p[1]-g.centre[1], p[2]-g.centre[2]};
+  double l[3];
+  for (int i=0;i<3;i++)
+    l[i]=(g.rotation[0][i]*v[0]+g.rotation[1][i]*v[1]+g.rotation[2][i]*v[2])/g.axes[i];
+  if (forme=="grains")
+    //superellipsoide d'exposant 4 : un cube aux coins arrondis
+    return l[0]*l[0]*l[0]*l[0]+l[1]*l[1]*l[1]*l[1]+l[2]*l[2]*l[2]*l[2] <= 1;
+  return l[0]*l[0]+l[1]*l[1]+l[2]*l[2] <= 1;
+}
+
+
+//remplit le volume n*n*n et renvoie la fraction de glace obtenue
+double genereVolume(const Cas &cas, int n, uint64_t graine, vector<unsigned char> &volume)
+{
+  Alea alea(graine);
+  volume.assign((size_t)n*n*n, 0);
+  size_t voxelsGlace(0), cible((size_t)(cas.densite*n*n*n));
+  //spheres et grains ne se recouvrent pas (depot sequentiel aleatoire sur
+  //la sphere englobante), les ellipsoides se recouvrent librement
+  bool recouvrement=(cas.forme=="ellipsoids");
+  double rayonEnglobant=cas.rayon;
+  vector<Grain> grains;
+  const int essaisMax=200000;
+  for (int essai=0; essai<essaisMax && voxelsGlace<cible; essai++){
+    Grain g;
+    for (int a=0;a<3;a++) g.centre[a]=alea.uniforme()*n;
+    rotationAleatoire(alea, g.rotation);
+    if (cas.forme=="ellipsoids"){
+      g.axes[0]=cas.rayon; g.axes[1]=0.6*cas.rayon; g.axes[2]=0.35*cas.rayon;
+    }
+    else if (cas.forme=="grains"){
+      //meme volume qu'une sphere de rayon cas.rayon
+      double a=cas.rayon*pow(4*M_PI/3/6.4, 1.0/3);
+      g.axes[0]=g.axes[1]=g.axes[2]=a;
+      rayonEnglobant=a*pow(3.0, 0.25);
+    }
+    else
+      g.axes[0]=g.axes[1]=g.axes[2]=cas.rayon;
+
+    if (!recouvrement){
+      bool libre=true;
+      for (size_t i=0;i<grains.size() && libre;i++){
+        double d2=0;
+        for (int a=0;a<3;a++) d2+=(grains[i].centre[a]-g.centre[a])*(grains[i].centre[a]-g.centre[a]);
+        libre = d2 >= 4*rayonEnglobant*rayonEnglobant;
+      }
+      if (!libre) continue;
+    }
+    grains.push_back(g);
+
+    //on remplit les voxels dont le centre est dans le grain
+    int bmin[3], bmax[3];
+    for (int a=0;a<3;a++){
+      bmin[a]=max(0, (int)floor(g.centre[a]-rayonEnglobant));
+      bmax[a]=min(n-1, (int)ceil(g.centre[a]+rayonEnglobant));
+    }
+    for (int z=bmin[2];z<=bmax[2];z++)
+      for (int y=bmin[1];y<=bmax[1];y++)
+        for (int x=bmin[0];x<=bmax[0];x++){
+          unsigned char &v=volume[((size_t)z*n+y)*n+x];
+          double p[3]={x+0.5, y+0.5, z+0.5};
+          if (!v && dansGrain(g, cas.forme, p)){
+            v=1;
+            voxelsGlace++;
+          }
+        }
+  }
+  return (double)voxelsGlace/((double)n*n*n);
+}
+
+
+//ecrit le bord du volume en noff : une face carree par face de voxel entre
+//glace et air, normales vers l'interieur de la glace comme vol2normalField.
+//Les bords du volume sont de l'air, la surface est donc fermee.
+size_t ecritNoff(const vector<unsigned char> &volume, int n, const string &fichierNoff)
+{
+  //les 6 faces d'un voxel : direction de la normale sortante et coins
+  static const int directions[6][3]={{-1,0,0},{1,0,0},{0,-1,0},{0,1,0},{0,0,-1},{0,0,1}};
+  static const int coins[6][4][3]={
+    {{0,0,0},{0,0,1},{0,1,1},{0,1,0}}, {{1,0,0},{1,1,0},{1,1,1},{1,0,1}},
+    {{0,0,0},{1,0,0},{1,0,1},{0,0,1}}, {{0,1,0},{0,1,1},{1,1,1},{1,1,0}},
+    {{0,0,0},{0,1,0},{1,1,0},{1,0,0}}, {{0,0,1},{1,0,1},{1,1,1},{0,1,1}}};
+
+  vector<int> faces;
+  for (int z=0;z<n;z++)
+    for (int y=0;y<n;y++)
+      for (int x=0;x<n;x++){
+        if (!volume[((size_t)z*n+y)*n+x]) continue;
+        for (int f=0;f<6;f++){
+          int vx=x+directions[f][0], vy=y+directions[f][1], vz=z+directions[f][2];
+          bool air = vx<0 || vy<0 || vz<0 || vx>=n || vy>=n || vz>=n ||
+            !volume[((size_t)vz*n+vy)*n+vx];
+          if (air){
+            faces.push_back(x); faces.push_back(y); faces.push_back(z); faces.push_back(f);
+          }
+        }
+      }
+
+  size_t nFaces=faces.size()/4;
+  FILE *f=fopen(fichierNoff.c_str(), "w");
+  if (!f) { cerr << "unable to write " << fichierNoff << endl; exit(1); }
+  fprintf(f, "NOFF\n%lu %lu 0\n", (unsigned long)(4*nFaces), (unsigned long)nFaces);
+  for (size_t i=0;i<nFaces;i++){
+    const int *v=&faces[4*i];
+    const int *d=directions[v[3]];
+    for (int c=0;c<4;c++)
+      fprintf(f, "%d %d %d %d %d %d\n", v[0]+coins[v[3]][c][0], v[1]+coins[v[3]][c][1],
+              v[2]+coins[v[3]][c][2], -d[0], -d[1], -d[2]);
+  }
+  for (size_t i=0;i<nFaces;i++)
+    fprintf(f, "4 %lu %lu %lu %lu\n", (unsigned long)(4*i), (unsigned long)(4*i+1),
+            (unsigned long)(4*i+2), (unsigned long)(4*i+3));
+  fclose(f);
+  return 2*nFaces;
+}
+
+
+double maintenant()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+
+//lance une commande dans le repertoire de travail, sortie dans journal ;
+//renvoie le temps ecoule et la memoire maximale (Mo) du processus
+bool lance(const vector<string> &arguments, const string &repertoire, const string &journal,
+           double *temps, double *memoireMo)
+{
+  double debut=maintenant();
+  pid_t pid=fork();
+  if (pid==0){
+    if (chdir(repertoire.c_str())!=0) _exit(127);
+    int fd=open(journal.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd>=0){ dup2(fd, 1); dup2(fd, 2); close(fd); }
+    vector<char *> argv;
+    for (size_t i=0;i<arguments.size();i++) argv.push_back(const_cast<char *>(arguments[i].c_str()));
+    argv.push_back(NULL);
+    execv(argv[0], &argv[0]);
+    _exit(127);
+  }
+  int statut;
+  struct rusage usage;
+  if (pid<0 || wait4(pid, &statut, 0, &usage)<0) return false;
+  *temps=maintenant()-debut;
+  //ru_maxrss est en kilo-octets sous Linux
+  *memoireMo=usage.ru_maxrss/1024.0;
+  return WIFEXITED(statut) && WEXITSTATUS(statut)==0;
+}
+
+
+//chemin absolu, les commandes sont lancees depuis le repertoire de travail
+string absolu(const string &chemin)
+{
+  if (chemin.empty() || chemin[0]=='/') return chemin;
+  char courant[4096];
+  if (!getcwd(courant, sizeof(courant))) return chemin;
+  return string(courant)+"/"+chemin;
+}
+
+
+//lit une valeur "cle : valeur" du fichier de statistiques de pbrt
+bool litStat(const string &fichierStat, const string &cle, double *valeur)
+{
+  ifstream f(fichierStat.c_str());
+  string ligne;
+  while (getline(f, ligne)){
+    size_t pos=ligne.find(cle+" : ");
+    if (pos!=string::npos){
+      *valeur=atof(ligne.c_str()+pos+cle.size()+3);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+map<string, Mesure> litReference(const string &fichier)
+{
+  map<string, Mesure> reference;
+  ifstream f(fichier.c_str());
+  string ligne;
+  while (getline(f, ligne)){
+    if (ligne.empty() || ligne[0]=='#') continue;
+    istringstream in(ligne);
+    string nom;
+    Mesure m;
+    if (in >> nom >> m.photonsParSeconde >> m.intersectionsParPhoton >> m.memoireMo >> m.albedo)
+      reference[nom]=m;
+  }
+  return reference;
+}
+
+
+void ecritMesures(const string &fichier, const vector<Cas> &cas, const vector<Mesure> &mesures,
+                  int n, int nPhotons)
+{
+  ofstream f(fichier.c_str());
+  f << "# snowBenchmark --size " << n << " --photons " << nPhotons << "\n";
+  f << "# case photons/s intersections/photon peakRSS(MB) albedo\n";
+  for (size_t i=0;i<mesures.size();i++){
+    char ligne[256];
+    sprintf(ligne, "%s %.1f %.4f %.1f %.6f\n", cas[i].nom.c_str(), mesures[i].photonsParSeconde,
+            mesures[i].intersectionsParPhoton, mesures[i].memoireMo, mesures[i].albedo);
+    f << ligne;
+  }
+}
+
+
+
+//nombre de faces d'un fichier NOFF/OFF, lu dans son en-tete
+size_t compteTriangles(const string &fichier)
+{
+  ifstream in(fichier.c_str());
+  string entete;
+  size_t nSommets(0), nFaces(0);
+  in >> entete >> nSommets >> nFaces;
+  return nFaces;
+}
+
+
+//mise en forme de repertoire/nom.off par Noff2Pbrt, comme pour un
+//echantillon reel, puis lancer de photons ; false si une commande echoue
+bool mesure(const string &nom, const string &pbrt, const string &noff2pbrt, const string &repertoire,
+            const char *dimension, int nPhotons, Mesure &m)
+{
+  double temps, memoire;
+  vector<string> arguments;
+  arguments.push_back(noff2pbrt);
+  arguments.push_back("-i"); arguments.push_back(nom+".off");
+  arguments.push_back("-o"); arguments.push_back(nom);
+  if (!lance(arguments, repertoire, nom+"_noff2pbrt.log", &temps, &memoire)){
+    cerr << nom << ": Noff2Pbrt failed, see " << repertoire << "/" << nom << "_noff2pbrt.log" << endl;
+    return false;
+  }
+  remove((repertoire+"/"+nom+".off").c_str());
+  if (nPhotons!=20000){
+    string fichierPhoton=repertoire+"/"+nom+"Photon.pbrt";
+    ifstream in(fichierPhoton.c_str());
+    stringstream contenu;
+    contenu << in.rdbuf();
+    in.close();
+    string texte=contenu.str();
+    size_t pos=texte.find("\"integer causticphotons\" [20000]");
+    if (pos!=string::npos){
+      ostringstream remplacement;
+      remplacement << "\"integer causticphotons\" [" << nPhotons << "]";
+      texte.replace(pos, strlen("\"integer causticphotons\" [20000]"), remplacement.str());
+    }
+    ofstream out(fichierPhoton.c_str());
+    out << texte;
+  }
+
+  //lancer de photons, un seul coeur pour des mesures comparables
+  arguments.clear();
+  arguments.push_back(pbrt);
+  arguments.push_back("-p");
+  arguments.push_back("-w"); arguments.push_back("1030");
+  arguments.push_back("-x"); arguments.push_back(dimension);
+  arguments.push_back("-y"); arguments.push_back(dimension);
+  arguments.push_back("-z"); arguments.push_back(dimension);
+  arguments.push_back("-r"); arguments.push_back("30");
+  arguments.push_back(nom+"Photon.pbrt");
+  if (!lance(arguments, repertoire, nom+"_pbrt.log", &temps, &memoire)){
+    cerr << nom << ": pbrt failed, see " << repertoire << "/" << nom << "_pbrt.log" << endl;
+    return false;
+  }
+  string fichierStat=repertoire+"/"+nom+"Photon_1030_stat.txt";
+  double lances(0);
+  m.memoireMo=memoire;
+  if (!litStat(fichierStat, "launched photons", &lances) ||
+      !litStat(fichierStat, "albedo", &m.albedo) ||
+      !litStat(fichierStat, "intersections per photon", &m.intersectionsParPhoton)){
+    cerr << nom << ": unable to read " << fichierStat << endl;
+    return false;
+  }
+  m.photonsParSeconde=lances/temps;
+  return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+  string pbrt, noff2pbrt, repertoire("snowBenchmark"), fichierReference;
+  int n(64), nPhotons(5000);
+  double tolerance(10);
+  bool miseAJour(false);
+  string seulement, decimation;
+  string toleranceDecimation("0.5");
+
+  for (int i=1; i<argc;i++){
+    if (!strcmp(argv[i],"--help") || !strcmp(argv[i],"-h")){
+      cout << "syntax : <command> --pbrt path/to/pbrt --noff2pbrt path/to/Noff2Pbrt [--dir workdir] [--size n] [--photons n] [--reference file] [--tolerance percent] [--update] [--case name] [--decimate path/to/meshDecimation [--decimation voxels]]\n";
+      return 0;
+    }
+    else if (!strcmp(argv[i],"--pbrt") && i+1<argc) pbrt=argv[++i];
+    else if (!strcmp(argv[i],"--noff2pbrt") && i+1<argc) noff2pbrt=argv[++i];
+    else if ((!strcmp(argv[i],"--dir") || !strcmp(argv[i],"-d")) && i+1<argc) repertoire=argv[++i];
+    else if ((!strcmp(argv[i],"--size") || !strcmp(argv[i],"-n")) && i+1<argc) n=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--photons") || !strcmp(argv[i],"-p")) && i+1<argc) nPhotons=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--reference") || !strcmp(argv[i],"-r")) && i+1<argc) fichierReference=argv[++i];
+    else if ((!strcmp(argv[i],"--tolerance") || !strcmp(argv[i],"-t")) && i+1<argc) tolerance=atof(argv[++i]);
+    else if (!strcmp(argv[i],"--update") || !strcmp(argv[i],"-u")) miseAJour=true;
+    else if ((!strcmp(argv[i],"--case") || !strcmp(argv[i],"-c")) && i+1<argc) seulement=argv[++i];
+    else if (!strcmp(argv[i],"--decimate") && i+1<argc) decimation=argv[++i];
+    else if (!strcmp(argv[i],"--decimation") && i+1<argc) toleranceDecimation=argv[++i];
+  }
+  if (pbrt.empty() || noff2pbrt.empty()){
+    cout << "syntax : <command> --pbrt path/to/pbrt --noff2pbrt path/to/Noff2Pbrt [--dir workdir] [--size n] [--photons n] [--reference file] [--tolerance percent] [--update] [--case name] [--decimate path/to/meshDecimation [--decimation voxels]]\n";
+    return 0;
+  }
+  pbrt=absolu(pbrt);
+  noff2pbrt=absolu(noff2pbrt);
+  if (!decimation.empty()) decimation=absolu(decimation);
+  mkdir(repertoire.c_str(), 0755);
+  repertoire=absolu(repertoire);
+
+  //les cas : 3 formes, 2 densites, 2 tailles de grains
+  vector<Cas> listeCas;
+  const char *formes[3]={"spheres", "ellipsoids", "grains"};
+  const double densites[2]={0.2, 0.35};
+  const double rayons[2]={floor(n/24.0+0.5), floor(n/12.0+0.5)};
+  for (int f=0;f<3;f++)
+    for (int d=0;d<2;d++)
+      for (int r=0;r<2;r++){
+        Cas c;
+        c.forme=formes[f];
+        c.densite=densites[d];
+        c.rayon=rayons[r];
+        char nom[128];
+        sprintf(nom, "%s_d%.2f_r%g", formes[f], densites[d], rayons[r]);
+        c.nom=nom;
+        if (seulement.empty() || seulement==c.nom) listeCas.push_back(c);
+      }
+
+  char dimension[32];
+  sprintf(dimension, "%d", n);
+  vector<Mesure> mesures;
+  printf("%-24s %9s %10s %12s %10s %9s\n", "case", "triangles", "photons/s", "isect/photon", "RSS (MB)", "albedo");
+  for (size_t i=0;i<listeCas.size();i++){
+    const Cas &cas=listeCas[i];
+    vector<unsigned char> volume;
+    //graine fixe par cas, independante de --case
+    uint64_t graine=1;
+    for (size_t c=0;c<cas.nom.size();c++) graine=graine*131+cas.nom[c];
+    genereVolume(cas, n, graine, volume);
+    size_t nTriangles=ecritNoff(volume, n, repertoire+"/"+cas.nom+".off");
+
+    //le maillage decime est produit avant que Noff2Pbrt ne consomme cas.off
+    string nomDecime=cas.nom+"_decimated";
+    if (!decimation.empty()){
+      vector<string> arguments;
+      arguments.push_back(decimation);
+      arguments.push_back("-i"); arguments.push_back(cas.nom+".off");
+      arguments.push_back("-o"); arguments.push_back(nomDecime+".off");
+      arguments.push_back("--tolerance"); arguments.push_back(toleranceDecimation);
+      double temps, memoire;
+      if (!lance(arguments, repertoire, cas.nom+"_decimation.log", &temps, &memoire)){
+        cerr << cas.nom << ": meshDecimation failed, see " << repertoire << "/" << cas.nom << "_decimation.log" << endl;
+        return 1;
+      }
+    }
+
+    Mesure m;
+    if (!mesure(cas.nom, pbrt, noff2pbrt, repertoire, dimension, nPhotons, m)) return 1;
+    mesures.push_back(m);
+    printf("%-24s %9lu %10.1f %12.2f %10.1f %9.4f\n", cas.nom.c_str(), (unsigned long)nTriangles,
+           m.photonsParSeconde, m.intersectionsParPhoton, m.memoireMo, m.albedo);
+    if (!decimation.empty()){
+      //seules les mesures du maillage complet vont dans la reference
+      size_t nDecimes=compteTriangles(repertoire+"/"+nomDecime+".off");
+      Mesure d;
+      if (!mesure(nomDecime, pbrt, noff2pbrt, repertoire, dimension, nPhotons, d)) return 1;
+      printf("%-24s %9lu %10.1f %12.2f %10.1f %9.4f\n", "  decimated", (unsigned long)nDecimes,
+             d.photonsParSeconde, d.intersectionsParPhoton, d.memoireMo, d.albedo);
+      printf("%-24s %8.1f%% %9.1f%% %25s %+9.4f\n", "  change", 100.0*nDecimes/nTriangles-100,
+             100*d.photonsParSeconde/m.photonsParSeconde-100, "", d.albedo-m.albedo);
+    }
+    fflush(stdout);
+  }
+  ecritMesures(repertoire+"/snowBenchmark.txt", listeCas, mesures, n, nPhotons);
+
+  if (fichierReference.empty()) return 0;
+  if (miseAJour){
+    ecritMesures(fichierReference, listeCas, mesures, n, nPhotons);
+    cout << "reference timings written to " << fichierReference << endl;
+    return 0;
+  }
+
+  //comparaison avec les mesures de reference : le temps et la memoire
+  //peuvent varier de tolerance %, les resultats physiques doivent etre
+  //identiques (a l'arrondi pres) puisque les graines sont fixes
+  map<string, Mesure> reference=litReference(fichierReference);
+  int regressions(0);
+  for (size_t i=0;i<mesures.size();i++){
+    map<string, Mesure>::iterator it=reference.find(listeCas[i].nom);
+    if (it==reference.end()){
+      cout << listeCas[i].nom << ": no reference timing" << endl;
+      continue;
+    }
+    const Mesure &r=it->second, &m=mesures[i];
+    if (m.photonsParSeconde < r.photonsParSeconde*(1-tolerance/100)){
+      printf("%s: SLOWER %.1f photons/s (reference %.1f)\n", listeCas[i].nom.c_str(), m.photonsParSeconde, r.photonsParSeconde);
+      regressions++;
+    }
+    if (m.memoireMo > r.memoireMo*(1+tolerance/100)){
+      printf("%s: MEMORY %.1f MB (reference %.1f)\n", listeCas[i].nom.c_str(), m.memoireMo, r.memoireMo);
+      regressions++;
+    }
+    if (fabs(m.albedo-r.albedo) > 1e-5 || fabs(m.intersectionsParPhoton-r.intersectionsParPhoton) > 1e-3*r.intersectionsParPhoton){
+      printf("%s: CHANGED albedo %.6f intersections/photon %.4f (reference %.6f %.4f)\n", listeCas[i].nom.c_str(),
+             m.albedo, m.intersectionsParPhoton, r.albedo, r.intersectionsParPhoton);
+      regressions++;
+    }
+  }
+  if (regressions) cout << regressions << " regression(s) against " << fichierReference << endl;
+  else cout << "no regression against " << fichierReference << endl;
+  return regressions ? 1 : 0;
+}
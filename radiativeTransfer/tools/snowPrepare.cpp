@@ -0,0 +1,341 @@
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include <cctype>
+#include <cstring>
+#include <cmath>
+#include <climits>
+#include <algorithm>
+#include <vector>
+#include <sstream>
+#include <cstdio>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+
+using namespace std;
+
+#include "scenePbrt.h"
+
+//preparation d'un echantillon en un seul programme, sans fichier
+//intermediaire : lecture du .raw (raw2vol), seuillage, bord d'air
+//(volAddBorder), sous-echantillonnage eventuel (volSubSample), extraction de
+//la surface avec ses normales (vol2normalField) et ecriture des fichiers pbrt
+//(Noff2Pbrt). Chaque etape est faite en parallele par tranches de z.
+
+
+double maintenant()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+
+//le volume binaire (1 : glace) apres seuillage et sous-echantillonnage ;
+//tout ce qui est hors du volume est de l'air, ce qui joue le role du bord
+//ajoute par volAddBorder : la surface est toujours fermee
+struct Volume {
+  int nx, ny, nz;
+  vector<unsigned char> glace;
+  bool operator()(int x, int y, int z) const {
+    if (x<0 || y<0 || z<0 || x>=nx || y>=ny || z>=nz) return false;
+    return glace[((size_t)z*ny+y)*nx+x];
+  }
+};
+
+
+//1) lecture du fichier brut projete en memoire
+struct TrancheLecture {
+  const unsigned char *brut;
+  int nx, ny, nz, facteur, seuilMin, seuilMax;
+  Volume *volume;
+  int z0, z1;
+};
+
+void *litTranche(void *arg)
+{
+  TrancheLecture &t=*(TrancheLecture *)arg;
+  Volume &v=*t.volume;
+  //comme volSubSample, un voxel du volume reduit prend la valeur du dernier
+  //voxel de son bloc facteur^3
+  for (int z=t.z0;z<t.z1;z++){
+    size_t bz=min(t.facteur*z+t.facteur-1,t.nz-1);
+    for (int y=0;y<v.ny;y++){
+      size_t by=min(t.facteur*y+t.facteur-1,t.ny-1);
+      const unsigned char *ligne=t.brut+(bz*t.ny+by)*t.nx;
+      unsigned char *sortie=&v.glace[((size_t)z*v.ny+y)*v.nx];
+      for (int x=0;x<v.nx;x++){
+	int valeur=ligne[min(t.facteur*x+t.facteur-1,t.nx-1)];
+	sortie[x]=(valeur>t.seuilMin && valeur<=t.seuilMax);
+      }
+    }
+  }
+  return NULL;
+}
+
+
+//les 6 faces d'un voxel : direction de la normale sortante et coins,
+//dans l'ordre de snowBenchmark
+static const int directions[6][3]={{-1,0,0},{1,0,0},{0,-1,0},{0,1,0},{0,0,-1},{0,0,1}};
+static const int coins[6][4][3]={
+  {{0,0,0},{0,0,1},{0,1,1},{0,1,0}}, {{1,0,0},{1,1,0},{1,1,1},{1,0,1}},
+  {{0,0,0},{1,0,0},{1,0,1},{0,0,1}}, {{0,1,0},{0,1,1},{1,1,1},{1,1,0}},
+  {{0,0,0},{0,1,0},{1,1,0},{1,0,0}}, {{0,0,1},{1,0,1},{1,1,1},{0,1,1}}};
+
+//noyau d'estimation des normales pour une direction de face : decalage du
+//voxel voisin et vecteur (pondere) du centre de la face vers son centre
+struct ElementNoyau {
+  int d[3];
+  float v[3];
+};
+
+//une face de surfel entre glace et air
+struct Face {
+  int x, y, z, direction;
+  float normale[3];
+};
+
+
+//2) extraction de la surface et des normales d'une tranche de z
+struct TrancheSurface {
+  const Volume *volume;
+  const vector<ElementNoyau> *noyaux;
+  int z0, z1;
+  vector<Face> faces;
+  int bornes[2][3];
+};
+
+void *extraitTranche(void *arg)
+{
+  TrancheSurface &t=*(TrancheSurface *)arg;
+  const Volume &v=*t.volume;
+  for (int k=0;k<3;k++){ t.bornes[0][k]=INT_MAX; t.bornes[1][k]=INT_MIN; }
+  for (int z=t.z0;z<t.z1;z++)
+    for (int y=0;y<v.ny;y++)
+      for (int x=0;x<v.nx;x++){
+	if (!v.glace[((size_t)z*v.ny+y)*v.nx+x]) continue;
+	for (int f=0;f<6;f++){
+	  if (v(x+directions[f][0],y+directions[f][1],z+directions[f][2])) continue;
+	  Face face;
+	  face.x=x; face.y=y; face.z=z; face.direction=f;
+	  //normale : moyenne ponderee des directions vers la glace autour du
+	  //centre de la face, donc vers l'interieur comme vol2normalField
+	  double n[3]={0,0,0};
+	  const vector<ElementNoyau> &noyau=t.noyaux[f];
+	  for (size_t e=0;e<noyau.size();e++)
+	    if (v(x+noyau[e].d[0],y+noyau[e].d[1],z+noyau[e].d[2]))
+	      for (int k=0;k<3;k++) n[k]+=noyau[e].v[k];
+	  double longueur=sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+	  if (longueur==0 || n[0]*directions[f][0]+n[1]*directions[f][1]+n[2]*directions[f][2]>=0)
+	    for (int k=0;k<3;k++) face.normale[k]=-directions[f][k];
+	  else
+	    for (int k=0;k<3;k++) face.normale[k]=n[k]/longueur;
+	  t.faces.push_back(face);
+	  const int c[3]={x,y,z};
+	  for (int s=0;s<4;s++)
+	    for (int k=0;k<3;k++){
+	      t.bornes[0][k]=min(t.bornes[0][k],c[k]+coins[f][s][k]);
+	      t.bornes[1][k]=max(t.bornes[1][k],c[k]+coins[f][s][k]);
+	    }
+	}
+      }
+  return NULL;
+}
+
+//noyau gaussien (ecart type rayon/2) sur la boule de rayon donne autour du
+//centre de chaque type de face ; rayon 0 : normales elementaires
+void construitNoyaux(float rayon, vector<ElementNoyau> noyaux[6])
+{
+  if (rayon<=0) return;
+  int r=(int)ceil(rayon)+1;
+  float sigma=rayon/2;
+  for (int f=0;f<6;f++)
+    for (int dz=-r;dz<=r;dz++)
+      for (int dy=-r;dy<=r;dy++)
+	for (int dx=-r;dx<=r;dx++){
+	  //centre du voxel voisin moins centre de la face
+	  float v[3]={dx-.5f*directions[f][0], dy-.5f*directions[f][1], dz-.5f*directions[f][2]};
+	  float d2=v[0]*v[0]+v[1]*v[1]+v[2]*v[2];
+	  if (d2>rayon*rayon) continue;
+	  float poids=exp(-d2/(2*sigma*sigma));
+	  ElementNoyau e;
+	  e.d[0]=dx; e.d[1]=dy; e.d[2]=dz;
+	  for (int k=0;k<3;k++) e.v[k]=poids*v[k];
+	  noyaux[f].push_back(e);
+	}
+}
+
+
+//3) mise en forme du fichier de geometrie, comme Noff2Pbrt : 4 sommets par
+//face avec la normale retournee (vers l'exterieur), 2 triangles par face
+struct TrancheGeometrie {
+  const vector<Face> *faces;
+  uint64_t premierSommet;
+  string points, normales, indices;
+};
+
+void *ecritTranche(void *arg)
+{
+  TrancheGeometrie &t=*(TrancheGeometrie *)arg;
+  const vector<Face> &faces=*t.faces;
+  t.points.reserve(faces.size()*4*12);
+  t.normales.reserve(faces.size()*4*24);
+  t.indices.reserve(faces.size()*2*24);
+  for (size_t i=0;i<faces.size();i++){
+    const Face &face=faces[i];
+    const int c[3]={face.x,face.y,face.z};
+    for (int s=0;s<4;s++)
+      for (int k=0;k<3;k++){
+	ajouteEntier(t.points,c[k]+coins[face.direction][s][k]);
+	t.points+=(k<2 ? ' ' : '\n');
+      }
+    //les 4 sommets ont la normale de la face : mise en forme une seule fois
+    size_t debut=t.normales.size();
+    for (int k=0;k<3;k++){
+      ajouteReel(t.normales,-face.normale[k]);
+      t.normales+=(k<2 ? ' ' : '\n');
+    }
+    size_t longueur=t.normales.size()-debut;
+    for (int s=1;s<4;s++) t.normales.append(t.normales, debut, longueur);
+    //triangulation en eventail, comme Noff2Pbrt
+    uint64_t s0=t.premierSommet+4*i;
+    for (int j=1;j<3;j++){
+      ajouteEntier(t.indices,s0);
+      t.indices+=' ';
+      ajouteEntier(t.indices,s0+j);
+      t.indices+=' ';
+      ajouteEntier(t.indices,s0+j+1);
+      t.indices+='\n';
+    }
+  }
+  return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+  string fichierRaw, fichier_sortie;
+  int nx(0), ny(0), nz(0);
+  //seuils de vol2normalField : la glace est dans ]seuilMin, seuilMax]
+  int seuilMin(0), seuilMax(255);
+  int facteur(1), nThreads(0);
+  float rayon(3), tempsApercu(0);
+  const char *syntaxe="syntax : <command> -i input.raw -x dimX -y dimY -z dimZ -o output [--min m] [--max M] [--subsample factor] [--radius r] [--preview seconds] [--threads n]\n";
+
+  for (int i=1; i<argc;i++){
+    if (!strcmp(argv[i],"--help") || !strcmp(argv[i],"-h")){cout << syntaxe; return 0;}
+    else if ((!strcmp(argv[i],"--input") || !strcmp(argv[i],"-i")) && i+1<argc) fichierRaw=argv[++i];
+    else if ((!strcmp(argv[i],"--output") || !strcmp(argv[i],"-o")) && i+1<argc) fichier_sortie=argv[++i];
+    else if (!strcmp(argv[i],"-x") && i+1<argc) nx=atoi(argv[++i]);
+    else if (!strcmp(argv[i],"-y") && i+1<argc) ny=atoi(argv[++i]);
+    else if (!strcmp(argv[i],"-z") && i+1<argc) nz=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--min") || !strcmp(argv[i],"-m")) && i+1<argc) seuilMin=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--max") || !strcmp(argv[i],"-M")) && i+1<argc) seuilMax=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--subsample") || !strcmp(argv[i],"-s")) && i+1<argc) facteur=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--radius") || !strcmp(argv[i],"-r")) && i+1<argc) rayon=atof(argv[++i]);
+    else if ((!strcmp(argv[i],"--preview") || !strcmp(argv[i],"-p")) && i+1<argc) tempsApercu=atof(argv[++i]);
+    else if ((!strcmp(argv[i],"--threads") || !strcmp(argv[i],"-j")) && i+1<argc) nThreads=atoi(argv[++i]);
+  }
+  if (fichierRaw.empty() || fichier_sortie.empty() || nx<=0 || ny<=0 || nz<=0 || facteur<1){
+    cout << syntaxe;
+    exit(1);
+  }
+  int n=nThreads>0 ? nThreads : max(1L,sysconf(_SC_NPROCESSORS_ONLN));
+  double debut=maintenant(), etape=debut;
+
+  //1) lecture et seuillage
+  int descripteur=open(fichierRaw.c_str(),O_RDONLY);
+  struct stat infos;
+  if (descripteur<0 || fstat(descripteur,&infos)!=0){cout << "unable to open " << fichierRaw << endl; exit(3);}
+  size_t taille=(size_t)nx*ny*nz;
+  if ((size_t)infos.st_size<taille){cout << fichierRaw << " is smaller than " << nx << "*" << ny << "*" << nz << " bytes" << endl; exit(3);}
+  const unsigned char *brut=(const unsigned char *)mmap(NULL, taille, PROT_READ, MAP_PRIVATE, descripteur, 0);
+  if (brut==MAP_FAILED){cout << "unable to map " << fichierRaw << endl; exit(3);}
+  madvise((void *)brut, taille, MADV_SEQUENTIAL);
+
+  Volume volume;
+  volume.nx=(nx+facteur-1)/facteur;
+  volume.ny=(ny+facteur-1)/facteur;
+  volume.nz=(nz+facteur-1)/facteur;
+  volume.glace.resize((size_t)volume.nx*volume.ny*volume.nz);
+  int nTranches=min(n,volume.nz);
+  vector<TrancheLecture> lectures(nTranches);
+  for (int i=0;i<nTranches;i++){
+    TrancheLecture &t=lectures[i];
+    t.brut=brut; t.nx=nx; t.ny=ny; t.nz=nz; t.facteur=facteur;
+    t.seuilMin=seuilMin; t.seuilMax=seuilMax; t.volume=&volume;
+    t.z0=(int)((long)volume.nz*i/nTranches);
+    t.z1=(int)((long)volume.nz*(i+1)/nTranches);
+  }
+  executeEnParallele(&lectures[0], nTranches, litTranche);
+  munmap((void *)brut, taille);
+  close(descripteur);
+  cout << "volume " << volume.nx << "*" << volume.ny << "*" << volume.nz << " read in " << maintenant()-etape << " s" << endl;
+  etape=maintenant();
+
+  //2) surface et normales
+  vector<ElementNoyau> noyaux[6];
+  construitNoyaux(rayon, noyaux);
+  vector<TrancheSurface> surfaces(nTranches);
+  for (int i=0;i<nTranches;i++){
+    surfaces[i].volume=&volume;
+    surfaces[i].noyaux=noyaux;
+    surfaces[i].z0=lectures[i].z0;
+    surfaces[i].z1=lectures[i].z1;
+  }
+  executeEnParallele(&surfaces[0], nTranches, extraitTranche);
+  vector<unsigned char>().swap(volume.glace);
+  uint64_t nombreFaces(0);
+  int bornes[2][3]={{INT_MAX,INT_MAX,INT_MAX},{INT_MIN,INT_MIN,INT_MIN}};
+  for (int i=0;i<nTranches;i++){
+    nombreFaces+=surfaces[i].faces.size();
+    for (int k=0;k<3;k++){
+      bornes[0][k]=min(bornes[0][k],surfaces[i].bornes[0][k]);
+      bornes[1][k]=max(bornes[1][k],surfaces[i].bornes[1][k]);
+    }
+  }
+  if (nombreFaces>0){
+    minX=bornes[0][0]; minY=bornes[0][1]; minZ=bornes[0][2];
+    maxX=bornes[1][0]; maxY=bornes[1][1]; maxZ=bornes[1][2];
+  }
+  cout << nombreFaces << " surfels extracted in " << maintenant()-etape << " s" << endl;
+  etape=maintenant();
+
+  //3) fichier de geometrie
+  string fichierGeomPbrt=fichier_sortie+"Geometry.pbrt";
+  vector<TrancheGeometrie> geometries(nTranches);
+  uint64_t premierSommet(0);
+  for (int i=0;i<nTranches;i++){
+    geometries[i].faces=&surfaces[i].faces;
+    geometries[i].premierSommet=premierSommet;
+    premierSommet+=4*surfaces[i].faces.size();
+  }
+  executeEnParallele(&geometries[0], nTranches, ecritTranche);
+  FILE *fichierSortieGeom=fopen(fichierGeomPbrt.c_str(),"wb");
+  if (!fichierSortieGeom){cout << "unable to create " << fichierGeomPbrt << endl; exit(3);}
+  fputs("Shape \"trianglemesh\" \"point P\" [ \n", fichierSortieGeom);
+  for (int i=0;i<nTranches;i++) fwrite(geometries[i].points.data(), 1, geometries[i].points.size(), fichierSortieGeom);
+  fputs("] \"normal N\" [\n", fichierSortieGeom);
+  for (int i=0;i<nTranches;i++) fwrite(geometries[i].normales.data(), 1, geometries[i].normales.size(), fichierSortieGeom);
+  fputs("] \"integer indices\" [", fichierSortieGeom);
+  for (int i=0;i<nTranches;i++) fwrite(geometries[i].indices.data(), 1, geometries[i].indices.size(), fichierSortieGeom);
+  fputs("]", fichierSortieGeom);
+  fclose(fichierSortieGeom);
+  cout << "geometry file " << fichierGeomPbrt << " (" << 2*nombreFaces << " triangles) written in " << maintenant()-etape << " s" << endl;
+  etape=maintenant();
+
+  //4) fichiers pbrt de l'image et du lanceur de photons
+  ecritFichierPbrt(fichier_sortie+"Image.pbrt",fichierGeomPbrt,fichier_sortie+".exr",tempsApercu);
+  ecritFichierPhoton(fichier_sortie+"Photon.pbrt",fichierGeomPbrt);
+  cout << "scene files written in " << maintenant()-etape << " s" << endl;
+
+  cout << "sample prepared in " << maintenant()-debut << " s ; photon launcher : pbrt -p -w <wavelength> -x " << volume.nx << " -y " << volume.ny << " -z " << volume.nz << " -r <voxel size * " << facteur << "> " << fichier_sortie << "Photon.pbrt" << endl;
+  return 0;
+}
@@ -0,0 +1,74 @@
+//table des marching cubes, commune a marchingCubes et volRemesh. A inclure
+//apres "using namespace std;" dans un seul fichier source par programme.
+
+#ifndef TABLEMARCHINGCUBES_H
+#define TABLEMARCHINGCUBES_H
+
+//le champ vaut 1 dans la glace et 0 dans l'air : la surface est son isovaleur
+static const float isovaleur=0.5f;
+
+
+//table des marching cubes, construite au demarrage : le coin c du cube est
+//en (c&1, (c>>1)&1, (c>>2)&1), l'arete a va du coin coinsArete[a][0] au coin
+//coinsArete[a][1] le long de l'axe axeArete[a]
+int coinsArete[12][2], axeArete[12];
+//pour chaque configuration des coins de glace, 3 aretes par triangle
+vector<unsigned char> triangles[256];
+
+void construitTable()
+{
+  int nAretes=0;
+  for (int k=0;k<3;k++)
+    for (int c=0;c<8;c++)
+      if (!((c>>k)&1)){
+	coinsArete[nAretes][0]=c;
+	coinsArete[nAretes][1]=c|(1<<k);
+	axeArete[nAretes++]=k;
+      }
+  //coins et aretes de chaque face, dans le sens direct vu de l'exterieur
+  const int cycle[4][2]={{0,0},{1,0},{1,1},{0,1}};
+  int coinsFace[6][4], aretesFace[6][4];
+  for (int k=0;k<3;k++)
+    for (int s=0;s<2;s++){
+      int f=2*k+s, u=(k+1)%3, v=(k+2)%3;
+      for (int i=0;i<4;i++){
+	int j=s ? i : 3-i;
+	coinsFace[f][i]=(s<<k)|(cycle[j][0]<<u)|(cycle[j][1]<<v);
+      }
+      for (int i=0;i<4;i++){
+	int c0=min(coinsFace[f][i],coinsFace[f][(i+1)%4]), c1=max(coinsFace[f][i],coinsFace[f][(i+1)%4]);
+	for (int a=0;a<12;a++)
+	  if (coinsArete[a][0]==c0 && coinsArete[a][1]==c1) aretesFace[f][i]=a;
+      }
+    }
+
+  for (int cas=0;cas<256;cas++){
+    //sur chaque face, l'arete ou l'on entre dans la glace est reliee a
+    //l'arete de sortie suivante : sur une face ambigue, les deux coins de
+    //glace restent separes, de la meme facon pour les deux cubes qui la
+    //partagent, donc la surface n'a pas de trou
+    int suivante[12];
+    for (int a=0;a<12;a++) suivante[a]=-1;
+    for (int f=0;f<6;f++)
+      for (int i=0;i<4;i++){
+	if (((cas>>coinsFace[f][i])&1) || !((cas>>coinsFace[f][(i+1)%4])&1)) continue;
+	int j=(i+1)%4;
+	while ((cas>>coinsFace[f][(j+1)%4])&1) j=(j+1)%4;
+	suivante[aretesFace[f][i]]=aretesFace[f][j];
+      }
+    //chaque boucle d'aretes est triangulee en eventail
+    bool vue[12]={false};
+    for (int a=0;a<12;a++){
+      if (suivante[a]<0 || vue[a]) continue;
+      vector<int> boucle;
+      for (int b=a;!vue[b];b=suivante[b]){ vue[b]=true; boucle.push_back(b); }
+      for (size_t i=1;i+1<boucle.size();i++){
+	triangles[cas].push_back(boucle[0]);
+	triangles[cas].push_back(boucle[i]);
+	triangles[cas].push_back(boucle[i+1]);
+      }
+    }
+  }
+}
+
+#endif
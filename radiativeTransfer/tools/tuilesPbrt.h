@@ -0,0 +1,105 @@
+//format du fichier de tuiles de la forme "tiledmesh" de pbrt, commun a
+//Noff2Pbrt --tiles et volRemesh, et BVH d'une tuile. A inclure apres
+//"using namespace std;" dans un seul fichier source par programme.
+
+#ifndef TUILESPBRT_H
+#define TUILESPBRT_H
+
+//structures du fichier : elles doivent rester identiques a celles de
+//shapes/tiledmesh.h dans pbrt. volRemesh garde dans le champ pad d'une tuile
+//le numero de sa brique, que pbrt ignore.
+struct EnteteTuiles {
+  char magic[8];
+  uint32_t version;
+  uint32_t nTuiles;
+  uint64_t nTriangles;
+  float bornes[2][3];
+};
+
+struct InfoTuile {
+  float bornes[2][3];
+  uint64_t decalage;
+  uint64_t premierTriangle;
+  uint32_t nSommets, nTriangles, nNoeuds;
+  uint32_t pad;
+};
+
+struct NoeudBVH {
+  float bornes[2][3];
+  uint32_t decalage;
+  uint8_t nTriangles;
+  uint8_t axe;
+  uint8_t pad[2];
+};
+
+//"PBRTTILE" et TILEDMESH_VERSION de pbrt
+static const char magicTuiles[8]={'P','B','R','T','T','I','L','E'};
+static const uint32_t versionTuiles=1;
+
+//chaque tuile commence sur une frontiere de page
+static const uint64_t alignement=4096;
+
+static inline uint64_t tailleTuile(const InfoTuile &info)
+{
+  return info.nNoeuds*sizeof(NoeudBVH)+2*3*info.nSommets*sizeof(float)+3*info.nTriangles*sizeof(int32_t);
+}
+
+
+//un triangle pendant la construction du BVH d'une tuile
+struct TriangleTuile {
+  int32_t indices[3];
+  float centre[3];
+  float bornes[2][3];
+};
+
+struct CompareCentres {
+  CompareCentres(int a) : axe(a) {}
+  int axe;
+  bool operator()(const TriangleTuile &a, const TriangleTuile &b) const {
+    return a.centre[axe] < b.centre[axe];
+  }
+};
+
+
+//BVH par coupe mediane, noeuds ranges en profondeur d'abord comme dans pbrt
+uint32_t construitBVH(vector<TriangleTuile> &triangles, uint32_t debut, uint32_t fin, vector<NoeudBVH> &noeuds)
+{
+  uint32_t numero=noeuds.size();
+  noeuds.push_back(NoeudBVH());
+  NoeudBVH noeud;
+  float cmin[3], cmax[3];
+  for (int a=0;a<3;a++){
+    noeud.bornes[0][a]=triangles[debut].bornes[0][a];
+    noeud.bornes[1][a]=triangles[debut].bornes[1][a];
+    cmin[a]=cmax[a]=triangles[debut].centre[a];
+  }
+  for (uint32_t i=debut+1;i<fin;i++)
+    for (int a=0;a<3;a++){
+      noeud.bornes[0][a]=min(noeud.bornes[0][a],triangles[i].bornes[0][a]);
+      noeud.bornes[1][a]=max(noeud.bornes[1][a],triangles[i].bornes[1][a]);
+      cmin[a]=min(cmin[a],triangles[i].centre[a]);
+      cmax[a]=max(cmax[a],triangles[i].centre[a]);
+    }
+  int axe=0;
+  for (int a=1;a<3;a++)
+    if (cmax[a]-cmin[a] > cmax[axe]-cmin[axe]) axe=a;
+  uint32_t n=fin-debut;
+  if (n<=4 || (cmax[axe]==cmin[axe] && n<=255)){
+    //feuille : les triangles sont deja contigus
+    noeud.decalage=debut;
+    noeud.nTriangles=n;
+    noeud.axe=0;
+    noeuds[numero]=noeud;
+    return numero;
+  }
+  uint32_t milieu=(debut+fin)/2;
+  nth_element(triangles.begin()+debut, triangles.begin()+milieu, triangles.begin()+fin, CompareCentres(axe));
+  construitBVH(triangles, debut, milieu, noeuds);
+  noeud.decalage=construitBVH(triangles, milieu, fin, noeuds);
+  noeud.nTriangles=0;
+  noeud.axe=axe;
+  noeuds[numero]=noeud;
+  return numero;
+}
+
+#endif
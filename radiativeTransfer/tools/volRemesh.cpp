@@ -0,0 +1,609 @@
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include "ImageContainerByMmapVol.h"
+
+
+using namespace std;
+
+#include "scenePbrt.h"
+#include "tableMarchingCubes.h"
+#include "tuilesPbrt.h"
+
+//surface d'une suite d'etats d'un echantillon (deformation3d --outputFormat
+//vol) par marching cubes, sans tout remailler a chaque etat : le volume est
+//coupe en briques de cubes, chaque brique non vide est une tuile du fichier
+//de la forme "tiledmesh" de pbrt. Avec --previous, seules les briques ou le
+//champ a change entre les deux volumes sont extraites de nouveau, ajoutees a
+//la fin du fichier de tuiles, et la table des tuiles est reecrite en place.
+
+
+double maintenant()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+
+//le volume projete en memoire et la grille des briques. Les coordonnees
+//sont celles du champ de marchingCubes : le voxel (x,y,z) du volume est au
+//point (x+1,y+1,z+1), entoure d'une couche d'air, et le cube (x,y,z) va du
+//point (x,y,z) au point (x+1,y+1,z+1).
+struct Grille {
+  const unsigned char *voxels;
+  int nx, ny, nz;              //dimensions du volume
+  int n[3];                    //dimensions du champ, couche d'air comprise
+  int seuilMin, seuilMax;      //la glace est dans ]seuilMin, seuilMax]
+  float sigma;
+  vector<float> noyau;         //noyau gaussien, vide si sigma = 0
+  int brique;                  //cote d'une brique en cubes
+  int nBriques[3];
+  bool glace(int x, int y, int z) const {
+    //point du champ ; hors du volume, c'est de l'air
+    if (x<1 || y<1 || z<1 || x>nx || y>ny || z>nz) return false;
+    unsigned char v=voxels[((size_t)(z-1)*ny+(y-1))*nx+(x-1)];
+    return v>seuilMin && v<=seuilMax;
+  }
+  uint32_t nombreBriques() const { return nBriques[0]*nBriques[1]*nBriques[2]; }
+};
+
+void initialiseGrille(Grille &g)
+{
+  g.n[0]=g.nx+2; g.n[1]=g.ny+2; g.n[2]=g.nz+2;
+  for (int k=0;k<3;k++) g.nBriques[k]=(g.n[k]-1+g.brique-1)/g.brique;
+  g.noyau.clear();
+  if (g.sigma>0){
+    //le meme noyau que marchingCubes
+    float sigma=g.sigma;
+    int r=(int)ceil(3*sigma);
+    g.noyau.resize(2*r+1);
+    float somme=0;
+    for (int d=-r;d<=r;d++) somme+=g.noyau[d+r]=exp(-d*d/(2*sigma*sigma));
+    for (int d=0;d<=2*r;d++) g.noyau[d]/=somme;
+  }
+}
+
+
+//le champ d'une brique : les points dont dependent ses cubes (leurs coins et
+//leurs voisins pour le gradient), lisse comme marchingCubes lisse tout le
+//champ. Les sommes sont faites dans le meme ordre, donc la surface d'une
+//brique est exactement celle de marchingCubes.
+struct ChampLocal {
+  int o[3], n[3];       //origine et dimensions dans le champ global
+  int global[3];        //dimensions du champ global
+  vector<float> v, a, b;
+  float operator()(int x, int y, int z) const { return v[((size_t)(z-o[2])*n[1]+(y-o[1]))*n[0]+(x-o[0])]; }
+};
+
+void calculeChampLocal(const Grille &g, const int c0[3], const int c1[3], ChampLocal &c)
+{
+  for (int k=0;k<3;k++){
+    c.o[k]=max(c0[k]-1,0);
+    c.n[k]=min(c1[k]+1,g.n[k]-1)-c.o[k]+1;
+    c.global[k]=g.n[k];
+  }
+  size_t taille=(size_t)c.n[0]*c.n[1]*c.n[2];
+  c.v.resize(taille);
+  int r=g.noyau.size()/2;
+  if (r==0){
+    for (int z=0;z<c.n[2];z++)
+      for (int y=0;y<c.n[1];y++)
+	for (int x=0;x<c.n[0];x++)
+	  c.v[((size_t)z*c.n[1]+y)*c.n[0]+x]=g.glace(c.o[0]+x,c.o[1]+y,c.o[2]+z);
+    return;
+  }
+  //seuillage sur la boite elargie de r, puis un axe a la fois : x sur
+  //toute la boite en y et z, y sur la boite en z, z sur la boite du champ
+  int t[3]={c.n[0]+2*r,c.n[1]+2*r,c.n[2]+2*r};
+  c.a.resize((size_t)t[0]*t[1]*t[2]);
+  for (int z=0;z<t[2];z++)
+    for (int y=0;y<t[1];y++)
+      for (int x=0;x<t[0];x++)
+	c.a[((size_t)z*t[1]+y)*t[0]+x]=g.glace(c.o[0]-r+x,c.o[1]-r+y,c.o[2]-r+z);
+  const vector<float> &noyau=g.noyau;
+  c.b.resize((size_t)c.n[0]*t[1]*t[2]);
+  for (int z=0;z<t[2];z++)
+    for (int y=0;y<t[1];y++){
+      const float *ligne=&c.a[((size_t)z*t[1]+y)*t[0]];
+      float *sortie=&c.b[((size_t)z*t[1]+y)*c.n[0]];
+      for (int x=0;x<c.n[0];x++){
+	float somme=0;
+	for (int d=0;d<=2*r;d++) somme+=noyau[d]*ligne[x+d];
+	sortie[x]=somme;
+      }
+    }
+  c.a.resize((size_t)c.n[0]*c.n[1]*t[2]);
+  for (int z=0;z<t[2];z++)
+    for (int y=0;y<c.n[1];y++)
+      for (int x=0;x<c.n[0];x++){
+	float somme=0;
+	for (int d=0;d<=2*r;d++) somme+=noyau[d]*c.b[((size_t)z*t[1]+y+d)*c.n[0]+x];
+	c.a[((size_t)z*c.n[1]+y)*c.n[0]+x]=somme;
+      }
+  size_t plan=(size_t)c.n[0]*c.n[1];
+  for (int z=0;z<c.n[2];z++)
+    for (size_t i=0;i<plan;i++){
+      float somme=0;
+      for (int d=0;d<=2*r;d++) somme+=noyau[d]*c.a[(z+d)*plan+i];
+      c.v[z*plan+i]=somme;
+    }
+  //la couche d'air est remise a zero pour fermer la surface
+  for (int z=0;z<c.n[2];z++)
+    for (int y=0;y<c.n[1];y++)
+      for (int x=0;x<c.n[0];x++){
+	int p[3]={c.o[0]+x,c.o[1]+y,c.o[2]+z};
+	for (int k=0;k<3;k++)
+	  if (p[k]==0 || p[k]==g.n[k]-1) c.v[((size_t)z*c.n[1]+y)*c.n[0]+x]=0;
+      }
+}
+
+//gradient par differences centrees (decentrees sur le bord du champ)
+static void gradient(const ChampLocal &c, int x, int y, int z, float g[3])
+{
+  const int p[3]={x,y,z};
+  for (int k=0;k<3;k++){
+    int a[3]={x,y,z}, b[3]={x,y,z};
+    a[k]=max(p[k]-1,0);
+    b[k]=min(p[k]+1,c.global[k]-1);
+    g[k]=(c(b[0],b[1],b[2])-c(a[0],a[1],a[2]))/(b[k]-a[k]);
+  }
+}
+
+
+//une brique extraite, prete a etre ecrite comme une tuile
+struct Tuile {
+  uint32_t brique;
+  InfoTuile info;
+  vector<NoeudBVH> noeuds;
+  vector<float> P, N;
+  vector<int32_t> indices;
+};
+
+void extraitBrique(const Grille &g, uint32_t brique, ChampLocal &c, Tuile &t)
+{
+  t.brique=brique;
+  t.noeuds.clear(); t.P.clear(); t.N.clear(); t.indices.clear();
+  int b[3]={(int)(brique%g.nBriques[0]),(int)(brique/g.nBriques[0]%g.nBriques[1]),(int)(brique/g.nBriques[0]/g.nBriques[1])};
+  int c0[3], c1[3];
+  for (int k=0;k<3;k++){
+    c0[k]=b[k]*g.brique;
+    c1[k]=min(c0[k]+g.brique,g.n[k]-1);
+  }
+  calculeChampLocal(g,c0,c1,c);
+
+  //les sommets sont sur les aretes de la grille issues des points
+  //[c0, c1], numerotes a leur premier triangle
+  int m[3]={c1[0]-c0[0]+1,c1[1]-c0[1]+1,c1[2]-c0[2]+1};
+  vector<int32_t> numeros((size_t)3*m[0]*m[1]*m[2],-1);
+  vector<TriangleTuile> faces;
+  for (int z=c0[2];z<c1[2];z++)
+    for (int y=c0[1];y<c1[1];y++)
+      for (int x=c0[0];x<c1[0];x++){
+	int cas=0;
+	for (int k=0;k<8;k++)
+	  if (c(x+(k&1),y+((k>>1)&1),z+((k>>2)&1))>isovaleur) cas|=1<<k;
+	const vector<unsigned char> &aretes=triangles[cas];
+	for (size_t i=0;i<aretes.size();i+=3){
+	  TriangleTuile tri;
+	  for (int j=0;j<3;j++){
+	    int a=aretes[i+j], coin=coinsArete[a][0], k=axeArete[a];
+	    int p[3]={x+(coin&1),y+((coin>>1)&1),z+((coin>>2)&1)};
+	    int32_t &numero=numeros[3*(((size_t)(p[2]-c0[2])*m[1]+p[1]-c0[1])*m[0]+p[0]-c0[0])+k];
+	    if (numero<0){
+	      //nouveau sommet, calcule comme dans marchingCubes
+	      numero=t.P.size()/3;
+	      int q[3]={p[0],p[1],p[2]};
+	      q[k]++;
+	      float f0=c(p[0],p[1],p[2]), f1=c(q[0],q[1],q[2]);
+	      float s=(isovaleur-f0)/(f1-f0);
+	      float position[3]={p[0]-.5f,p[1]-.5f,p[2]-.5f};
+	      position[k]+=s;
+	      float g0[3], g1[3], n[3];
+	      gradient(c,p[0],p[1],p[2],g0);
+	      gradient(c,q[0],q[1],q[2],g1);
+	      for (int l=0;l<3;l++) n[l]=-((1-s)*g0[l]+s*g1[l]);
+	      float longueur=sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+	      if (longueur>0)
+		for (int l=0;l<3;l++) n[l]/=longueur;
+	      else {
+		n[0]=n[1]=n[2]=0;
+		n[k]=f0>isovaleur ? 1 : -1;
+	      }
+	      for (int l=0;l<3;l++){
+		t.P.push_back(position[l]);
+		t.N.push_back(n[l]);
+	      }
+	    }
+	    tri.indices[j]=numero;
+	  }
+	  faces.push_back(tri);
+	}
+      }
+  t.info.nSommets=t.P.size()/3;
+  t.info.nTriangles=faces.size();
+  t.info.nNoeuds=0;
+  t.info.pad=brique;
+  if (faces.empty()) return;
+
+  for (size_t i=0;i<faces.size();i++){
+    TriangleTuile &tri=faces[i];
+    for (int k=0;k<3;k++){
+      float p0=t.P[3*tri.indices[0]+k], p1=t.P[3*tri.indices[1]+k], p2=t.P[3*tri.indices[2]+k];
+      tri.bornes[0][k]=min(p0,min(p1,p2));
+      tri.bornes[1][k]=max(p0,max(p1,p2));
+      tri.centre[k]=.5f*(tri.bornes[0][k]+tri.bornes[1][k]);
+    }
+  }
+  construitBVH(faces, 0, faces.size(), t.noeuds);
+  t.indices.resize(3*faces.size());
+  for (size_t i=0;i<faces.size();i++)
+    for (int k=0;k<3;k++) t.indices[3*i+k]=faces[i].indices[k];
+  memcpy(t.info.bornes, t.noeuds[0].bornes, sizeof(t.info.bornes));
+  t.info.nNoeuds=t.noeuds.size();
+}
+
+
+//extraction d'un lot de briques : le thread i prend les briques i, i+n, ...
+struct LotBriques {
+  const Grille *grille;
+  const uint32_t *briques;
+  Tuile *tuiles;
+  size_t debut, fin, pas;
+};
+
+void *extraitLot(void *arg)
+{
+  LotBriques &l=*(LotBriques *)arg;
+  ChampLocal champ;
+  for (size_t i=l.debut;i<l.fin;i+=l.pas)
+    extraitBrique(*l.grille, l.briques[i], champ, l.tuiles[i]);
+  return NULL;
+}
+
+
+//extrait les briques et ecrit leurs tuiles non vides a partir de fin (aligne
+//sur 4096 octets), par lots pour ne garder en memoire qu'une partie du
+//maillage ; fin devient la fin du fichier
+void ecritBriques(const Grille &g, const vector<uint32_t> &briques, int nThreads, int descripteur, uint64_t &fin,
+		  vector<InfoTuile> &infos, uint64_t &nTriangles)
+{
+  size_t tailleLot=64*(size_t)nThreads;
+  vector<Tuile> tuiles;
+  for (size_t debut=0;debut<briques.size();debut+=tailleLot){
+    size_t n=min(tailleLot,briques.size()-debut);
+    tuiles.resize(n);
+    int nLots=min((size_t)nThreads,n);
+    vector<LotBriques> lots(nLots);
+    for (int i=0;i<nLots;i++){
+      lots[i].grille=&g; lots[i].briques=&briques[debut]; lots[i].tuiles=&tuiles[0];
+      lots[i].debut=i; lots[i].fin=n; lots[i].pas=nLots;
+    }
+    executeEnParallele(&lots[0], nLots, extraitLot);
+    for (size_t i=0;i<n;i++){
+      Tuile &t=tuiles[i];
+      if (t.info.nTriangles==0) continue;
+      fin=(fin+alignement-1)/alignement*alignement;
+      t.info.decalage=fin;
+      string donnees;
+      donnees.append((const char *)&t.noeuds[0], t.noeuds.size()*sizeof(NoeudBVH));
+      donnees.append((const char *)&t.P[0], t.P.size()*sizeof(float));
+      donnees.append((const char *)&t.N[0], t.N.size()*sizeof(float));
+      donnees.append((const char *)&t.indices[0], t.indices.size()*sizeof(int32_t));
+      if (pwrite(descripteur, donnees.data(), donnees.size(), fin)!=(ssize_t)donnees.size()){cout << "unable to write the tiles file" << endl; exit(3);}
+      fin+=donnees.size();
+      infos.push_back(t.info);
+      nTriangles+=t.info.nTriangles;
+    }
+  }
+}
+
+
+//la table est rangee par brique : premierTriangle croit avec elle comme pbrt
+//le demande. Elle est ecrite avec l'entete ; la place de toutes les briques
+//est reservee au debut du fichier, donc elle ne deborde jamais sur les tuiles.
+void ecritTable(int descripteur, vector<InfoTuile> &infos, uint32_t capacite)
+{
+  EnteteTuiles entete;
+  memcpy(entete.magic, magicTuiles, 8);
+  entete.version=versionTuiles;
+  entete.nTuiles=infos.size();
+  entete.nTriangles=0;
+  float bornes[2][3]={{FLT_MAX,FLT_MAX,FLT_MAX},{-FLT_MAX,-FLT_MAX,-FLT_MAX}};
+  for (size_t i=0;i<infos.size();i++){
+    infos[i].premierTriangle=entete.nTriangles;
+    entete.nTriangles+=infos[i].nTriangles;
+    for (int k=0;k<3;k++){
+      bornes[0][k]=min(bornes[0][k],infos[i].bornes[0][k]);
+      bornes[1][k]=max(bornes[1][k],infos[i].bornes[1][k]);
+    }
+  }
+  if (infos.empty()) memset(bornes, 0, sizeof(bornes));
+  memcpy(entete.bornes, bornes, sizeof(bornes));
+  minX=bornes[0][0]; minY=bornes[0][1]; minZ=bornes[0][2];
+  maxX=bornes[1][0]; maxY=bornes[1][1]; maxZ=bornes[1][2];
+  string table((const char *)&entete, sizeof(EnteteTuiles));
+  if (!infos.empty()) table.append((const char *)&infos[0], infos.size()*sizeof(InfoTuile));
+  table.resize(sizeof(EnteteTuiles)+(size_t)capacite*sizeof(InfoTuile), 0);
+  if (pwrite(descripteur, table.data(), table.size(), 0)!=(ssize_t)table.size()){cout << "unable to write the tiles table" << endl; exit(3);}
+}
+
+static bool compareBriques(const InfoTuile &a, const InfoTuile &b)
+{
+  return a.pad<b.pad;
+}
+
+
+//2) le volume precedent et le nouveau sont compares par tranches de z : un
+//voxel dont la glace change modifie le champ lisse a moins de r voxels, donc
+//les cubes [p-r-2, p+r+1] autour de son point p, et les briques qui les
+//contiennent sont a extraire de nouveau
+struct TrancheDifference {
+  const Grille *grille;
+  const unsigned char *avant;
+  int z0, z1;
+  vector<unsigned char> changees;
+  uint64_t voxels;
+};
+
+void *compareTranche(void *arg)
+{
+  TrancheDifference &t=*(TrancheDifference *)arg;
+  const Grille &g=*t.grille;
+  int r=g.noyau.size()/2;
+  t.changees.assign(g.nombreBriques(),0);
+  t.voxels=0;
+  for (int z=t.z0;z<t.z1;z++)
+    for (int y=0;y<g.ny;y++){
+      size_t ligne=((size_t)z*g.ny+y)*g.nx;
+      const unsigned char *a=t.avant+ligne, *b=g.voxels+ligne;
+      if (!memcmp(a,b,g.nx)) continue;
+      int derniere[2][3]={{-1,-1,-1},{-1,-1,-1}};
+      for (int x=0;x<g.nx;x++){
+	if ((a[x]>g.seuilMin && a[x]<=g.seuilMax)==(b[x]>g.seuilMin && b[x]<=g.seuilMax)) continue;
+	t.voxels++;
+	int p[3]={x+1,y+1,z+1}, b0[3], b1[3];
+	for (int k=0;k<3;k++){
+	  b0[k]=max(p[k]-r-2,0)/g.brique;
+	  b1[k]=min(p[k]+r+1,g.n[k]-2)/g.brique;
+	}
+	//les voxels voisins d'une ligne marquent en general les memes briques
+	if (!memcmp(b0,derniere[0],sizeof(b0)) && !memcmp(b1,derniere[1],sizeof(b1))) continue;
+	memcpy(derniere[0],b0,sizeof(b0)); memcpy(derniere[1],b1,sizeof(b1));
+	for (int bz=b0[2];bz<=b1[2];bz++)
+	  for (int by=b0[1];by<=b1[1];by++)
+	    for (int bx=b0[0];bx<=b1[0];bx++)
+	      t.changees[((size_t)bz*g.nBriques[1]+by)*g.nBriques[0]+bx]=1;
+      }
+    }
+  return NULL;
+}
+
+
+//un volume .vol projete en memoire
+struct VolumeProjete {
+  const unsigned char *fichier;
+  size_t taille, entete;
+  int nx, ny, nz;
+};
+
+void projetteVolume(string fichierVolume, VolumeProjete &v)
+{
+  int dimensions[3];
+  if (!DGtal::readVolHeader(fichierVolume,dimensions,v.entete)){cout << fichierVolume << " is not a vol file" << endl; exit(3);}
+  v.nx=dimensions[0]; v.ny=dimensions[1]; v.nz=dimensions[2];
+  int descripteur=open(fichierVolume.c_str(),O_RDONLY);
+  struct stat infos;
+  if (descripteur<0 || fstat(descripteur,&infos)!=0){cout << "unable to open " << fichierVolume << endl; exit(3);}
+  v.taille=v.entete+(size_t)v.nx*v.ny*v.nz;
+  if ((size_t)infos.st_size<v.taille){cout << fichierVolume << " is smaller than " << v.nx << "*" << v.ny << "*" << v.nz << " voxels" << endl; exit(3);}
+  v.fichier=(const unsigned char *)mmap(NULL, v.taille, PROT_READ, MAP_PRIVATE, descripteur, 0);
+  if (v.fichier==MAP_FAILED){cout << "unable to map " << fichierVolume << endl; exit(3);}
+  close(descripteur);
+}
+
+
+//la premiere ligne du fichier de geometrie garde les parametres du maillage
+//pour les mises a jour suivantes
+void ecritFichierGeometrie(string fichierGeomPbrt, string fichierTuiles, const Grille &g, string fichierVolume)
+{
+  ofstream fichierSortieGeom(fichierGeomPbrt.c_str());
+  fichierSortieGeom << "# volRemesh brick " << g.brique << " sigma " << g.sigma << " min " << g.seuilMin << " max " << g.seuilMax
+		    << " size " << g.nx << " " << g.ny << " " << g.nz << " volume " << fichierVolume << "\n";
+  fichierSortieGeom << "Shape \"tiledmesh\" \"string filename\" \"" << fichierTuiles << "\" \"integer maxresidentmb\" [4096]\n";
+}
+
+bool litFichierGeometrie(string fichierGeomPbrt, Grille &g, string &fichierVolume)
+{
+  ifstream fichierEntree(fichierGeomPbrt.c_str());
+  string ligne;
+  if (!getline(fichierEntree,ligne)) return false;
+  char nom[4096];
+  int lus=sscanf(ligne.c_str(), "# volRemesh brick %d sigma %f min %d max %d size %d %d %d volume %4095[^\n]",
+		 &g.brique, &g.sigma, &g.seuilMin, &g.seuilMax, &g.nx, &g.ny, &g.nz, nom);
+  if (lus<7) return false;
+  fichierVolume=lus==8 ? nom : "";
+  return g.brique>0;
+}
+
+
+int main(int argc, char *argv[])
+{
+  string fichierVolume, fichierPrecedent, fichier_sortie;
+  Grille g;
+  g.brique=32; g.seuilMin=0; g.seuilMax=255; g.sigma=1;
+  int nThreads(0);
+  float tempsApercu(0), rebut(1);
+  const char *syntaxe="syntax : <command> -i input.vol -o output [--brick b] [--min m] [--max M] [--sigma s] [--preview seconds] [--threads n]\n"
+    "         <command> -i input.vol --previous previous.vol -o output [--garbage g] [--preview seconds] [--threads n]\n";
+
+  for (int i=1; i<argc;i++){
+    if (!strcmp(argv[i],"--help") || !strcmp(argv[i],"-h")){cout << syntaxe; return 0;}
+    else if ((!strcmp(argv[i],"--input") || !strcmp(argv[i],"-i")) && i+1<argc) fichierVolume=argv[++i];
+    else if ((!strcmp(argv[i],"--previous") || !strcmp(argv[i],"-P")) && i+1<argc) fichierPrecedent=argv[++i];
+    else if ((!strcmp(argv[i],"--output") || !strcmp(argv[i],"-o")) && i+1<argc) fichier_sortie=argv[++i];
+    else if ((!strcmp(argv[i],"--brick") || !strcmp(argv[i],"-b")) && i+1<argc) g.brique=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--min") || !strcmp(argv[i],"-m")) && i+1<argc) g.seuilMin=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--max") || !strcmp(argv[i],"-M")) && i+1<argc) g.seuilMax=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"--sigma") || !strcmp(argv[i],"-s")) && i+1<argc) g.sigma=atof(argv[++i]);
+    else if ((!strcmp(argv[i],"--garbage") || !strcmp(argv[i],"-g")) && i+1<argc) rebut=atof(argv[++i]);
+    else if ((!strcmp(argv[i],"--preview") || !strcmp(argv[i],"-p")) && i+1<argc) tempsApercu=atof(argv[++i]);
+    else if ((!strcmp(argv[i],"--threads") || !strcmp(argv[i],"-j")) && i+1<argc) nThreads=atoi(argv[++i]);
+  }
+  if (fichierVolume.empty() || fichier_sortie.empty() || g.sigma<0 || g.brique<=0 || rebut<0){
+    cout << syntaxe;
+    exit(1);
+  }
+  int n=nThreads>0 ? nThreads : max(1L,sysconf(_SC_NPROCESSORS_ONLN));
+  double debut=maintenant(), etape=debut;
+  construitTable();
+  string fichierGeomPbrt=fichier_sortie+"Geometry.pbrt", fichierTuiles=fichier_sortie+"Geometry.tiles";
+
+  VolumeProjete volume;
+  projetteVolume(fichierVolume, volume);
+
+  if (fichierPrecedent.empty()){
+    //1) maillage complet : toutes les briques, dans l'ordre
+    g.voxels=volume.fichier+volume.entete;
+    g.nx=volume.nx; g.ny=volume.ny; g.nz=volume.nz;
+    initialiseGrille(g);
+    uint32_t nBriques=g.nombreBriques();
+    vector<uint32_t> briques(nBriques);
+    for (uint32_t b=0;b<nBriques;b++) briques[b]=b;
+    int descripteur=open(fichierTuiles.c_str(),O_RDWR|O_CREAT|O_TRUNC,0644);
+    if (descripteur<0){cout << "unable to create " << fichierTuiles << endl; exit(3);}
+    uint64_t fin=sizeof(EnteteTuiles)+(uint64_t)nBriques*sizeof(InfoTuile), nTriangles=0;
+    vector<InfoTuile> infos;
+    ecritBriques(g, briques, n, descripteur, fin, infos, nTriangles);
+    ecritTable(descripteur, infos, nBriques);
+    close(descripteur);
+    ecritFichierGeometrie(fichierGeomPbrt, fichierTuiles, g, fichierVolume);
+    cout << nTriangles << " triangles extracted in " << infos.size() << " tiles of " << nBriques << " bricks (" << g.brique
+	 << " cubes wide) in " << maintenant()-etape << " s" << endl;
+  }
+  else {
+    //2) mise a jour : les parametres sont ceux du maillage existant
+    string volumeMaille;
+    if (!litFichierGeometrie(fichierGeomPbrt, g, volumeMaille)){cout << fichierGeomPbrt << " was not written by volRemesh : mesh the first state without --previous" << endl; exit(3);}
+    if (!volumeMaille.empty() && volumeMaille!=fichierPrecedent)
+      cout << "warning : the mesh was extracted from " << volumeMaille << ", not from " << fichierPrecedent << endl;
+    VolumeProjete precedent;
+    projetteVolume(fichierPrecedent, precedent);
+    if (precedent.nx!=g.nx || precedent.ny!=g.ny || precedent.nz!=g.nz || volume.nx!=g.nx || volume.ny!=g.ny || volume.nz!=g.nz){
+      cout << "the volumes must have the size of the mesh (" << g.nx << "*" << g.ny << "*" << g.nz << ")" << endl;
+      exit(3);
+    }
+    g.voxels=volume.fichier+volume.entete;
+    initialiseGrille(g);
+    uint32_t nBriques=g.nombreBriques();
+
+    int nTranches=min(n,g.nz);
+    vector<TrancheDifference> differences(nTranches);
+    for (int i=0;i<nTranches;i++){
+      TrancheDifference &t=differences[i];
+      t.grille=&g; t.avant=precedent.fichier+precedent.entete;
+      t.z0=(int)((long)g.nz*i/nTranches);
+      t.z1=(int)((long)g.nz*(i+1)/nTranches);
+    }
+    executeEnParallele(&differences[0], nTranches, compareTranche);
+    munmap((void *)precedent.fichier, precedent.taille);
+    vector<uint32_t> briques;
+    uint64_t voxelsChanges=0;
+    for (int i=0;i<nTranches;i++) voxelsChanges+=differences[i].voxels;
+    for (uint32_t b=0;b<nBriques;b++){
+      bool changee=false;
+      for (int i=0;i<nTranches;i++) changee|=differences[i].changees[b];
+      if (changee) briques.push_back(b);
+    }
+    cout << voxelsChanges << " voxels changed, " << briques.size() << " of " << nBriques << " bricks to extract again (compared in "
+	 << maintenant()-etape << " s)" << endl;
+    etape=maintenant();
+
+    //l'ancienne table, sans les briques extraites de nouveau
+    int descripteur=open(fichierTuiles.c_str(),O_RDWR);
+    if (descripteur<0){cout << "unable to open " << fichierTuiles << endl; exit(3);}
+    EnteteTuiles entete;
+    if (pread(descripteur, &entete, sizeof(entete), 0)!=sizeof(entete) || memcmp(entete.magic,magicTuiles,8) || entete.version!=versionTuiles || entete.nTuiles>nBriques){
+      cout << fichierTuiles << " is not the tiles file of this mesh" << endl;
+      exit(3);
+    }
+    vector<InfoTuile> anciennes(entete.nTuiles), infos;
+    size_t tailleTable=entete.nTuiles*sizeof(InfoTuile);
+    if (entete.nTuiles>0 && pread(descripteur, &anciennes[0], tailleTable, sizeof(entete))!=(ssize_t)tailleTable){cout << "truncated tiles table in " << fichierTuiles << endl; exit(3);}
+    uint64_t utiles=0;
+    for (size_t i=0;i<anciennes.size();i++){
+      if (anciennes[i].pad>=nBriques){cout << fichierTuiles << " is not the tiles file of this mesh" << endl; exit(3);}
+      if (binary_search(briques.begin(), briques.end(), anciennes[i].pad)) continue;
+      infos.push_back(anciennes[i]);
+      utiles+=tailleTuile(anciennes[i]);
+    }
+
+    //les nouvelles tuiles a la fin du fichier
+    struct stat etat;
+    fstat(descripteur,&etat);
+    uint64_t debutDonnees=sizeof(EnteteTuiles)+(uint64_t)nBriques*sizeof(InfoTuile);
+    uint64_t fin=max((uint64_t)etat.st_size,debutDonnees), ancienneFin=fin, nTriangles=0;
+    size_t nouvelles=infos.size();
+    ecritBriques(g, briques, n, descripteur, fin, infos, nTriangles);
+    for (size_t i=nouvelles;i<infos.size();i++) utiles+=tailleTuile(infos[i]);
+    inplace_merge(infos.begin(), infos.begin()+nouvelles, infos.end(), compareBriques);
+    uint64_t ajoutes=fin-ancienneFin;
+
+    //3) quand les anciennes tuiles occupent plus de --garbage fois la place
+    //des tuiles utiles, le fichier est recopie sans elles
+    bool compacte=fin-debutDonnees > (1+rebut)*utiles+alignement*infos.size();
+    if (compacte){
+      string fichierTemp=fichierTuiles+".tmp";
+      int sortie=open(fichierTemp.c_str(),O_RDWR|O_CREAT|O_TRUNC,0644);
+      if (sortie<0){cout << "unable to create " << fichierTemp << endl; exit(3);}
+      uint64_t position=debutDonnees;
+      vector<char> tampon;
+      for (size_t i=0;i<infos.size();i++){
+	tampon.resize(tailleTuile(infos[i]));
+	position=(position+alignement-1)/alignement*alignement;
+	if (pread(descripteur, &tampon[0], tampon.size(), infos[i].decalage)!=(ssize_t)tampon.size() ||
+	    pwrite(sortie, &tampon[0], tampon.size(), position)!=(ssize_t)tampon.size()){cout << "unable to compact " << fichierTuiles << endl; exit(3);}
+	infos[i].decalage=position;
+	position+=tampon.size();
+      }
+      close(descripteur);
+      descripteur=sortie;
+      ecritTable(descripteur, infos, nBriques);
+      close(descripteur);
+      if (rename(fichierTemp.c_str(), fichierTuiles.c_str())!=0){cout << "unable to replace " << fichierTuiles << endl; exit(3);}
+    }
+    else {
+      //les tuiles d'abord, la table ensuite
+      fdatasync(descripteur);
+      ecritTable(descripteur, infos, nBriques);
+      close(descripteur);
+    }
+    ecritFichierGeometrie(fichierGeomPbrt, fichierTuiles, g, fichierVolume);
+    cout << nTriangles << " triangles extracted again in " << maintenant()-etape << " s ; " << ajoutes/1048576. << " MB appended to "
+	 << fichierTuiles << (compacte ? ", compacted" : "") << endl;
+  }
+  munmap((void *)volume.fichier, volume.taille);
+  etape=maintenant();
+
+  ecritFichierPbrt(fichier_sortie+"Image.pbrt",fichierGeomPbrt,fichier_sortie+".exr",tempsApercu);
+  ecritFichierPhoton(fichier_sortie+"Photon.pbrt",fichierGeomPbrt);
+
+  cout << "scene files written in " << maintenant()-etape << " s" << endl;
+
+  cout << "surface written in " << maintenant()-debut << " s ; photon launcher : pbrt -p -w <wavelength> -x " << g.nx << " -y " << g.ny << " -z " << g.nz << " -r <voxel size> " << fichier_sortie << "Photon.pbrt" << endl;
+  return 0;
+}
@@ -26,13 +26,21 @@
  */
 
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <DGtal/base/Common.h>
-#include <DGtal/io/readers/VolReader.h>
-#include <DGtal/io/writers/VolWriter.h>
 #include <DGtal/helpers/StdDefs.h>
-#include "DGtal/io/colormaps/GrayscaleColorMap.h"
-#include <DGtal/images/Image.h>
-#include <DGtal/images/ImageContainerBySTLVector.h>
+#include "ImageContainerByMmapVol.h"
+#include "ImageContainerByBits.h"
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/parsers.hpp>
@@ -40,7 +48,6 @@
 
 using namespace std;
 using namespace DGtal;
-using namespace Z3i;
 
 namespace po = boost::program_options;
 
@@ -58,6 +65,130 @@ void missingParam ( std::string param )
 }
 
 
+/**
+ * How the values of a factor^3 block are reduced to one voxel.
+ */
+enum Reduction { LAST, MAJORITY, ANY, ALL, MEAN };
+
+
+/**
+ * Sub-sampling job shared by the threads. The volume is processed by
+ * z-slabs: each thread reads the factor input slices of one output slice
+ * with pread, reduces them and writes the output slice with pwrite, so
+ * that only (factor+1) slices per thread are in memory.
+ */
+struct SubSampling
+{
+  int input, output;
+  off_t inputData, outputData;
+  int nx, ny, nz;          ///< input extent
+  int mx, my, mz;          ///< output extent, margin included
+  int factor, margin;
+  Reduction reduction;
+  pthread_mutex_t lock;
+  int nextSlice, doneSlices;
+  bool failed;
+};
+
+
+/**
+ * Reduces the block of output voxel (x, y) from the factor input slices
+ * in slab (slab[k] is slice k of the block, kz of them available).
+ */
+static inline unsigned char reduceBlock( const SubSampling &s, const vector<unsigned char> &slab,
+                                         int kz, int x, int y, unsigned int *histogram,
+                                         vector<unsigned char> &values )
+{
+  const size_t sliceSize = (size_t)s.nx*s.ny;
+  int x0 = x*s.factor, x1 = min(x0+s.factor, s.nx);
+  int y0 = y*s.factor, y1 = min(y0+s.factor, s.ny);
+  if ( s.reduction == LAST )
+    //like the former volSubSample: the last voxel of the block wins
+    return slab[ (kz-1)*sliceSize + (size_t)(y1-1)*s.nx + x1-1 ];
+
+  unsigned int sum = 0, count = 0;
+  unsigned char lowest = 255, highest = 0;
+  values.clear();
+  for ( int k = 0; k < kz; k++ )
+    for ( int y = y0; y < y1; y++ )
+      {
+        const unsigned char *line = &slab[ k*sliceSize + (size_t)y*s.nx ];
+        for ( int x = x0; x < x1; x++ )
+          {
+            unsigned char v = line[x];
+            sum += v;
+            lowest = min(lowest, v);
+            highest = max(highest, v);
+            if ( s.reduction == MAJORITY ) { histogram[v]++; values.push_back(v); }
+          }
+        count += x1-x0;
+      }
+  switch ( s.reduction )
+    {
+    case ANY: return highest;
+    case ALL: return lowest;
+    case MEAN: return (unsigned char)((sum + count/2) / count);
+    default: break;
+    }
+  //most frequent value, ties go to the highest one
+  unsigned char best = 0;
+  unsigned int bestCount = 0;
+  for ( size_t i = 0; i < values.size(); i++ )
+    {
+      unsigned char v = values[i];
+      if ( histogram[v] > bestCount || ( histogram[v] == bestCount && v > best ) )
+        { best = v; bestCount = histogram[v]; }
+    }
+  for ( size_t i = 0; i < values.size(); i++ ) histogram[values[i]] = 0;
+  return best;
+}
+
+
+/**
+ * Thread body: takes the next output slice until none is left.
+ */
+void *subSampleSlices( void *arg )
+{
+  SubSampling &s = *(SubSampling *)arg;
+  const size_t sliceSize = (size_t)s.nx*s.ny;
+  vector<unsigned char> slab( sliceSize*s.factor );
+  vector<unsigned char> out( (size_t)s.mx*s.my, 0 );
+  unsigned int histogram[256] = {0};
+  vector<unsigned char> values;
+  while ( true )
+    {
+      pthread_mutex_lock( &s.lock );
+      int z = s.nextSlice++;
+      pthread_mutex_unlock( &s.lock );
+      if ( z >= s.mz - 2*s.margin || s.failed ) break;
+
+      int z0 = z*s.factor, kz = min(s.factor, s.nz-z0);
+      size_t bytes = sliceSize*kz, read = 0;
+      while ( read < bytes )
+        {
+          ssize_t r = pread( s.input, &slab[read], bytes-read, s.inputData + (off_t)z0*sliceSize + read );
+          if ( r <= 0 ) { s.failed = true; return NULL; }
+          read += r;
+        }
+      for ( int y = 0; y < s.my - 2*s.margin; y++ )
+        {
+          unsigned char *line = &out[ (size_t)(y+s.margin)*s.mx + s.margin ];
+          for ( int x = 0; x < s.mx - 2*s.margin; x++ )
+            line[x] = reduceBlock( s, slab, kz, x, y, histogram, values );
+        }
+      off_t offset = s.outputData + (off_t)(z+s.margin)*out.size();
+      if ( pwrite( s.output, &out[0], out.size(), offset ) != (ssize_t)out.size() )
+        { s.failed = true; return NULL; }
+
+      pthread_mutex_lock( &s.lock );
+      s.doneSlices++;
+      trace.progressBar( s.doneSlices, s.mz - 2*s.margin );
+      pthread_mutex_unlock( &s.lock );
+    }
+  return NULL;
+}
+
+
 int main(int argc, char**argv)
 {
 
@@ -66,16 +197,22 @@ int main(int argc, char**argv)
   general_opt.add_options()
     ( "help,h", "display this message." )
     ( "input,i", po::value<std::string>(), "Input vol file." )
-    ( "output,o", po::value<string>(),"Output filename." );
+    ( "output,o", po::value<string>(),"Output filename." )
+    ( "factor,f", po::value<int>()->default_value(2), "Sub-sampling factor in each direction." )
+    ( "reduction,r", po::value<string>()->default_value("last"),
+      "Value of an output voxel from its factor^3 block: last (last voxel of the block, former behaviour), majority (most frequent value), any (maximum), all (minimum) or mean." )
+    ( "margin,m", po::value<int>()->default_value(1), "Width of the zero margin around the output volume." )
+    ( "threads,t", po::value<int>()->default_value(0), "Number of threads (0: one per core)." )
+    ( "packed,p", "Binary volume: the voxels > 0 are packed in memory (1 bit per voxel) and reduced 64 at a time, the output voxels are 0 or 255 (any, all or majority reduction only)." );
 
   po::variables_map vm;
   po::store ( po::parse_command_line ( argc, argv, general_opt ), vm );
   po::notify ( vm );
   if ( vm.count ( "help" ) ||argc<=1 )
     {
-      trace.info() << "brutally sub sample a vol file (division by 2 in each direction)."<<std::endl
+      trace.info() << "sub sample a vol file by an integer factor in each direction, by z-slabs (the volume is never entirely in memory)."<<std::endl
                    << std::endl << "Basic usage: "<<std::endl
-                   << "\tvolSubSample --input <volFileName> --o <volOutputFileName> "<<std::endl
+                   << "\tvolSubSample --input <volFileName> --o <volOutputFileName> [--factor 2] [--reduction last]"<<std::endl
                    << general_opt << "\n";
       return 0;
     }
@@ -86,32 +223,83 @@ int main(int argc, char**argv)
   if ( ! ( vm.count ( "output" ) ) ) missingParam ( "--output" );
   std::string outputFileName = vm["output"].as<std::string>();
 
-  trace.beginBlock("Loading file");
-  typedef ImageContainerBySTLVector<Z3i::Domain, unsigned char>  MyImageC;
+  SubSampling s;
+  s.factor = vm["factor"].as<int>();
+  s.margin = vm["margin"].as<int>();
+  std::string reduction = vm["reduction"].as<std::string>();
+  if ( reduction == "last" ) s.reduction = LAST;
+  else if ( reduction == "majority" ) s.reduction = MAJORITY;
+  else if ( reduction == "any" ) s.reduction = ANY;
+  else if ( reduction == "all" ) s.reduction = ALL;
+  else if ( reduction == "mean" ) s.reduction = MEAN;
+  else { trace.error() << "unknown reduction " << reduction << std::endl; return 1; }
+  if ( s.factor < 1 || s.margin < 0 ) { trace.error() << "bad factor or margin" << std::endl; return 1; }
+  int nThreads = vm["threads"].as<int>();
+  if ( nThreads <= 0 ) nThreads = max( 1L, sysconf( _SC_NPROCESSORS_ONLN ) );
 
-  MyImageC  imageC = VolReader< MyImageC >::importVol ( filename );
-  MyImageC  outputImage( Z3i::Domain( imageC.domain().lowerBound() - Vector().diagonal(1),
-                                      (imageC.domain().upperBound()-imageC.domain().lowerBound())/Vector().diagonal(2) + Vector().diagonal(1)));
+  if ( vm.count( "packed" ) )
+    {
+      if ( s.reduction != ANY && s.reduction != ALL && s.reduction != MAJORITY )
+        { trace.error() << "the packed volume can only be reduced by any, all or majority" << std::endl; return 1; }
+      typedef ImageContainerByBits<Z3i::Domain> Bits;
+      Bits::Reduction bitsReduction = s.reduction == ANY ? Bits::ANY :
+        s.reduction == ALL ? Bits::ALL : Bits::MAJORITY;
+      trace.beginBlock("Down-scaling the packed volume...");
+      try
+        {
+          Bits mask = importVolBits<Z3i::Domain>( filename );
+          trace.info() << mask << ": " << mask.count() << " voxels" << std::endl;
+          Bits out = mask.downsample( s.factor, bitsReduction ).addBorder( s.margin );
+          trace.info() << out << std::endl;
+          if ( ! exportVolBits( outputFileName, out ) )
+            { trace.error() << "unable to write " << outputFileName << std::endl; return 1; }
+        }
+      catch ( IOException & )
+        {
+          trace.error() << "unable to read the vol file " << filename << std::endl;
+          return 1;
+        }
+      trace.endBlock();
+      return 0;
+    }
 
+  trace.beginBlock("Opening files");
+  int extent[3];
+  std::size_t headerSize;
+  bool header = readVolHeader( filename, extent, headerSize );
+  s.nx = extent[0]; s.ny = extent[1]; s.nz = extent[2];
+  s.inputData = headerSize;
+  s.input = open( filename.c_str(), O_RDONLY );
+  if ( !header || s.input < 0 )
+    { trace.error() << "unable to read the vol file " << filename << std::endl; return 1; }
+  s.mx = (s.nx + s.factor - 1)/s.factor + 2*s.margin;
+  s.my = (s.ny + s.factor - 1)/s.factor + 2*s.margin;
+  s.mz = (s.nz + s.factor - 1)/s.factor + 2*s.margin;
+  std::string outputHeader = volHeader( s.mx, s.my, s.mz );
+  s.outputData = outputHeader.size();
+  s.output = open( outputFileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+  if ( s.output < 0 || write( s.output, outputHeader.data(), outputHeader.size() ) != (ssize_t)outputHeader.size() ||
+       ftruncate( s.output, s.outputData + (off_t)s.mx*s.my*s.mz ) != 0 )
+    { trace.error() << "unable to write " << outputFileName << std::endl; return 1; }
+  trace.info() << s.nx << "*" << s.ny << "*" << s.nz << " -> " << s.mx << "*" << s.my << "*" << s.mz << std::endl;
   trace.endBlock();
-  unsigned int cpt=0;
-  unsigned int maxS = imageC.domain().size();
-  Point subvector = Vector().diagonal(2);
 
   trace.beginBlock("Down-scaling the volume...");
-  //Fast Copy
-  for(MyImageC::Domain::ConstIterator it = imageC.domain().begin(),
-        itend = imageC.domain().end(); it != itend; ++it)
-    {
-      trace.info() << cpt; 
-      trace.progressBar( cpt, maxS);
-      cpt++;
-      outputImage.setValue( *it/subvector , imageC(*it));
-    }
+  //the margin slices are left to zero by ftruncate
+  pthread_mutex_init( &s.lock, NULL );
+  s.nextSlice = 0;
+  s.doneSlices = 0;
+  s.failed = false;
+  vector<pthread_t> threads( nThreads );
+  for ( int i = 0; i < nThreads; i++ )
+    pthread_create( &threads[i], NULL, subSampleSlices, &s );
+  for ( int i = 0; i < nThreads; i++ )
+    pthread_join( threads[i], NULL );
+  pthread_mutex_destroy( &s.lock );
   trace.endBlock();
-  
-  
-  typedef GrayscaleColorMap<unsigned char> Gray;
-  bool res =  VolWriter< MyImageC , Gray>::exportVol(outputFileName, outputImage, 0, 255);
-  if (res) return 0; else return 1;
+
+  close( s.input );
+  if ( close( s.output ) != 0 || s.failed )
+    { trace.error() << "sub-sampling of " << filename << " failed" << std::endl; return 1; }
+  return 0;
 }